@@ -10,6 +10,19 @@ fastpath_module = Extension(
         "src/fastpath/module.c",
         "src/fastpath/allocator.c",
         "src/fastpath/path.c",
+        "src/fastpath/snapshot.c",
+        "src/fastpath/fs.c",
+        "src/fastpath/column.c",
+        "src/fastpath/compact.c",
+        "src/fastpath/cache.c",
+        "src/fastpath/simd.c",
+        "src/fastpath/glob.c",
+        "src/fastpath/names.c",
+        "src/fastpath/pickle.c",
+        "src/fastpath/diff.c",
+        "src/fastpath/flavour.c",
+        "src/fastpath/blocks.c",
+        "src/fastpath/ingest.c",
     ],
     include_dirs=["src/fastpath"],
     extra_compile_args=["-O3", "-Wall"],
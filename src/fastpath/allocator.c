@@ -1,14 +1,122 @@
 #include "fastpath.h"
 
+/* ========================================================================
+ * Chunked storage
+ * ======================================================================== */
+
+/* Allocate chunk k; chunks below k that were never needed stay NULL */
+static int
+chunked_alloc(ChunkedArray *array, int k, int base_bits, size_t elem_size, int zeroed)
+{
+    if (k >= CHUNK_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "chunked array is full");
+        return -1;
+    }
+
+    size_t size = ((size_t)1 << (base_bits + k)) * elem_size;
+    char *chunk = block_alloc(size, zeroed);
+    if (chunk == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    array->chunks[k] = chunk;
+    array->base_bits = base_bits;
+    array->elem_size = (uint32_t)elem_size;
+    if (array->count <= k)
+        array->count = k + 1;
+    return 0;
+}
+
+int
+chunked_grow(ChunkedArray *array, int base_bits, size_t elem_size, int zeroed)
+{
+    return chunked_alloc(array, array->count, base_bits, elem_size, zeroed);
+}
+
+/* Point the first count chunks into one flat array */
+void
+chunked_borrow(ChunkedArray *array, char *base, int count, int base_bits, size_t elem_size)
+{
+    for (int k = 0; k < count; k++) {
+        array->chunks[k] = base + (size_t)chunk_capacity(k, base_bits) * elem_size;
+    }
+    array->count = count;
+    array->borrowed = count;
+    array->base_bits = base_bits;
+    array->elem_size = (uint32_t)elem_size;
+}
+
+void
+chunked_free(ChunkedArray *array)
+{
+    for (int k = array->borrowed; k < array->count; k++) {
+        block_free(array->chunks[k], ((size_t)1 << (array->base_bits + k)) * array->elem_size);
+    }
+    array->count = 0;
+    array->borrowed = 0;
+}
+
 /* ========================================================================
  * StringPool implementation
  * ======================================================================== */
 
+static inline uint64_t
+hash_round(uint64_t h, uint64_t word)
+{
+    h ^= word * 0xC2B2AE3D27D4EB4FULL;
+    h = (h << 31) | (h >> 33);
+    return h * 0x9E3779B97F4A7C15ULL;
+}
+
+/* Hash of a component's bytes, consumed eight at a time and finished with
+ * the murmur3 mixer.  Words are read in native byte order, which snapshots
+ * already require to match. */
+static inline uint64_t
+string_hash(const char *data, Py_ssize_t length)
+{
+    uint64_t h = 0x27D4EB2F165667C5ULL ^ ((uint64_t)length * 0x9E3779B97F4A7C15ULL);
+    Py_ssize_t pos = 0;
+    uint64_t word;
+    for (; pos + 8 <= length; pos += 8) {
+        memcpy(&word, data + pos, 8);
+        h = hash_round(h, word);
+    }
+    if (pos < length) {
+        word = 0;
+        memcpy(&word, data + pos, length - pos);
+        h = hash_round(h, word);
+    }
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline PyObject **
+string_object_slot(StringPoolObject *self, Py_ssize_t string_id)
+{
+    return (PyObject **)chunked_at(&self->objects, string_id, STRING_ENTRY_CHUNK_BITS, sizeof(PyObject *));
+}
+
 static void
 StringPool_dealloc(StringPoolObject *self)
 {
-    Py_XDECREF(self->strings);
-    Py_XDECREF(self->string_map);
+    if (self->objects.count > 0) {
+        for (Py_ssize_t i = 0; i < self->count; i++) {
+            Py_XDECREF(*string_object_slot(self, i));
+        }
+    }
+    chunked_free(&self->objects);
+    chunked_free(&self->entries);
+    chunked_free(&self->bytes);
+    chunked_free(&self->splits);
+    if (!self->table_borrowed)
+        block_free(self->table, self->table_capacity * sizeof(uint32_t));
+    if (self->snapshot.obj != NULL)
+        PyBuffer_Release(&self->snapshot);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -18,49 +126,225 @@ StringPool_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     StringPoolObject *self;
     self = (StringPoolObject *)type->tp_alloc(type, 0);
     if (self != NULL) {
-        self->strings = PyList_New(0);
-        if (self->strings == NULL) {
+        self->count = 0;
+        self->capacity = 0;
+        self->bytes_used = 0;
+        self->table_borrowed = 0;
+        self->snapshot.obj = NULL;
+
+        self->table_capacity = 64;
+        self->table = block_alloc(self->table_capacity * sizeof(uint32_t), 0);
+        if (self->table == NULL) {
             Py_DECREF(self);
-            return NULL;
-        }
-        self->string_map = PyDict_New();
-        if (self->string_map == NULL) {
-            Py_DECREF(self);
-            return NULL;
+            return PyErr_NoMemory();
         }
+        memset(self->table, 0xFF, self->table_capacity * sizeof(uint32_t));
     }
     return (PyObject *)self;
 }
 
-PyObject *
-StringPool_intern(StringPoolObject *self, PyObject *args)
+/* Copy bytes into the pool storage, returning the offset of a NUL-terminated copy */
+static Py_ssize_t
+string_bytes_store(StringPoolObject *self, const char *data, Py_ssize_t length)
 {
-    PyObject *s;
-    if (!PyArg_ParseTuple(args, "U", &s))
-        return NULL;
+    Py_ssize_t needed = length + 1;
+    Py_ssize_t offset = self->bytes_used;
+    Py_ssize_t chunk_offset;
+    int k = chunk_locate(offset, STRING_BYTES_CHUNK_BITS, &chunk_offset);
+
+    /* A string never straddles chunks; move on to the first chunk with room */
+    while (k < CHUNK_MAX && chunk_offset + needed > ((Py_ssize_t)1 << (STRING_BYTES_CHUNK_BITS + k))) {
+        k++;
+        offset = chunk_capacity(k, STRING_BYTES_CHUNK_BITS);
+        chunk_offset = 0;
+    }
+    if (k >= self->bytes.count || self->bytes.chunks[k] == NULL) {
+        if (chunked_alloc(&self->bytes, k, STRING_BYTES_CHUNK_BITS, 1, 0) < 0)
+            return -1;
+    }
+
+    char *dest = self->bytes.chunks[k] + chunk_offset;
+    memcpy(dest, data, length);
+    dest[length] = '\0';
+    self->bytes_used = offset + needed;
+    return offset;
+}
+
+static int
+string_table_resize(StringPoolObject *self, Py_ssize_t new_capacity)
+{
+    uint32_t *new_table = block_alloc(new_capacity * sizeof(uint32_t), 0);
+    if (new_table == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(new_table, 0xFF, new_capacity * sizeof(uint32_t));
+
+    size_t mask = (size_t)new_capacity - 1;
+    for (Py_ssize_t id = 0; id < self->count; id++) {
+        size_t slot = (size_t)string_entry(self, id)->hash & mask;
+        while (new_table[slot] != STRING_ID_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        new_table[slot] = (uint32_t)id;
+    }
+
+    if (!self->table_borrowed)
+        block_free(self->table, self->table_capacity * sizeof(uint32_t));
+    self->table = new_table;
+    self->table_capacity = new_capacity;
+    self->table_borrowed = 0;
+    return 0;
+}
+
+/* Find the table slot holding the given bytes, or the empty slot to use */
+static inline size_t
+string_table_probe(StringPoolObject *self, const char *data, Py_ssize_t length, uint64_t hash)
+{
+    size_t mask = (size_t)self->table_capacity - 1;
+    size_t slot = (size_t)hash & mask;
+
+    for (;;) {
+        uint32_t id = self->table[slot];
+        if (id == STRING_ID_NONE)
+            return slot;
+        StringEntry *entry = string_entry(self, id);
+        if (entry->hash == hash && entry->length == (uint64_t)length &&
+            memcmp(string_entry_data(self, entry), data, length) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static Py_ssize_t
+string_pool_lookup(StringPoolObject *self, const char *data, Py_ssize_t length)
+{
+    size_t slot = string_table_probe(self, data, length, string_hash(data, length));
+    uint32_t id = self->table[slot];
+    return id == STRING_ID_NONE ? -1 : (Py_ssize_t)id;
+}
 
-    /* Check if string already exists */
-    PyObject *existing = PyDict_GetItem(self->string_map, s);
-    if (existing != NULL) {
-        Py_INCREF(existing);
-        return existing;
+/* Intern without locking; the caller holds the pool's critical section */
+Py_ssize_t
+string_pool_intern(StringPoolObject *self, const char *data, Py_ssize_t length)
+{
+    uint64_t hash = string_hash(data, length);
+    size_t slot = string_table_probe(self, data, length, hash);
+    if (self->table[slot] != STRING_ID_NONE) {
+        FASTPATH_COUNT(self->counters.intern_hits, 1);
+        return self->table[slot];
     }
 
     /* Add new string */
-    Py_ssize_t string_id = PyList_Size(self->strings);
-    if (PyList_Append(self->strings, s) < 0)
+    if (self->count >= (Py_ssize_t)STRING_ID_NONE) {
+        PyErr_SetString(PyExc_OverflowError, "string pool is full");
+        return -1;
+    }
+    if ((uint64_t)length >= UINT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "string is too long to intern");
+        return -1;
+    }
+
+    if (self->count >= self->capacity) {
+        if (self->entries.count == self->objects.count &&
+            chunked_grow(&self->entries, STRING_ENTRY_CHUNK_BITS, sizeof(StringEntry), 0) < 0)
+            return -1;
+        if (chunked_grow(&self->objects, STRING_ENTRY_CHUNK_BITS, sizeof(PyObject *), 1) < 0)
+            return -1;
+        self->capacity = chunk_capacity(self->objects.count, STRING_ENTRY_CHUNK_BITS);
+    }
+
+    /* Keep the table at most half full */
+    if ((self->count + 1) * 2 > self->table_capacity) {
+        if (string_table_resize(self, self->table_capacity * 2) < 0)
+            return -1;
+        slot = string_table_probe(self, data, length, hash);
+    }
+
+    Py_ssize_t offset = string_bytes_store(self, data, length);
+    if (offset < 0)
+        return -1;
+
+    Py_ssize_t string_id = self->count;
+    StringEntry *entry = string_entry(self, string_id);
+    entry->offset = (uint64_t)offset;
+    entry->hash = hash;
+    entry->length = (uint32_t)length;
+    entry->reserved = 0;
+    self->table[slot] = (uint32_t)string_id;
+    self->count++;
+    FASTPATH_COUNT(self->counters.intern_misses, 1);
+
+    return string_id;
+}
+
+Py_ssize_t
+StringPool_lookup_bytes(StringPoolObject *self, const char *data, Py_ssize_t length)
+{
+    Py_ssize_t string_id;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    string_id = string_pool_lookup(self, data, length);
+    Py_END_CRITICAL_SECTION();
+    return string_id;
+}
+
+Py_ssize_t
+StringPool_intern_bytes(StringPoolObject *self, const char *data, Py_ssize_t length)
+{
+    Py_ssize_t string_id;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    string_id = string_pool_intern(self, data, length);
+    Py_END_CRITICAL_SECTION();
+    return string_id;
+}
+
+PyObject *
+StringPool_get_object(StringPoolObject *self, Py_ssize_t string_id)
+{
+    if (string_id < 0 || string_id >= self->count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid string ID");
         return NULL;
+    }
 
-    PyObject *id_obj = PyLong_FromSsize_t(string_id);
-    if (id_obj == NULL)
+    /* Published objects are never replaced, so the fast path needs no lock */
+    PyObject **slot = string_object_slot(self, string_id);
+    PyObject *result = *slot;
+    if (result == NULL) {
+        Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+        result = *slot;
+        if (result == NULL) {
+            StringEntry *entry = string_entry(self, string_id);
+            result = PyUnicode_DecodeUTF8(string_entry_data(self, entry), entry->length, "surrogateescape");
+            *slot = result;
+            FASTPATH_COUNT(self->counters.objects_created, result != NULL);
+        }
+        Py_END_CRITICAL_SECTION();
+        if (result == NULL)
+            return NULL;
+    }
+
+    Py_INCREF(result);
+    return result;
+}
+
+PyObject *
+StringPool_intern(StringPoolObject *self, PyObject *args)
+{
+    PyObject *s;
+    if (!PyArg_ParseTuple(args, "O", &s))
         return NULL;
 
-    if (PyDict_SetItem(self->string_map, s, id_obj) < 0) {
-        Py_DECREF(id_obj);
+    /* Names are interned as the bytes a path argument encodes to */
+    PyObject *owned;
+    Py_ssize_t length;
+    const char *data = path_argument_bytes(s, &length, &owned);
+    Py_ssize_t string_id = data == NULL ? -1 : StringPool_intern_bytes(self, data, length);
+    Py_XDECREF(owned);
+    if (string_id < 0)
         return NULL;
-    }
 
-    return id_obj;
+    return PyLong_FromSsize_t(string_id);
 }
 
 PyObject *
@@ -70,18 +354,13 @@ StringPool_get_string(StringPoolObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "n", &string_id))
         return NULL;
 
-    PyObject *result = PyList_GetItem(self->strings, string_id);
-    if (result == NULL)
-        return NULL;
-
-    Py_INCREF(result);
-    return result;
+    return StringPool_get_object(self, string_id);
 }
 
 static Py_ssize_t
 StringPool_length(StringPoolObject *self)
 {
-    return PyList_Size(self->strings);
+    return self->count;
 }
 
 static PyMethodDef StringPool_methods[] = {
@@ -89,6 +368,12 @@ static PyMethodDef StringPool_methods[] = {
      "Intern a string and return its ID"},
     {"get_string", (PyCFunction)StringPool_get_string, METH_VARARGS,
      "Get the string associated with an ID"},
+    {"suffix_id", (PyCFunction)StringPool_suffix_id_py, METH_VARARGS,
+     "Get the ID of a string's suffix, the empty string's ID if it has none"},
+    {"stem_id", (PyCFunction)StringPool_stem_id_py, METH_VARARGS,
+     "Get the ID of a string with its suffix removed"},
+    {"fold_id", (PyCFunction)StringPool_fold_id_py, METH_VARARGS,
+     "Get the ID of a string's lowercase form, under which Windows paths compare"},
     {NULL}  /* Sentinel */
 };
 
@@ -113,14 +398,48 @@ PyTypeObject StringPoolType = {
  * TreeAllocator implementation
  * ======================================================================== */
 
+static inline PyObject **
+tree_path_string_slot(TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (PyObject **)chunked_at(&tree->path_strings, node_idx, NODE_CHUNK_BITS, sizeof(PyObject *));
+}
+
+static inline PyObject **
+tree_path_bytes_slot(TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (PyObject **)chunked_at(&tree->path_bytes, node_idx, NODE_CHUNK_BITS, sizeof(PyObject *));
+}
+
 static void
 TreeAllocator_dealloc(TreeAllocatorObject *self)
 {
-    if (self->nodes) {
-        PyMem_Free(self->nodes);
+    if (self->path_strings.count > 0) {
+        for (Py_ssize_t i = 0; i < self->node_count; i++) {
+            Py_XDECREF(*tree_path_string_slot(self, i));
+        }
     }
+    if (self->path_bytes.count > 0) {
+        for (Py_ssize_t i = 0; i < self->node_count; i++) {
+            Py_XDECREF(*tree_path_bytes_slot(self, i));
+        }
+    }
+    chunked_free(&self->path_strings);
+    chunked_free(&self->path_bytes);
+    chunked_free(&self->parents);
+    chunked_free(&self->names);
+    chunked_free(&self->anchors);
+    chunked_free(&self->hashes);
+    chunked_free(&self->first_children);
+    chunked_free(&self->next_siblings);
+    chunked_free(&self->depths);
+    tree_columns_free(self);
+    PyMem_Free(self->epoch_starts);
+    if (!self->child_index_borrowed)
+        block_free(self->child_index, self->child_index_capacity * sizeof(node_index_t));
+    if (self->snapshot.obj != NULL)
+        PyBuffer_Release(&self->snapshot);
     Py_XDECREF(self->string_pool);
-    Py_XDECREF(self->drive_roots);
+    Py_XDECREF(self->retired);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
@@ -130,14 +449,24 @@ TreeAllocator_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     TreeAllocatorObject *self;
     self = (TreeAllocatorObject *)type->tp_alloc(type, 0);
     if (self != NULL) {
-        self->nodes = NULL;
         self->node_count = 0;
+        self->depth_total = 0;
         self->node_capacity = 0;
+        self->child_index = NULL;
+        self->child_index_capacity = 0;
+        self->child_index_count = 0;
+        self->child_index_borrowed = 0;
+        self->path_string_bytes = 0;
+        self->path_string_budget = -1;
         self->string_pool = NULL;
         self->relative_root = -1;
         self->absolute_root = -1;
-        self->drive_roots = PyDict_New();
-        if (self->drive_roots == NULL) {
+        self->snapshot.obj = NULL;
+        self->epoch_starts = NULL;
+        self->epoch_count = 0;
+        self->fold_case = 0;
+        self->retired = NULL;
+        if (tree_columns_init(self) < 0) {
             Py_DECREF(self);
             return NULL;
         }
@@ -145,74 +474,364 @@ TreeAllocator_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     return (PyObject *)self;
 }
 
+/* Bytes of per-node array storage for each node slot */
+#define TREE_NODE_BYTES (4 * sizeof(node_index_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t))
+
+/* Add one chunk to every per-node array */
 static int
-TreeAllocator_init(TreeAllocatorObject *self, PyObject *args, PyObject *kwds)
+tree_grow(TreeAllocatorObject *self)
 {
-    PyObject *string_pool;
-    if (!PyArg_ParseTuple(args, "O", &string_pool))
+    /* depths is grown last, so its chunk count is the usable capacity */
+    int target = self->depths.count + 1;
+
+    if ((self->parents.count < target &&
+         chunked_grow(&self->parents, NODE_CHUNK_BITS, sizeof(node_index_t), 0) < 0) ||
+        (self->names.count < target &&
+         chunked_grow(&self->names, NODE_CHUNK_BITS, sizeof(uint32_t), 0) < 0) ||
+        (self->anchors.count < target &&
+         chunked_grow(&self->anchors, NODE_CHUNK_BITS, sizeof(node_index_t), 0) < 0) ||
+        (self->hashes.count < target &&
+         chunked_grow(&self->hashes, NODE_CHUNK_BITS, sizeof(uint64_t), 0) < 0) ||
+        (self->first_children.count < target &&
+         chunked_grow(&self->first_children, NODE_CHUNK_BITS, sizeof(node_index_t), 0) < 0) ||
+        (self->next_siblings.count < target &&
+         chunked_grow(&self->next_siblings, NODE_CHUNK_BITS, sizeof(node_index_t), 0) < 0) ||
+        chunked_grow(&self->depths, NODE_CHUNK_BITS, sizeof(uint32_t), 0) < 0) {
+        return -1;
+    }
+
+    /* The string caches are only allocated once a string is materialized */
+    if (self->path_strings.count > 0 && self->path_strings.count < target &&
+        chunked_grow(&self->path_strings, NODE_CHUNK_BITS, sizeof(PyObject *), 1) < 0) {
+        return -1;
+    }
+    if (self->path_bytes.count > 0 && self->path_bytes.count < target &&
+        chunked_grow(&self->path_bytes, NODE_CHUNK_BITS, sizeof(PyObject *), 1) < 0) {
+        return -1;
+    }
+
+    Py_ssize_t capacity = chunk_capacity(target, NODE_CHUNK_BITS);
+    FASTPATH_COUNT(self->counters.node_grows, 1);
+    FASTPATH_COUNT(self->counters.node_grow_bytes, (capacity - self->node_capacity) * TREE_NODE_BYTES);
+    FASTPATH_PROBE2(node_grow, self->node_capacity, capacity);
+    self->node_capacity = capacity;
+    return 0;
+}
+
+/* Intern a root name through the tree's string pool */
+static Py_ssize_t
+tree_intern_root_name(TreeAllocatorObject *self, const char *name)
+{
+    if (Py_IS_TYPE(self->string_pool, &StringPoolType)) {
+        return StringPool_intern_bytes((StringPoolObject *)self->string_pool, name, strlen(name));
+    }
+
+    PyObject *id_obj = PyObject_CallMethod(self->string_pool, "intern", "s", name);
+    if (id_obj == NULL)
         return -1;
+    Py_ssize_t name_id = PyLong_AsSsize_t(id_obj);
+    Py_DECREF(id_obj);
+    return name_id;
+}
 
+/* Attach a string pool and allocate empty storage, without root nodes */
+int
+tree_setup(TreeAllocatorObject *self, PyObject *string_pool)
+{
     Py_INCREF(string_pool);
-    self->string_pool = string_pool;
+    Py_XSETREF(self->string_pool, string_pool);
+
+    /* Initialize node arrays */
+    if (tree_grow(self) < 0)
+        return -1;
 
-    /* Initialize nodes array */
-    self->node_capacity = 128;
-    self->nodes = PyMem_Malloc(self->node_capacity * sizeof(TreeNode));
-    if (self->nodes == NULL) {
+    /* Initialize child index */
+    self->child_index_capacity = 256;
+    self->child_index = block_alloc(self->child_index_capacity * sizeof(node_index_t), 0);
+    if (self->child_index == NULL) {
         PyErr_NoMemory();
         return -1;
     }
+    memset(self->child_index, 0xFF, self->child_index_capacity * sizeof(node_index_t));
+    return 0;
+}
+
+static int
+TreeAllocator_init(TreeAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *string_pool;
+    const char *root_name = "/";
+    if (!PyArg_ParseTuple(args, "O|s", &string_pool, &root_name))
+        return -1;
+
+    if (tree_setup(self, string_pool) < 0)
+        return -1;
 
     /* Add root nodes */
     /* Relative root with empty string */
-    PyObject *empty = PyUnicode_FromString("");
-    PyObject *empty_id = PyObject_CallMethod(string_pool, "intern", "O", empty);
-    Py_DECREF(empty);
-    if (empty_id == NULL)
+    Py_ssize_t empty_id = tree_intern_root_name(self, "");
+    if (empty_id < 0)
+        return -1;
+    self->relative_root = TreeAllocator_add_node(self, -1, empty_id);
+    if (self->relative_root < 0)
+        return -1;
+
+    /* Absolute root, "/" unless the allocator names it after its separator */
+    Py_ssize_t slash_id = tree_intern_root_name(self, root_name);
+    if (slash_id < 0)
+        return -1;
+    self->absolute_root = TreeAllocator_add_node(self, -1, slash_id);
+    if (self->absolute_root < 0)
+        return -1;
+
+    return 0;
+}
+
+/* ========================================================================
+ * Child index
+ *
+ * Open-addressing hash table with linear probing that maps
+ * (parent_idx, name_id) to the index of the child node.  Roots are keyed
+ * with NODE_NONE as their parent.  Slots hold node indices, NODE_NONE marks
+ * an empty slot.  The table is kept at most half full.
+ * ======================================================================== */
+
+static inline size_t
+child_index_hash(Py_ssize_t parent_idx, Py_ssize_t name_id)
+{
+    uint64_t h = (uint64_t)parent_idx * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)name_id + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 29;
+    return (size_t)h;
+}
+
+static int
+child_index_resize(TreeAllocatorObject *self, Py_ssize_t new_capacity)
+{
+    node_index_t *new_index = block_alloc(new_capacity * sizeof(node_index_t), 0);
+    if (new_index == NULL) {
+        PyErr_NoMemory();
         return -1;
+    }
+    memset(new_index, 0xFF, new_capacity * sizeof(node_index_t));
+
+    size_t mask = (size_t)new_capacity - 1;
+    for (Py_ssize_t i = 0; i < self->child_index_capacity; i++) {
+        node_index_t node_idx = self->child_index[i];
+        if (node_idx == NODE_NONE)
+            continue;
+        size_t slot = child_index_hash(*tree_parent_slot(self, node_idx), *tree_name_slot(self, node_idx)) & mask;
+        while (new_index[slot] != NODE_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        new_index[slot] = node_idx;
+    }
+
+    if (!self->child_index_borrowed)
+        block_free(self->child_index, self->child_index_capacity * sizeof(node_index_t));
+    FASTPATH_PROBE2(child_index_grow, self->child_index_capacity, new_capacity);
+    self->child_index = new_index;
+    self->child_index_capacity = new_capacity;
+    self->child_index_borrowed = 0;
+    return 0;
+}
+
+/* Insert node_idx into the child index unless an equal key is present */
+static int
+child_index_insert(TreeAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if ((self->child_index_count + 1) * 2 > self->child_index_capacity) {
+        if (child_index_resize(self, self->child_index_capacity * 2) < 0)
+            return -1;
+    }
+
+    node_index_t parent_idx = *tree_parent_slot(self, node_idx);
+    uint32_t name_id = *tree_name_slot(self, node_idx);
+    size_t mask = (size_t)self->child_index_capacity - 1;
+    size_t slot = child_index_hash(parent_idx, name_id) & mask;
+
+    for (;;) {
+        node_index_t existing = self->child_index[slot];
+        if (existing == NODE_NONE)
+            break;
+        if (*tree_parent_slot(self, existing) == parent_idx && *tree_name_slot(self, existing) == name_id) {
+            /* Keep the first node for duplicate keys */
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
 
-    self->nodes[0].parent_idx = -1;
-    self->nodes[0].name_id = PyLong_AsLong(empty_id);
-    Py_DECREF(empty_id);
-    self->relative_root = 0;
-    self->node_count = 1;
+    self->child_index[slot] = (node_index_t)node_idx;
+    self->child_index_count++;
+    return 0;
+}
 
-    /* Absolute root with "/" */
-    PyObject *slash = PyUnicode_FromString("/");
-    PyObject *slash_id = PyObject_CallMethod(string_pool, "intern", "O", slash);
-    Py_DECREF(slash);
-    if (slash_id == NULL)
+/* Child lookup without locking; the caller holds the tree's critical section */
+Py_ssize_t
+tree_lookup_child(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id)
+{
+    if (self->child_index == NULL)
         return -1;
+    /* Roots are keyed under the stored NODE_NONE, not -1 widened to 64 bits */
+    if (parent_idx < 0)
+        parent_idx = (Py_ssize_t)NODE_NONE;
+
+    size_t mask = (size_t)self->child_index_capacity - 1;
+    size_t slot = child_index_hash(parent_idx, name_id) & mask;
+    FASTPATH_COUNT(self->counters.child_lookups, 1);
+
+    for (;;) {
+        FASTPATH_COUNT(self->counters.child_probes, 1);
+        node_index_t node_idx = self->child_index[slot];
+        if (node_idx == NODE_NONE)
+            return -1;
+        if (*tree_parent_slot(self, node_idx) == (node_index_t)parent_idx &&
+            *tree_name_slot(self, node_idx) == (uint32_t)name_id) {
+            return (Py_ssize_t)node_idx;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
 
-    self->nodes[1].parent_idx = -1;
-    self->nodes[1].name_id = PyLong_AsLong(slash_id);
-    Py_DECREF(slash_id);
-    self->absolute_root = 1;
-    self->node_count = 2;
+/* Combine a parent path hash with a component hash */
+static inline uint64_t
+path_hash_combine(uint64_t parent_hash, uint64_t name_hash)
+{
+    uint64_t h = parent_hash ^ (name_hash * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h;
+}
 
+static int
+name_fold_hash(const char *data, Py_ssize_t length, uint64_t *hash)
+{
+    PyObject *folded = name_fold(data, length);
+    if (folded == NULL)
+        return -1;
+    *hash = string_hash(PyBytes_AS_STRING(folded), PyBytes_GET_SIZE(folded));
+    Py_DECREF(folded);
     return 0;
 }
 
+/* Hash of a name's UTF-8 bytes, the same for every pool holding it.  Trees
+ * that fold case hash the lowercase form, so paths equal under Windows
+ * rules hash alike. */
+static int
+tree_name_hash(TreeAllocatorObject *self, Py_ssize_t name_id, uint64_t *hash)
+{
+    if (Py_IS_TYPE(self->string_pool, &StringPoolType)) {
+        StringPoolObject *pool = (StringPoolObject *)self->string_pool;
+        if (name_id >= pool->count) {
+            PyErr_SetString(PyExc_ValueError, "Invalid name ID");
+            return -1;
+        }
+        const StringEntry *entry = string_entry(pool, name_id);
+        if (!self->fold_case) {
+            *hash = entry->hash;
+            return 0;
+        }
+        return name_fold_hash(string_entry_data(pool, entry), entry->length, hash);
+    }
+
+    PyObject *name = PyObject_CallMethod(self->string_pool, "get_string", "n", name_id);
+    if (name == NULL)
+        return -1;
+    if (!PyUnicode_Check(name)) {
+        PyErr_Format(PyExc_TypeError, "get_string() returned %.200s, not str", Py_TYPE(name)->tp_name);
+        Py_DECREF(name);
+        return -1;
+    }
+    Py_ssize_t length;
+    const char *data = PyUnicode_AsUTF8AndSize(name, &length);
+    int status = data != NULL ? 0 : -1;
+    if (status == 0 && self->fold_case)
+        status = name_fold_hash(data, length, hash);
+    else if (status == 0)
+        *hash = string_hash(data, length);
+    Py_DECREF(name);
+    return status;
+}
+
+/* Add a node without locking; the caller holds the tree's critical section */
 Py_ssize_t
-TreeAllocator_add_node(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id)
+tree_add_node(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id)
 {
-    /* Grow array if needed */
+    if (parent_idx < -1 || parent_idx >= self->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid parent index");
+        return -1;
+    }
+    if (name_id < 0 || name_id >= (Py_ssize_t)STRING_ID_NONE) {
+        PyErr_SetString(PyExc_ValueError, "Invalid name ID");
+        return -1;
+    }
+    if (self->node_count >= (Py_ssize_t)NODE_INDEX_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "tree allocator is full");
+        return -1;
+    }
+
+    uint64_t name_hash;
+    if (tree_name_hash(self, name_id, &name_hash) < 0)
+        return -1;
+
+    /* Grow arrays if needed */
     if (self->node_count >= self->node_capacity) {
-        Py_ssize_t new_capacity = self->node_capacity * 2;
-        TreeNode *new_nodes = PyMem_Realloc(self->nodes, new_capacity * sizeof(TreeNode));
-        if (new_nodes == NULL) {
-            PyErr_NoMemory();
+        if (tree_grow(self) < 0)
             return -1;
-        }
-        self->nodes = new_nodes;
-        self->node_capacity = new_capacity;
     }
 
     Py_ssize_t node_idx = self->node_count;
-    self->nodes[node_idx].parent_idx = parent_idx;
-    self->nodes[node_idx].name_id = name_id;
+    if (parent_idx < 0) {
+        *tree_parent_slot(self, node_idx) = NODE_NONE;
+        *tree_anchor_slot(self, node_idx) = (node_index_t)node_idx;
+        *tree_depth_slot(self, node_idx) = 0;
+    } else {
+        *tree_parent_slot(self, node_idx) = (node_index_t)parent_idx;
+        *tree_anchor_slot(self, node_idx) = *tree_anchor_slot(self, parent_idx);
+        *tree_depth_slot(self, node_idx) = *tree_depth_slot(self, parent_idx) + 1;
+    }
+    *tree_name_slot(self, node_idx) = (uint32_t)name_id;
+    *tree_first_child_slot(self, node_idx) = NODE_NONE;
+    *tree_next_sibling_slot(self, node_idx) = NODE_NONE;
+    *(uint64_t *)chunked_at(&self->hashes, node_idx, NODE_CHUNK_BITS, sizeof(uint64_t)) =
+        path_hash_combine(parent_idx < 0 ? 0 : tree_hash(self, parent_idx), name_hash);
     self->node_count++;
 
+    /* Roots are indexed under NODE_NONE, so drive roots are found by name */
+    if (child_index_insert(self, node_idx) < 0) {
+        self->node_count--;
+        return -1;
+    }
+    if (parent_idx >= 0) {
+        /* Link in as the parent's newest child */
+        *tree_next_sibling_slot(self, node_idx) = *tree_first_child_slot(self, parent_idx);
+        *tree_first_child_slot(self, parent_idx) = (node_index_t)node_idx;
+    }
+    self->depth_total += *tree_depth_slot(self, node_idx);
+
+    return node_idx;
+}
+
+Py_ssize_t
+TreeAllocator_lookup_child(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id)
+{
+    Py_ssize_t child_idx;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    child_idx = tree_lookup_child(self, parent_idx, name_id);
+    Py_END_CRITICAL_SECTION();
+    return child_idx;
+}
+
+Py_ssize_t
+TreeAllocator_add_node(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id)
+{
+    Py_ssize_t node_idx;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    node_idx = tree_add_node(self, parent_idx, name_id);
+    Py_END_CRITICAL_SECTION();
     return node_idx;
 }
 
@@ -230,47 +849,54 @@ TreeAllocator_add_node_py(TreeAllocatorObject *self, PyObject *args)
     return PyLong_FromSsize_t(node_idx);
 }
 
-PyObject *
-TreeAllocator_get_parts(TreeAllocatorObject *self, PyObject *args)
+/* Fetch a string from the pool, bypassing method dispatch for native pools */
+static PyObject *
+tree_get_string(TreeAllocatorObject *self, Py_ssize_t name_id)
 {
-    Py_ssize_t node_idx;
-    if (!PyArg_ParseTuple(args, "n", &node_idx))
-        return NULL;
+    if (Py_IS_TYPE(self->string_pool, &StringPoolType)) {
+        return StringPool_get_object((StringPoolObject *)self->string_pool, name_id);
+    }
+    return PyObject_CallMethod(self->string_pool, "get_string", "n", name_id);
+}
 
+PyObject *
+TreeAllocator_get_parts(TreeAllocatorObject *self, Py_ssize_t node_idx)
+{
     if (node_idx < 0 || node_idx >= self->node_count) {
         PyErr_SetString(PyExc_IndexError, "Invalid node index");
         return NULL;
     }
 
-    /* Count depth */
-    Py_ssize_t depth = 0;
-    Py_ssize_t curr = node_idx;
-    while (self->nodes[curr].parent_idx >= 0) {
-        depth++;
-        curr = self->nodes[curr].parent_idx;
-    }
-
     /* Build parts tuple */
+    Py_ssize_t depth = tree_depth(self, node_idx);
     PyObject *parts = PyTuple_New(depth);
     if (parts == NULL)
         return NULL;
 
-    curr = node_idx;
+    Py_ssize_t curr = node_idx;
     for (Py_ssize_t i = depth - 1; i >= 0; i--) {
-        PyObject *name_id = PyLong_FromSsize_t(self->nodes[curr].name_id);
-        PyObject *name = PyObject_CallMethod(self->string_pool, "get_string", "O", name_id);
-        Py_DECREF(name_id);
+        PyObject *name = tree_get_string(self, tree_name(self, curr));
         if (name == NULL) {
             Py_DECREF(parts);
             return NULL;
         }
         PyTuple_SET_ITEM(parts, i, name);
-        curr = self->nodes[curr].parent_idx;
+        curr = tree_parent(self, curr);
     }
 
     return parts;
 }
 
+static PyObject *
+TreeAllocator_get_parts_py(TreeAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return TreeAllocator_get_parts(self, node_idx);
+}
+
 PyObject *
 TreeAllocator_find_child(TreeAllocatorObject *self, PyObject *args)
 {
@@ -278,15 +904,12 @@ TreeAllocator_find_child(TreeAllocatorObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "nn", &parent_idx, &name_id))
         return NULL;
 
-    /* Linear search through nodes */
-    for (Py_ssize_t i = 0; i < self->node_count; i++) {
-        if (self->nodes[i].parent_idx == parent_idx &&
-            self->nodes[i].name_id == name_id) {
-            return PyLong_FromSsize_t(i);
-        }
+    Py_ssize_t child_idx = TreeAllocator_lookup_child(self, parent_idx, name_id);
+    if (child_idx < 0) {
+        Py_RETURN_NONE;
     }
 
-    Py_RETURN_NONE;
+    return PyLong_FromSsize_t(child_idx);
 }
 
 static PyObject *
@@ -301,7 +924,7 @@ TreeAllocator_get_parent_idx(TreeAllocatorObject *self, PyObject *args)
         return NULL;
     }
 
-    return PyLong_FromSsize_t(self->nodes[node_idx].parent_idx);
+    return PyLong_FromSsize_t(tree_parent(self, node_idx));
 }
 
 static PyObject *
@@ -316,9 +939,40 @@ TreeAllocator_get_name_id(TreeAllocatorObject *self, PyObject *args)
         return NULL;
     }
 
-    return PyLong_FromSsize_t(self->nodes[node_idx].name_id);
+    return PyLong_FromSsize_t(tree_name(self, node_idx));
+}
+
+static PyObject *
+TreeAllocator_get_depth(TreeAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    if (node_idx < 0 || node_idx >= self->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    return PyLong_FromSsize_t(tree_depth(self, node_idx));
+}
+
+static PyObject *
+TreeAllocator_get_root_idx(TreeAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    if (node_idx < 0 || node_idx >= self->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    return PyLong_FromSsize_t(tree_anchor(self, node_idx));
 }
 
+/* Roots other than the relative and absolute roots are drive roots */
 static PyObject *
 TreeAllocator_get_root_type(TreeAllocatorObject *self, PyObject *args)
 {
@@ -326,18 +980,17 @@ TreeAllocator_get_root_type(TreeAllocatorObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "n", &node_idx))
         return NULL;
 
+    if (node_idx < 0 || node_idx >= self->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
     if (node_idx == self->relative_root) {
         return PyUnicode_FromString("relative");
     } else if (node_idx == self->absolute_root) {
         return PyUnicode_FromString("absolute");
-    }
-    /* Check drive roots */
-    PyObject *key, *value;
-    Py_ssize_t pos = 0;
-    while (PyDict_Next(self->drive_roots, &pos, &key, &value)) {
-        if (PyLong_AsLong(value) == node_idx) {
-            return PyUnicode_FromString("drive");
-        }
+    } else if (tree_anchor(self, node_idx) == node_idx) {
+        return PyUnicode_FromString("drive");
     }
     return PyUnicode_FromString("unknown");
 }
@@ -349,404 +1002,1965 @@ TreeAllocator_is_root(TreeAllocatorObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "n", &node_idx))
         return NULL;
 
-    if (node_idx == self->relative_root || node_idx == self->absolute_root) {
-        Py_RETURN_TRUE;
+    if (node_idx < 0 || node_idx >= self->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
     }
 
-    /* Check drive roots */
-    PyObject *key, *value;
-    Py_ssize_t pos = 0;
-    while (PyDict_Next(self->drive_roots, &pos, &key, &value)) {
-        if (PyLong_AsLong(value) == node_idx) {
-            Py_RETURN_TRUE;
-        }
-    }
-    Py_RETURN_FALSE;
+    return PyBool_FromLong(tree_anchor(self, node_idx) == node_idx);
 }
 
-static PyMethodDef TreeAllocator_methods[] = {
-    {"add_node", (PyCFunction)TreeAllocator_add_node_py, METH_VARARGS,
-     "Add a new node to the tree"},
-    {"get_parts", (PyCFunction)TreeAllocator_get_parts, METH_VARARGS,
-     "Get path parts for a node"},
-    {"find_child", (PyCFunction)TreeAllocator_find_child, METH_VARARGS,
-     "Find a child node by parent and name"},
-    {"get_parent_idx", (PyCFunction)TreeAllocator_get_parent_idx, METH_VARARGS,
-     "Get parent index of a node"},
-    {"get_root_type", (PyCFunction)TreeAllocator_get_root_type, METH_VARARGS,
-     "Get root type of a path"},
-    {"is_root", (PyCFunction)TreeAllocator_is_root, METH_VARARGS,
-     "Check if node is a root"},
-    {"get_name_id", (PyCFunction)TreeAllocator_get_name_id, METH_VARARGS,
-     "Get name ID of a node"},
-    {NULL}  /* Sentinel */
-};
-
-static PyMemberDef TreeAllocator_members[] = {
-    {"string_pool", T_OBJECT_EX, offsetof(TreeAllocatorObject, string_pool), READONLY,
-     "String pool"},
-    {"relative_root", T_PYSSIZET, offsetof(TreeAllocatorObject, relative_root), READONLY,
-     "Relative root index"},
-    {"absolute_root", T_PYSSIZET, offsetof(TreeAllocatorObject, absolute_root), READONLY,
-     "Absolute root index"},
-    {"drive_roots", T_OBJECT_EX, offsetof(TreeAllocatorObject, drive_roots), READONLY,
-     "Drive roots dictionary"},
-    {NULL}  /* Sentinel */
-};
-
-PyTypeObject TreeAllocatorType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "fastpath.TreeAllocator",
-    .tp_doc = "Tree allocator for paths",
-    .tp_basicsize = sizeof(TreeAllocatorObject),
-    .tp_itemsize = 0,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = TreeAllocator_new,
-    .tp_init = (initproc)TreeAllocator_init,
-    .tp_dealloc = (destructor)TreeAllocator_dealloc,
-    .tp_methods = TreeAllocator_methods,
-    .tp_members = TreeAllocator_members,
-};
-
 /* ========================================================================
- * PathAllocator implementation
+ * Ancestry queries
+ *
+ * Depths are stored per node, so lining two nodes up takes exactly the
+ * difference in depth parent steps, and a common ancestor is then found
+ * by climbing both in lockstep.  A node's parent, depth and root never
+ * change once added, so the read-only queries need no lock; compact()
+ * keeps the storage it replaces alive for them (see compact.c).  Trees that
+ * fold case keep each spelling of a name as its own node, so there two
+ * nodes line up when their components are equal ignoring case.
  * ======================================================================== */
 
-static void
-PathAllocator_dealloc(PathAllocatorObject *self)
-{
-    Py_XDECREF(self->string_pool);
-    Py_XDECREF(self->tree);
-    Py_XDECREF(self->cache);
-    Py_TYPE(self)->tp_free((PyObject *)self);
-}
+#define ANCESTRY_STACK 64
 
-static PyObject *
-PathAllocator_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+/* Climb from node_idx to its ancestor at the given depth */
+static inline Py_ssize_t
+tree_ancestor_at(const TreeAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t depth)
 {
-    PathAllocatorObject *self;
-    self = (PathAllocatorObject *)type->tp_alloc(type, 0);
-    if (self != NULL) {
-        self->string_pool = NULL;
-        self->tree = NULL;
-        self->cache = NULL;
-        self->separator = "/";
-    }
-    return (PyObject *)self;
+    for (Py_ssize_t d = tree_depth(self, node_idx); d > depth; d--)
+        node_idx = tree_parent(self, node_idx);
+    return node_idx;
 }
 
+/* Whether two nodes name the same component, ignoring case on trees that
+ * fold it; returns -1 on error */
 static int
-PathAllocator_init(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+tree_same_component(TreeAllocatorObject *self, Py_ssize_t a_idx, Py_ssize_t b_idx)
 {
-    const char *separator = "/";
-    static char *kwlist[] = {"separator", NULL};
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", kwlist, &separator))
+    Py_ssize_t a_name = tree_name(self, a_idx), b_name = tree_name(self, b_idx);
+    if (a_name == b_name)
+        return 1;
+    if (!self->fold_case || !Py_IS_TYPE(self->string_pool, &StringPoolType))
+        return 0;
+    StringPoolObject *pool = (StringPoolObject *)self->string_pool;
+    Py_ssize_t a_fold = StringPool_fold_id(pool, a_name);
+    if (a_fold < 0)
         return -1;
-
-    self->separator = separator;
-
-    /* Create string pool */
-    self->string_pool = (StringPoolObject *)PyObject_CallObject((PyObject *)&StringPoolType, NULL);
-    if (self->string_pool == NULL)
+    Py_ssize_t b_fold = StringPool_fold_id(pool, b_name);
+    if (b_fold < 0)
         return -1;
+    return a_fold == b_fold;
+}
 
-    /* Create tree allocator */
-    PyObject *tree_args = Py_BuildValue("(O)", self->string_pool);
-    self->tree = (TreeAllocatorObject *)PyObject_CallObject((PyObject *)&TreeAllocatorType, tree_args);
-    Py_DECREF(tree_args);
-    if (self->tree == NULL)
-        return -1;
+/* Whether two nodes at the same depth spell the same path; returns -1 on error */
+static int
+tree_same_path(TreeAllocatorObject *self, Py_ssize_t a_idx, Py_ssize_t b_idx)
+{
+    while (a_idx != b_idx) {
+        int same = tree_same_component(self, a_idx, b_idx);
+        if (same <= 0)
+            return same;
+        a_idx = tree_parent(self, a_idx);
+        b_idx = tree_parent(self, b_idx);
+    }
+    return 1;
+}
 
-    /* Create cache */
-    self->cache = PyDict_New();
-    if (self->cache == NULL)
+/* Returns 1 if ancestor_idx is node_idx or one of its ancestors, 0 if not, -1 on error */
+int
+TreeAllocator_is_ancestor(TreeAllocatorObject *self, Py_ssize_t ancestor_idx, Py_ssize_t node_idx)
+{
+    if (!tree_valid_index(self, ancestor_idx) || !tree_valid_index(self, node_idx))
         return -1;
 
-    return 0;
+    Py_ssize_t depth = tree_depth(self, ancestor_idx);
+    if (depth > tree_depth(self, node_idx))
+        return 0;
+    if (self->fold_case)
+        return tree_same_path(self, ancestor_idx, tree_ancestor_at(self, node_idx, depth));
+    if (tree_anchor(self, ancestor_idx) != tree_anchor(self, node_idx))
+        return 0;
+    return tree_ancestor_at(self, node_idx, depth) == ancestor_idx;
 }
 
-PyObject *
-PathAllocator_from_parts(PathAllocatorObject *self, PyObject *args)
+/* Deepest node that is an ancestor of both; ValueError if they have different roots */
+Py_ssize_t
+TreeAllocator_common_ancestor(TreeAllocatorObject *self, Py_ssize_t a_idx, Py_ssize_t b_idx)
 {
-    /* Accept variable arguments */
-    Py_ssize_t num_args = PyTuple_Size(args);
-    PyObject *parts;
+    if (!tree_valid_index(self, a_idx) || !tree_valid_index(self, b_idx))
+        return -1;
+    int same_root = tree_same_component(self, tree_anchor(self, a_idx), tree_anchor(self, b_idx));
+    if (same_root < 0)
+        return -1;
+    if (!same_root) {
+        PyErr_SetString(PyExc_ValueError, "Nodes have different roots");
+        return -1;
+    }
 
-    /* Handle the case where all args are passed as parts */
-    if (num_args == 1) {
-        PyObject *first = PyTuple_GetItem(args, 0);
-        if (PyTuple_Check(first)) {
-            parts = first;
-            Py_INCREF(parts);
-        } else {
-            parts = args;
-            Py_INCREF(parts);
-        }
+    Py_ssize_t a_depth = tree_depth(self, a_idx), b_depth = tree_depth(self, b_idx);
+    if (a_depth > b_depth) {
+        a_idx = tree_ancestor_at(self, a_idx, b_depth);
     } else {
-        parts = args;
-        Py_INCREF(parts);
+        b_idx = tree_ancestor_at(self, b_idx, a_depth);
     }
-
-    Py_ssize_t num_parts = PyTuple_Size(parts);
-    if (num_parts == 0) {
-        Py_DECREF(parts);
-        return PyLong_FromSsize_t(self->tree->relative_root);
+    /* The answer is on a's side, just above the highest components that differ */
+    Py_ssize_t common = a_idx;
+    while (a_idx != b_idx) {
+        int same = tree_same_component(self, a_idx, b_idx);
+        if (same < 0)
+            return -1;
+        a_idx = tree_parent(self, a_idx);
+        b_idx = tree_parent(self, b_idx);
+        if (!same)
+            common = a_idx;
     }
+    return common;
+}
 
-    /* Determine root */
-    Py_ssize_t current_idx;
-    PyObject *first = PyTuple_GetItem(parts, 0);
-    const char *first_str = PyUnicode_AsUTF8(first);
-
-    if (first_str && first_str[0] == '/') {
-        current_idx = self->tree->absolute_root;
-    } else {
-        current_idx = self->tree->relative_root;
+/* Re-root the components of node_idx below base_idx onto the relative root */
+Py_ssize_t
+TreeAllocator_relative_to(TreeAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t base_idx)
+{
+    int is_ancestor = TreeAllocator_is_ancestor(self, base_idx, node_idx);
+    if (is_ancestor < 0)
+        return -1;
+    if (!is_ancestor) {
+        PyErr_Format(PyExc_ValueError, "Node %zd is not relative to node %zd", node_idx, base_idx);
+        return -1;
     }
 
-    /* Process each part */
-    for (Py_ssize_t i = 0; i < num_parts; i++) {
-        PyObject *part = PyTuple_GetItem(parts, i);
-        if (part == NULL) {
-            Py_DECREF(parts);
-            return NULL;
-        }
+    /* Already relative to the relative root */
+    if (base_idx == self->relative_root)
+        return node_idx;
 
-        /* Skip empty parts */
-        if (PyUnicode_GetLength(part) == 0)
-            continue;
+    Py_ssize_t count = tree_depth(self, node_idx) - tree_depth(self, base_idx);
 
-        /* Intern the part */
-        PyObject *intern_args = PyTuple_Pack(1, part);
-        PyObject *name_id_obj = StringPool_intern(self->string_pool, intern_args);
-        Py_DECREF(intern_args);
-        if (name_id_obj == NULL) {
-            Py_DECREF(parts);
-            return NULL;
+    uint32_t stack_buf[ANCESTRY_STACK];
+    uint32_t *names = stack_buf;
+    if (count > ANCESTRY_STACK) {
+        names = PyMem_Malloc(count * sizeof(uint32_t));
+        if (names == NULL) {
+            PyErr_NoMemory();
+            return -1;
         }
+    }
+    Py_ssize_t curr = node_idx;
+    for (Py_ssize_t i = count - 1; i >= 0; i--) {
+        names[i] = tree_name(self, curr);
+        curr = tree_parent(self, curr);
+    }
 
-        Py_ssize_t name_id = PyLong_AsLong(name_id_obj);
-        Py_DECREF(name_id_obj);
-
-        /* Find or create child node */
-        PyObject *find_args = Py_BuildValue("(nn)", current_idx, name_id);
-        PyObject *child_idx_obj = TreeAllocator_find_child(self->tree, find_args);
-        Py_DECREF(find_args);
-
-        if (child_idx_obj == Py_None) {
-            Py_DECREF(child_idx_obj);
-            current_idx = TreeAllocator_add_node(self->tree, current_idx, name_id);
-            if (current_idx < 0) {
-                Py_DECREF(parts);
-                return NULL;
-            }
-        } else {
-            current_idx = PyLong_AsLong(child_idx_obj);
-            Py_DECREF(child_idx_obj);
-        }
+    Py_ssize_t result = self->relative_root;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    for (Py_ssize_t i = 0; i < count && result >= 0; i++) {
+        Py_ssize_t child_idx = tree_lookup_child(self, result, names[i]);
+        if (child_idx < 0)
+            child_idx = tree_add_node(self, result, names[i]);
+        result = child_idx;
     }
+    Py_END_CRITICAL_SECTION();
 
-    Py_DECREF(parts);
-    return PyLong_FromSsize_t(current_idx);
+    if (names != stack_buf)
+        PyMem_Free(names);
+    return result;
 }
 
+/* Ancestors of a node from its parent up to its root, as pathlib's parents */
 PyObject *
-PathAllocator_from_string(PathAllocatorObject *self, PyObject *args)
+TreeAllocator_get_ancestors(TreeAllocatorObject *self, Py_ssize_t node_idx)
 {
-    const char *path_str;
-    if (!PyArg_ParseTuple(args, "s", &path_str))
+    if (!tree_valid_index(self, node_idx))
         return NULL;
 
-    /* Split path by separator and call from_parts */
-    PyObject *parts_list = PyList_New(0);
-    if (parts_list == NULL)
+    Py_ssize_t depth = tree_depth(self, node_idx);
+    PyObject *result = PyTuple_New(depth);
+    if (result == NULL)
         return NULL;
 
-    char *path_copy = strdup(path_str);
-    char *token = strtok(path_copy, self->separator);
-    while (token != NULL) {
-        PyObject *part = PyUnicode_FromString(token);
-        if (PyList_Append(parts_list, part) < 0) {
-            Py_DECREF(part);
-            Py_DECREF(parts_list);
-            free(path_copy);
+    Py_ssize_t curr = node_idx;
+    for (Py_ssize_t i = 0; i < depth; i++) {
+        curr = tree_parent(self, curr);
+        PyObject *idx = PyLong_FromSsize_t(curr);
+        if (idx == NULL) {
+            Py_DECREF(result);
             return NULL;
         }
-        Py_DECREF(part);
-        token = strtok(NULL, self->separator);
+        PyTuple_SET_ITEM(result, i, idx);
     }
-    free(path_copy);
-
-    /* Convert list to tuple */
-    PyObject *parts_tuple = PyList_AsTuple(parts_list);
-    Py_DECREF(parts_list);
-    if (parts_tuple == NULL)
-        return NULL;
-
-    /* Call from_parts */
-    PyObject *result = PathAllocator_from_parts(self, parts_tuple);
-    Py_DECREF(parts_tuple);
     return result;
 }
 
-PyObject *
-PathAllocator_get_parts(PathAllocatorObject *self, PyObject *args)
+static PyObject *
+TreeAllocator_is_ancestor_py(TreeAllocatorObject *self, PyObject *args)
 {
-    Py_ssize_t node_idx;
-    if (!PyArg_ParseTuple(args, "n", &node_idx))
+    Py_ssize_t ancestor_idx, node_idx;
+    if (!PyArg_ParseTuple(args, "nn", &ancestor_idx, &node_idx))
         return NULL;
 
-    PyObject *tree_args = Py_BuildValue("(n)", node_idx);
-    PyObject *result = TreeAllocator_get_parts(self->tree, tree_args);
-    Py_DECREF(tree_args);
-
-    return result;
+    int result = TreeAllocator_is_ancestor(self, ancestor_idx, node_idx);
+    if (result < 0)
+        return NULL;
+    return PyBool_FromLong(result);
 }
 
-PyObject *
-PathAllocator_get_parent(PathAllocatorObject *self, PyObject *args)
+static PyObject *
+TreeAllocator_common_ancestor_py(TreeAllocatorObject *self, PyObject *args)
 {
-    Py_ssize_t node_idx;
-    if (!PyArg_ParseTuple(args, "n", &node_idx))
+    Py_ssize_t a_idx, b_idx;
+    if (!PyArg_ParseTuple(args, "nn", &a_idx, &b_idx))
         return NULL;
 
-    if (node_idx < 0 || node_idx >= self->tree->node_count) {
-        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+    Py_ssize_t result = TreeAllocator_common_ancestor(self, a_idx, b_idx);
+    if (result < 0)
         return NULL;
-    }
+    return PyLong_FromSsize_t(result);
+}
 
-    Py_ssize_t parent_idx = self->tree->nodes[node_idx].parent_idx;
-    if (parent_idx < 0) {
-        return PyLong_FromSsize_t(node_idx);  /* Root is its own parent */
-    }
+static PyObject *
+TreeAllocator_relative_to_py(TreeAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx, base_idx;
+    if (!PyArg_ParseTuple(args, "nn", &node_idx, &base_idx))
+        return NULL;
 
-    return PyLong_FromSsize_t(parent_idx);
+    Py_ssize_t result = TreeAllocator_relative_to(self, node_idx, base_idx);
+    if (result < 0)
+        return NULL;
+    return PyLong_FromSsize_t(result);
 }
 
-PyObject *
-PathAllocator_get_name(PathAllocatorObject *self, PyObject *args)
+static PyObject *
+TreeAllocator_get_ancestors_py(TreeAllocatorObject *self, PyObject *args)
 {
     Py_ssize_t node_idx;
     if (!PyArg_ParseTuple(args, "n", &node_idx))
         return NULL;
 
-    if (node_idx < 0 || node_idx >= self->tree->node_count) {
-        PyErr_SetString(PyExc_IndexError, "Invalid node index");
-        return NULL;
-    }
-
-    Py_ssize_t name_id = self->tree->nodes[node_idx].name_id;
-    PyObject *name_id_obj = PyLong_FromSsize_t(name_id);
-    PyObject *get_args = Py_BuildValue("(O)", name_id_obj);
-    PyObject *result = StringPool_get_string(self->string_pool, get_args);
-    Py_DECREF(get_args);
-    Py_DECREF(name_id_obj);
-
-    return result;
+    return TreeAllocator_get_ancestors(self, node_idx);
 }
 
+/* Nearest of node_idx and its ancestors found in candidates, or None.
+ * Costs one membership test per level however many candidates there are. */
 static PyObject *
-PathAllocator_join(PathAllocatorObject *self, PyObject *args)
+TreeAllocator_find_ancestor(TreeAllocatorObject *self, PyObject *args)
 {
-    Py_ssize_t base_idx;
-    PyObject *parts;
-
-    /* Parse base_idx and remaining args as parts */
-    if (PyTuple_Size(args) < 1) {
-        PyErr_SetString(PyExc_TypeError, "join() missing required argument: 'base_idx'");
+    Py_ssize_t node_idx;
+    PyObject *candidates;
+    if (!PyArg_ParseTuple(args, "nO", &node_idx, &candidates))
         return NULL;
+    if (!tree_valid_index(self, node_idx))
+        return NULL;
+
+    for (Py_ssize_t curr = node_idx; curr >= 0; curr = tree_parent(self, curr)) {
+        PyObject *idx = PyLong_FromSsize_t(curr);
+        if (idx == NULL)
+            return NULL;
+        int found = PySequence_Contains(candidates, idx);
+        if (found != 0) {
+            if (found < 0)
+                Py_CLEAR(idx);
+            return idx;
+        }
+        Py_DECREF(idx);
     }
+    Py_RETURN_NONE;
+}
 
-    PyObject *first = PyTuple_GetItem(args, 0);
-    base_idx = PyLong_AsLong(first);
-    if (PyErr_Occurred())
-        return NULL;
+/* ========================================================================
+ * Subtree enumeration
+ *
+ * Each node links to its newest child and each child to its next older
+ * sibling, so listing a directory touches only its children, and a
+ * subtree is walked in preorder without a stack: descend to the first
+ * child, otherwise move to the next sibling of the nearest node on the
+ * way back up that has one.
+ * ======================================================================== */
 
-    /* Get base parts */
-    PyObject *get_args = Py_BuildValue("(n)", base_idx);
-    PyObject *base_parts = PathAllocator_get_parts(self, get_args);
-    Py_DECREF(get_args);
-    if (base_parts == NULL)
+/* Child indices of a node, newest first, as an array('q') */
+PyObject *
+TreeAllocator_get_children(TreeAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (!tree_valid_index(self, node_idx))
         return NULL;
 
-    /* Combine with new parts */
-    Py_ssize_t base_len = PyTuple_Size(base_parts);
-    Py_ssize_t new_len = PyTuple_Size(args) - 1;
-    PyObject *combined = PyTuple_New(base_len + new_len);
-
-    /* Copy base parts */
-    for (Py_ssize_t i = 0; i < base_len; i++) {
-        PyObject *item = PyTuple_GetItem(base_parts, i);
-        Py_INCREF(item);
-        PyTuple_SET_ITEM(combined, i, item);
+    Py_ssize_t count = 0;
+    int64_t *indices;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    for (Py_ssize_t child = tree_first_child(self, node_idx); child >= 0; child = tree_next_sibling(self, child))
+        count++;
+    indices = PyMem_Malloc((count > 0 ? count : 1) * sizeof(int64_t));
+    if (indices != NULL) {
+        Py_ssize_t i = 0;
+        for (Py_ssize_t child = tree_first_child(self, node_idx); child >= 0; child = tree_next_sibling(self, child))
+            indices[i++] = child;
     }
+    Py_END_CRITICAL_SECTION();
 
-    /* Copy new parts */
-    for (Py_ssize_t i = 1; i < PyTuple_Size(args); i++) {
-        PyObject *item = PyTuple_GetItem(args, i);
-        Py_INCREF(item);
-        PyTuple_SET_ITEM(combined, base_len + i - 1, item);
-    }
+    if (indices == NULL)
+        return PyErr_NoMemory();
+    PyObject *result = fastpath_index_array(indices, count);
+    PyMem_Free(indices);
+    return result;
+}
 
-    Py_DECREF(base_parts);
+/* Number of nodes below a node, not counting the node itself */
+Py_ssize_t
+TreeAllocator_count_descendants(TreeAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (!tree_valid_index(self, node_idx))
+        return -1;
 
-    /* Call from_parts */
-    PyObject *result = PathAllocator_from_parts(self, combined);
-    Py_DECREF(combined);
-    return result;
+    Py_ssize_t count = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    for (Py_ssize_t curr = tree_next_preorder(self, node_idx, node_idx); curr >= 0;
+         curr = tree_next_preorder(self, curr, node_idx)) {
+        count++;
+    }
+    Py_END_CRITICAL_SECTION();
+    return count;
 }
 
 static PyObject *
-PathAllocator_stats(PathAllocatorObject *self, PyObject *args)
+TreeAllocator_get_children_py(TreeAllocatorObject *self, PyObject *args)
 {
-    PyObject *dict = PyDict_New();
-    if (dict == NULL)
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
         return NULL;
 
-    PyDict_SetItemString(dict, "string_count", PyLong_FromSsize_t(PyList_Size(self->string_pool->strings)));
-    PyDict_SetItemString(dict, "node_count", PyLong_FromSsize_t(self->tree->node_count));
-    PyDict_SetItemString(dict, "cache_size", PyLong_FromSsize_t(PyDict_Size(self->cache)));
-
-    return dict;
+    return TreeAllocator_get_children(self, node_idx);
 }
 
 static PyObject *
-PathAllocator_is_absolute(PathAllocatorObject *self, PyObject *args)
+TreeAllocator_count_descendants_py(TreeAllocatorObject *self, PyObject *args)
 {
     Py_ssize_t node_idx;
     if (!PyArg_ParseTuple(args, "n", &node_idx))
         return NULL;
 
-    /* Walk up to root */
-    Py_ssize_t current = node_idx;
-    while (current >= 0 && self->tree->nodes[current].parent_idx >= 0) {
-        current = self->tree->nodes[current].parent_idx;
-    }
-
-    if (current == self->tree->absolute_root) {
-        Py_RETURN_TRUE;
-    }
-    Py_RETURN_FALSE;
+    Py_ssize_t count = TreeAllocator_count_descendants(self, node_idx);
+    if (count < 0)
+        return NULL;
+    return PyLong_FromSsize_t(count);
 }
 
-static PyMethodDef PathAllocator_methods[] = {
-    {"from_parts", (PyCFunction)PathAllocator_from_parts, METH_VARARGS,
-     "Create path from parts"},
-    {"from_string", (PyCFunction)PathAllocator_from_string, METH_VARARGS,
-     "Create path from string"},
-    {"get_parts", (PyCFunction)PathAllocator_get_parts, METH_VARARGS,
+/* Preorder iterator over the nodes below a node.  Nodes added while
+ * iterating may or may not be visited, but every node that existed when
+ * the walk reached its parent is. */
+typedef struct {
+    PyObject_HEAD
+    TreeAllocatorObject *tree;
+    PyObject *allocator;      /* Allocator for yielded paths */
+    PyTypeObject *path_type;  /* Path type to yield, NULL to yield node indices */
+    Py_ssize_t root_idx;
+    Py_ssize_t current_idx;   /* Last node yielded, -1 once exhausted */
+} DescendantIterObject;
+
+PyObject *
+TreeAllocator_iter_descendants(TreeAllocatorObject *self, Py_ssize_t node_idx, PyObject *allocator,
+                               PyTypeObject *path_type)
+{
+    if (!tree_valid_index(self, node_idx))
+        return NULL;
+
+    DescendantIterObject *iter = PyObject_New(DescendantIterObject, &DescendantIterType);
+    if (iter == NULL)
+        return NULL;
+    Py_INCREF(self);
+    iter->tree = self;
+    Py_XINCREF(allocator);
+    iter->allocator = allocator;
+    Py_XINCREF(path_type);
+    iter->path_type = path_type;
+    iter->root_idx = node_idx;
+    iter->current_idx = node_idx;
+    return (PyObject *)iter;
+}
+
+static void
+DescendantIter_dealloc(DescendantIterObject *self)
+{
+    Py_DECREF(self->tree);
+    Py_XDECREF(self->allocator);
+    Py_XDECREF(self->path_type);
+    PyObject_Free(self);
+}
+
+static PyObject *
+DescendantIter_next(DescendantIterObject *self)
+{
+    if (self->current_idx < 0)
+        return NULL;
+
+    Py_ssize_t next_idx;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    next_idx = tree_next_preorder(self->tree, self->current_idx, self->root_idx);
+    Py_END_CRITICAL_SECTION();
+    self->current_idx = next_idx;
+    if (next_idx < 0)
+        return NULL;
+
+    if (self->path_type != NULL)
+        return PureFastPath_from_index(self->path_type, self->allocator, next_idx);
+    return PyLong_FromSsize_t(next_idx);
+}
+
+PyTypeObject DescendantIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.DescendantIterator",
+    .tp_doc = "Preorder iterator over the nodes below a node",
+    .tp_basicsize = sizeof(DescendantIterObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)DescendantIter_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc)DescendantIter_next,
+};
+
+static PyObject *
+TreeAllocator_iter_descendants_py(TreeAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return TreeAllocator_iter_descendants(self, node_idx, NULL, NULL);
+}
+
+static PyMethodDef TreeAllocator_methods[] = {
+    {"add_node", (PyCFunction)TreeAllocator_add_node_py, METH_VARARGS,
+     "Add a new node to the tree"},
+    {"get_parts", (PyCFunction)TreeAllocator_get_parts_py, METH_VARARGS,
+     "Get path parts for a node"},
+    {"find_child", (PyCFunction)TreeAllocator_find_child, METH_VARARGS,
+     "Find a child node by parent and name"},
+    {"get_parent_idx", (PyCFunction)TreeAllocator_get_parent_idx, METH_VARARGS,
+     "Get parent index of a node"},
+    {"get_root_type", (PyCFunction)TreeAllocator_get_root_type, METH_VARARGS,
+     "Get root type of a path"},
+    {"is_root", (PyCFunction)TreeAllocator_is_root, METH_VARARGS,
+     "Check if node is a root"},
+    {"get_name_id", (PyCFunction)TreeAllocator_get_name_id, METH_VARARGS,
+     "Get name ID of a node"},
+    {"get_depth", (PyCFunction)TreeAllocator_get_depth, METH_VARARGS,
+     "Get number of components between a node and its root"},
+    {"is_ancestor", (PyCFunction)TreeAllocator_is_ancestor_py, METH_VARARGS,
+     "Check whether a node is another node or one of its ancestors"},
+    {"common_ancestor", (PyCFunction)TreeAllocator_common_ancestor_py, METH_VARARGS,
+     "Get the deepest common ancestor of two nodes"},
+    {"relative_to", (PyCFunction)TreeAllocator_relative_to_py, METH_VARARGS,
+     "Get the relative node for a node's components below an ancestor"},
+    {"get_ancestors", (PyCFunction)TreeAllocator_get_ancestors_py, METH_VARARGS,
+     "Get the ancestor indices of a node, nearest first"},
+    {"find_ancestor", (PyCFunction)TreeAllocator_find_ancestor, METH_VARARGS,
+     "Find the nearest of a node and its ancestors in a set of indices"},
+    {"get_children", (PyCFunction)TreeAllocator_get_children_py, METH_VARARGS,
+     "Get the child indices of a node, newest first"},
+    {"count_descendants", (PyCFunction)TreeAllocator_count_descendants_py, METH_VARARGS,
+     "Count the nodes below a node"},
+    {"iter_descendants", (PyCFunction)TreeAllocator_iter_descendants_py, METH_VARARGS,
+     "Iterate over the indices of the nodes below a node in preorder"},
+    {"get_root_idx", (PyCFunction)TreeAllocator_get_root_idx, METH_VARARGS,
+     "Get index of the root a node descends from"},
+    {"column", (PyCFunction)TreeAllocator_column, METH_VARARGS,
+     "Get a per-node column by name"},
+    {"add_column", (PyCFunction)TreeAllocator_add_column, METH_VARARGS | METH_KEYWORDS,
+     "Add a per-node column with a struct type code, 'q' by default"},
+    {"column_names", (PyCFunction)TreeAllocator_column_names, METH_NOARGS,
+     "Get the names of the tree's columns"},
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef TreeAllocator_members[] = {
+    {"string_pool", T_OBJECT_EX, offsetof(TreeAllocatorObject, string_pool), READONLY,
+     "String pool"},
+    {"relative_root", T_PYSSIZET, offsetof(TreeAllocatorObject, relative_root), READONLY,
+     "Relative root index"},
+    {"absolute_root", T_PYSSIZET, offsetof(TreeAllocatorObject, absolute_root), READONLY,
+     "Absolute root index"},
+    {NULL}  /* Sentinel */
+};
+
+/* Roots other than the relative and absolute roots, by name */
+static PyObject *
+TreeAllocator_get_drive_roots(TreeAllocatorObject *self, void *closure)
+{
+    PyObject *result = PyDict_New();
+    int status = result != NULL ? 0 : -1;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    for (Py_ssize_t i = 0; status == 0 && i < self->node_count; i++) {
+        if (tree_parent(self, i) >= 0 || i == self->relative_root || i == self->absolute_root)
+            continue;
+        PyObject *name = tree_get_string(self, tree_name(self, i));
+        PyObject *idx = name != NULL ? PyLong_FromSsize_t(i) : NULL;
+        status = idx != NULL ? PyDict_SetItem(result, name, idx) : -1;
+        Py_XDECREF(name);
+        Py_XDECREF(idx);
+    }
+    Py_END_CRITICAL_SECTION();
+    if (status < 0)
+        Py_CLEAR(result);
+    return result;
+}
+
+static PyGetSetDef TreeAllocator_getset[] = {
+    {"drive_roots", (getter)TreeAllocator_get_drive_roots, NULL,
+     "Dict mapping the name of each drive root to its node index", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject TreeAllocatorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.TreeAllocator",
+    .tp_doc = "Tree allocator for paths",
+    .tp_basicsize = sizeof(TreeAllocatorObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_new = TreeAllocator_new,
+    .tp_init = (initproc)TreeAllocator_init,
+    .tp_dealloc = (destructor)TreeAllocator_dealloc,
+    .tp_methods = TreeAllocator_methods,
+    .tp_members = TreeAllocator_members,
+    .tp_getset = TreeAllocator_getset,
+};
+
+/* ========================================================================
+ * PathAllocator implementation
+ * ======================================================================== */
+
+static void
+PathAllocator_dealloc(PathAllocatorObject *self)
+{
+    if (self->weakreflist != NULL)
+        PyObject_ClearWeakRefs((PyObject *)self);
+    Py_XDECREF(self->string_pool);
+    Py_XDECREF(self->tree);
+    path_cache_free(&self->cache);
+    PyMem_Free(self->tracked_paths);
+    Py_XDECREF(self->token);
+    Py_XDECREF(self->share_path);
+    Py_XDECREF(self->origin_token);
+    Py_XDECREF(self->origin_path);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+PathAllocator_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PathAllocatorObject *self;
+    self = (PathAllocatorObject *)type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->string_pool = NULL;
+        self->tree = NULL;
+        path_cache_init(&self->cache, LOOKUP_CACHE_DEFAULT_ENTRIES, LOOKUP_CACHE_DEFAULT_BYTES);
+        self->separator[0] = '/';
+        self->separator[1] = '\0';
+        self->flavour = &path_flavour_posix;
+        self->track_paths = 0;
+        self->tracked_paths = NULL;
+        self->tracked_capacity = 0;
+        self->tracked_count = 0;
+        self->generation = 0;
+        self->token = NULL;
+        self->share_path = NULL;
+        self->share_nodes = -1;
+        self->origin_token = NULL;
+        self->origin_path = NULL;
+        self->origin_nodes = 0;
+        self->weakreflist = NULL;
+    }
+    return (PyObject *)self;
+}
+
+static int
+PathAllocator_init(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    const char *separator = NULL;
+    Py_ssize_t path_cache_bytes = PATH_CACHE_DEFAULT_BYTES;
+    int track_paths = 0;
+    Py_ssize_t lookup_cache_entries = LOOKUP_CACHE_DEFAULT_ENTRIES;
+    Py_ssize_t lookup_cache_bytes = LOOKUP_CACHE_DEFAULT_BYTES;
+    const char *flavour_name = NULL;
+    static char *kwlist[] = {"separator", "path_cache_bytes", "track_paths", "lookup_cache_entries",
+                             "lookup_cache_bytes", "flavour", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|znpnnz", kwlist, &separator, &path_cache_bytes, &track_paths,
+                                     &lookup_cache_entries, &lookup_cache_bytes, &flavour_name))
+        return -1;
+    if (lookup_cache_entries < 0) {
+        PyErr_SetString(PyExc_ValueError, "lookup_cache_entries must be non-negative");
+        return -1;
+    }
+
+    int flavour = FLAVOUR_NATIVE;
+    if (flavour_name != NULL && strcmp(flavour_name, "posix") == 0) {
+        flavour = FLAVOUR_POSIX;
+    } else if (flavour_name != NULL && strcmp(flavour_name, "windows") == 0) {
+        flavour = FLAVOUR_WINDOWS;
+    } else if (flavour_name != NULL) {
+        PyErr_Format(PyExc_ValueError, "flavour must be 'posix' or 'windows', not %.200s", flavour_name);
+        return -1;
+    }
+    if (separator == NULL) {
+        separator = flavour == FLAVOUR_WINDOWS ? "\\" : "/";
+    } else if (strlen(separator) != 1) {
+        PyErr_SetString(PyExc_ValueError, "separator must be a single ASCII character");
+        return -1;
+    }
+
+    /* Strings cached by an earlier __init__ refer to the tree being replaced */
+    path_cache_free(&self->cache);
+    path_cache_init(&self->cache, lookup_cache_entries, lookup_cache_bytes < 0 ? -1 : lookup_cache_bytes);
+
+    self->track_paths = (char)track_paths;
+
+    /* Create string pool */
+    self->string_pool = (StringPoolObject *)PyObject_CallObject((PyObject *)&StringPoolType, NULL);
+    if (self->string_pool == NULL)
+        return -1;
+
+    /* Create tree allocator.  Windows trees name the absolute root after the
+     * separator; its hash is the same folded or not. */
+    PyObject *tree_args = flavour == FLAVOUR_WINDOWS ? Py_BuildValue("(Os)", self->string_pool, separator)
+                                                     : Py_BuildValue("(O)", self->string_pool);
+    if (tree_args == NULL)
+        return -1;
+    self->tree = (TreeAllocatorObject *)PyObject_CallObject((PyObject *)&TreeAllocatorType, tree_args);
+    Py_DECREF(tree_args);
+    if (self->tree == NULL)
+        return -1;
+    self->tree->path_string_budget = path_cache_bytes;
+    path_allocator_set_flavour(self, flavour, separator[0]);
+
+    return 0;
+}
+
+/* ========================================================================
+ * Materialized path strings
+ *
+ * str() of a node is built from its parent's string plus separator plus
+ * name and cached in the tree's path_strings side array, so repeated
+ * conversions are O(1) and a new child costs O(len(name)).  Caching stops
+ * once path_string_budget bytes are held; uncached strings are still
+ * built from the nearest cached ancestor.
+ * ======================================================================== */
+
+static inline Py_ssize_t
+path_string_size(PyObject *str)
+{
+    return (Py_ssize_t)sizeof(PyASCIIObject) + PyUnicode_GET_LENGTH(str) * PyUnicode_KIND(str);
+}
+
+static inline PyObject *
+path_string_cached(TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return tree->path_strings.count > 0 ? *tree_path_string_slot(tree, node_idx) : NULL;
+}
+
+static void
+path_string_store(TreeAllocatorObject *tree, Py_ssize_t node_idx, PyObject *str)
+{
+    if (tree->path_strings.count == 0 || *tree_path_string_slot(tree, node_idx) != NULL)
+        return;
+
+    Py_ssize_t size = path_string_size(str);
+    if (tree->path_string_budget >= 0 &&
+        tree->path_string_bytes + size > tree->path_string_budget) {
+        return;
+    }
+    Py_INCREF(str);
+    *tree_path_string_slot(tree, node_idx) = str;
+    tree->path_string_bytes += size;
+}
+
+/* Concatenate prefix, optional separator and name into a new str */
+static PyObject *
+path_string_concat(PyObject *prefix, PyObject *separator, PyObject *name)
+{
+    Py_ssize_t prefix_len = PyUnicode_GET_LENGTH(prefix);
+    Py_ssize_t sep_len = separator ? PyUnicode_GET_LENGTH(separator) : 0;
+    Py_ssize_t name_len = PyUnicode_GET_LENGTH(name);
+
+    Py_UCS4 maxchar = PyUnicode_MAX_CHAR_VALUE(prefix);
+    if (separator && PyUnicode_MAX_CHAR_VALUE(separator) > maxchar)
+        maxchar = PyUnicode_MAX_CHAR_VALUE(separator);
+    if (PyUnicode_MAX_CHAR_VALUE(name) > maxchar)
+        maxchar = PyUnicode_MAX_CHAR_VALUE(name);
+
+    PyObject *result = PyUnicode_New(prefix_len + sep_len + name_len, maxchar);
+    if (result == NULL)
+        return NULL;
+
+    if (PyUnicode_CopyCharacters(result, 0, prefix, 0, prefix_len) < 0 ||
+        (separator && PyUnicode_CopyCharacters(result, prefix_len, separator, 0, sep_len) < 0) ||
+        PyUnicode_CopyCharacters(result, prefix_len + sep_len, name, 0, name_len) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+/* A root spells out its name, which for drives already ends in the separator */
+static PyObject *
+path_string_root(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx == self->tree->absolute_root) {
+        return PyUnicode_FromString(self->separator);
+    } else if (node_idx == self->tree->relative_root) {
+        return PyUnicode_FromString(".");
+    }
+    return StringPool_get_object(self->string_pool, tree_name(self->tree, node_idx));
+}
+
+static PyObject *
+path_get_str(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    TreeAllocatorObject *tree = self->tree;
+    PyObject *cached = path_string_cached(tree, node_idx);
+    if (cached != NULL) {
+        Py_INCREF(cached);
+        return cached;
+    }
+
+    /* The cache array is allocated on first use */
+    if (tree->path_strings.count == 0 && tree->path_string_budget != 0) {
+        while (tree->path_strings.count < tree->depths.count) {
+            if (chunked_grow(&tree->path_strings, NODE_CHUNK_BITS, sizeof(PyObject *), 1) < 0) {
+                chunked_free(&tree->path_strings);
+                return NULL;
+            }
+        }
+    }
+
+    /* Find the nearest ancestor with a cached string, or the root */
+    Py_ssize_t depth = 0;
+    Py_ssize_t curr = node_idx;
+    while (tree_parent(tree, curr) >= 0 && path_string_cached(tree, curr) == NULL) {
+        depth++;
+        curr = tree_parent(tree, curr);
+    }
+
+    PyObject *current = path_string_cached(tree, curr);
+    if (current != NULL) {
+        Py_INCREF(current);
+    } else {
+        current = path_string_root(self, curr);
+        if (current == NULL)
+            return NULL;
+        path_string_store(tree, curr, current);
+    }
+    if (depth == 0)
+        return current;
+
+    /* Collect the uncached chain from the ancestor down to the node */
+    Py_ssize_t stack_buf[64];
+    Py_ssize_t *chain = stack_buf;
+    if (depth > (Py_ssize_t)(sizeof(stack_buf) / sizeof(stack_buf[0]))) {
+        chain = PyMem_Malloc(depth * sizeof(Py_ssize_t));
+        if (chain == NULL) {
+            Py_DECREF(current);
+            return PyErr_NoMemory();
+        }
+    }
+    Py_ssize_t pos = depth;
+    for (Py_ssize_t idx = node_idx; idx != curr; idx = tree_parent(tree, idx)) {
+        chain[--pos] = idx;
+    }
+
+    PyObject *separator = PyUnicode_FromString(self->separator);
+    if (separator == NULL) {
+        goto error;
+    }
+
+    for (Py_ssize_t i = 0; i < depth; i++) {
+        Py_ssize_t idx = chain[i];
+        Py_ssize_t parent_idx = tree_parent(tree, idx);
+        PyObject *name = StringPool_get_object(self->string_pool, tree_name(tree, idx));
+        if (name == NULL)
+            goto error;
+
+        PyObject *next;
+        if (parent_idx == tree->relative_root) {
+            /* Relative paths do not spell out the "." root */
+            next = name;
+            Py_INCREF(next);
+        } else if (tree_parent(tree, parent_idx) < 0) {
+            /* Roots end in a separator, or are a bare drive like "C:" */
+            next = path_string_concat(current, NULL, name);
+        } else {
+            next = path_string_concat(current, separator, name);
+        }
+        Py_DECREF(name);
+        if (next == NULL)
+            goto error;
+
+        Py_SETREF(current, next);
+        path_string_store(tree, idx, current);
+    }
+    FASTPATH_COUNT(tree->counters.path_strings_built, depth);
+
+    Py_DECREF(separator);
+    if (chain != stack_buf)
+        PyMem_Free(chain);
+    return current;
+
+error:
+    Py_XDECREF(separator);
+    Py_DECREF(current);
+    if (chain != stack_buf)
+        PyMem_Free(chain);
+    return NULL;
+}
+
+PyObject *
+PathAllocator_get_str(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    PyObject *result;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    result = path_get_str(self, node_idx);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+/* ========================================================================
+ * Encoded paths
+ *
+ * The pool already holds each name as the bytes the filesystem uses, so
+ * bytes(path) and every system call are served by copying names straight
+ * into a bytes object, without building and re-encoding a str.  Results
+ * are cached per node in path_bytes under the same budget as path
+ * strings and reused as the prefix of their descendants.  A filesystem
+ * encoding other than UTF-8 with surrogateescape falls back to encoding
+ * str().
+ * ======================================================================== */
+
+static inline PyObject *
+path_bytes_cached(TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return tree->path_bytes.count > 0 ? *tree_path_bytes_slot(tree, node_idx) : NULL;
+}
+
+static void
+path_bytes_store(TreeAllocatorObject *tree, Py_ssize_t node_idx, PyObject *encoded)
+{
+    if (tree->path_bytes.count == 0 || *tree_path_bytes_slot(tree, node_idx) != NULL)
+        return;
+
+    Py_ssize_t size = (Py_ssize_t)sizeof(PyBytesObject) + PyBytes_GET_SIZE(encoded);
+    if (tree->path_string_budget >= 0 &&
+        tree->path_string_bytes + size > tree->path_string_budget) {
+        return;
+    }
+    Py_INCREF(encoded);
+    *tree_path_bytes_slot(tree, node_idx) = encoded;
+    tree->path_string_bytes += size;
+}
+
+/* Encoded path without locking; the caller holds the tree and pool critical sections */
+static PyObject *
+path_get_bytes(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    PyObject *cached = path_bytes_cached(tree, node_idx);
+    if (cached != NULL) {
+        Py_INCREF(cached);
+        return cached;
+    }
+    if (node_idx == tree->relative_root)
+        return PyBytes_FromString(".");
+
+    /* The cache array is allocated on first use */
+    if (tree->path_bytes.count == 0 && tree->path_string_budget != 0) {
+        while (tree->path_bytes.count < tree->depths.count) {
+            if (chunked_grow(&tree->path_bytes, NODE_CHUNK_BITS, sizeof(PyObject *), 1) < 0) {
+                chunked_free(&tree->path_bytes);
+                return NULL;
+            }
+        }
+    }
+
+    /* Measure names up to the nearest cached ancestor or the root; a name
+     * below another name is preceded by a separator */
+    Py_ssize_t length = 0;
+    Py_ssize_t curr = node_idx;
+    PyObject *prefix = NULL;
+    while (tree_parent(tree, curr) >= 0 && (prefix = path_bytes_cached(tree, curr)) == NULL) {
+        Py_ssize_t parent_idx = tree_parent(tree, curr);
+        length += string_entry(pool, tree_name(tree, curr))->length + (tree_parent(tree, parent_idx) >= 0);
+        curr = parent_idx;
+    }
+
+    const char *prefix_data = "";
+    Py_ssize_t prefix_length = 0;
+    if (prefix != NULL) {
+        prefix_data = PyBytes_AS_STRING(prefix);
+        prefix_length = PyBytes_GET_SIZE(prefix);
+    } else if (curr == tree->absolute_root) {
+        prefix_data = self->separator;
+        prefix_length = 1;
+    } else if (curr != tree->relative_root) {
+        const StringEntry *entry = string_entry(pool, tree_name(tree, curr));
+        prefix_data = string_entry_data(pool, entry);
+        prefix_length = entry->length;
+    }
+
+    PyObject *result = PyBytes_FromStringAndSize(NULL, prefix_length + length);
+    if (result == NULL)
+        return NULL;
+    char *dest = PyBytes_AS_STRING(result);
+    memcpy(dest, prefix_data, prefix_length);
+    Py_ssize_t pos = prefix_length + length;
+    for (Py_ssize_t idx = node_idx; idx != curr; idx = tree_parent(tree, idx)) {
+        const StringEntry *entry = string_entry(pool, tree_name(tree, idx));
+        pos -= entry->length;
+        memcpy(dest + pos, string_entry_data(pool, entry), entry->length);
+        if (tree_parent(tree, tree_parent(tree, idx)) >= 0)
+            dest[--pos] = self->separator[0];
+    }
+    path_bytes_store(tree, node_idx, result);
+    FASTPATH_COUNT(tree->counters.path_bytes_built, 1);
+    return result;
+}
+
+PyObject *
+PathAllocator_get_bytes(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+    if (!fastpath_fs_utf8) {
+        PyObject *str = PathAllocator_get_str(self, node_idx);
+        PyObject *encoded = str != NULL ? PyUnicode_EncodeFSDefault(str) : NULL;
+        Py_XDECREF(str);
+        return encoded;
+    }
+
+    PyObject *result;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self->tree, (PyObject *)self->string_pool);
+    result = path_get_bytes(self, node_idx);
+    Py_END_CRITICAL_SECTION2();
+    return result;
+}
+
+static PyObject *
+PathAllocator_get_bytes_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_bytes(self, node_idx);
+}
+
+/* POSIX walk without locking; the caller holds the tree and pool critical sections */
+Py_ssize_t
+path_walk_posix(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length,
+                const char sep)
+{
+    TreeAllocatorObject *tree = self->tree;
+    Py_ssize_t current_idx = base_idx;
+    Py_ssize_t pos = 0;
+
+    /* A leading separator anchors the path at the absolute root */
+    if (length > 0 && data[0] == sep) {
+        current_idx = tree->absolute_root;
+    }
+
+    ByteScanner separators;
+    byte_scanner_init(&separators, data, length, sep);
+    for (Py_ssize_t start = 0; start < length; start = pos + 1) {
+        /* Empty components come from repeated separators, "." names the directory itself */
+        pos = byte_scanner_next(&separators);
+        if (pos == start || (pos == start + 1 && data[start] == '.'))
+            continue;
+
+        Py_ssize_t name_id = string_pool_intern(self->string_pool, data + start, pos - start);
+        if (name_id < 0)
+            return -1;
+
+        Py_ssize_t child_idx = tree_lookup_child(tree, current_idx, name_id);
+        if (child_idx < 0) {
+            child_idx = tree_add_node(tree, current_idx, name_id);
+            if (child_idx < 0)
+                return -1;
+        }
+        current_idx = child_idx;
+    }
+
+    return current_idx;
+}
+
+static Py_ssize_t
+path_walk_sep(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length,
+              const char sep)
+{
+    Py_ssize_t node_idx;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self->tree, (PyObject *)self->string_pool);
+    node_idx = self->flavour->walk(self, base_idx, data, length, sep);
+    Py_END_CRITICAL_SECTION2();
+    return node_idx;
+}
+
+Py_ssize_t
+PathAllocator_walk(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length)
+{
+    return path_walk_sep(self, base_idx, data, length, self->separator[0]);
+}
+
+/* Child of parent_idx named by a single component, taken literally */
+Py_ssize_t
+PathAllocator_add_child(PathAllocatorObject *self, Py_ssize_t parent_idx, const char *name, Py_ssize_t length)
+{
+    if (parent_idx < 0 || parent_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+
+    Py_ssize_t child_idx;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self->tree, (PyObject *)self->string_pool);
+    Py_ssize_t name_id = string_pool_intern(self->string_pool, name, length);
+    child_idx = name_id < 0 ? -1 : tree_lookup_child(self->tree, parent_idx, name_id);
+    if (name_id >= 0 && child_idx < 0)
+        child_idx = tree_add_node(self->tree, parent_idx, name_id);
+    Py_END_CRITICAL_SECTION2();
+    return child_idx;
+}
+
+/* Pool bytes of a path argument.  str is taken as UTF-8, with the lone
+ * surrogates that stand for undecodable filename bytes turned back into
+ * those bytes, bytes are taken as they are, and os.PathLike objects are
+ * resolved first.  *owned keeps alive whatever the result points into and
+ * is released by the caller with Py_XDECREF. */
+const char *
+path_argument_bytes(PyObject *arg, Py_ssize_t *length, PyObject **owned)
+{
+    *owned = NULL;
+    if (PyUnicode_Check(arg)) {
+        const char *data = PyUnicode_AsUTF8AndSize(arg, length);
+        if (data != NULL || !PyErr_ExceptionMatches(PyExc_UnicodeEncodeError))
+            return data;
+        PyErr_Clear();
+        *owned = PyUnicode_AsEncodedString(arg, "utf-8", "surrogateescape");
+        if (*owned == NULL)
+            return NULL;
+    } else if (PyBytes_Check(arg)) {
+        *length = PyBytes_GET_SIZE(arg);
+        return PyBytes_AS_STRING(arg);
+    } else {
+        PyObject *fspath = PyOS_FSPath(arg);
+        if (fspath == NULL)
+            return NULL;
+        const char *data = path_argument_bytes(fspath, length, owned);
+        if (*owned == NULL)
+            *owned = fspath;
+        else
+            Py_DECREF(fspath);
+        return data;
+    }
+    *length = PyBytes_GET_SIZE(*owned);
+    return PyBytes_AS_STRING(*owned);
+}
+
+Py_ssize_t
+PathAllocator_join_part(PathAllocatorObject *self, Py_ssize_t base_idx, PyObject *part)
+{
+    if (base_idx < 0 || base_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+    if (base_idx == self->tree->relative_root) {
+        /* A path of this allocator already names its node */
+        if (PyObject_TypeCheck(part, &PureFastPathType) &&
+            ((PureFastPathObject *)part)->_allocator == (PyObject *)self) {
+            return ((PureFastPathObject *)part)->_node_idx;
+        }
+        if (PyUnicode_CheckExact(part))
+            return PathAllocator_lookup_path(self, part);
+    }
+
+    PyObject *owned;
+    Py_ssize_t length;
+    const char *data = path_argument_bytes(part, &length, &owned);
+    Py_ssize_t node_idx = data != NULL ? PathAllocator_walk(self, base_idx, data, length) : -1;
+    Py_XDECREF(owned);
+    return node_idx;
+}
+
+Py_ssize_t
+PathAllocator_join_parts(PathAllocatorObject *self, Py_ssize_t base_idx, PyObject *parts)
+{
+    Py_ssize_t current_idx = base_idx;
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(parts); i++) {
+        current_idx = PathAllocator_join_part(self, current_idx, PyTuple_GET_ITEM(parts, i));
+        if (current_idx < 0)
+            return -1;
+    }
+    return current_idx;
+}
+
+PyObject *
+PathAllocator_from_parts(PathAllocatorObject *self, PyObject *args)
+{
+    /* Accept either from_parts(*parts) or from_parts(parts_tuple) */
+    PyObject *parts = args;
+    if (PyTuple_GET_SIZE(args) == 1 && PyTuple_Check(PyTuple_GET_ITEM(args, 0))) {
+        parts = PyTuple_GET_ITEM(args, 0);
+    }
+
+    Py_ssize_t node_idx = PathAllocator_join_parts(self, self->tree->relative_root, parts);
+    if (node_idx < 0)
+        return NULL;
+
+    return PyLong_FromSsize_t(node_idx);
+}
+
+PyObject *
+PathAllocator_from_string(PathAllocatorObject *self, PyObject *args)
+{
+    PyObject *path;
+    if (!PyArg_ParseTuple(args, "O", &path))
+        return NULL;
+
+    Py_ssize_t node_idx = PathAllocator_join_part(self, self->tree->relative_root, path);
+    if (node_idx < 0)
+        return NULL;
+
+    return PyLong_FromSsize_t(node_idx);
+}
+
+/* ========================================================================
+ * Batch construction
+ * ======================================================================== */
+
+/* Append to buf, which the caller frees with PyMem_Free */
+int
+index_buffer_append(IndexBuffer *buf, Py_ssize_t node_idx)
+{
+    if (buf->count >= buf->capacity) {
+        Py_ssize_t new_capacity = buf->capacity ? buf->capacity * 2 : 1024;
+        int64_t *new_items = PyMem_Realloc(buf->items, new_capacity * sizeof(int64_t));
+        if (new_items == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        buf->items = new_items;
+        buf->capacity = new_capacity;
+    }
+    buf->items[buf->count++] = node_idx;
+    return 0;
+}
+
+/* array(format) holding a copy of nbytes of raw items */
+PyObject *
+fastpath_typed_array(const char *format, const void *items, Py_ssize_t nbytes)
+{
+    PyObject *array_module = PyImport_ImportModule("array");
+    if (array_module == NULL)
+        return NULL;
+
+    PyObject *data = PyBytes_FromStringAndSize((const char *)items, nbytes);
+    if (data == NULL) {
+        Py_DECREF(array_module);
+        return NULL;
+    }
+
+    PyObject *result = PyObject_CallMethod(array_module, "array", "sO", format, data);
+    Py_DECREF(data);
+    Py_DECREF(array_module);
+    return result;
+}
+
+PyObject *
+fastpath_index_array(const int64_t *indices, Py_ssize_t count)
+{
+    return fastpath_typed_array("q", indices, count * (Py_ssize_t)sizeof(int64_t));
+}
+
+/* Intern every newline-separated path of a bytes-like buffer */
+static int
+from_strings_buffer(PathAllocatorObject *self, Py_buffer *view, char sep, IndexBuffer *out)
+{
+    const char *data = view->buf;
+    Py_ssize_t length = view->len;
+    Py_ssize_t pos = 0;
+
+    while (pos < length) {
+        const char *line = data + pos;
+        const char *newline = memchr(line, '\n', length - pos);
+        Py_ssize_t line_len = newline ? newline - line : length - pos;
+        pos += line_len + 1;
+
+        if (line_len > 0 && line[line_len - 1] == '\r')
+            line_len--;
+        /* Blank lines are skipped, as ingest() skips empty records */
+        if (line_len == 0)
+            continue;
+
+        Py_ssize_t node_idx = path_walk_sep(self, self->tree->relative_root, line, line_len, sep);
+        if (node_idx < 0 || index_buffer_append(out, node_idx) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* Intern every str produced by an iterable */
+static int
+from_strings_iterable(PathAllocatorObject *self, PyObject *iterable, char sep, IndexBuffer *out)
+{
+    PyObject *iter = PyObject_GetIter(iterable);
+    if (iter == NULL)
+        return -1;
+
+    PyObject *item;
+    while ((item = PyIter_Next(iter)) != NULL) {
+        PyObject *owned;
+        Py_ssize_t length;
+        const char *data = path_argument_bytes(item, &length, &owned);
+        Py_ssize_t node_idx = -1;
+        if (data != NULL) {
+            node_idx = path_walk_sep(self, self->tree->relative_root, data, length, sep);
+        }
+        Py_XDECREF(owned);
+        Py_DECREF(item);
+        if (node_idx < 0 || index_buffer_append(out, node_idx) < 0) {
+            Py_DECREF(iter);
+            return -1;
+        }
+    }
+    Py_DECREF(iter);
+
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static PyObject *
+PathAllocator_from_strings(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *source;
+    const char *sep = NULL;
+    static char *kwlist[] = {"paths", "sep", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|z", kwlist, &source, &sep))
+        return NULL;
+
+    if (sep == NULL)
+        sep = self->separator;
+    if (strlen(sep) != 1) {
+        PyErr_SetString(PyExc_ValueError, "sep must be a single character");
+        return NULL;
+    }
+
+    /* Iterating a str would make a path of every character */
+    if (PyUnicode_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "paths must be an iterable of paths or a bytes-like object, not str");
+        return NULL;
+    }
+
+    IndexBuffer out = {NULL, 0, 0};
+    int status;
+    if (PyObject_CheckBuffer(source)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(source, &view, PyBUF_SIMPLE) < 0)
+            return NULL;
+        status = from_strings_buffer(self, &view, sep[0], &out);
+        PyBuffer_Release(&view);
+    } else {
+        status = from_strings_iterable(self, source, sep[0], &out);
+    }
+
+    PyObject *result = NULL;
+    if (status == 0) {
+        result = fastpath_index_array(out.items, out.count);
+    }
+    PyMem_Free(out.items);
+    return result;
+}
+
+PyObject *
+PathAllocator_get_parts(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    return TreeAllocator_get_parts(self->tree, node_idx);
+}
+
+static PyObject *
+PathAllocator_get_parts_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_parts(self, node_idx);
+}
+
+Py_ssize_t
+PathAllocator_get_parent(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+
+    Py_ssize_t parent_idx = tree_parent(self->tree, node_idx);
+    if (parent_idx < 0) {
+        return node_idx;  /* Root is its own parent */
+    }
+
+    return parent_idx;
+}
+
+static PyObject *
+PathAllocator_get_parent_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    Py_ssize_t parent_idx = PathAllocator_get_parent(self, node_idx);
+    if (parent_idx < 0)
+        return NULL;
+
+    return PyLong_FromSsize_t(parent_idx);
+}
+
+PyObject *
+PathAllocator_get_name(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    /* Roots have no name, like pathlib's anchor-only paths */
+    if (tree_parent(self->tree, node_idx) < 0) {
+        return PyUnicode_FromStringAndSize(NULL, 0);
+    }
+
+    return StringPool_get_object(self->string_pool, tree_name(self->tree, node_idx));
+}
+
+static PyObject *
+PathAllocator_get_name_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_name(self, node_idx);
+}
+
+static PyObject *
+PathAllocator_get_suffix_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_suffix(self, node_idx);
+}
+
+static PyObject *
+PathAllocator_get_stem_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_stem(self, node_idx);
+}
+
+static PyObject *
+PathAllocator_get_suffixes_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_suffixes(self, node_idx);
+}
+
+static PyObject *
+PathAllocator_with_name_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    PyObject *name;
+    if (!PyArg_ParseTuple(args, "nO", &node_idx, &name))
+        return NULL;
+
+    Py_ssize_t result = PathAllocator_with_name(self, node_idx, name);
+    return result < 0 ? NULL : PyLong_FromSsize_t(result);
+}
+
+static PyObject *
+PathAllocator_with_suffix_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    PyObject *suffix;
+    if (!PyArg_ParseTuple(args, "nO", &node_idx, &suffix))
+        return NULL;
+
+    Py_ssize_t result = PathAllocator_with_suffix(self, node_idx, suffix);
+    return result < 0 ? NULL : PyLong_FromSsize_t(result);
+}
+
+static PyObject *
+PathAllocator_join_py(PathAllocatorObject *self, PyObject *args)
+{
+    /* Parse base_idx and remaining args as parts */
+    if (PyTuple_Size(args) < 1) {
+        PyErr_SetString(PyExc_TypeError, "join() missing required argument: 'base_idx'");
+        return NULL;
+    }
+
+    Py_ssize_t current_idx = PyLong_AsSsize_t(PyTuple_GET_ITEM(args, 0));
+    if (current_idx == -1 && PyErr_Occurred())
+        return NULL;
+
+    if (current_idx < 0 || current_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    for (Py_ssize_t i = 1; i < PyTuple_GET_SIZE(args); i++) {
+        current_idx = PathAllocator_join_part(self, current_idx, PyTuple_GET_ITEM(args, i));
+        if (current_idx < 0)
+            return NULL;
+    }
+
+    return PyLong_FromSsize_t(current_idx);
+}
+
+/* Store an integer in a stats dict, releasing it */
+static int
+stats_set(PyObject *dict, const char *key, PyObject *value)
+{
+    if (value == NULL)
+        return -1;
+    int status = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return status;
+}
+
+/* Sizes, cache effectiveness and, with FASTPATH_STATS, hot-path counters */
+static PyObject *
+PathAllocator_stats(PathAllocatorObject *self, PyObject *Py_UNUSED(ignored))
+{
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    StringPoolCounters pool_counters;
+    TreeCounters tree_counters;
+    Py_ssize_t string_count, node_count, string_bytes, node_bytes, child_index_bytes, path_cache_bytes;
+    uint64_t depth_total;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)tree, (PyObject *)pool);
+    string_count = pool->count;
+    string_bytes = pool->bytes_used + pool->capacity * (Py_ssize_t)(sizeof(StringEntry) + sizeof(PyObject *)) +
+                   pool->table_capacity * (Py_ssize_t)sizeof(uint32_t);
+    node_count = tree->node_count;
+    node_bytes = tree->node_capacity * (Py_ssize_t)TREE_NODE_BYTES;
+    child_index_bytes = tree->child_index_capacity * (Py_ssize_t)sizeof(node_index_t);
+    path_cache_bytes = tree->path_string_bytes;
+    depth_total = tree->depth_total;
+    pool_counters = pool->counters;
+    tree_counters = tree->counters;
+    Py_END_CRITICAL_SECTION2();
+
+    Py_ssize_t cache_entries, cache_bytes, cache_hits, cache_misses, cache_evictions;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    cache_entries = self->cache.count;
+    cache_bytes = self->cache.bytes;
+    cache_hits = self->cache.hits;
+    cache_misses = self->cache.misses;
+    cache_evictions = self->cache.evictions;
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *dict = PyDict_New();
+    if (dict == NULL)
+        return NULL;
+
+    const struct {
+        const char *key;
+        Py_ssize_t value;
+    } sizes[] = {
+        {"strings_interned", string_count},
+        {"nodes_allocated", node_count},
+        /* Earlier names of the two counts */
+        {"string_count", string_count},
+        {"node_count", node_count},
+        {"string_bytes", string_bytes},
+        {"node_bytes", node_bytes},
+        {"child_index_bytes", child_index_bytes},
+        {"path_cache_bytes", path_cache_bytes},
+        {"cache_entries", cache_entries},
+        {"cache_bytes", cache_bytes},
+        {"cache_hits", cache_hits},
+        {"cache_misses", cache_misses},
+        {"cache_evictions", cache_evictions},
+    };
+    int status = 0;
+    for (size_t i = 0; status == 0 && i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        status = stats_set(dict, sizes[i].key, PyLong_FromSsize_t(sizes[i].value));
+
+    Py_ssize_t cache_lookups = cache_hits + cache_misses;
+    if (status == 0)
+        status = stats_set(dict, "cache_hit_rate",
+                           PyFloat_FromDouble(cache_lookups ? (double)cache_hits / cache_lookups : 0.0));
+    if (status == 0)
+        status = stats_set(dict, "average_depth",
+                           PyFloat_FromDouble(node_count ? (double)depth_total / node_count : 0.0));
+
+#ifdef FASTPATH_STATS
+    const struct {
+        const char *key;
+        uint64_t value;
+    } counters[] = {
+        {"intern_hits", pool_counters.intern_hits},
+        {"intern_misses", pool_counters.intern_misses},
+        {"str_objects_created", pool_counters.objects_created},
+        {"child_lookups", tree_counters.child_lookups},
+        {"child_probes", tree_counters.child_probes},
+        {"node_grows", tree_counters.node_grows},
+        {"node_grow_bytes", tree_counters.node_grow_bytes},
+        {"path_strings_built", tree_counters.path_strings_built},
+        {"path_bytes_built", tree_counters.path_bytes_built},
+    };
+    for (size_t i = 0; status == 0 && i < sizeof(counters) / sizeof(counters[0]); i++)
+        status = stats_set(dict, counters[i].key, PyLong_FromUnsignedLongLong(counters[i].value));
+    uint64_t lookups = tree_counters.child_lookups;
+    if (status == 0)
+        status = stats_set(dict, "average_probe_length",
+                           PyFloat_FromDouble(lookups ? (double)tree_counters.child_probes / lookups : 0.0));
+#else
+    (void)pool_counters;
+    (void)tree_counters;
+#endif
+    if (status == 0)
+        status = stats_set(dict, "counters_enabled", PyBool_FromLong(FASTPATH_STATS_ENABLED));
+
+    if (status < 0)
+        Py_CLEAR(dict);
+    return dict;
+}
+
+int
+PathAllocator_is_absolute(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+
+    return self->flavour->absolute(self, tree_anchor(self->tree, node_idx));
+}
+
+/* Drive and root of a path, as pathlib's anchor; empty for relative paths */
+PyObject *
+PathAllocator_get_anchor(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return NULL;
+    }
+
+    Py_ssize_t anchor_idx = tree_anchor(self->tree, node_idx);
+    if (anchor_idx == self->tree->relative_root)
+        return PyUnicode_FromStringAndSize(NULL, 0);
+    return path_string_root(self, anchor_idx);
+}
+
+static PyObject *
+PathAllocator_get_anchor_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return PathAllocator_get_anchor(self, node_idx);
+}
+
+static PyObject *
+PathAllocator_is_absolute_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    int result = PathAllocator_is_absolute(self, node_idx);
+    if (result < 0)
+        return NULL;
+
+    return PyBool_FromLong(result);
+}
+
+/* Relative path of node_idx below base_idx, with pathlib's error message */
+Py_ssize_t
+PathAllocator_relative_to(PathAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t base_idx)
+{
+    int is_ancestor = TreeAllocator_is_ancestor(self->tree, base_idx, node_idx);
+    if (is_ancestor < 0)
+        return -1;
+    if (!is_ancestor) {
+        PyObject *path = PathAllocator_get_str(self, node_idx);
+        PyObject *base = PathAllocator_get_str(self, base_idx);
+        if (path != NULL && base != NULL) {
+            PyErr_Format(PyExc_ValueError, "%R is not in the subpath of %R", path, base);
+        }
+        Py_XDECREF(path);
+        Py_XDECREF(base);
+        return -1;
+    }
+
+    return TreeAllocator_relative_to(self->tree, node_idx, base_idx);
+}
+
+static PyObject *
+PathAllocator_relative_to_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx, base_idx;
+    if (!PyArg_ParseTuple(args, "nn", &node_idx, &base_idx))
+        return NULL;
+
+    Py_ssize_t result = PathAllocator_relative_to(self, node_idx, base_idx);
+    if (result < 0)
+        return NULL;
+    return PyLong_FromSsize_t(result);
+}
+
+static PyObject *
+PathAllocator_is_relative_to_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx, base_idx;
+    if (!PyArg_ParseTuple(args, "nn", &node_idx, &base_idx))
+        return NULL;
+
+    int result = TreeAllocator_is_ancestor(self->tree, base_idx, node_idx);
+    if (result < 0)
+        return NULL;
+    return PyBool_FromLong(result);
+}
+
+static PyObject *
+PathAllocator_get_parents_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    return TreeAllocator_get_ancestors(self->tree, node_idx);
+}
+
+static PyObject *
+PathAllocator_common_ancestor_py(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t a_idx, b_idx;
+    if (!PyArg_ParseTuple(args, "nn", &a_idx, &b_idx))
+        return NULL;
+
+    Py_ssize_t result = TreeAllocator_common_ancestor(self->tree, a_idx, b_idx);
+    if (result < 0)
+        return NULL;
+    return PyLong_FromSsize_t(result);
+}
+
+/* Parse (node_idx, path_type=None) for the subtree queries */
+static int
+path_subtree_args(PyObject *args, PyObject *kwds, Py_ssize_t *node_idx, PyTypeObject **path_type)
+{
+    PyObject *type = Py_None;
+    static char *kwlist[] = {"node_idx", "path_type", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|O", kwlist, node_idx, &type))
+        return -1;
+
+    *path_type = NULL;
+    if (type != Py_None) {
+        if (!PyType_Check(type) || !PyType_IsSubtype((PyTypeObject *)type, &PureFastPathType)) {
+            PyErr_SetString(PyExc_TypeError, "path_type must be a PureFastPath subclass");
+            return -1;
+        }
+        *path_type = (PyTypeObject *)type;
+    }
+    return 0;
+}
+
+static PyObject *
+PathAllocator_children(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    Py_ssize_t node_idx;
+    PyTypeObject *path_type;
+    if (path_subtree_args(args, kwds, &node_idx, &path_type) < 0)
+        return NULL;
+
+    PyObject *indices = TreeAllocator_get_children(self->tree, node_idx);
+    if (indices == NULL || path_type == NULL)
+        return indices;
+
+    /* Materialize paths from the index array */
+    Py_ssize_t count = PySequence_Size(indices);
+    PyObject *result = count < 0 ? NULL : PyList_New(count);
+    for (Py_ssize_t i = 0; result != NULL && i < count; i++) {
+        PyObject *idx = PySequence_GetItem(indices, i);
+        PyObject *path = idx ? PureFastPath_from_index(path_type, (PyObject *)self, PyLong_AsSsize_t(idx)) : NULL;
+        Py_XDECREF(idx);
+        if (path == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, path);
+    }
+    Py_DECREF(indices);
+    return result;
+}
+
+static PyObject *
+PathAllocator_iter_descendants(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    Py_ssize_t node_idx;
+    PyTypeObject *path_type;
+    if (path_subtree_args(args, kwds, &node_idx, &path_type) < 0)
+        return NULL;
+
+    return TreeAllocator_iter_descendants(self->tree, node_idx, (PyObject *)self, path_type);
+}
+
+static PyObject *
+PathAllocator_count_descendants(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    Py_ssize_t count = TreeAllocator_count_descendants(self->tree, node_idx);
+    if (count < 0)
+        return NULL;
+    return PyLong_FromSsize_t(count);
+}
+
+/* ========================================================================
+ * Path comparison
+ *
+ * Paths compare like pathlib's parts: component by component, each by its
+ * UTF-8 bytes (which orders like code points).  The relative root adds no
+ * component; other roots contribute their name.  Components are read
+ * straight from the string pools, so no strings are created.  Windows
+ * allocators compare the lowercase forms of components instead.
+ * ======================================================================== */
+
+#define PATH_CHAIN_STACK 64
+
+/* Collect a node's components top-down into chain; returns the count */
+static Py_ssize_t
+path_chain(TreeAllocatorObject *tree, Py_ssize_t node_idx, Py_ssize_t *stack_buf, Py_ssize_t **chain)
+{
+    Py_ssize_t anchor = tree_anchor(tree, node_idx);
+    Py_ssize_t count = tree_depth(tree, node_idx) + (anchor != tree->relative_root);
+
+    *chain = stack_buf;
+    if (count > PATH_CHAIN_STACK) {
+        *chain = PyMem_Malloc(count * sizeof(Py_ssize_t));
+        if (*chain == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    Py_ssize_t pos = count;
+    for (Py_ssize_t idx = node_idx; pos > 0; idx = tree_parent(tree, idx)) {
+        (*chain)[--pos] = idx;
+    }
+    return count;
+}
+
+/* Component order of the POSIX flavour, by exact bytes */
+int
+path_component_compare(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx)
+{
+    Py_ssize_t a_name = tree_name(a->tree, a_idx);
+    Py_ssize_t b_name = tree_name(b->tree, b_idx);
+    if (a->string_pool == b->string_pool && a_name == b_name)
+        return 0;
+
+    StringEntry *a_entry = string_entry(a->string_pool, a_name);
+    StringEntry *b_entry = string_entry(b->string_pool, b_name);
+    uint32_t length = a_entry->length < b_entry->length ? a_entry->length : b_entry->length;
+    int cmp = memcmp(string_entry_data(a->string_pool, a_entry),
+                     string_entry_data(b->string_pool, b_entry), length);
+    if (cmp != 0)
+        return cmp;
+    return (a_entry->length > b_entry->length) - (a_entry->length < b_entry->length);
+}
+
+int
+PathAllocator_compare(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx,
+                      int *result)
+{
+    if (a_idx < 0 || a_idx >= a->tree->node_count || b_idx < 0 || b_idx >= b->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+    if (a == b && a_idx == b_idx) {
+        *result = 0;
+        return 0;
+    }
+    if (a->flavour != b->flavour) {
+        PyErr_Format(PyExc_TypeError, "cannot compare %s and %s paths", a->flavour->name, b->flavour->name);
+        return -1;
+    }
+
+    /* Same tree and root: climb to the first differing ancestors.  Distinct
+     * siblings can only tie when case is ignored, which needs every component. */
+    if (a == b && tree_anchor(a->tree, a_idx) == tree_anchor(b->tree, b_idx) && a->flavour->id == FLAVOUR_POSIX) {
+        TreeAllocatorObject *tree = a->tree;
+        Py_ssize_t a_depth = tree_depth(tree, a_idx), b_depth = tree_depth(tree, b_idx);
+        Py_ssize_t x = a_idx, y = b_idx;
+        for (Py_ssize_t d = a_depth; d > b_depth; d--)
+            x = tree_parent(tree, x);
+        for (Py_ssize_t d = b_depth; d > a_depth; d--)
+            y = tree_parent(tree, y);
+        if (x == y) {
+            *result = (a_depth > b_depth) - (a_depth < b_depth);
+            return 0;
+        }
+        while (tree_parent(tree, x) != tree_parent(tree, y)) {
+            x = tree_parent(tree, x);
+            y = tree_parent(tree, y);
+        }
+        *result = path_component_compare(a, x, b, y);
+        return 0;
+    }
+
+    Py_ssize_t a_buf[PATH_CHAIN_STACK], b_buf[PATH_CHAIN_STACK];
+    Py_ssize_t *a_chain, *b_chain;
+    Py_ssize_t a_count = path_chain(a->tree, a_idx, a_buf, &a_chain);
+    if (a_count < 0)
+        return -1;
+    Py_ssize_t b_count = path_chain(b->tree, b_idx, b_buf, &b_chain);
+    if (b_count < 0) {
+        if (a_chain != a_buf)
+            PyMem_Free(a_chain);
+        return -1;
+    }
+
+    int cmp = 0;
+    Py_ssize_t common = a_count < b_count ? a_count : b_count;
+    for (Py_ssize_t i = 0; i < common && cmp == 0; i++)
+        cmp = a->flavour->compare(a, a_chain[i], b, b_chain[i]);
+    if (cmp == 0)
+        cmp = (a_count > b_count) - (a_count < b_count);
+
+    if (a_chain != a_buf)
+        PyMem_Free(a_chain);
+    if (b_chain != b_buf)
+        PyMem_Free(b_chain);
+    *result = cmp;
+    return cmp == PATH_COMPARE_ERROR ? -1 : 0;
+}
+
+/* Returns 1 if both nodes name the same path, 0 if not, -1 on error */
+int
+PathAllocator_equal(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx)
+{
+    if (a_idx < 0 || a_idx >= a->tree->node_count || b_idx < 0 || b_idx >= b->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+    if (a == b && a_idx == b_idx)
+        return 1;
+    if (a->flavour != b->flavour || tree_hash(a->tree, a_idx) != tree_hash(b->tree, b_idx))
+        return 0;
+    if ((tree_anchor(a->tree, a_idx) == a->tree->relative_root) !=
+        (tree_anchor(b->tree, b_idx) == b->tree->relative_root)) {
+        return 0;
+    }
+
+    int cmp;
+    if (PathAllocator_compare(a, a_idx, b, b_idx, &cmp) < 0)
+        return -1;
+    return cmp == 0;
+}
+
+static PyMethodDef PathAllocator_methods[] = {
+    {"from_parts", (PyCFunction)PathAllocator_from_parts, METH_VARARGS,
+     "Create path from parts"},
+    {"from_string", (PyCFunction)PathAllocator_from_string, METH_VARARGS,
+     "Create path from a str, bytes or os.PathLike path"},
+    {"from_strings", (PyCFunction)PathAllocator_from_strings, METH_VARARGS | METH_KEYWORDS,
+     "Create paths from an iterable of strings or a newline-separated buffer, returning array('q') of node indices"},
+    {"ingest", (PyCFunction)PathAllocator_ingest, METH_VARARGS | METH_KEYWORDS,
+     "Create paths from a delimited listing read in blocks from a file descriptor or binary file, "
+     "returning array('q') of node indices"},
+    {"get_parts", (PyCFunction)PathAllocator_get_parts_py, METH_VARARGS,
      "Get parts of a path"},
-    {"get_parent", (PyCFunction)PathAllocator_get_parent, METH_VARARGS,
+    {"get_bytes", (PyCFunction)PathAllocator_get_bytes_py, METH_VARARGS,
+     "Get a path encoded for the filesystem, as os.fsencode() would"},
+    {"get_parent", (PyCFunction)PathAllocator_get_parent_py, METH_VARARGS,
      "Get parent node index"},
-    {"get_name", (PyCFunction)PathAllocator_get_name, METH_VARARGS,
+    {"get_name", (PyCFunction)PathAllocator_get_name_py, METH_VARARGS,
      "Get name of a node"},
-    {"join", (PyCFunction)PathAllocator_join, METH_VARARGS,
+    {"get_anchor", (PyCFunction)PathAllocator_get_anchor_py, METH_VARARGS,
+     "Get the drive and root of a path, empty for relative paths"},
+    {"get_suffix", (PyCFunction)PathAllocator_get_suffix_py, METH_VARARGS,
+     "Get the final suffix of a node's name"},
+    {"get_stem", (PyCFunction)PathAllocator_get_stem_py, METH_VARARGS,
+     "Get a node's name without its final suffix"},
+    {"get_suffixes", (PyCFunction)PathAllocator_get_suffixes_py, METH_VARARGS,
+     "Get the list of suffixes of a node's name"},
+    {"with_name", (PyCFunction)PathAllocator_with_name_py, METH_VARARGS,
+     "Get the index of the sibling node with the given name"},
+    {"with_suffix", (PyCFunction)PathAllocator_with_suffix_py, METH_VARARGS,
+     "Get the index of the sibling node with the suffix replaced"},
+    {"suffix_ids", (PyCFunction)PathAllocator_suffix_ids, METH_VARARGS,
+     "Map node indices to the string IDs of their suffixes, as array('q')"},
+    {"join", (PyCFunction)PathAllocator_join_py, METH_VARARGS,
      "Join path parts"},
     {"stats", (PyCFunction)PathAllocator_stats, METH_NOARGS,
-     "Get allocator statistics"},
-    {"is_absolute", (PyCFunction)PathAllocator_is_absolute, METH_VARARGS,
+     "Get sizes, cache hit rates and, in builds with FASTPATH_STATS, hot-path counters"},
+    {"is_absolute", (PyCFunction)PathAllocator_is_absolute_py, METH_VARARGS,
      "Check if path is absolute"},
+    {"relative_to", (PyCFunction)PathAllocator_relative_to_py, METH_VARARGS,
+     "Get the node for a path relative to one of its ancestors"},
+    {"is_relative_to", (PyCFunction)PathAllocator_is_relative_to_py, METH_VARARGS,
+     "Check whether a path is equal to or below another path"},
+    {"get_parents", (PyCFunction)PathAllocator_get_parents_py, METH_VARARGS,
+     "Get the ancestor indices of a path, nearest first"},
+    {"common_ancestor", (PyCFunction)PathAllocator_common_ancestor_py, METH_VARARGS,
+     "Get the longest common ancestor of two paths"},
+    {"children", (PyCFunction)PathAllocator_children, METH_VARARGS | METH_KEYWORDS,
+     "Get the children of a path, newest first, as indices or path_type objects"},
+    {"iter_descendants", (PyCFunction)PathAllocator_iter_descendants, METH_VARARGS | METH_KEYWORDS,
+     "Iterate in preorder over the paths below a path, as indices or path_type objects"},
+    {"count_descendants", (PyCFunction)PathAllocator_count_descendants, METH_VARARGS,
+     "Count the paths below a path"},
+    {"scan", (PyCFunction)PathAllocator_scan, METH_VARARGS | METH_KEYWORDS,
+     "Read a directory tree into the allocator on worker threads, returning the root's node index"},
+    {"compile_glob", (PyCFunction)PathAllocator_compile_glob, METH_VARARGS,
+     "Compile a glob pattern against this allocator's strings for repeated use"},
+    {"glob", (PyCFunction)PathAllocator_glob, METH_VARARGS,
+     "Get the known nodes at or below a node that match a glob pattern, as array('q')"},
+    {"match", (PyCFunction)PathAllocator_match, METH_VARARGS,
+     "Check whether a node matches a glob pattern, with the rules of PurePath.match"},
+    {"new_epoch", (PyCFunction)PathAllocator_new_epoch, METH_NOARGS,
+     "Begin a new epoch for the nodes added from now on, returning its number"},
+    {"node_epoch", (PyCFunction)PathAllocator_node_epoch, METH_VARARGS,
+     "Get the epoch a node was added in"},
+    {"added_since", (PyCFunction)PathAllocator_added_since, METH_VARARGS,
+     "Get the nodes added since an epoch began, optionally only those at or below a node, as array('q')"},
+    {"diff", (PyCFunction)PathAllocator_diff, METH_VARARGS,
+     "Compare the subtrees below two nodes by name, returning (added, removed, common) arrays of node indices"},
+    {"compact", (PyCFunction)PathAllocator_compact, METH_VARARGS | METH_KEYWORDS,
+     "Drop nodes and strings no live path needs and renumber the rest densely, returning array('q') of new indices"},
+    {"share", (PyCFunction)PathAllocator_share, METH_VARARGS,
+     "Save a snapshot that pickles of this allocator refer to instead of embedding one, or stop with None"},
+    {"__reduce__", (PyCFunction)PathAllocator_reduce, METH_NOARGS,
+     "Pickle as a token plus the shared snapshot file or an inline snapshot"},
+    {"save", (PyCFunction)PathAllocator_save, METH_VARARGS,
+     "Write the allocator to a snapshot file"},
+    {"load", (PyCFunction)(void (*)(void))PathAllocator_load, METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+     "Load an allocator from a snapshot file; mmap=True maps it copy-on-write instead of reading it"},
     {NULL}  /* Sentinel */
 };
 
@@ -755,8 +2969,20 @@ static PyMemberDef PathAllocator_members[] = {
      "String pool"},
     {"tree", T_OBJECT_EX, offsetof(PathAllocatorObject, tree), READONLY,
      "Tree allocator"},
-    {"_separator", T_STRING, offsetof(PathAllocatorObject, separator), READONLY,
+    {"_separator", T_STRING_INPLACE, offsetof(PathAllocatorObject, separator), READONLY,
      "Path separator"},
+    {"track_paths", T_BOOL, offsetof(PathAllocatorObject, track_paths), READONLY,
+     "Whether live paths are tracked so compact() can remap them"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef PathAllocator_getset[] = {
+    {"_cache", (getter)PathAllocator_get_cache, NULL,
+     "Copy of the path lookup cache, most recently used first", NULL},
+    {"flavour", (getter)PathAllocator_get_flavour, NULL,
+     "Path rules of the allocator, 'posix' or 'windows'", NULL},
+    {"epoch", (getter)PathAllocator_get_epoch, NULL,
+     "Current epoch, advanced by new_epoch()", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -767,9 +2993,11 @@ PyTypeObject PathAllocatorType = {
     .tp_basicsize = sizeof(PathAllocatorObject),
     .tp_itemsize = 0,
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_weaklistoffset = offsetof(PathAllocatorObject, weakreflist),
     .tp_new = PathAllocator_new,
     .tp_init = (initproc)PathAllocator_init,
     .tp_dealloc = (destructor)PathAllocator_dealloc,
     .tp_methods = PathAllocator_methods,
     .tp_members = PathAllocator_members,
+    .tp_getset = PathAllocator_getset,
 };
\ No newline at end of file
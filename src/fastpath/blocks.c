@@ -0,0 +1,175 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Block pool
+ *
+ * Chunks and hash tables are power-of-two multiples of a few element
+ * sizes, so allocators ask for the same handful of block sizes over and
+ * over.  Freed blocks up to BLOCK_POOL_MAX_BLOCK bytes go on a free list
+ * per exact size, up to block_pool_limit bytes in total, and the next
+ * allocator asking for that size takes them from there.  Short-lived
+ * allocators then set up their storage without calling malloc, and
+ * tearing down any allocator costs one push or free per chunk.  Larger
+ * blocks are released at once so big trees hand their memory back.
+ * ======================================================================== */
+
+#define BLOCK_POOL_CLASSES 128
+#define BLOCK_POOL_MAX_BLOCK ((size_t)4 << 20)
+#define BLOCK_POOL_DEFAULT_LIMIT ((size_t)64 << 20)
+
+/* Free blocks of one size, linked through their first word */
+typedef struct {
+    size_t size;  /* 0 for a class not used yet */
+    void *head;
+    Py_ssize_t count;
+} BlockClass;
+
+static BlockClass block_classes[BLOCK_POOL_CLASSES];
+static size_t block_pool_bytes;
+static size_t block_pool_limit = BLOCK_POOL_DEFAULT_LIMIT;
+static Py_ssize_t block_pool_hits;
+static Py_ssize_t block_pool_misses;
+
+#ifdef Py_GIL_DISABLED
+static PyMutex block_pool_mutex;
+#define BLOCK_POOL_LOCK() PyMutex_Lock(&block_pool_mutex)
+#define BLOCK_POOL_UNLOCK() PyMutex_Unlock(&block_pool_mutex)
+#else
+#define BLOCK_POOL_LOCK()
+#define BLOCK_POOL_UNLOCK()
+#endif
+
+/* Class for size, claiming an unused one if create is set; the caller holds the pool lock */
+static BlockClass *
+block_class(size_t size, int create)
+{
+    for (int i = 0; i < BLOCK_POOL_CLASSES; i++) {
+        if (block_classes[i].size == size)
+            return &block_classes[i];
+        if (block_classes[i].size == 0) {
+            if (!create)
+                return NULL;
+            block_classes[i].size = size;
+            return &block_classes[i];
+        }
+    }
+    return NULL;
+}
+
+static inline int
+block_poolable(size_t size)
+{
+    return size >= sizeof(void *) && size <= BLOCK_POOL_MAX_BLOCK;
+}
+
+/* Allocate size bytes, like PyMem_Malloc or, with zeroed set, PyMem_Calloc */
+void *
+block_alloc(size_t size, int zeroed)
+{
+    if (block_poolable(size)) {
+        void *block = NULL;
+        BLOCK_POOL_LOCK();
+        BlockClass *cls = block_class(size, 0);
+        if (cls != NULL && cls->head != NULL) {
+            block = cls->head;
+            cls->head = *(void **)block;
+            cls->count--;
+            block_pool_bytes -= size;
+            block_pool_hits++;
+        } else {
+            block_pool_misses++;
+        }
+        BLOCK_POOL_UNLOCK();
+        if (block != NULL) {
+            if (zeroed)
+                memset(block, 0, size);
+            return block;
+        }
+    }
+    return zeroed ? PyMem_Calloc(size, 1) : PyMem_Malloc(size);
+}
+
+/* Release a block of size bytes from block_alloc, keeping it for reuse while the pool has room */
+void
+block_free(void *block, size_t size)
+{
+    if (block == NULL)
+        return;
+    if (block_poolable(size)) {
+        int kept = 0;
+        BLOCK_POOL_LOCK();
+        if (block_pool_bytes + size <= block_pool_limit) {
+            BlockClass *cls = block_class(size, 1);
+            if (cls != NULL) {
+                *(void **)block = cls->head;
+                cls->head = block;
+                cls->count++;
+                block_pool_bytes += size;
+                kept = 1;
+            }
+        }
+        BLOCK_POOL_UNLOCK();
+        if (kept)
+            return;
+    }
+    PyMem_Free(block);
+}
+
+/* Free pooled blocks until the pool holds at most limit bytes */
+static void
+block_pool_trim(size_t limit)
+{
+    for (;;) {
+        void *block = NULL;
+        BLOCK_POOL_LOCK();
+        for (int i = 0; i < BLOCK_POOL_CLASSES && block_pool_bytes > limit; i++) {
+            BlockClass *cls = &block_classes[i];
+            if (cls->head != NULL) {
+                block = cls->head;
+                cls->head = *(void **)block;
+                cls->count--;
+                block_pool_bytes -= cls->size;
+                break;
+            }
+        }
+        BLOCK_POOL_UNLOCK();
+        if (block == NULL)
+            return;
+        PyMem_Free(block);
+    }
+}
+
+PyObject *
+fastpath_block_pool_info(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t blocks = 0;
+    size_t bytes, limit;
+    Py_ssize_t hits, misses;
+    BLOCK_POOL_LOCK();
+    for (int i = 0; i < BLOCK_POOL_CLASSES; i++)
+        blocks += block_classes[i].count;
+    bytes = block_pool_bytes;
+    limit = block_pool_limit;
+    hits = block_pool_hits;
+    misses = block_pool_misses;
+    BLOCK_POOL_UNLOCK();
+    return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n}", "blocks", blocks, "bytes", (Py_ssize_t)bytes, "limit",
+                         (Py_ssize_t)limit, "hits", hits, "misses", misses);
+}
+
+PyObject *
+fastpath_set_block_pool_limit(PyObject *module, PyObject *arg)
+{
+    Py_ssize_t limit = PyLong_AsSsize_t(arg);
+    if (limit == -1 && PyErr_Occurred())
+        return NULL;
+    if (limit < 0) {
+        PyErr_SetString(PyExc_ValueError, "limit must not be negative");
+        return NULL;
+    }
+    BLOCK_POOL_LOCK();
+    block_pool_limit = (size_t)limit;
+    BLOCK_POOL_UNLOCK();
+    block_pool_trim((size_t)limit);
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,308 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Path lookup cache
+ *
+ * Maps whole path strings, resolved from the relative root, to their node
+ * index, so that constructing a hot path again skips tokenizing, interning
+ * and the child lookups of the walk.  Entries live in an array threaded on
+ * a most-recently-used list and are found through an open-addressing table
+ * of entry indices keyed by the str's own cached hash.  The least recently
+ * used entries are evicted once the entry or byte limit would be exceeded.
+ * Nodes are only ever renumbered by compact(), which clears the cache, so a
+ * cached index stays valid for as long as its entry exists.
+ * ======================================================================== */
+
+/* Bytes charged for an entry: the key string, the entry and its share of the table */
+static inline Py_ssize_t
+path_cache_cost(PyObject *key)
+{
+    return (Py_ssize_t)(sizeof(PyASCIIObject) + sizeof(PathCacheEntry) + 2 * sizeof(Py_ssize_t)) +
+           PyUnicode_GET_LENGTH(key) * PyUnicode_KIND(key);
+}
+
+static inline int
+path_cache_key_equal(PyObject *a, PyObject *b)
+{
+    if (a == b)
+        return 1;
+    Py_ssize_t length = PyUnicode_GET_LENGTH(a);
+    return length == PyUnicode_GET_LENGTH(b) && PyUnicode_KIND(a) == PyUnicode_KIND(b) &&
+           memcmp(PyUnicode_DATA(a), PyUnicode_DATA(b), length * PyUnicode_KIND(a)) == 0;
+}
+
+void
+path_cache_init(PathCache *cache, Py_ssize_t max_entries, Py_ssize_t max_bytes)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->free_head = -1;
+    cache->head = -1;
+    cache->tail = -1;
+    cache->max_entries = max_entries;
+    cache->max_bytes = max_bytes;
+}
+
+/* Drop every entry, keeping the storage and the counters */
+void
+path_cache_clear(PathCache *cache)
+{
+    for (Py_ssize_t i = 0; i < cache->entry_used; i++)
+        Py_CLEAR(cache->entries[i].key);
+    for (Py_ssize_t i = 0; i < cache->slot_capacity; i++)
+        cache->slots[i] = -1;
+    cache->entry_used = 0;
+    cache->count = 0;
+    cache->bytes = 0;
+    cache->free_head = -1;
+    cache->head = -1;
+    cache->tail = -1;
+}
+
+void
+path_cache_free(PathCache *cache)
+{
+    path_cache_clear(cache);
+    PyMem_Free(cache->entries);
+    PyMem_Free(cache->slots);
+    cache->entries = NULL;
+    cache->slots = NULL;
+    cache->entry_capacity = 0;
+    cache->slot_capacity = 0;
+}
+
+/* Slot holding key, or the empty slot where it would go */
+static inline size_t
+path_cache_find_slot(const PathCache *cache, PyObject *key, Py_hash_t hash)
+{
+    size_t mask = (size_t)cache->slot_capacity - 1;
+    size_t slot = (size_t)hash & mask;
+    for (;;) {
+        Py_ssize_t entry_idx = cache->slots[slot];
+        if (entry_idx < 0)
+            return slot;
+        const PathCacheEntry *entry = &cache->entries[entry_idx];
+        if (entry->hash == hash && path_cache_key_equal(entry->key, key))
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+static void
+path_cache_unlink(PathCache *cache, Py_ssize_t entry_idx)
+{
+    PathCacheEntry *entry = &cache->entries[entry_idx];
+    if (entry->prev >= 0)
+        cache->entries[entry->prev].next = entry->next;
+    else
+        cache->head = entry->next;
+    if (entry->next >= 0)
+        cache->entries[entry->next].prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+}
+
+static void
+path_cache_push_front(PathCache *cache, Py_ssize_t entry_idx)
+{
+    PathCacheEntry *entry = &cache->entries[entry_idx];
+    entry->prev = -1;
+    entry->next = cache->head;
+    if (cache->head >= 0)
+        cache->entries[cache->head].prev = entry_idx;
+    else
+        cache->tail = entry_idx;
+    cache->head = entry_idx;
+}
+
+static void
+path_cache_evict_tail(PathCache *cache)
+{
+    Py_ssize_t entry_idx = cache->tail;
+    PathCacheEntry *entry = &cache->entries[entry_idx];
+
+    /* Remove the table slot, shifting later entries of the probe run back
+     * when their home slot does not lie between the hole and their position */
+    size_t mask = (size_t)cache->slot_capacity - 1;
+    size_t hole = (size_t)entry->hash & mask;
+    while (cache->slots[hole] != entry_idx)
+        hole = (hole + 1) & mask;
+    for (size_t next = (hole + 1) & mask; cache->slots[next] >= 0; next = (next + 1) & mask) {
+        size_t home = (size_t)cache->entries[cache->slots[next]].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            cache->slots[hole] = cache->slots[next];
+            hole = next;
+        }
+    }
+    cache->slots[hole] = -1;
+
+    path_cache_unlink(cache, entry_idx);
+    Py_CLEAR(entry->key);
+    cache->bytes -= entry->cost;
+    cache->count--;
+    cache->evictions++;
+    entry->next = cache->free_head;
+    cache->free_head = entry_idx;
+}
+
+static int
+path_cache_resize_slots(PathCache *cache, Py_ssize_t new_capacity)
+{
+    Py_ssize_t *slots = PyMem_Malloc(new_capacity * sizeof(Py_ssize_t));
+    if (slots == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < new_capacity; i++)
+        slots[i] = -1;
+
+    size_t mask = (size_t)new_capacity - 1;
+    for (Py_ssize_t i = cache->head; i >= 0; i = cache->entries[i].next) {
+        size_t slot = (size_t)cache->entries[i].hash & mask;
+        while (slots[slot] >= 0)
+            slot = (slot + 1) & mask;
+        slots[slot] = i;
+    }
+
+    PyMem_Free(cache->slots);
+    cache->slots = slots;
+    cache->slot_capacity = new_capacity;
+    return 0;
+}
+
+/* Node cached for key, or -1 on a miss */
+static Py_ssize_t
+path_cache_get(PathCache *cache, PyObject *key, Py_hash_t hash)
+{
+    if (cache->count > 0) {
+        Py_ssize_t entry_idx = cache->slots[path_cache_find_slot(cache, key, hash)];
+        if (entry_idx >= 0) {
+            if (cache->head != entry_idx) {
+                path_cache_unlink(cache, entry_idx);
+                path_cache_push_front(cache, entry_idx);
+            }
+            cache->hits++;
+            return cache->entries[entry_idx].node_idx;
+        }
+    }
+    cache->misses++;
+    return -1;
+}
+
+static int
+path_cache_put(PathCache *cache, PyObject *key, Py_hash_t hash, Py_ssize_t node_idx)
+{
+    Py_ssize_t cost = path_cache_cost(key);
+    if (cache->max_bytes >= 0 && cost > cache->max_bytes)
+        return 0;
+
+    /* Another thread may have resolved the same string meanwhile */
+    if (cache->count > 0 && cache->slots[path_cache_find_slot(cache, key, hash)] >= 0)
+        return 0;
+
+    while (cache->count > 0 &&
+           (cache->count >= cache->max_entries ||
+            (cache->max_bytes >= 0 && cache->bytes + cost > cache->max_bytes))) {
+        path_cache_evict_tail(cache);
+    }
+
+    if (cache->free_head < 0 && cache->entry_used == cache->entry_capacity) {
+        Py_ssize_t new_capacity = cache->entry_capacity ? cache->entry_capacity * 2 : 64;
+        if (new_capacity > cache->max_entries)
+            new_capacity = cache->max_entries;
+        PathCacheEntry *entries = PyMem_Realloc(cache->entries, new_capacity * sizeof(PathCacheEntry));
+        if (entries == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        cache->entries = entries;
+        cache->entry_capacity = new_capacity;
+    }
+    if ((cache->count + 1) * 2 > cache->slot_capacity &&
+        path_cache_resize_slots(cache, cache->slot_capacity ? cache->slot_capacity * 2 : 128) < 0) {
+        return -1;
+    }
+
+    Py_ssize_t entry_idx;
+    if (cache->free_head >= 0) {
+        entry_idx = cache->free_head;
+        cache->free_head = cache->entries[entry_idx].next;
+    } else {
+        entry_idx = cache->entry_used++;
+    }
+
+    PathCacheEntry *entry = &cache->entries[entry_idx];
+    Py_INCREF(key);
+    entry->key = key;
+    entry->hash = hash;
+    entry->node_idx = node_idx;
+    entry->cost = cost;
+    cache->slots[path_cache_find_slot(cache, key, hash)] = entry_idx;
+    path_cache_push_front(cache, entry_idx);
+    cache->bytes += cost;
+    cache->count++;
+    return 0;
+}
+
+/* Node for a whole path string below the relative root, through the cache.
+ * Only exact str keys are cached, so a subclass cannot change the result
+ * through its own hash or equality. */
+Py_ssize_t
+PathAllocator_lookup_path(PathAllocatorObject *self, PyObject *path)
+{
+    PyObject *owned;
+    Py_ssize_t length;
+    const char *data;
+    if (self->cache.max_entries == 0 || !PyUnicode_CheckExact(path)) {
+        data = path_argument_bytes(path, &length, &owned);
+        Py_ssize_t node_idx = data == NULL ? -1 : PathAllocator_walk(self, self->tree->relative_root, data, length);
+        Py_XDECREF(owned);
+        return node_idx;
+    }
+
+    Py_hash_t hash = PyObject_Hash(path);
+    if (hash == -1)
+        return -1;
+
+    Py_ssize_t node_idx;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    node_idx = path_cache_get(&self->cache, path, hash);
+    Py_END_CRITICAL_SECTION();
+    if (node_idx >= 0)
+        return node_idx;
+
+    data = path_argument_bytes(path, &length, &owned);
+    node_idx = data == NULL ? -1 : PathAllocator_walk(self, self->tree->relative_root, data, length);
+    Py_XDECREF(owned);
+    if (node_idx < 0)
+        return -1;
+
+    int status;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    status = path_cache_put(&self->cache, path, hash, node_idx);
+    Py_END_CRITICAL_SECTION();
+    return status < 0 ? -1 : node_idx;
+}
+
+/* Snapshot of the cache as {path: node_idx}, most recently used first */
+PyObject *
+PathAllocator_get_cache(PathAllocatorObject *self, void *closure)
+{
+    PyObject *dict = PyDict_New();
+    if (dict == NULL)
+        return NULL;
+
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    for (Py_ssize_t i = self->cache.head; status == 0 && i >= 0; i = self->cache.entries[i].next) {
+        PyObject *node = PyLong_FromSsize_t(self->cache.entries[i].node_idx);
+        status = node == NULL ? -1 : PyDict_SetItem(dict, self->cache.entries[i].key, node);
+        Py_XDECREF(node);
+    }
+    Py_END_CRITICAL_SECTION();
+
+    if (status < 0) {
+        Py_DECREF(dict);
+        return NULL;
+    }
+    return dict;
+}
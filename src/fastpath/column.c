@@ -0,0 +1,794 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Node columns
+ *
+ * A tree carries typed side tables indexed by node index: the builtin
+ * size, mtime_ns and mode columns, plus any added with add_column().  Each
+ * column is a single contiguous allocation, so it can be handed to
+ * memoryview or numpy.frombuffer() through the buffer protocol without a
+ * copy.  Storage is allocated on first write and grows to the tree's node
+ * capacity; nodes past the allocated length read as zero.  Growing would
+ * move the data, so while a buffer is exported growth raises BufferError,
+ * as it does for bytearray and array.array.
+ * ======================================================================== */
+
+enum { COLUMN_SIGNED, COLUMN_UNSIGNED, COLUMN_FLOAT };
+
+typedef union {
+    long long i;
+    unsigned long long u;
+    double d;
+} ColumnValue;
+
+/* Item size and kind of a struct type code; -1 if columns don't support it */
+static int
+column_format_info(char format, Py_ssize_t *itemsize, int *kind)
+{
+    switch (format) {
+    case 'b': *itemsize = sizeof(signed char); *kind = COLUMN_SIGNED; return 0;
+    case 'B': *itemsize = sizeof(unsigned char); *kind = COLUMN_UNSIGNED; return 0;
+    case 'h': *itemsize = sizeof(short); *kind = COLUMN_SIGNED; return 0;
+    case 'H': *itemsize = sizeof(unsigned short); *kind = COLUMN_UNSIGNED; return 0;
+    case 'i': *itemsize = sizeof(int); *kind = COLUMN_SIGNED; return 0;
+    case 'I': *itemsize = sizeof(unsigned int); *kind = COLUMN_UNSIGNED; return 0;
+    case 'l': *itemsize = sizeof(long); *kind = COLUMN_SIGNED; return 0;
+    case 'L': *itemsize = sizeof(unsigned long); *kind = COLUMN_UNSIGNED; return 0;
+    case 'q': *itemsize = sizeof(long long); *kind = COLUMN_SIGNED; return 0;
+    case 'Q': *itemsize = sizeof(unsigned long long); *kind = COLUMN_UNSIGNED; return 0;
+    case 'f': *itemsize = sizeof(float); *kind = COLUMN_FLOAT; return 0;
+    case 'd': *itemsize = sizeof(double); *kind = COLUMN_FLOAT; return 0;
+    }
+    return -1;
+}
+
+/* NUL-terminated type code that outlives the column, for exported buffers;
+ * tree->columns moves whenever a column is added */
+static const char *
+column_static_format(char format)
+{
+    static const char codes[] = "bBhHiIlLqQfd";
+    static const char formats[][2] = {"b", "B", "h", "H", "i", "I", "l", "L", "q", "Q", "f", "d"};
+    const char *code = strchr(codes, format);
+    return code != NULL && format != '\0' ? formats[code - codes] : "B";
+}
+
+static ColumnValue
+column_load_at(char format, const char *base, Py_ssize_t i)
+{
+    ColumnValue value;
+    switch (format) {
+    case 'b': value.i = ((const signed char *)base)[i]; break;
+    case 'B': value.u = ((const unsigned char *)base)[i]; break;
+    case 'h': value.i = ((const short *)base)[i]; break;
+    case 'H': value.u = ((const unsigned short *)base)[i]; break;
+    case 'i': value.i = ((const int *)base)[i]; break;
+    case 'I': value.u = ((const unsigned int *)base)[i]; break;
+    case 'l': value.i = ((const long *)base)[i]; break;
+    case 'L': value.u = ((const unsigned long *)base)[i]; break;
+    case 'q': value.i = ((const long long *)base)[i]; break;
+    case 'Q': value.u = ((const unsigned long long *)base)[i]; break;
+    case 'f': value.d = ((const float *)base)[i]; break;
+    default: value.d = ((const double *)base)[i]; break;
+    }
+    return value;
+}
+
+static void
+column_store_at(char format, char *base, Py_ssize_t i, ColumnValue value)
+{
+    switch (format) {
+    case 'b': ((signed char *)base)[i] = (signed char)value.i; break;
+    case 'B': ((unsigned char *)base)[i] = (unsigned char)value.u; break;
+    case 'h': ((short *)base)[i] = (short)value.i; break;
+    case 'H': ((unsigned short *)base)[i] = (unsigned short)value.u; break;
+    case 'i': ((int *)base)[i] = (int)value.i; break;
+    case 'I': ((unsigned int *)base)[i] = (unsigned int)value.u; break;
+    case 'l': ((long *)base)[i] = (long)value.i; break;
+    case 'L': ((unsigned long *)base)[i] = (unsigned long)value.u; break;
+    case 'q': ((long long *)base)[i] = value.i; break;
+    case 'Q': ((unsigned long long *)base)[i] = value.u; break;
+    case 'f': ((float *)base)[i] = (float)value.d; break;
+    default: ((double *)base)[i] = value.d; break;
+    }
+}
+
+/* Value of a node; zero past the allocated length */
+static ColumnValue
+column_load(const NodeColumnData *column, Py_ssize_t node_idx)
+{
+    if (node_idx >= column->length) {
+        ColumnValue zero;
+        memset(&zero, 0, sizeof(zero));
+        return zero;
+    }
+    return column_load_at(column->format[0], column->data, node_idx);
+}
+
+/* Convert a Python number, checking it fits the column's items */
+static int
+column_value_from_object(const NodeColumnData *column, PyObject *obj, ColumnValue *value)
+{
+    int kind = column->kind;
+    int bits = (int)(column->itemsize * 8);
+
+    if (kind == COLUMN_FLOAT) {
+        value->d = PyFloat_AsDouble(obj);
+        return value->d == -1.0 && PyErr_Occurred() ? -1 : 0;
+    }
+    if (kind == COLUMN_SIGNED) {
+        value->i = PyLong_AsLongLong(obj);
+        if (value->i == -1 && PyErr_Occurred())
+            return -1;
+        if (bits < 64 && (value->i < -(1LL << (bits - 1)) || value->i > (1LL << (bits - 1)) - 1))
+            goto overflow;
+        return 0;
+    }
+    if (!PyLong_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "an integer is required, not %.200s", Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    value->u = PyLong_AsUnsignedLongLong(obj);
+    if (value->u == (unsigned long long)-1 && PyErr_Occurred())
+        return -1;
+    if (bits < 64 && value->u > (1ULL << bits) - 1)
+        goto overflow;
+    return 0;
+
+overflow:
+    PyErr_Format(PyExc_OverflowError, "value out of range for column %R", column->name);
+    return -1;
+}
+
+static PyObject *
+column_value_to_object(const NodeColumnData *column, ColumnValue value)
+{
+    switch (column->kind) {
+    case COLUMN_SIGNED:
+        return PyLong_FromLongLong(value.i);
+    case COLUMN_UNSIGNED:
+        return PyLong_FromUnsignedLongLong(value.u);
+    default:
+        return PyFloat_FromDouble(value.d);
+    }
+}
+
+/* Make room for count items; callers hold the tree's critical section */
+static int
+column_reserve(TreeAllocatorObject *tree, NodeColumnData *column, Py_ssize_t count)
+{
+    if (count <= column->length)
+        return 0;
+    if (column->exports > 0) {
+        PyErr_Format(PyExc_BufferError, "cannot grow column %R while a buffer of it is exported", column->name);
+        return -1;
+    }
+
+    Py_ssize_t length = tree->node_capacity > count ? tree->node_capacity : count;
+    char *data = PyMem_Realloc(column->data, length * column->itemsize);
+    if (data == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memset(data + column->length * column->itemsize, 0, (length - column->length) * column->itemsize);
+    column->data = data;
+    column->length = length;
+    return 0;
+}
+
+static int
+column_data_init(NodeColumnData *column, PyObject *name, char format)
+{
+    if (column_format_info(format, &column->itemsize, &column->kind) < 0)
+        return -1;
+    Py_INCREF(name);
+    column->name = name;
+    column->format[0] = format;
+    column->format[1] = '\0';
+    column->data = NULL;
+    column->length = 0;
+    column->exports = 0;
+    return 0;
+}
+
+/* Append a column; callers hold the tree's critical section */
+static Py_ssize_t
+tree_append_column(TreeAllocatorObject *tree, PyObject *name, char format)
+{
+    NodeColumnData *columns = PyMem_Realloc(tree->columns, (tree->column_count + 1) * sizeof(NodeColumnData));
+    if (columns == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    tree->columns = columns;
+    if (column_data_init(&columns[tree->column_count], name, format) < 0) {
+        PyErr_SetString(PyExc_ValueError, "unsupported column format");
+        return -1;
+    }
+    return tree->column_count++;
+}
+
+int
+tree_columns_init(TreeAllocatorObject *tree)
+{
+    static const struct {
+        const char *name;
+        char format;
+    } builtin[NODE_COLUMN_BUILTIN_COUNT] = {
+        [NODE_COLUMN_SIZE] = {"size", 'q'},
+        [NODE_COLUMN_MTIME] = {"mtime_ns", 'q'},
+        [NODE_COLUMN_MODE] = {"mode", 'I'},
+    };
+
+    tree->columns = NULL;
+    tree->column_count = 0;
+    for (int i = 0; i < NODE_COLUMN_BUILTIN_COUNT; i++) {
+        PyObject *name = PyUnicode_InternFromString(builtin[i].name);
+        if (name == NULL)
+            return -1;
+        Py_ssize_t column = tree_append_column(tree, name, builtin[i].format);
+        Py_DECREF(name);
+        if (column < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void
+tree_columns_free(TreeAllocatorObject *tree)
+{
+    for (Py_ssize_t i = 0; i < tree->column_count; i++) {
+        Py_DECREF(tree->columns[i].name);
+        PyMem_Free(tree->columns[i].data);
+    }
+    PyMem_Free(tree->columns);
+    tree->columns = NULL;
+    tree->column_count = 0;
+}
+
+/* 1 if a buffer of any of the tree's columns is exported */
+int
+tree_columns_exported(const TreeAllocatorObject *tree)
+{
+    for (Py_ssize_t i = 0; i < tree->column_count; i++) {
+        if (tree->columns[i].exports > 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Give dst every column of src, moving the value of each node i with
+ * remap[i] >= 0 to index remap[i]; used by compaction */
+int
+tree_columns_compact(TreeAllocatorObject *dst, const TreeAllocatorObject *src, const int64_t *remap)
+{
+    for (Py_ssize_t i = 0; i < src->column_count; i++) {
+        const NodeColumnData *column = &src->columns[i];
+        Py_ssize_t target = i;
+        if (i >= dst->column_count) {
+            target = tree_append_column(dst, column->name, column->format[0]);
+            if (target < 0)
+                return -1;
+        }
+        if (column->data == NULL)
+            continue;
+
+        NodeColumnData *out = &dst->columns[target];
+        if (column_reserve(dst, out, dst->node_count) < 0)
+            return -1;
+        Py_ssize_t count = column->length < src->node_count ? column->length : src->node_count;
+        for (Py_ssize_t node_idx = 0; node_idx < count; node_idx++) {
+            if (remap[node_idx] >= 0)
+                memcpy(out->data + remap[node_idx] * out->itemsize, column->data + node_idx * column->itemsize,
+                       column->itemsize);
+        }
+    }
+    return 0;
+}
+
+/* Index of the column called name, or -1 */
+static Py_ssize_t
+tree_find_column(TreeAllocatorObject *tree, PyObject *name)
+{
+    for (Py_ssize_t i = 0; i < tree->column_count; i++) {
+        if (PyUnicode_Compare(tree->columns[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static PyObject *
+node_column_new(TreeAllocatorObject *tree, Py_ssize_t column)
+{
+    NodeColumnObject *self = PyObject_New(NodeColumnObject, &NodeColumnType);
+    if (self == NULL)
+        return NULL;
+    Py_INCREF(tree);
+    self->tree = tree;
+    self->column = column;
+    return (PyObject *)self;
+}
+
+PyObject *
+TreeAllocator_column(TreeAllocatorObject *self, PyObject *args)
+{
+    PyObject *name;
+    if (!PyArg_ParseTuple(args, "U", &name))
+        return NULL;
+
+    Py_ssize_t column;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    column = tree_find_column(self, name);
+    Py_END_CRITICAL_SECTION();
+    if (column < 0) {
+        PyErr_SetObject(PyExc_KeyError, name);
+        return NULL;
+    }
+    return node_column_new(self, column);
+}
+
+PyObject *
+TreeAllocator_add_column(TreeAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *name;
+    const char *format = "q";
+    static char *kwlist[] = {"name", "format", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "U|s", kwlist, &name, &format))
+        return NULL;
+
+    Py_ssize_t itemsize;
+    int kind;
+    if (strlen(format) != 1 || column_format_info(format[0], &itemsize, &kind) < 0) {
+        PyErr_Format(PyExc_ValueError, "unsupported column format '%s'", format);
+        return NULL;
+    }
+
+    Py_ssize_t column;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    if (tree_find_column(self, name) >= 0) {
+        PyErr_Format(PyExc_ValueError, "column %R already exists", name);
+        column = -1;
+    } else {
+        column = tree_append_column(self, name, format[0]);
+    }
+    Py_END_CRITICAL_SECTION();
+    if (column < 0)
+        return NULL;
+    return node_column_new(self, column);
+}
+
+PyObject *
+TreeAllocator_column_names(TreeAllocatorObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *names;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    names = PyTuple_New(self->column_count);
+    for (Py_ssize_t i = 0; names != NULL && i < self->column_count; i++) {
+        Py_INCREF(self->columns[i].name);
+        PyTuple_SET_ITEM(names, i, self->columns[i].name);
+    }
+    Py_END_CRITICAL_SECTION();
+    return names;
+}
+
+/* ========================================================================
+ * NodeColumn type
+ * ======================================================================== */
+
+/* The column's storage; only valid inside the tree's critical section,
+ * since add_column() may move the array of columns */
+static inline NodeColumnData *
+node_column_data(NodeColumnObject *self)
+{
+    return &self->tree->columns[self->column];
+}
+
+/* Copy of the column's name, format and item size for use outside the lock */
+static NodeColumnData
+node_column_info(NodeColumnObject *self)
+{
+    NodeColumnData info;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    info = *node_column_data(self);
+    Py_END_CRITICAL_SECTION();
+    return info;
+}
+
+static Py_ssize_t
+NodeColumn_length(NodeColumnObject *self)
+{
+    return self->tree->node_count;
+}
+
+static PyObject *
+NodeColumn_subscript(NodeColumnObject *self, PyObject *key)
+{
+    Py_ssize_t node_idx = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (node_idx == -1 && PyErr_Occurred())
+        return NULL;
+
+    PyObject *result = NULL;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    if (tree_valid_index(self->tree, node_idx)) {
+        NodeColumnData *column = node_column_data(self);
+        result = column_value_to_object(column, column_load(column, node_idx));
+    }
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static int
+NodeColumn_ass_subscript(NodeColumnObject *self, PyObject *key, PyObject *value)
+{
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "column items cannot be deleted");
+        return -1;
+    }
+    Py_ssize_t node_idx = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (node_idx == -1 && PyErr_Occurred())
+        return -1;
+    ColumnValue item;
+    NodeColumnData info = node_column_info(self);
+    if (column_value_from_object(&info, value, &item) < 0)
+        return -1;
+
+    int status = -1;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    NodeColumnData *column = node_column_data(self);
+    if (tree_valid_index(self->tree, node_idx) && column_reserve(self->tree, column, node_idx + 1) == 0) {
+        column_store_at(column->format[0], column->data, node_idx, item);
+        status = 0;
+    }
+    Py_END_CRITICAL_SECTION();
+    return status;
+}
+
+/* Plain type code of a native-order buffer format, or 0 */
+static char
+column_buffer_code(const Py_buffer *view)
+{
+    const char *format = view->format ? view->format : "B";
+    if (format[0] == '@' || format[0] == '=')
+        format++;
+#if PY_LITTLE_ENDIAN
+    else if (format[0] == '<')
+        format++;
+#else
+    else if (format[0] == '>' || format[0] == '!')
+        format++;
+#endif
+    return format[0] != '\0' && format[1] == '\0' ? format[0] : 0;
+}
+
+/* Get a one-dimensional buffer of items matching kind and itemsize; 0 if
+ * obj is not such a buffer, with no exception set */
+static int
+column_get_matching_buffer(PyObject *obj, Py_buffer *view, int kind, Py_ssize_t itemsize)
+{
+    if (!PyObject_CheckBuffer(obj))
+        return 0;
+    if (PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+        PyErr_Clear();
+        return 0;
+    }
+    Py_ssize_t code_itemsize;
+    int code_kind;
+    char code = column_buffer_code(view);
+    if (view->ndim == 1 && code != 0 && column_format_info(code, &code_itemsize, &code_kind) == 0 &&
+        code_kind == kind && code_itemsize == itemsize && view->itemsize == itemsize)
+        return 1;
+    PyBuffer_Release(view);
+    return 0;
+}
+
+/* Node indices from a buffer of 64-bit integers such as array('q'), or an iterable of ints */
+int
+index_buffer_collect(PyObject *nodes, IndexBuffer *out)
+{
+    Py_buffer view;
+    if (column_get_matching_buffer(nodes, &view, COLUMN_SIGNED, sizeof(int64_t))) {
+        Py_ssize_t count = view.len / view.itemsize;
+        out->items = PyMem_Malloc((count ? count : 1) * sizeof(int64_t));
+        if (out->items != NULL) {
+            memcpy(out->items, view.buf, count * sizeof(int64_t));
+            out->count = out->capacity = count;
+        }
+        PyBuffer_Release(&view);
+        if (out->items == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        return 0;
+    }
+
+    PyObject *iter = PyObject_GetIter(nodes);
+    if (iter == NULL)
+        return -1;
+    PyObject *item;
+    while ((item = PyIter_Next(iter)) != NULL) {
+        Py_ssize_t node_idx = PyNumber_AsSsize_t(item, PyExc_IndexError);
+        Py_DECREF(item);
+        if ((node_idx == -1 && PyErr_Occurred()) || index_buffer_append(out, node_idx) < 0) {
+            Py_DECREF(iter);
+            return -1;
+        }
+    }
+    Py_DECREF(iter);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static int
+column_check_nodes(TreeAllocatorObject *tree, const IndexBuffer *nodes, Py_ssize_t *max_idx)
+{
+    *max_idx = -1;
+    for (Py_ssize_t i = 0; i < nodes->count; i++) {
+        if (!tree_valid_index(tree, (Py_ssize_t)nodes->items[i]))
+            return -1;
+        if (nodes->items[i] > *max_idx)
+            *max_idx = (Py_ssize_t)nodes->items[i];
+    }
+    return 0;
+}
+
+static PyObject *
+NodeColumn_get_many(NodeColumnObject *self, PyObject *nodes)
+{
+    IndexBuffer indices = {NULL, 0, 0};
+    if (index_buffer_collect(nodes, &indices) < 0) {
+        PyMem_Free(indices.items);
+        return NULL;
+    }
+
+    NodeColumnData info = node_column_info(self);
+    char *values = PyMem_Malloc((indices.count ? indices.count : 1) * info.itemsize);
+    if (values == NULL) {
+        PyMem_Free(indices.items);
+        return PyErr_NoMemory();
+    }
+
+    Py_ssize_t max_idx;
+    int status;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    NodeColumnData *column = node_column_data(self);
+    status = column_check_nodes(self->tree, &indices, &max_idx);
+    for (Py_ssize_t i = 0; status == 0 && i < indices.count; i++)
+        column_store_at(info.format[0], values, i, column_load(column, (Py_ssize_t)indices.items[i]));
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *result = NULL;
+    if (status == 0)
+        result = fastpath_typed_array(info.format, values, indices.count * info.itemsize);
+    PyMem_Free(values);
+    PyMem_Free(indices.items);
+    return result;
+}
+
+/* Item values for set_many(), converted to the column's type */
+static char *
+column_collect_values(const NodeColumnData *column, PyObject *values, Py_ssize_t count)
+{
+    char *items = PyMem_Malloc((count ? count : 1) * column->itemsize);
+    if (items == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+
+    Py_buffer view;
+    if (column_get_matching_buffer(values, &view, column->kind, column->itemsize)) {
+        Py_ssize_t length = view.len / view.itemsize;
+        if (length == count)
+            memcpy(items, view.buf, count * column->itemsize);
+        PyBuffer_Release(&view);
+        if (length == count)
+            return items;
+        goto mismatch;
+    }
+
+    PyObject *seq = PySequence_Fast(values, "values must be iterable");
+    if (seq == NULL) {
+        PyMem_Free(items);
+        return NULL;
+    }
+    if (PySequence_Fast_GET_SIZE(seq) != count) {
+        Py_DECREF(seq);
+        goto mismatch;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        ColumnValue value;
+        if (column_value_from_object(column, PySequence_Fast_GET_ITEM(seq, i), &value) < 0) {
+            Py_DECREF(seq);
+            PyMem_Free(items);
+            return NULL;
+        }
+        column_store_at(column->format[0], items, i, value);
+    }
+    Py_DECREF(seq);
+    return items;
+
+mismatch:
+    PyErr_SetString(PyExc_ValueError, "nodes and values must have the same length");
+    PyMem_Free(items);
+    return NULL;
+}
+
+static PyObject *
+NodeColumn_set_many(NodeColumnObject *self, PyObject *args)
+{
+    PyObject *nodes, *values;
+    if (!PyArg_ParseTuple(args, "OO", &nodes, &values))
+        return NULL;
+
+    IndexBuffer indices = {NULL, 0, 0};
+    if (index_buffer_collect(nodes, &indices) < 0) {
+        PyMem_Free(indices.items);
+        return NULL;
+    }
+    NodeColumnData info = node_column_info(self);
+    char *items = column_collect_values(&info, values, indices.count);
+    if (items == NULL) {
+        PyMem_Free(indices.items);
+        return NULL;
+    }
+
+    Py_ssize_t max_idx;
+    int status;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    NodeColumnData *column = node_column_data(self);
+    status = column_check_nodes(self->tree, &indices, &max_idx);
+    if (status == 0)
+        status = column_reserve(self->tree, column, max_idx + 1);
+    for (Py_ssize_t i = 0; status == 0 && i < indices.count; i++) {
+        memcpy(column->data + indices.items[i] * column->itemsize, items + i * column->itemsize,
+               column->itemsize);
+    }
+    Py_END_CRITICAL_SECTION();
+
+    PyMem_Free(items);
+    PyMem_Free(indices.items);
+    if (status < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+NodeColumn_subtree_sum(NodeColumnObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    PyObject *result = NULL;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    TreeAllocatorObject *tree = self->tree;
+    NodeColumnData *column = node_column_data(self);
+    if (tree_valid_index(tree, node_idx)) {
+        int kind = column->kind;
+        ColumnValue total;
+        memset(&total, 0, sizeof(total));
+        for (Py_ssize_t curr = node_idx; column->data != NULL && curr >= 0;
+             curr = tree_next_preorder(tree, curr, node_idx)) {
+            ColumnValue value = column_load(column, curr);
+            if (kind == COLUMN_SIGNED)
+                total.i += value.i;
+            else if (kind == COLUMN_UNSIGNED)
+                total.u += value.u;
+            else
+                total.d += value.d;
+        }
+        result = column_value_to_object(column, total);
+    }
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+static PyObject *
+NodeColumn_get_name(NodeColumnObject *self, void *closure)
+{
+    PyObject *name = node_column_info(self).name;
+    Py_INCREF(name);
+    return name;
+}
+
+static PyObject *
+NodeColumn_get_format(NodeColumnObject *self, void *closure)
+{
+    return PyUnicode_FromString(node_column_info(self).format);
+}
+
+/* Export every current node; the column is grown to the node count first */
+static int
+NodeColumn_getbuffer(NodeColumnObject *self, Py_buffer *view, int flags)
+{
+    static char empty[sizeof(double)];
+    Py_ssize_t *shape = PyMem_Malloc(sizeof(Py_ssize_t));
+    if (shape == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    int status;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    NodeColumnData *column = node_column_data(self);
+    status = column_reserve(self->tree, column, self->tree->node_count);
+    if (status == 0) {
+        *shape = self->tree->node_count;
+        view->buf = column->data != NULL ? column->data : empty;
+        view->len = *shape * column->itemsize;
+        view->itemsize = column->itemsize;
+        view->format = (flags & PyBUF_FORMAT) ? (char *)column_static_format(column->format[0]) : NULL;
+        column->exports++;
+    }
+    Py_END_CRITICAL_SECTION();
+    if (status < 0) {
+        PyMem_Free(shape);
+        view->obj = NULL;
+        return -1;
+    }
+
+    Py_INCREF(self);
+    view->obj = (PyObject *)self;
+    view->readonly = 0;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &view->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = shape;
+    return 0;
+}
+
+static void
+NodeColumn_releasebuffer(NodeColumnObject *self, Py_buffer *view)
+{
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    node_column_data(self)->exports--;
+    Py_END_CRITICAL_SECTION();
+    PyMem_Free(view->internal);
+}
+
+static void
+NodeColumn_dealloc(NodeColumnObject *self)
+{
+    Py_DECREF(self->tree);
+    PyObject_Free(self);
+}
+
+static PyMethodDef NodeColumn_methods[] = {
+    {"get_many", (PyCFunction)NodeColumn_get_many, METH_O,
+     "Get the values of many nodes as an array of the column's format"},
+    {"set_many", (PyCFunction)NodeColumn_set_many, METH_VARARGS,
+     "Set the values of many nodes from parallel sequences or buffers of nodes and values"},
+    {"subtree_sum", (PyCFunction)NodeColumn_subtree_sum, METH_VARARGS,
+     "Sum the values of a node and every node below it"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef NodeColumn_getset[] = {
+    {"name", (getter)NodeColumn_get_name, NULL, "Column name", NULL},
+    {"format", (getter)NodeColumn_get_format, NULL, "struct type code of the items", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PyMappingMethods NodeColumn_as_mapping = {
+    .mp_length = (lenfunc)NodeColumn_length,
+    .mp_subscript = (binaryfunc)NodeColumn_subscript,
+    .mp_ass_subscript = (objobjargproc)NodeColumn_ass_subscript,
+};
+
+static PyBufferProcs NodeColumn_as_buffer = {
+    .bf_getbuffer = (getbufferproc)NodeColumn_getbuffer,
+    .bf_releasebuffer = (releasebufferproc)NodeColumn_releasebuffer,
+};
+
+PyTypeObject NodeColumnType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.NodeColumn",
+    .tp_doc = "Typed per-node values of a tree, indexed by node index",
+    .tp_basicsize = sizeof(NodeColumnObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)NodeColumn_dealloc,
+    .tp_as_mapping = &NodeColumn_as_mapping,
+    .tp_as_buffer = &NodeColumn_as_buffer,
+    .tp_methods = NodeColumn_methods,
+    .tp_getset = NodeColumn_getset,
+};
@@ -0,0 +1,315 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Path tracking
+ *
+ * An allocator created with track_paths=True registers every native path
+ * object bound to it in an open-addressing set of object pointers, and
+ * drops it again from the path's dealloc.  Only such allocators can be
+ * compacted, since compaction has to find every live path to renumber it.
+ * Deletion shifts later entries of the probe run back, so the set needs
+ * no tombstones and lookups stay short under churn.
+ * ======================================================================== */
+
+static inline size_t
+tracked_path_hash(const PureFastPathObject *path)
+{
+    uint64_t h = (uint64_t)(uintptr_t)path * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static int
+tracked_paths_resize(PathAllocatorObject *self, Py_ssize_t new_capacity)
+{
+    PureFastPathObject **slots = PyMem_Calloc(new_capacity, sizeof(PureFastPathObject *));
+    if (slots == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    size_t mask = (size_t)new_capacity - 1;
+    for (Py_ssize_t i = 0; i < self->tracked_capacity; i++) {
+        PureFastPathObject *path = self->tracked_paths[i];
+        if (path == NULL)
+            continue;
+        size_t slot = tracked_path_hash(path) & mask;
+        while (slots[slot] != NULL)
+            slot = (slot + 1) & mask;
+        slots[slot] = path;
+    }
+
+    PyMem_Free(self->tracked_paths);
+    self->tracked_paths = slots;
+    self->tracked_capacity = new_capacity;
+    return 0;
+}
+
+int
+PathAllocator_track_path(PathAllocatorObject *self, PureFastPathObject *path)
+{
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    if ((self->tracked_count + 1) * 2 > self->tracked_capacity)
+        status = tracked_paths_resize(self, self->tracked_capacity ? self->tracked_capacity * 2 : 64);
+    if (status == 0) {
+        size_t mask = (size_t)self->tracked_capacity - 1;
+        size_t slot = tracked_path_hash(path) & mask;
+        while (self->tracked_paths[slot] != NULL && self->tracked_paths[slot] != path)
+            slot = (slot + 1) & mask;
+        if (self->tracked_paths[slot] == NULL) {
+            self->tracked_paths[slot] = path;
+            self->tracked_count++;
+        }
+    }
+    Py_END_CRITICAL_SECTION();
+    return status;
+}
+
+void
+PathAllocator_untrack_path(PathAllocatorObject *self, PureFastPathObject *path)
+{
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    if (self->tracked_capacity > 0) {
+        size_t mask = (size_t)self->tracked_capacity - 1;
+        size_t slot = tracked_path_hash(path) & mask;
+        while (self->tracked_paths[slot] != NULL && self->tracked_paths[slot] != path)
+            slot = (slot + 1) & mask;
+
+        if (self->tracked_paths[slot] != NULL) {
+            /* Move later entries of the run into the hole when their home
+             * slot does not lie between the hole and their position */
+            size_t hole = slot;
+            for (size_t next = (hole + 1) & mask; self->tracked_paths[next] != NULL; next = (next + 1) & mask) {
+                size_t home = tracked_path_hash(self->tracked_paths[next]) & mask;
+                if (((next - home) & mask) >= ((next - hole) & mask)) {
+                    self->tracked_paths[hole] = self->tracked_paths[next];
+                    hole = next;
+                }
+            }
+            self->tracked_paths[hole] = NULL;
+            self->tracked_count--;
+        }
+    }
+    Py_END_CRITICAL_SECTION();
+}
+
+/* ========================================================================
+ * Compaction
+ *
+ * compact() marks every node held by a tracked path, every node passed in
+ * keep, all of their ancestors and every root.  It then replays the marked
+ * nodes in index order into a fresh tree and string pool, so parents are
+ * always added before their children and the new numbering is dense.  The
+ * fresh storage is swapped into the existing TreeAllocator and StringPool
+ * objects, so references to them stay valid.  Tracked paths are renumbered
+ * in place; any other node index or string ID held outside the allocator
+ * is invalidated and can be translated through the returned array.
+ *
+ * Readers such as get_parent(), get_name(), get_parts() and is_ancestor()
+ * walk the tree and pool without taking their critical sections.  With the
+ * GIL none of them can run during the swap, so the old storage is freed
+ * with the temporaries.  Free-threaded builds defer freeing instead: the
+ * temporaries holding the old storage hang off the tree's retired chain
+ * until the tree is deallocated, so a reader racing with compact() may see
+ * either numbering but never freed memory.  The bodies are swapped a word
+ * at a time, so such a reader never loads a half-written pointer.
+ * ======================================================================== */
+
+/* Exchange the contents of two objects of the same type, leaving their headers */
+static void
+swap_object_bodies(PyObject *a, PyObject *b, size_t size)
+{
+    Py_BUILD_ASSERT(sizeof(PyObject) % sizeof(void *) == 0);
+    void **pa = (void **)a, **pb = (void **)b;
+    for (size_t i = sizeof(PyObject) / sizeof(void *); i < size / sizeof(void *); i++) {
+        void *tmp = pa[i];
+        pa[i] = pb[i];
+        pb[i] = tmp;
+    }
+    char *ca = (char *)a, *cb = (char *)b;
+    for (size_t i = size - size % sizeof(void *); i < size; i++) {
+        char tmp = ca[i];
+        ca[i] = cb[i];
+        cb[i] = tmp;
+    }
+}
+
+static inline void
+compact_mark(const TreeAllocatorObject *tree, unsigned char *live, Py_ssize_t node_idx)
+{
+    while (node_idx >= 0 && !live[node_idx]) {
+        live[node_idx] = 1;
+        node_idx = tree_parent(tree, node_idx);
+    }
+}
+
+/* Fill new_tree and new_pool with the marked nodes of tree; remap[i] gets
+ * the new index of node i, or -1 */
+static int
+compact_replay(TreeAllocatorObject *tree, StringPoolObject *pool, const unsigned char *live,
+               TreeAllocatorObject *new_tree, StringPoolObject *new_pool, int64_t *remap)
+{
+    /* Names hash as they did in the old tree */
+    new_tree->fold_case = tree->fold_case;
+    for (Py_ssize_t i = 0; i < tree->node_count; i++) {
+        remap[i] = -1;
+        if (!live[i])
+            continue;
+
+        const StringEntry *entry = string_entry(pool, tree_name(tree, i));
+        Py_ssize_t name_id = StringPool_intern_bytes(new_pool, string_entry_data(pool, entry), entry->length);
+        if (name_id < 0)
+            return -1;
+        Py_ssize_t parent_idx = tree_parent(tree, i);
+        Py_ssize_t new_idx = TreeAllocator_add_node(new_tree, parent_idx < 0 ? -1 : (Py_ssize_t)remap[parent_idx],
+                                                    name_id);
+        if (new_idx < 0)
+            return -1;
+        remap[i] = new_idx;
+    }
+
+    new_tree->relative_root = tree->relative_root < 0 ? -1 : (Py_ssize_t)remap[tree->relative_root];
+    new_tree->absolute_root = tree->absolute_root < 0 ? -1 : (Py_ssize_t)remap[tree->absolute_root];
+    new_tree->path_string_budget = tree->path_string_budget;
+    /* Counters carry over; the replay itself is not counted */
+    new_tree->counters = tree->counters;
+    new_pool->counters = pool->counters;
+    if (tree_epochs_compact(new_tree, tree, remap) < 0)
+        return -1;
+    return tree_columns_compact(new_tree, tree, remap);
+}
+
+PyObject *
+PathAllocator_compact(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *keep = NULL;
+    static char *kwlist[] = {"keep", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &keep))
+        return NULL;
+
+    if (!self->track_paths) {
+        PyErr_SetString(PyExc_RuntimeError, "compact() requires an allocator created with track_paths=True");
+        return NULL;
+    }
+
+    /* Nodes that must survive: the keep argument plus every tracked path */
+    IndexBuffer roots = {NULL, 0, 0};
+    if (keep != NULL && keep != Py_None) {
+        PyObject *iter = PyObject_GetIter(keep);
+        if (iter == NULL)
+            return NULL;
+        PyObject *item;
+        while ((item = PyIter_Next(iter)) != NULL) {
+            Py_ssize_t node_idx = PyNumber_AsSsize_t(item, PyExc_IndexError);
+            Py_DECREF(item);
+            if ((node_idx == -1 && PyErr_Occurred()) || index_buffer_append(&roots, node_idx) < 0)
+                break;
+        }
+        Py_DECREF(iter);
+        if (PyErr_Occurred()) {
+            PyMem_Free(roots.items);
+            return NULL;
+        }
+    }
+
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    StringPoolObject *new_pool = (StringPoolObject *)PyObject_CallObject((PyObject *)&StringPoolType, NULL);
+    PyObject *empty = PyTuple_New(0);
+    TreeAllocatorObject *new_tree = NULL;
+    if (new_pool != NULL && empty != NULL)
+        new_tree = (TreeAllocatorObject *)TreeAllocatorType.tp_new(&TreeAllocatorType, empty, NULL);
+    Py_XDECREF(empty);
+    if (new_tree == NULL || tree_setup(new_tree, (PyObject *)new_pool) < 0) {
+        PyMem_Free(roots.items);
+        Py_XDECREF(new_tree);
+        Py_XDECREF(new_pool);
+        return NULL;
+    }
+
+    PyObject *retired = NULL;
+#ifdef Py_GIL_DISABLED
+    /* Made up front so nothing can fail once the storage is swapped */
+    retired = PyTuple_Pack(2, (PyObject *)new_tree, (PyObject *)new_pool);
+    if (retired == NULL) {
+        PyMem_Free(roots.items);
+        Py_DECREF(new_tree);
+        Py_DECREF(new_pool);
+        return NULL;
+    }
+#endif
+
+    int64_t *remap = NULL;
+    Py_ssize_t node_count;
+    int status = -1;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)tree, (PyObject *)pool);
+    node_count = tree->node_count;
+    unsigned char *live = PyMem_Calloc(node_count ? node_count : 1, 1);
+    remap = PyMem_Malloc((node_count ? node_count : 1) * sizeof(int64_t));
+
+    if (live == NULL || remap == NULL) {
+        PyErr_NoMemory();
+    } else if (tree_columns_exported(tree)) {
+        PyErr_SetString(PyExc_BufferError, "cannot compact while a buffer of a column is exported");
+    } else {
+        status = 0;
+        for (Py_ssize_t i = 0; status == 0 && i < roots.count; i++) {
+            if (!tree_valid_index(tree, (Py_ssize_t)roots.items[i]))
+                status = -1;
+            else
+                compact_mark(tree, live, (Py_ssize_t)roots.items[i]);
+        }
+        for (Py_ssize_t i = 0; status == 0 && i < node_count; i++) {
+            if (tree_parent(tree, i) < 0)
+                live[i] = 1;
+        }
+        if (status == 0) {
+            Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+            for (Py_ssize_t i = 0; i < self->tracked_capacity; i++) {
+                if (self->tracked_paths[i] != NULL)
+                    compact_mark(tree, live, self->tracked_paths[i]->_node_idx);
+            }
+            Py_END_CRITICAL_SECTION();
+            status = compact_replay(tree, pool, live, new_tree, new_pool, remap);
+        }
+    }
+
+    if (status == 0) {
+        swap_object_bodies((PyObject *)tree, (PyObject *)new_tree, sizeof(TreeAllocatorObject));
+        swap_object_bodies((PyObject *)pool, (PyObject *)new_pool, sizeof(StringPoolObject));
+        /* Each tree must keep pointing at the pool object holding its
+         * strings */
+        PyObject *tree_pool = tree->string_pool;
+        tree->string_pool = new_tree->string_pool;
+        new_tree->string_pool = tree_pool;
+        /* The swap moved the earlier retired chain into new_tree, which
+         * retired now leads to */
+        tree->retired = retired;
+        retired = NULL;
+    }
+    PyMem_Free(live);
+    Py_END_CRITICAL_SECTION2();
+    PyMem_Free(roots.items);
+
+    if (status == 0) {
+        Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+        for (Py_ssize_t i = 0; i < self->tracked_capacity; i++) {
+            PureFastPathObject *path = self->tracked_paths[i];
+            if (path != NULL)
+                path->_node_idx = (Py_ssize_t)remap[path->_node_idx];
+        }
+        path_cache_clear(&self->cache);
+        self->generation++;
+        PathAllocator_forget_origin(self);
+        Py_END_CRITICAL_SECTION();
+    }
+
+    /* The temporaries now hold the old storage, or the partial copy on failure */
+    Py_XDECREF(retired);
+    Py_DECREF(new_tree);
+    Py_DECREF(new_pool);
+
+    PyObject *result = status == 0 ? fastpath_index_array(remap, node_count) : NULL;
+    PyMem_Free(remap);
+    return result;
+}
@@ -0,0 +1,245 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Epochs
+ *
+ * Nodes are only ever appended, so the nodes added during an epoch are a
+ * contiguous index range.  The tree records the first node index of each
+ * epoch after epoch 0, and a node's epoch is the number of those starts at
+ * or before its index.  compact() keeps surviving nodes in index order, so
+ * it carries every start over to the first surviving node at or after it.
+ * Epochs are not part of snapshots or pickles; a loaded allocator starts
+ * in epoch 0.
+ * ======================================================================== */
+
+/* Begin a new epoch; the caller holds the tree's critical section */
+static Py_ssize_t
+tree_new_epoch(TreeAllocatorObject *tree)
+{
+    Py_ssize_t *starts = PyMem_Realloc(tree->epoch_starts, (tree->epoch_count + 1) * sizeof(Py_ssize_t));
+    if (starts == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    tree->epoch_starts = starts;
+    starts[tree->epoch_count++] = tree->node_count;
+    return tree->epoch_count;
+}
+
+/* First node index of an epoch, or node_count for epochs not begun yet */
+static Py_ssize_t
+tree_epoch_start(const TreeAllocatorObject *tree, Py_ssize_t epoch)
+{
+    if (epoch <= 0)
+        return 0;
+    if (epoch > tree->epoch_count)
+        return tree->node_count;
+    return tree->epoch_starts[epoch - 1];
+}
+
+static Py_ssize_t
+tree_node_epoch(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    /* Count of starts <= node_idx; empty epochs share a start with the next */
+    Py_ssize_t lo = 0, hi = tree->epoch_count;
+    while (lo < hi) {
+        Py_ssize_t mid = lo + (hi - lo) / 2;
+        if (tree->epoch_starts[mid] <= node_idx)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int
+tree_epochs_compact(TreeAllocatorObject *dst, const TreeAllocatorObject *src, const int64_t *remap)
+{
+    if (src->epoch_count == 0)
+        return 0;
+    dst->epoch_starts = PyMem_Malloc(src->epoch_count * sizeof(Py_ssize_t));
+    if (dst->epoch_starts == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    dst->epoch_count = src->epoch_count;
+
+    Py_ssize_t i = 0;
+    for (Py_ssize_t e = 0; e < src->epoch_count; e++) {
+        if (i < src->epoch_starts[e])
+            i = src->epoch_starts[e];
+        while (i < src->node_count && remap[i] < 0)
+            i++;
+        dst->epoch_starts[e] = i < src->node_count ? (Py_ssize_t)remap[i] : dst->node_count;
+    }
+    return 0;
+}
+
+/* 1 if node_idx is base_idx or below it; the caller holds the tree's critical section */
+static inline int
+tree_within(const TreeAllocatorObject *tree, Py_ssize_t node_idx, Py_ssize_t base_idx)
+{
+    if (tree_anchor(tree, node_idx) != tree_anchor(tree, base_idx))
+        return 0;
+    Py_ssize_t base_depth = tree_depth(tree, base_idx);
+    for (Py_ssize_t depth = tree_depth(tree, node_idx); depth > base_depth; depth--)
+        node_idx = tree_parent(tree, node_idx);
+    return node_idx == base_idx;
+}
+
+PyObject *
+PathAllocator_new_epoch(PathAllocatorObject *self, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t epoch;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    epoch = tree_new_epoch(self->tree);
+    Py_END_CRITICAL_SECTION();
+    return epoch < 0 ? NULL : PyLong_FromSsize_t(epoch);
+}
+
+PyObject *
+PathAllocator_get_epoch(PathAllocatorObject *self, void *closure)
+{
+    Py_ssize_t epoch;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    epoch = self->tree->epoch_count;
+    Py_END_CRITICAL_SECTION();
+    return PyLong_FromSsize_t(epoch);
+}
+
+PyObject *
+PathAllocator_node_epoch(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+
+    TreeAllocatorObject *tree = self->tree;
+    Py_ssize_t epoch;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)tree);
+    epoch = tree_valid_index(tree, node_idx) ? tree_node_epoch(tree, node_idx) : -1;
+    Py_END_CRITICAL_SECTION();
+    return epoch < 0 ? NULL : PyLong_FromSsize_t(epoch);
+}
+
+PyObject *
+PathAllocator_added_since(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t epoch;
+    Py_ssize_t base_idx = -1;
+    if (!PyArg_ParseTuple(args, "n|n", &epoch, &base_idx))
+        return NULL;
+
+    TreeAllocatorObject *tree = self->tree;
+    IndexBuffer out = {NULL, 0, 0};
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)tree);
+    if (PyTuple_GET_SIZE(args) > 1 && !tree_valid_index(tree, base_idx))
+        status = -1;
+    for (Py_ssize_t i = tree_epoch_start(tree, epoch); status == 0 && i < tree->node_count; i++) {
+        if (base_idx < 0 || tree_within(tree, i, base_idx))
+            status = index_buffer_append(&out, i);
+    }
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *result = status < 0 ? NULL : fastpath_index_array(out.items, out.count);
+    PyMem_Free(out.items);
+    return result;
+}
+
+/* ========================================================================
+ * Tree diff
+ *
+ * diff() walks two subtrees in parallel, pairing children that have the
+ * same name ID.  Each child of a paired node is looked up among the other
+ * side's children through the child index, so the walk costs one probe per
+ * node on either side.  A child without a partner is reported together
+ * with everything below it, without further lookups.
+ * ======================================================================== */
+
+/* Append node_idx and its descendants; the caller holds the tree's critical section */
+static int
+diff_append_subtree(const TreeAllocatorObject *tree, Py_ssize_t node_idx, IndexBuffer *out)
+{
+    for (Py_ssize_t curr = node_idx; curr >= 0; curr = tree_next_preorder(tree, curr, node_idx)) {
+        if (index_buffer_append(out, curr) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int
+diff_unlocked(TreeAllocatorObject *tree, Py_ssize_t a_idx, Py_ssize_t b_idx, IndexBuffer *added,
+              IndexBuffer *removed, IndexBuffer *common)
+{
+    /* Pending pairs, a node then its partner */
+    IndexBuffer stack = {NULL, 0, 0};
+    int status = 0;
+    if (index_buffer_append(&stack, a_idx) < 0 || index_buffer_append(&stack, b_idx) < 0)
+        status = -1;
+
+    while (status == 0 && stack.count > 0) {
+        b_idx = (Py_ssize_t)stack.items[--stack.count];
+        a_idx = (Py_ssize_t)stack.items[--stack.count];
+        if (a_idx == b_idx) {
+            /* Everything below is shared between both sides */
+            for (Py_ssize_t curr = tree_next_preorder(tree, b_idx, b_idx); status == 0 && curr >= 0;
+                 curr = tree_next_preorder(tree, curr, b_idx)) {
+                status = index_buffer_append(common, curr);
+            }
+            continue;
+        }
+
+        for (Py_ssize_t child = tree_first_child(tree, b_idx); status == 0 && child >= 0;
+             child = tree_next_sibling(tree, child)) {
+            Py_ssize_t partner = tree_lookup_child(tree, a_idx, tree_name(tree, child));
+            if (partner < 0) {
+                status = diff_append_subtree(tree, child, added);
+            } else if (index_buffer_append(common, child) < 0 || index_buffer_append(&stack, partner) < 0 ||
+                       index_buffer_append(&stack, child) < 0) {
+                status = -1;
+            }
+        }
+        for (Py_ssize_t child = tree_first_child(tree, a_idx); status == 0 && child >= 0;
+             child = tree_next_sibling(tree, child)) {
+            if (tree_lookup_child(tree, b_idx, tree_name(tree, child)) < 0)
+                status = diff_append_subtree(tree, child, removed);
+        }
+    }
+    PyMem_Free(stack.items);
+    return status;
+}
+
+PyObject *
+PathAllocator_diff(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t a_idx, b_idx;
+    if (!PyArg_ParseTuple(args, "nn", &a_idx, &b_idx))
+        return NULL;
+
+    TreeAllocatorObject *tree = self->tree;
+    IndexBuffer added = {NULL, 0, 0}, removed = {NULL, 0, 0}, common = {NULL, 0, 0};
+    int status;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)tree);
+    if (!tree_valid_index(tree, a_idx) || !tree_valid_index(tree, b_idx))
+        status = -1;
+    else
+        status = diff_unlocked(tree, a_idx, b_idx, &added, &removed, &common);
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *result = NULL;
+    if (status == 0) {
+        PyObject *added_array = fastpath_index_array(added.items, added.count);
+        PyObject *removed_array = fastpath_index_array(removed.items, removed.count);
+        PyObject *common_array = fastpath_index_array(common.items, common.count);
+        if (added_array != NULL && removed_array != NULL && common_array != NULL)
+            result = PyTuple_Pack(3, added_array, removed_array, common_array);
+        Py_XDECREF(added_array);
+        Py_XDECREF(removed_array);
+        Py_XDECREF(common_array);
+    }
+    PyMem_Free(added.items);
+    PyMem_Free(removed.items);
+    PyMem_Free(common.items);
+    return result;
+}
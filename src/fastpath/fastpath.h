@@ -6,47 +6,465 @@
 #include <structmember.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+/* Critical sections lock an object on free-threaded builds and are no-ops
+ * with the GIL; provide them for Python versions that predate them */
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#define Py_BEGIN_CRITICAL_SECTION2(a, b) {
+#define Py_END_CRITICAL_SECTION2() }
+#endif
 
 /* ========================================================================
  * Type definitions
  * ======================================================================== */
 
-/* TreeNode structure */
+/* Node index storage type.  Nodes are stored as 32-bit indices unless the
+ * extension is built with FASTPATH_WIDE_NODES for trees beyond 2^32 nodes. */
+#ifdef FASTPATH_WIDE_NODES
+typedef uint64_t node_index_t;
+#else
+typedef uint32_t node_index_t;
+#endif
+
+/* No parent / empty slot marker */
+#define NODE_NONE ((node_index_t)-1)
+#define NODE_INDEX_MAX (NODE_NONE < (node_index_t)PY_SSIZE_T_MAX ? (Py_ssize_t)NODE_NONE : PY_SSIZE_T_MAX)
+
+/* ========================================================================
+ * Instrumentation
+ *
+ * Building with FASTPATH_STATS counts hot-path events into the counters
+ * of the pool or tree they happen in, and stats() reports them.  Without
+ * it FASTPATH_COUNT expands to nothing and the counters stay zero.
+ * FASTPATH_USDT also fires USDT probes under the "fastpath" provider when
+ * arrays grow, for bpftrace or perf on a running process; it needs
+ * <sys/sdt.h>.
+ * ======================================================================== */
+
+#ifdef FASTPATH_STATS
+#define FASTPATH_STATS_ENABLED 1
+#define FASTPATH_COUNT(counter, n) ((void)((counter) += (uint64_t)(n)))
+#else
+#define FASTPATH_STATS_ENABLED 0
+#define FASTPATH_COUNT(counter, n) ((void)0)
+#endif
+
+#ifdef FASTPATH_USDT
+#include <sys/sdt.h>
+#define FASTPATH_PROBE2(name, a, b) DTRACE_PROBE2(fastpath, name, a, b)
+#else
+#define FASTPATH_PROBE2(name, a, b) ((void)0)
+#endif
+
+typedef struct {
+    uint64_t intern_hits;      /* Interned names already in the pool */
+    uint64_t intern_misses;    /* Interned names added to the pool */
+    uint64_t objects_created;  /* str objects decoded for string IDs */
+} StringPoolCounters;
+
+typedef struct {
+    uint64_t child_lookups;       /* Child index lookups */
+    uint64_t child_probes;        /* Slots visited by those lookups */
+    uint64_t node_grows;          /* Times the per-node arrays grew */
+    uint64_t node_grow_bytes;     /* Bytes those growths allocated */
+    uint64_t path_strings_built;  /* str() results built rather than served from the cache */
+    uint64_t path_bytes_built;    /* Encoded paths built rather than served from the cache */
+} TreeCounters;
+
+/* ========================================================================
+ * Chunked storage
+ *
+ * Per-node and per-string arrays are split into chunks that double in
+ * size: chunk k holds (1 << (base_bits + k)) elements.  Chunks never move
+ * once allocated and growing never copies.  Any prefix of the logical
+ * array that ends on a chunk boundary has the same layout as one flat
+ * array, which lets a snapshot buffer supply the leading chunks in place.
+ * ======================================================================== */
+
+#define CHUNK_MAX 57  /* Enough chunks to address 2^63 elements with base_bits >= 7 */
+
+typedef struct {
+    char *chunks[CHUNK_MAX];  /* Chunk storage, NULL for chunks never allocated */
+    int count;                /* Number of chunk slots in use */
+    int borrowed;             /* Leading chunks owned by a snapshot buffer */
+    int base_bits;            /* Layout, recorded on first use so chunks can be freed by size */
+    uint32_t elem_size;
+} ChunkedArray;
+
+static inline int
+chunk_log2(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanReverse64(&bit, value);
+    return (int)bit;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+/* Number of elements held by the first count chunks */
+static inline Py_ssize_t
+chunk_capacity(int count, int base_bits)
+{
+    return (((Py_ssize_t)1 << count) - 1) << base_bits;
+}
+
+/* Split a logical index into a chunk number and an offset within it */
+static inline int
+chunk_locate(Py_ssize_t idx, int base_bits, Py_ssize_t *offset)
+{
+    uint64_t biased = (uint64_t)idx + ((uint64_t)1 << base_bits);
+    int bit = chunk_log2(biased);
+    *offset = (Py_ssize_t)(biased - ((uint64_t)1 << bit));
+    return bit - base_bits;
+}
+
+static inline void *
+chunked_at(const ChunkedArray *array, Py_ssize_t idx, int base_bits, size_t elem_size)
+{
+    Py_ssize_t offset;
+    int k = chunk_locate(idx, base_bits, &offset);
+    return array->chunks[k] + (size_t)offset * elem_size;
+}
+
+/* ========================================================================
+ * Byte scanning
+ * ======================================================================== */
+
+/* Bitmask of the bytes equal to c in a 64-byte block, bit i for block[i] */
+typedef uint64_t (*ByteMaskFunc)(const char *block, char c);
+extern ByteMaskFunc fastpath_byte_mask;
+extern const char *fastpath_simd;  /* Name of the kernel chosen at import */
+void fastpath_simd_init(void);
+uint64_t byte_mask_partial(const char *data, Py_ssize_t length, char c);
+Py_ssize_t fastpath_rfind_byte(const char *data, Py_ssize_t length, char c);
+
+static inline int
+bit_lowest(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward64(&bit, value);
+    return (int)bit;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+/* Yields the offsets of one byte value in order, masking a block at a time */
+typedef struct {
+    const char *data;
+    Py_ssize_t length;
+    Py_ssize_t base;    /* Offset of the block covered by mask */
+    uint64_t mask;      /* Matches in that block not yet returned */
+    char c;
+} ByteScanner;
+
+static inline uint64_t
+byte_scanner_block(const ByteScanner *scanner)
+{
+    Py_ssize_t remaining = scanner->length - scanner->base;
+    return remaining >= 64 ? fastpath_byte_mask(scanner->data + scanner->base, scanner->c)
+                           : byte_mask_partial(scanner->data + scanner->base, remaining, scanner->c);
+}
+
+static inline void
+byte_scanner_init(ByteScanner *scanner, const char *data, Py_ssize_t length, char c)
+{
+    scanner->data = data;
+    scanner->length = length;
+    scanner->base = 0;
+    scanner->c = c;
+    scanner->mask = length > 0 ? byte_scanner_block(scanner) : 0;
+}
+
+/* Offset of the next match, or length once there are none left */
+static inline Py_ssize_t
+byte_scanner_next(ByteScanner *scanner)
+{
+    while (scanner->mask == 0) {
+        if (scanner->base + 64 >= scanner->length)
+            return scanner->length;
+        scanner->base += 64;
+        scanner->mask = byte_scanner_block(scanner);
+    }
+    Py_ssize_t offset = scanner->base + bit_lowest(scanner->mask);
+    scanner->mask &= scanner->mask - 1;
+    return offset;
+}
+
+/* Offset of the dot that starts a name's suffix, or length if there is
+ * none.  As in pathlib, a leading or trailing dot does not start one. */
+static inline Py_ssize_t
+name_suffix_offset(const char *name, Py_ssize_t length)
+{
+    if (length < 2 || name[length - 1] == '.')
+        return length;
+    Py_ssize_t dot = fastpath_rfind_byte(name, length - 1, '.');
+    return dot > 0 ? dot : length;
+}
+
+/* Interned string entry */
+typedef struct {
+    uint64_t offset;    /* Offset of the NUL-terminated UTF-8 bytes in the pool byte storage */
+    uint64_t hash;      /* Hash of the bytes */
+    uint32_t length;    /* Length in bytes, excluding the terminator */
+    uint32_t reserved;
+} StringEntry;
+
+/* No string ID / empty slot marker */
+#define STRING_ID_NONE UINT32_MAX
+
+#define STRING_ENTRY_CHUNK_BITS 7
+#define STRING_BYTES_CHUNK_BITS 16
+
+/* Suffix, stem and lowercase form of an interned name, each itself
+ * interned; STRING_ID_NONE until first asked for */
 typedef struct {
-    Py_ssize_t parent_idx;
-    Py_ssize_t name_id;
-} TreeNode;
+    uint32_t suffix_id;
+    uint32_t stem_id;
+    uint32_t fold_id;
+} StringSplit;
 
 /* StringPool object */
 typedef struct {
     PyObject_HEAD
-    PyObject *strings;      /* List of interned strings */
-    PyObject *string_map;   /* Dict mapping strings to IDs */
+    ChunkedArray entries;        /* StringEntry per string ID */
+    ChunkedArray objects;        /* Lazily created str object per string ID */
+    ChunkedArray bytes;          /* String bytes; a string never straddles two chunks */
+    ChunkedArray splits;         /* StringSplit per string ID, grown on demand */
+    Py_ssize_t count;            /* Number of interned strings */
+    Py_ssize_t capacity;         /* Capacity of the entries/objects arrays */
+    Py_ssize_t bytes_used;       /* Logical end of the string bytes */
+    uint32_t *table;             /* Open-addressing table of string IDs */
+    Py_ssize_t table_capacity;   /* Number of slots, always a power of two */
+    int table_borrowed;          /* Table lives in the snapshot buffer */
+    Py_buffer snapshot;          /* Snapshot buffer backing borrowed storage, obj is NULL if none */
+    StringPoolCounters counters;
 } StringPoolObject;
 
+static inline StringEntry *
+string_entry(const StringPoolObject *pool, Py_ssize_t string_id)
+{
+    return (StringEntry *)chunked_at(&pool->entries, string_id, STRING_ENTRY_CHUNK_BITS, sizeof(StringEntry));
+}
+
+static inline const char *
+string_entry_data(const StringPoolObject *pool, const StringEntry *entry)
+{
+    return (const char *)chunked_at(&pool->bytes, (Py_ssize_t)entry->offset, STRING_BYTES_CHUNK_BITS, 1);
+}
+
+#define NODE_CHUNK_BITS 7
+
+/* Typed per-node side table, one contiguous item per node */
+typedef struct {
+    PyObject *name;      /* Column name, a str */
+    char format[2];      /* struct module type code of the items, NUL-terminated */
+    Py_ssize_t itemsize;
+    int kind;            /* Whether items are signed, unsigned or floating point */
+    char *data;          /* NULL until first written or exported */
+    Py_ssize_t length;   /* Items allocated; nodes past it read as zero */
+    Py_ssize_t exports;  /* Live buffer exports, which pin data in place */
+} NodeColumnData;
+
+/* Columns every tree starts with */
+#define NODE_COLUMN_SIZE 0      /* int64 size in bytes */
+#define NODE_COLUMN_MTIME 1     /* int64 modification time in nanoseconds */
+#define NODE_COLUMN_MODE 2      /* uint32 st_mode */
+#define NODE_COLUMN_BUILTIN_COUNT 3
+
 /* TreeAllocator object */
 typedef struct {
     PyObject_HEAD
-    TreeNode *nodes;           /* Array of nodes */
+    ChunkedArray parents;      /* node_index_t parent per node, NODE_NONE for roots */
+    ChunkedArray names;        /* uint32_t name string ID per node */
+    ChunkedArray anchors;      /* node_index_t index of the root each node descends from */
+    ChunkedArray hashes;       /* uint64_t content hash of the path per node */
+    ChunkedArray first_children;  /* node_index_t most recently added child per node, NODE_NONE if a leaf */
+    ChunkedArray next_siblings;   /* node_index_t next older sibling per node, NODE_NONE if last */
+    ChunkedArray depths;       /* uint32_t number of components below the root per node */
     Py_ssize_t node_count;     /* Number of nodes */
-    Py_ssize_t node_capacity;  /* Capacity of nodes array */
+    Py_ssize_t node_capacity;  /* Capacity of the per-node arrays */
+    uint64_t depth_total;      /* Sum of the depths of all nodes, for stats() */
+    node_index_t *child_index; /* Open-addressing table of node indices keyed on (parent_idx, name_id) */
+    Py_ssize_t child_index_capacity;  /* Number of slots, always a power of two */
+    Py_ssize_t child_index_count;     /* Number of occupied slots */
+    int child_index_borrowed;         /* Child index lives in the snapshot buffer */
+    ChunkedArray path_strings;        /* PyObject* materialized path per node, allocated on first use */
+    ChunkedArray path_bytes;          /* PyObject* encoded path per node, allocated on first use */
+    Py_ssize_t path_string_bytes;     /* Bytes held by cached path strings and encoded paths */
+    Py_ssize_t path_string_budget;    /* Byte budget for both caches, -1 for unlimited */
     PyObject *string_pool;     /* Reference to string pool */
     Py_ssize_t relative_root;  /* Index of relative root */
     Py_ssize_t absolute_root;  /* Index of absolute root */
-    PyObject *drive_roots;     /* Dict of drive roots */
+    int fold_case;             /* Path hashes ignore case, as Windows paths compare */
+    Py_buffer snapshot;        /* Snapshot buffer backing borrowed storage, obj is NULL if none */
+    NodeColumnData *columns;   /* Per-node side tables, builtin columns first */
+    Py_ssize_t column_count;
+    PyObject *retired;         /* Storage compact() replaced on free-threaded builds, or NULL */
+    Py_ssize_t *epoch_starts;  /* First node index of each epoch after epoch 0 */
+    Py_ssize_t epoch_count;    /* Epochs begun after epoch 0, so also the current epoch */
+    TreeCounters counters;
 } TreeAllocatorObject;
 
+/* Default byte budget for materialized path strings */
+#define PATH_CACHE_DEFAULT_BYTES (64 * 1024 * 1024)
+
+/* Default limits of the path string lookup cache */
+#define LOOKUP_CACHE_DEFAULT_ENTRIES 4096
+#define LOOKUP_CACHE_DEFAULT_BYTES (1024 * 1024)
+
+/* Entry of the path string lookup cache */
+typedef struct {
+    PyObject *key;            /* Exact str, NULL for a free entry */
+    Py_hash_t hash;
+    Py_ssize_t node_idx;
+    Py_ssize_t cost;          /* Bytes charged against max_bytes */
+    Py_ssize_t prev;          /* Recency list links, -1 at the ends; next also chains free entries */
+    Py_ssize_t next;
+} PathCacheEntry;
+
+/* Bounded LRU map from whole path strings to node indices */
+typedef struct {
+    PathCacheEntry *entries;
+    Py_ssize_t entry_capacity;
+    Py_ssize_t entry_used;    /* Entries ever handed out, free ones included */
+    Py_ssize_t free_head;
+    Py_ssize_t *slots;        /* Open-addressing table of entry indices, -1 empty */
+    Py_ssize_t slot_capacity; /* Zero or a power of two */
+    Py_ssize_t head;          /* Most recently used */
+    Py_ssize_t tail;          /* Least recently used, evicted first */
+    Py_ssize_t count;
+    Py_ssize_t bytes;
+    Py_ssize_t max_entries;   /* Zero disables the cache */
+    Py_ssize_t max_bytes;     /* -1 for unlimited */
+    Py_ssize_t hits;
+    Py_ssize_t misses;
+    Py_ssize_t evictions;
+} PathCache;
+
 /* PathAllocator object */
 typedef struct {
     PyObject_HEAD
     StringPoolObject *string_pool;
     TreeAllocatorObject *tree;
-    PyObject *cache;          /* LRU cache dict */
-    const char *separator;    /* Path separator */
+    PathCache cache;          /* Path string lookup cache */
+    char separator[2];        /* Path separator, NUL-terminated */
+    const struct PathFlavour *flavour;  /* Parser and comparison rules, fixed at construction */
+    char track_paths;         /* Live native paths are registered so compact() can remap them */
+    struct PureFastPathObject **tracked_paths;  /* Open-addressing set of live paths, NULL slots empty */
+    Py_ssize_t tracked_capacity;  /* Number of slots, zero or a power of two */
+    Py_ssize_t tracked_count;
+    Py_ssize_t generation;    /* Bumped by compact(), which renumbers nodes and strings */
+    PyObject *token;          /* Identity in pickles, a str; NULL until first needed */
+    PyObject *share_path;     /* Snapshot file that pickles refer to, or NULL */
+    Py_ssize_t share_nodes;   /* Nodes that file holds, -1 once it is stale */
+    PyObject *origin_token;   /* Token of the allocator this one was unpickled from, or NULL */
+    Py_ssize_t origin_nodes;  /* Leading nodes identical to that origin's */
+    PyObject *origin_path;    /* Snapshot file that copy was loaded from, or NULL */
+    PyObject *weakreflist;
 } PathAllocatorObject;
 
-/* PureFastPath object */
+/* ========================================================================
+ * Path flavours
+ *
+ * The POSIX and Windows path rules are separate parser and comparison
+ * functions.  An allocator picks its table once when it is created, so
+ * parsing a POSIX path never tests for drives or a second separator.
+ * ======================================================================== */
+
+enum {
+    FLAVOUR_POSIX,
+    FLAVOUR_WINDOWS,
+};
+
+/* Flavour of allocators created without one */
+#ifdef _WIN32
+#define FLAVOUR_NATIVE FLAVOUR_WINDOWS
+#else
+#define FLAVOUR_NATIVE FLAVOUR_POSIX
+#endif
+
+/* Returned by a flavour's compare with an exception set */
+#define PATH_COMPARE_ERROR INT_MIN
+
+typedef struct PathFlavour {
+    const char *name;   /* "posix" or "windows" */
+    int id;             /* FLAVOUR_* */
+    char altsep;        /* Second separator accepted on input, NUL if none */
+    /* Walk a path string from base_idx; the caller holds the tree and pool critical sections */
+    Py_ssize_t (*walk)(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length,
+                       char sep);
+    /* Order two components, negative, zero or positive */
+    int (*compare)(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx);
+    /* Whether paths below a root are absolute */
+    int (*absolute)(PathAllocatorObject *self, Py_ssize_t anchor_idx);
+} PathFlavour;
+
+extern const PathFlavour path_flavour_posix;
+extern const PathFlavour path_flavour_windows;
+
+/* 1 if a name contains one of the allocator's separators */
+static inline int
+path_has_separator(const PathAllocatorObject *self, const char *data, Py_ssize_t length)
+{
+    return memchr(data, self->separator[0], length) != NULL ||
+           (self->flavour->altsep != '\0' && memchr(data, self->flavour->altsep, length) != NULL);
+}
+
+/* NodeColumn object: a view of one of a tree's columns */
+typedef struct {
+    PyObject_HEAD
+    TreeAllocatorObject *tree;
+    Py_ssize_t column;  /* Index into tree->columns */
+} NodeColumnObject;
+
+/* Kinds of compiled glob components */
+enum {
+    GLOB_LITERAL,     /* Plain name, compared by string ID */
+    GLOB_ANY,         /* "*" */
+    GLOB_WILDCARD,    /* Any other component with *, ? or [...] */
+    GLOB_RECURSIVE,   /* "**", zero or more components */
+};
+
+typedef struct {
+    int kind;
+    const char *text;          /* UTF-8 bytes of the component, into GlobPatternObject.text */
+    Py_ssize_t length;
+    Py_ssize_t name_id;        /* Literal: string ID, -1 while the name is not interned */
+    unsigned char *memo;       /* Wildcard: per string ID, 0 unknown, 1 no match, 2 match */
+    Py_ssize_t memo_size;
+} GlobComponent;
+
+/* GlobPattern object: a glob compiled against one allocator's strings */
 typedef struct {
+    PyObject_HEAD
+    PathAllocatorObject *allocator;
+    PyObject *pattern;         /* Source str */
+    char *text;                /* UTF-8 copy of the pattern */
+    GlobComponent *components;
+    Py_ssize_t count;
+    Py_ssize_t recursive_count;
+    int anchored;              /* Pattern starts with a separator */
+    int dir_only;              /* Pattern ends with a separator */
+    int fold_case;             /* Names match ignoring case, as Windows paths compare */
+    Py_ssize_t generation;     /* Allocator generation the string IDs belong to */
+} GlobPatternObject;
+
+/* Open-addressing set of 64-bit keys, used to drop repeated glob states */
+typedef struct {
+    int64_t *slots;            /* -1 for empty */
+    Py_ssize_t capacity;       /* Zero or a power of two */
+    Py_ssize_t count;
+} GlobSeen;
+
+/* PureFastPath object */
+typedef struct PureFastPathObject {
     PyObject_HEAD
     PyObject *_allocator;  /* PathAllocator instance */
     Py_ssize_t _node_idx;  /* Node index in tree */
@@ -57,6 +475,116 @@ typedef struct {
     PureFastPathObject base;  /* Inherits from PureFastPath */
 } FastPathObject;
 
+/* Per-node accessors; roots report a parent index of -1 */
+static inline node_index_t *
+tree_parent_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (node_index_t *)chunked_at(&tree->parents, node_idx, NODE_CHUNK_BITS, sizeof(node_index_t));
+}
+
+static inline uint32_t *
+tree_name_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (uint32_t *)chunked_at(&tree->names, node_idx, NODE_CHUNK_BITS, sizeof(uint32_t));
+}
+
+static inline uint32_t *
+tree_depth_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (uint32_t *)chunked_at(&tree->depths, node_idx, NODE_CHUNK_BITS, sizeof(uint32_t));
+}
+
+static inline Py_ssize_t
+tree_parent(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    node_index_t parent_idx = *tree_parent_slot(tree, node_idx);
+    return parent_idx == NODE_NONE ? -1 : (Py_ssize_t)parent_idx;
+}
+
+static inline Py_ssize_t
+tree_name(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (Py_ssize_t)*tree_name_slot(tree, node_idx);
+}
+
+static inline node_index_t *
+tree_anchor_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (node_index_t *)chunked_at(&tree->anchors, node_idx, NODE_CHUNK_BITS, sizeof(node_index_t));
+}
+
+static inline Py_ssize_t
+tree_depth(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (Py_ssize_t)*tree_depth_slot(tree, node_idx);
+}
+
+static inline uint64_t
+tree_hash(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return *(uint64_t *)chunked_at(&tree->hashes, node_idx, NODE_CHUNK_BITS, sizeof(uint64_t));
+}
+
+static inline node_index_t *
+tree_first_child_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (node_index_t *)chunked_at(&tree->first_children, node_idx, NODE_CHUNK_BITS, sizeof(node_index_t));
+}
+
+static inline node_index_t *
+tree_next_sibling_slot(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (node_index_t *)chunked_at(&tree->next_siblings, node_idx, NODE_CHUNK_BITS, sizeof(node_index_t));
+}
+
+static inline Py_ssize_t
+tree_first_child(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    node_index_t child_idx = *tree_first_child_slot(tree, node_idx);
+    return child_idx == NODE_NONE ? -1 : (Py_ssize_t)child_idx;
+}
+
+static inline Py_ssize_t
+tree_next_sibling(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    node_index_t sibling_idx = *tree_next_sibling_slot(tree, node_idx);
+    return sibling_idx == NODE_NONE ? -1 : (Py_ssize_t)sibling_idx;
+}
+
+/* Index of the root node a node descends from; roots are their own anchor */
+static inline Py_ssize_t
+tree_anchor(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    return (Py_ssize_t)*tree_anchor_slot(tree, node_idx);
+}
+
+/* 1 if node_idx names a node, otherwise 0 with IndexError set */
+static inline int
+tree_valid_index(const TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return 0;
+    }
+    return 1;
+}
+
+/* Node after node_idx in a preorder walk below root_idx, or -1 when done */
+static inline Py_ssize_t
+tree_next_preorder(const TreeAllocatorObject *tree, Py_ssize_t node_idx, Py_ssize_t root_idx)
+{
+    Py_ssize_t child_idx = tree_first_child(tree, node_idx);
+    if (child_idx >= 0)
+        return child_idx;
+    while (node_idx != root_idx) {
+        Py_ssize_t sibling_idx = tree_next_sibling(tree, node_idx);
+        if (sibling_idx >= 0)
+            return sibling_idx;
+        node_idx = tree_parent(tree, node_idx);
+    }
+    return -1;
+}
+
 /* ========================================================================
  * Global variables
  * ======================================================================== */
@@ -66,9 +594,21 @@ extern PyTypeObject TreeAllocatorType;
 extern PyTypeObject PathAllocatorType;
 extern PyTypeObject PureFastPathType;
 extern PyTypeObject FastPathType;
+extern PyTypeObject DescendantIterType;
+extern PyTypeObject WalkIterType;
+extern PyTypeObject NodeColumnType;
+extern PyTypeObject GlobPatternType;
+extern PyTypeObject PathListType;  /* tp_base is set to list at import */
 
 extern PyObject *default_allocator;
 
+/* Growable buffer of node indices */
+typedef struct {
+    int64_t *items;
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+} IndexBuffer;
+
 /* ========================================================================
  * Function declarations
  * ======================================================================== */
@@ -76,27 +616,163 @@ extern PyObject *default_allocator;
 /* StringPool methods */
 PyObject* StringPool_intern(StringPoolObject *self, PyObject *args);
 PyObject* StringPool_get_string(StringPoolObject *self, PyObject *args);
+Py_ssize_t StringPool_intern_bytes(StringPoolObject *self, const char *data, Py_ssize_t length);
+Py_ssize_t StringPool_lookup_bytes(StringPoolObject *self, const char *data, Py_ssize_t length);
+PyObject* StringPool_get_object(StringPoolObject *self, Py_ssize_t string_id);
+Py_ssize_t string_pool_intern(StringPoolObject *self, const char *data, Py_ssize_t length);
+Py_ssize_t StringPool_suffix_id(StringPoolObject *self, Py_ssize_t string_id);
+Py_ssize_t StringPool_stem_id(StringPoolObject *self, Py_ssize_t string_id);
+PyObject* StringPool_suffix_id_py(StringPoolObject *self, PyObject *args);
+PyObject* StringPool_stem_id_py(StringPoolObject *self, PyObject *args);
+PyObject* name_fold(const char *data, Py_ssize_t length);
+Py_ssize_t string_pool_fold(StringPoolObject *self, Py_ssize_t string_id);
+Py_ssize_t StringPool_fold_id(StringPoolObject *self, Py_ssize_t string_id);
+PyObject* StringPool_fold_id_py(StringPoolObject *self, PyObject *args);
 
 /* TreeAllocator methods */
+int tree_setup(TreeAllocatorObject *self, PyObject *string_pool);
 Py_ssize_t TreeAllocator_add_node(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id);
 PyObject* TreeAllocator_add_node_py(TreeAllocatorObject *self, PyObject *args);
-PyObject* TreeAllocator_get_parts(TreeAllocatorObject *self, PyObject *args);
+PyObject* TreeAllocator_get_parts(TreeAllocatorObject *self, Py_ssize_t node_idx);
 PyObject* TreeAllocator_find_child(TreeAllocatorObject *self, PyObject *args);
+Py_ssize_t TreeAllocator_lookup_child(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id);
+Py_ssize_t tree_lookup_child(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id);
+
+/* Root named name_id, or -1; the caller holds the tree's critical section */
+static inline Py_ssize_t
+tree_lookup_root(TreeAllocatorObject *self, Py_ssize_t name_id)
+{
+    return tree_lookup_child(self, (Py_ssize_t)NODE_NONE, name_id);
+}
+
+Py_ssize_t tree_add_node(TreeAllocatorObject *self, Py_ssize_t parent_idx, Py_ssize_t name_id);
+int TreeAllocator_is_ancestor(TreeAllocatorObject *self, Py_ssize_t ancestor_idx, Py_ssize_t node_idx);
+Py_ssize_t TreeAllocator_common_ancestor(TreeAllocatorObject *self, Py_ssize_t a_idx, Py_ssize_t b_idx);
+Py_ssize_t TreeAllocator_relative_to(TreeAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t base_idx);
+PyObject* TreeAllocator_get_ancestors(TreeAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* TreeAllocator_get_children(TreeAllocatorObject *self, Py_ssize_t node_idx);
+Py_ssize_t TreeAllocator_count_descendants(TreeAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* TreeAllocator_iter_descendants(TreeAllocatorObject *self, Py_ssize_t node_idx, PyObject *allocator,
+                                         PyTypeObject *path_type);
+
+/* Node columns */
+int tree_columns_init(TreeAllocatorObject *tree);
+void tree_columns_free(TreeAllocatorObject *tree);
+int tree_columns_exported(const TreeAllocatorObject *tree);
+int tree_columns_compact(TreeAllocatorObject *dst, const TreeAllocatorObject *src, const int64_t *remap);
+PyObject* TreeAllocator_column(TreeAllocatorObject *self, PyObject *args);
+PyObject* TreeAllocator_add_column(TreeAllocatorObject *self, PyObject *args, PyObject *kwds);
+PyObject* TreeAllocator_column_names(TreeAllocatorObject *self, PyObject *Py_UNUSED(ignored));
+
+/* Epochs and tree diff */
+int tree_epochs_compact(TreeAllocatorObject *dst, const TreeAllocatorObject *src, const int64_t *remap);
+PyObject* PathAllocator_new_epoch(PathAllocatorObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* PathAllocator_get_epoch(PathAllocatorObject *self, void *closure);
+PyObject* PathAllocator_node_epoch(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_added_since(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_diff(PathAllocatorObject *self, PyObject *args);
+
+/* Path flavours */
+void path_allocator_set_flavour(PathAllocatorObject *self, int flavour, char separator);
+Py_ssize_t path_walk_posix(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length,
+                           char sep);
+int path_component_compare(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx);
+PyObject* PathAllocator_get_flavour(PathAllocatorObject *self, void *closure);
+PyObject* PathAllocator_get_anchor(PathAllocatorObject *self, Py_ssize_t node_idx);
 
 /* PathAllocator methods */
 PyObject* PathAllocator_from_parts(PathAllocatorObject *self, PyObject *args);
 PyObject* PathAllocator_from_string(PathAllocatorObject *self, PyObject *args);
-PyObject* PathAllocator_get_parts(PathAllocatorObject *self, PyObject *args);
-PyObject* PathAllocator_get_parent(PathAllocatorObject *self, PyObject *args);
-PyObject* PathAllocator_get_name(PathAllocatorObject *self, PyObject *args);
+Py_ssize_t PathAllocator_walk(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length);
+Py_ssize_t PathAllocator_join_parts(PathAllocatorObject *self, Py_ssize_t base_idx, PyObject *parts);
+PyObject* PathAllocator_get_str(PathAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* PathAllocator_get_parts(PathAllocatorObject *self, Py_ssize_t node_idx);
+Py_ssize_t PathAllocator_get_parent(PathAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* PathAllocator_get_name(PathAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* PathAllocator_get_suffix(PathAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* PathAllocator_get_stem(PathAllocatorObject *self, Py_ssize_t node_idx);
+PyObject* PathAllocator_get_suffixes(PathAllocatorObject *self, Py_ssize_t node_idx);
+Py_ssize_t PathAllocator_with_name(PathAllocatorObject *self, Py_ssize_t node_idx, PyObject *name);
+Py_ssize_t PathAllocator_with_suffix(PathAllocatorObject *self, Py_ssize_t node_idx, PyObject *suffix);
+PyObject* PathAllocator_suffix_ids(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_share(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_reduce(PathAllocatorObject *self, PyObject *Py_UNUSED(ignored));
+void PathAllocator_forget_origin(PathAllocatorObject *self);
+const char* path_argument_bytes(PyObject *arg, Py_ssize_t *length, PyObject **owned);
+Py_ssize_t PathAllocator_join_part(PathAllocatorObject *self, Py_ssize_t base_idx, PyObject *part);
+PyObject* PathAllocator_get_bytes(PathAllocatorObject *self, Py_ssize_t node_idx);
+Py_ssize_t PathAllocator_add_child(PathAllocatorObject *self, Py_ssize_t parent_idx, const char *name, Py_ssize_t length);
+int PathAllocator_is_absolute(PathAllocatorObject *self, Py_ssize_t node_idx);
+Py_ssize_t PathAllocator_relative_to(PathAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t base_idx);
+int PathAllocator_compare(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx,
+                          int *result);
+int PathAllocator_equal(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx);
+PyObject* PathAllocator_save(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_load(PyObject *type, PyObject *args, PyObject *kwds);
+int snapshot_write(PathAllocatorObject *self, PyObject *file);
+PyObject* snapshot_load_buffer(PyTypeObject *type, PyObject *buffer);
+PyObject* snapshot_copy_chunked(const ChunkedArray *array, Py_ssize_t used, int base_bits, size_t elem_size);
+PyObject* PathAllocator_scan(PathAllocatorObject *self, PyObject *args, PyObject *kwds);
+PyObject* PathAllocator_ingest(PathAllocatorObject *self, PyObject *args, PyObject *kwds);
+int PathAllocator_track_path(PathAllocatorObject *self, struct PureFastPathObject *path);
+void PathAllocator_untrack_path(PathAllocatorObject *self, struct PureFastPathObject *path);
+PyObject* PathAllocator_compact(PathAllocatorObject *self, PyObject *args, PyObject *kwds);
+Py_ssize_t PathAllocator_lookup_path(PathAllocatorObject *self, PyObject *path);
+PyObject* PathAllocator_get_cache(PathAllocatorObject *self, void *closure);
+void path_cache_init(PathCache *cache, Py_ssize_t max_entries, Py_ssize_t max_bytes);
+void path_cache_clear(PathCache *cache);
+void path_cache_free(PathCache *cache);
+PyObject* PathAllocator_compile_glob(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_glob(PathAllocatorObject *self, PyObject *args);
+PyObject* PathAllocator_match(PathAllocatorObject *self, PyObject *args);
+
+/* Glob patterns */
+GlobPatternObject* glob_pattern_compile(PathAllocatorObject *allocator, PyObject *pattern);
+int glob_pattern_prepare(GlobPatternObject *self);
+int glob_component_match(GlobPatternObject *self, GlobComponent *component, Py_ssize_t name_id);
+PyObject* glob_pattern_tree(GlobPatternObject *self, Py_ssize_t base_idx);
+int glob_pattern_match(GlobPatternObject *self, Py_ssize_t node_idx);
+int glob_pattern_check(GlobPatternObject *self);
+int glob_push_state(GlobPatternObject *self, IndexBuffer *stack, GlobSeen *seen, Py_ssize_t node_idx, Py_ssize_t i);
+PyObject* glob_recursive_pattern(PyObject *allocator, PyObject *pattern);
 
 /* PureFastPath methods */
 PyObject* PureFastPath_str(PureFastPathObject *self);
 PyObject* PureFastPath_get_parent(PureFastPathObject *self, void *closure);
 PyObject* PureFastPath_get_name(PureFastPathObject *self, void *closure);
 PyObject* PureFastPath_truediv(PureFastPathObject *self, PyObject *other);
+PyObject* PureFastPath_from_index(PyTypeObject *type, PyObject *allocator, Py_ssize_t node_idx);
+PyObject* PureFastPath_reduce(PureFastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* fastpath_commonpath(PyObject *module, PyObject *paths);
+PyObject* fastpath_restore_allocator(PyObject *module, PyObject *args);
+PyObject* fastpath_restore_path(PyObject *module, PyObject *args);
+PyObject* fastpath_restore_paths(PyObject *module, PyObject *args);
+
+/* FastPath filesystem methods */
+int fastpath_fs_init(void);
+extern int fastpath_fs_utf8;  /* os.fsencode() is UTF-8 with surrogateescape, the pool's own encoding */
+PyObject* FastPath_stat(FastPathObject *self, PyObject *args, PyObject *kwds);
+PyObject* FastPath_lstat(FastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* FastPath_exists(FastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* FastPath_is_file(FastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* FastPath_is_dir(FastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* FastPath_iterdir(FastPathObject *self, PyObject *Py_UNUSED(ignored));
+PyObject* FastPath_walk(FastPathObject *self, PyObject *args, PyObject *kwds);
+PyObject* FastPath_glob(FastPathObject *self, PyObject *pattern);
+PyObject* FastPath_rglob(FastPathObject *self, PyObject *pattern);
 
 /* Helper functions */
 PyObject* get_default_allocator(void);
+int index_buffer_append(IndexBuffer *buf, Py_ssize_t node_idx);
+int index_buffer_collect(PyObject *nodes, IndexBuffer *out);
+PyObject* fastpath_typed_array(const char *format, const void *items, Py_ssize_t nbytes);
+PyObject* fastpath_index_array(const int64_t *indices, Py_ssize_t count);
+int chunked_grow(ChunkedArray *array, int base_bits, size_t elem_size, int zeroed);
+void chunked_borrow(ChunkedArray *array, char *base, int count, int base_bits, size_t elem_size);
+void chunked_free(ChunkedArray *array);
+void *block_alloc(size_t size, int zeroed);
+void block_free(void *block, size_t size);
+PyObject* fastpath_block_pool_info(PyObject *module, PyObject *Py_UNUSED(ignored));
+PyObject* fastpath_set_block_pool_limit(PyObject *module, PyObject *arg);
 
 #endif /* FASTPATH_H */
\ No newline at end of file
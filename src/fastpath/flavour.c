@@ -0,0 +1,278 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Windows paths
+ *
+ * A Windows path starts with an optional anchor, which pathlib splits into
+ * a drive and a root: "C:\", "C:" (relative to the drive's current
+ * directory), "\\server\share\" or a bare "\".  Every anchor beyond the
+ * allocator's two fixed roots is a root node named by the anchor with its
+ * separators normalized, found again through the child index under
+ * NODE_NONE.  Both "\" and "/" separate components, and "." components are
+ * dropped.  Components keep their case; comparisons and hashes use the
+ * lowercase forms.
+ * ======================================================================== */
+
+/* Yields the offsets of either of two byte values, like ByteScanner */
+typedef struct {
+    const char *data;
+    Py_ssize_t length;
+    Py_ssize_t base;
+    uint64_t mask;
+    char a, b;
+} SeparatorScanner;
+
+static inline uint64_t
+separator_scanner_block(const SeparatorScanner *scanner)
+{
+    const char *block = scanner->data + scanner->base;
+    Py_ssize_t remaining = scanner->length - scanner->base;
+    if (remaining >= 64)
+        return fastpath_byte_mask(block, scanner->a) | fastpath_byte_mask(block, scanner->b);
+    return byte_mask_partial(block, remaining, scanner->a) | byte_mask_partial(block, remaining, scanner->b);
+}
+
+static inline void
+separator_scanner_init(SeparatorScanner *scanner, const char *data, Py_ssize_t length, Py_ssize_t start, char a,
+                       char b)
+{
+    scanner->data = data;
+    scanner->length = length;
+    scanner->base = start & ~(Py_ssize_t)63;
+    scanner->a = a;
+    scanner->b = b;
+    scanner->mask = scanner->base < length ? separator_scanner_block(scanner) : 0;
+    /* Drop matches before start */
+    if (start > scanner->base)
+        scanner->mask &= ~(uint64_t)0 << (start - scanner->base);
+}
+
+static inline Py_ssize_t
+separator_scanner_next(SeparatorScanner *scanner)
+{
+    while (scanner->mask == 0) {
+        if (scanner->base + 64 >= scanner->length)
+            return scanner->length;
+        scanner->base += 64;
+        scanner->mask = separator_scanner_block(scanner);
+    }
+    Py_ssize_t offset = scanner->base + bit_lowest(scanner->mask);
+    scanner->mask &= scanner->mask - 1;
+    return offset;
+}
+
+static inline int
+windows_is_sep(char c, char sep)
+{
+    return c == sep || c == '/';
+}
+
+/* Split the anchor off a Windows path: sets the length of its drive and
+ * whether a root follows, and returns where the components start */
+static Py_ssize_t
+windows_split_anchor(const char *data, Py_ssize_t length, char sep, Py_ssize_t *drive_length, int *has_root)
+{
+    *drive_length = 0;
+    *has_root = 0;
+    if (length >= 3 && windows_is_sep(data[0], sep) && windows_is_sep(data[1], sep) &&
+        !windows_is_sep(data[2], sep)) {
+        /* "\\server\share" is a UNC drive, which is always rooted; without
+         * the separator after the server it is a plain rooted path */
+        Py_ssize_t server_end = 2;
+        while (server_end < length && !windows_is_sep(data[server_end], sep))
+            server_end++;
+        if (server_end < length) {
+            Py_ssize_t share_end = server_end + 1;
+            while (share_end < length && !windows_is_sep(data[share_end], sep))
+                share_end++;
+            *drive_length = share_end;
+            *has_root = 1;
+            return share_end;
+        }
+    } else if (length >= 2 && data[1] == ':' && ((data[0] | 0x20) >= 'a' && (data[0] | 0x20) <= 'z')) {
+        *drive_length = 2;
+        *has_root = length >= 3 && windows_is_sep(data[2], sep);
+        return 2;
+    }
+    *has_root = length >= 1 && windows_is_sep(data[0], sep);
+    return 0;
+}
+
+/* Root node for an anchor spelled with the allocator's separator, added on first use */
+static Py_ssize_t
+windows_anchor_root(PathAllocatorObject *self, const char *drive, Py_ssize_t drive_length, int has_root)
+{
+    char stack_buf[64];
+    char *name = stack_buf;
+    Py_ssize_t length = drive_length + has_root;
+    if (length > (Py_ssize_t)sizeof(stack_buf)) {
+        name = PyMem_Malloc(length);
+        if (name == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    const char sep = self->separator[0];
+    for (Py_ssize_t i = 0; i < drive_length; i++)
+        name[i] = windows_is_sep(drive[i], sep) ? sep : drive[i];
+    if (has_root)
+        name[drive_length] = sep;
+
+    Py_ssize_t root_idx = -1;
+    Py_ssize_t name_id = string_pool_intern(self->string_pool, name, length);
+    if (name_id >= 0) {
+        root_idx = tree_lookup_root(self->tree, name_id);
+        if (root_idx < 0)
+            root_idx = tree_add_node(self->tree, -1, name_id);
+    }
+    if (name != stack_buf)
+        PyMem_Free(name);
+    return root_idx;
+}
+
+/* Anchor a Windows path is walked from when joined onto base_idx, as
+ * pathlib joins: a new drive replaces everything, a bare root keeps the
+ * base's drive, and a drive-relative path on the base's drive continues it */
+static Py_ssize_t
+windows_join_anchor(PathAllocatorObject *self, Py_ssize_t base_idx, const char *drive, Py_ssize_t drive_length,
+                    int has_root)
+{
+    TreeAllocatorObject *tree = self->tree;
+    Py_ssize_t base_anchor = tree_anchor(tree, base_idx);
+    const StringEntry *entry = NULL;
+    const char *base_name = NULL;
+    if (base_anchor != tree->relative_root && base_anchor != tree->absolute_root) {
+        entry = string_entry(self->string_pool, tree_name(tree, base_anchor));
+        base_name = string_entry_data(self->string_pool, entry);
+    }
+
+    if (drive_length == 0) {
+        if (!has_root)
+            return base_idx;
+        if (base_name == NULL)
+            return tree->absolute_root;
+        if (windows_is_sep(base_name[entry->length - 1], self->separator[0]))
+            return base_anchor;
+        return windows_anchor_root(self, base_name, entry->length, 1);
+    }
+
+    if (!has_root && base_name != NULL && entry->length >= 2 && base_name[1] == ':' &&
+        (base_name[0] | 0x20) == (drive[0] | 0x20)) {
+        return base_idx;
+    }
+    return windows_anchor_root(self, drive, drive_length, has_root);
+}
+
+static Py_ssize_t
+windows_walk(PathAllocatorObject *self, Py_ssize_t base_idx, const char *data, Py_ssize_t length, char sep)
+{
+    TreeAllocatorObject *tree = self->tree;
+    Py_ssize_t drive_length;
+    int has_root;
+    Py_ssize_t start = windows_split_anchor(data, length, sep, &drive_length, &has_root);
+    Py_ssize_t current_idx = base_idx;
+    if (drive_length > 0 || has_root) {
+        current_idx = windows_join_anchor(self, base_idx, data, drive_length, has_root);
+        if (current_idx < 0)
+            return -1;
+    }
+
+    SeparatorScanner separators;
+    separator_scanner_init(&separators, data, length, start, sep, '/');
+    Py_ssize_t pos;
+    for (; start < length; start = pos + 1) {
+        /* Empty components come from repeated separators, "." names the directory itself */
+        pos = separator_scanner_next(&separators);
+        if (pos == start || (pos == start + 1 && data[start] == '.'))
+            continue;
+
+        Py_ssize_t name_id = string_pool_intern(self->string_pool, data + start, pos - start);
+        if (name_id < 0)
+            return -1;
+
+        Py_ssize_t child_idx = tree_lookup_child(tree, current_idx, name_id);
+        if (child_idx < 0) {
+            child_idx = tree_add_node(tree, current_idx, name_id);
+            if (child_idx < 0)
+                return -1;
+        }
+        current_idx = child_idx;
+    }
+
+    return current_idx;
+}
+
+/* Order components by their lowercase forms */
+static int
+windows_compare(PathAllocatorObject *a, Py_ssize_t a_idx, PathAllocatorObject *b, Py_ssize_t b_idx)
+{
+    Py_ssize_t a_fold = StringPool_fold_id(a->string_pool, tree_name(a->tree, a_idx));
+    if (a_fold < 0)
+        return PATH_COMPARE_ERROR;
+    Py_ssize_t b_fold = StringPool_fold_id(b->string_pool, tree_name(b->tree, b_idx));
+    if (b_fold < 0)
+        return PATH_COMPARE_ERROR;
+    if (a->string_pool == b->string_pool && a_fold == b_fold)
+        return 0;
+
+    const StringEntry *a_entry = string_entry(a->string_pool, a_fold);
+    const StringEntry *b_entry = string_entry(b->string_pool, b_fold);
+    uint32_t length = a_entry->length < b_entry->length ? a_entry->length : b_entry->length;
+    int cmp = memcmp(string_entry_data(a->string_pool, a_entry), string_entry_data(b->string_pool, b_entry), length);
+    if (cmp != 0)
+        return cmp;
+    return (a_entry->length > b_entry->length) - (a_entry->length < b_entry->length);
+}
+
+/* Absolute paths have both a drive and a root */
+static int
+windows_absolute(PathAllocatorObject *self, Py_ssize_t anchor_idx)
+{
+    if (anchor_idx == self->tree->relative_root || anchor_idx == self->tree->absolute_root)
+        return 0;
+    const StringEntry *entry = string_entry(self->string_pool, tree_name(self->tree, anchor_idx));
+    return entry->length > 0 &&
+           windows_is_sep(string_entry_data(self->string_pool, entry)[entry->length - 1], self->separator[0]);
+}
+
+static int
+posix_absolute(PathAllocatorObject *self, Py_ssize_t anchor_idx)
+{
+    return anchor_idx == self->tree->absolute_root;
+}
+
+const PathFlavour path_flavour_posix = {
+    .name = "posix",
+    .id = FLAVOUR_POSIX,
+    .altsep = '\0',
+    .walk = path_walk_posix,
+    .compare = path_component_compare,
+    .absolute = posix_absolute,
+};
+
+const PathFlavour path_flavour_windows = {
+    .name = "windows",
+    .id = FLAVOUR_WINDOWS,
+    .altsep = '/',
+    .walk = windows_walk,
+    .compare = windows_compare,
+    .absolute = windows_absolute,
+};
+
+/* Install a flavour and separator; the tree must not hold nodes whose hash
+ * depends on case yet */
+void
+path_allocator_set_flavour(PathAllocatorObject *self, int flavour, char separator)
+{
+    self->flavour = flavour == FLAVOUR_WINDOWS ? &path_flavour_windows : &path_flavour_posix;
+    self->separator[0] = separator;
+    self->separator[1] = '\0';
+    if (self->tree != NULL)
+        self->tree->fold_case = flavour == FLAVOUR_WINDOWS;
+}
+
+PyObject *
+PathAllocator_get_flavour(PathAllocatorObject *self, void *closure)
+{
+    return PyUnicode_FromString(self->flavour->name);
+}
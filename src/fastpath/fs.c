@@ -0,0 +1,1601 @@
+#include "fastpath.h"
+
+#ifndef MS_WINDOWS
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* ========================================================================
+ * Filesystem operations
+ *
+ * FastPath's filesystem methods call the OS directly instead of going
+ * through os and os.path.  Directory listings are read with the GIL
+ * released, entries are classified from d_type or with fstatat() on the
+ * directory's own descriptor, and each entry name is interned straight
+ * into the tree as a child of the directory's node, so no path string is
+ * built or parsed per entry.  walk() descends with openat() relative to
+ * the parent directory, keeping one descriptor open per level.
+ *
+ * Windows builds go through the os module instead.
+ * ======================================================================== */
+
+static PyObject *stat_result_type = NULL;  /* os.stat_result */
+int fastpath_fs_utf8 = 0;
+
+int
+fastpath_fs_init(void)
+{
+    PyObject *os = PyImport_ImportModule("os");
+    if (os == NULL)
+        return -1;
+    stat_result_type = PyObject_GetAttrString(os, "stat_result");
+    Py_DECREF(os);
+    if (stat_result_type == NULL)
+        return -1;
+
+    /* Pool bytes are the encoded form only when os.fsencode() is UTF-8 with surrogateescape */
+    PyObject *sys = PyImport_ImportModule("sys");
+    if (sys == NULL)
+        return -1;
+    PyObject *encoding = PyObject_CallMethod(sys, "getfilesystemencoding", NULL);
+    PyObject *errors = encoding != NULL ? PyObject_CallMethod(sys, "getfilesystemencodeerrors", NULL) : NULL;
+    Py_DECREF(sys);
+    if (errors != NULL) {
+        fastpath_fs_utf8 = PyUnicode_CompareWithASCIIString(encoding, "utf-8") == 0 &&
+                           PyUnicode_CompareWithASCIIString(errors, "surrogateescape") == 0;
+    }
+    Py_XDECREF(encoding);
+    Py_XDECREF(errors);
+    return errors != NULL ? 0 : -1;
+}
+
+/* Child node of parent_idx for the name in name_obj, through either dispatch path */
+static Py_ssize_t
+fs_child_index(PyObject *allocator, Py_ssize_t parent_idx, PyObject *name_obj)
+{
+    if (Py_IS_TYPE(allocator, &PathAllocatorType)) {
+        PyObject *owned;
+        Py_ssize_t length;
+        const char *name = path_argument_bytes(name_obj, &length, &owned);
+        Py_ssize_t child_idx = -1;
+        if (name != NULL)
+            child_idx = PathAllocator_add_child((PathAllocatorObject *)allocator, parent_idx, name, length);
+        Py_XDECREF(owned);
+        return child_idx;
+    }
+
+    PyObject *idx = PyObject_CallMethod(allocator, "join", "nO", parent_idx, name_obj);
+    if (idx == NULL)
+        return -1;
+    Py_ssize_t child_idx = PyLong_AsSsize_t(idx);
+    Py_DECREF(idx);
+    return child_idx;
+}
+
+#ifndef MS_WINDOWS
+
+#if defined(HAVE_STAT_TV_NSEC)
+#define FS_NSEC(st, field) ((st)->field##tim.tv_nsec)
+#elif defined(HAVE_STAT_TV_NSEC2)
+#define FS_NSEC(st, field) ((st)->field##timespec.tv_nsec)
+#else
+#define FS_NSEC(st, field) 0
+#endif
+
+/* Errors that make exists(), is_file() and is_dir() report False, as pathlib */
+static inline int
+fs_ignored_errno(int err)
+{
+    return err == ENOENT || err == ENOTDIR || err == EBADF || err == ELOOP;
+}
+
+/* Filesystem-encoded path of a FastPath; sets *str to its str() for error messages */
+static PyObject *
+fs_encoded_path(FastPathObject *self, PyObject **str)
+{
+    *str = PureFastPath_str((PureFastPathObject *)self);
+    if (*str == NULL)
+        return NULL;
+
+    PureFastPathObject *base = (PureFastPathObject *)self;
+    PyObject *encoded = Py_IS_TYPE(base->_allocator, &PathAllocatorType)
+                            ? PathAllocator_get_bytes((PathAllocatorObject *)base->_allocator, base->_node_idx)
+                            : PyUnicode_EncodeFSDefault(*str);
+    if (encoded != NULL && strlen(PyBytes_AS_STRING(encoded)) != (size_t)PyBytes_GET_SIZE(encoded)) {
+        PyErr_SetString(PyExc_ValueError, "embedded null byte");
+        Py_CLEAR(encoded);
+    }
+    if (encoded == NULL)
+        Py_CLEAR(*str);
+    return encoded;
+}
+
+static int
+fs_set_time(PyObject *dict, const char *name, const char *name_ns, time_t sec, long nsec)
+{
+    PyObject *seconds = PyFloat_FromDouble((double)sec + nsec * 1e-9);
+    if (seconds == NULL)
+        return -1;
+    int status = PyDict_SetItemString(dict, name, seconds);
+    Py_DECREF(seconds);
+    if (status < 0)
+        return -1;
+
+    PyObject *ns = PyLong_FromLongLong((long long)sec * 1000000000LL + nsec);
+    if (ns == NULL)
+        return -1;
+    status = PyDict_SetItemString(dict, name_ns, ns);
+    Py_DECREF(ns);
+    return status;
+}
+
+static PyObject *
+fs_stat_result(const struct stat *st)
+{
+    PyObject *fields = Py_BuildValue("(KKKKKKLLLL)",
+                                     (unsigned long long)st->st_mode, (unsigned long long)st->st_ino,
+                                     (unsigned long long)st->st_dev, (unsigned long long)st->st_nlink,
+                                     (unsigned long long)st->st_uid, (unsigned long long)st->st_gid,
+                                     (long long)st->st_size, (long long)st->st_atime,
+                                     (long long)st->st_mtime, (long long)st->st_ctime);
+    if (fields == NULL)
+        return NULL;
+
+    PyObject *extra = Py_BuildValue("{sLsLsK}", "st_blksize", (long long)st->st_blksize,
+                                    "st_blocks", (long long)st->st_blocks,
+                                    "st_rdev", (unsigned long long)st->st_rdev);
+    PyObject *result = NULL;
+    if (extra != NULL &&
+        fs_set_time(extra, "st_atime", "st_atime_ns", st->st_atime, FS_NSEC(st, st_a)) == 0 &&
+        fs_set_time(extra, "st_mtime", "st_mtime_ns", st->st_mtime, FS_NSEC(st, st_m)) == 0 &&
+        fs_set_time(extra, "st_ctime", "st_ctime_ns", st->st_ctime, FS_NSEC(st, st_c)) == 0) {
+        result = PyObject_CallFunctionObjArgs(stat_result_type, fields, extra, NULL);
+    }
+    Py_DECREF(fields);
+    Py_XDECREF(extra);
+    return result;
+}
+
+/* stat() the path; returns 0 on success, the errno on failure, -1 with an exception set */
+static int
+fs_stat(FastPathObject *self, int follow_symlinks, struct stat *st, PyObject **str)
+{
+    PyObject *encoded = fs_encoded_path(self, str);
+    if (encoded == NULL)
+        return -1;
+
+    int status, err = 0;
+    Py_BEGIN_ALLOW_THREADS
+    status = follow_symlinks ? stat(PyBytes_AS_STRING(encoded), st) : lstat(PyBytes_AS_STRING(encoded), st);
+    if (status != 0)
+        err = errno;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(encoded);
+    return err;
+}
+
+static PyObject *
+fs_stat_method(FastPathObject *self, int follow_symlinks)
+{
+    struct stat st;
+    PyObject *str;
+    int err = fs_stat(self, follow_symlinks, &st, &str);
+    if (err < 0)
+        return NULL;
+    if (err > 0) {
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, str);
+        Py_DECREF(str);
+        return NULL;
+    }
+    Py_DECREF(str);
+    return fs_stat_result(&st);
+}
+
+/* Test the file mode; mask 0 only checks that the path exists */
+static PyObject *
+fs_test_mode(FastPathObject *self, mode_t type)
+{
+    struct stat st;
+    PyObject *str;
+    int err = fs_stat(self, 1, &st, &str);
+    if (err < 0) {
+        /* Paths the OS cannot represent do not exist */
+        if (PyErr_ExceptionMatches(PyExc_ValueError)) {
+            PyErr_Clear();
+            Py_RETURN_FALSE;
+        }
+        return NULL;
+    }
+    if (err > 0) {
+        if (fs_ignored_errno(err)) {
+            Py_DECREF(str);
+            Py_RETURN_FALSE;
+        }
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, str);
+        Py_DECREF(str);
+        return NULL;
+    }
+    Py_DECREF(str);
+    return PyBool_FromLong(type == 0 || (st.st_mode & S_IFMT) == type);
+}
+
+/* Entries of one directory, read without the GIL */
+typedef struct {
+    char *names;            /* NUL-terminated entry names back to back */
+    size_t names_used;
+    size_t names_capacity;
+    unsigned char *is_dir;  /* Per entry: 1 if it is a directory to descend into */
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+} DirListing;
+
+static void
+dir_listing_free(DirListing *listing)
+{
+    PyMem_RawFree(listing->names);
+    PyMem_RawFree(listing->is_dir);
+}
+
+static int
+dir_listing_append(DirListing *listing, const char *name, size_t length, unsigned char is_dir)
+{
+    if (listing->names_used + length + 1 > listing->names_capacity) {
+        size_t capacity = listing->names_capacity ? listing->names_capacity : 4096;
+        while (capacity < listing->names_used + length + 1)
+            capacity *= 2;
+        char *names = PyMem_RawRealloc(listing->names, capacity);
+        if (names == NULL)
+            return -1;
+        listing->names = names;
+        listing->names_capacity = capacity;
+    }
+    if (listing->count >= listing->capacity) {
+        Py_ssize_t capacity = listing->capacity ? listing->capacity * 2 : 64;
+        unsigned char *is_dir_buf = PyMem_RawRealloc(listing->is_dir, capacity);
+        if (is_dir_buf == NULL)
+            return -1;
+        listing->is_dir = is_dir_buf;
+        listing->capacity = capacity;
+    }
+    memcpy(listing->names + listing->names_used, name, length + 1);
+    listing->names_used += length + 1;
+    listing->is_dir[listing->count++] = is_dir;
+    return 0;
+}
+
+/* Read every entry of dir; classify them when classify is set.  Called
+ * without the GIL; returns 0 or an errno. */
+static int
+dir_listing_read(DIR *dir, DirListing *listing, int classify, int follow_symlinks)
+{
+    int fd = dirfd(dir);
+    for (;;) {
+        errno = 0;
+        struct dirent *entry = readdir(dir);
+        if (entry == NULL)
+            return errno;
+
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        unsigned char is_dir = 0;
+        if (classify) {
+            int need_stat = 1;
+#ifdef HAVE_DIRENT_D_TYPE
+            if (entry->d_type != DT_UNKNOWN && !(entry->d_type == DT_LNK && follow_symlinks)) {
+                is_dir = entry->d_type == DT_DIR;
+                need_stat = 0;
+            }
+#endif
+            struct stat st;
+            if (need_stat && fstatat(fd, name, &st, follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0)
+                is_dir = S_ISDIR(st.st_mode);
+        }
+
+        if (dir_listing_append(listing, name, strlen(name), is_dir) < 0)
+            return ENOMEM;
+    }
+}
+
+/* Open a directory: relative to parent_fd when it is valid, otherwise by path */
+static DIR *
+fs_open_dir(int parent_fd, const char *path, int follow_symlinks, int *err)
+{
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (parent_fd >= 0 && !follow_symlinks)
+        flags |= O_NOFOLLOW;
+
+    int fd = parent_fd >= 0 ? openat(parent_fd, path, flags) : open(path, flags);
+    if (fd < 0) {
+        *err = errno;
+        return NULL;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        *err = errno;
+        close(fd);
+    }
+    return dir;
+}
+
+/* Child node for a raw directory entry name */
+static Py_ssize_t
+fs_entry_index(PyObject *allocator, Py_ssize_t parent_idx, const char *name, size_t length)
+{
+    /* ASCII names are already valid pool bytes; others go through the
+     * filesystem encoding first */
+    if (Py_IS_TYPE(allocator, &PathAllocatorType)) {
+        size_t i = 0;
+        while (i < length && (unsigned char)name[i] < 0x80)
+            i++;
+        if (i == length)
+            return PathAllocator_add_child((PathAllocatorObject *)allocator, parent_idx, name, (Py_ssize_t)length);
+    }
+
+    PyObject *decoded = PyUnicode_DecodeFSDefaultAndSize(name, (Py_ssize_t)length);
+    if (decoded == NULL)
+        return -1;
+    Py_ssize_t child_idx = fs_child_index(allocator, parent_idx, decoded);
+    Py_DECREF(decoded);
+    return child_idx;
+}
+
+/* Child node and interned name for a raw directory entry name */
+static Py_ssize_t
+fs_entry_child(PyObject *allocator, Py_ssize_t parent_idx, const char *name, PyObject **name_obj)
+{
+    Py_ssize_t child_idx = fs_entry_index(allocator, parent_idx, name, strlen(name));
+    *name_obj = NULL;
+    if (child_idx < 0)
+        return -1;
+
+    if (Py_IS_TYPE(allocator, &PathAllocatorType)) {
+        PathAllocatorObject *native = (PathAllocatorObject *)allocator;
+        *name_obj = StringPool_get_object(native->string_pool, tree_name(native->tree, child_idx));
+    } else {
+        *name_obj = PyUnicode_DecodeFSDefault(name);
+    }
+    return *name_obj != NULL ? child_idx : -1;
+}
+
+PyObject *
+FastPath_stat(FastPathObject *self, PyObject *args, PyObject *kwds)
+{
+    int follow_symlinks = 1;
+    static char *kwlist[] = {"follow_symlinks", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$p", kwlist, &follow_symlinks))
+        return NULL;
+
+    return fs_stat_method(self, follow_symlinks);
+}
+
+PyObject *
+FastPath_lstat(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_stat_method(self, 0);
+}
+
+PyObject *
+FastPath_exists(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, 0);
+}
+
+PyObject *
+FastPath_is_file(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, S_IFREG);
+}
+
+PyObject *
+FastPath_is_dir(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, S_IFDIR);
+}
+
+PyObject *
+FastPath_iterdir(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PureFastPathObject *base = (PureFastPathObject *)self;
+    PyObject *str;
+    PyObject *encoded = fs_encoded_path(self, &str);
+    if (encoded == NULL)
+        return NULL;
+
+    DirListing listing = {0};
+    int err = 0;
+    Py_BEGIN_ALLOW_THREADS
+    DIR *dir = fs_open_dir(-1, PyBytes_AS_STRING(encoded), 1, &err);
+    if (dir != NULL) {
+        err = dir_listing_read(dir, &listing, 0, 0);
+        closedir(dir);
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(encoded);
+
+    if (err != 0) {
+        dir_listing_free(&listing);
+        errno = err;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, str);
+        Py_DECREF(str);
+        return NULL;
+    }
+    Py_DECREF(str);
+
+    PyObject *children = PyList_New(listing.count);
+    const char *name = listing.names;
+    for (Py_ssize_t i = 0; children != NULL && i < listing.count; i++) {
+        PyObject *name_obj;
+        Py_ssize_t child_idx = fs_entry_child(base->_allocator, base->_node_idx, name, &name_obj);
+        PyObject *child = child_idx < 0 ? NULL : PureFastPath_from_index(Py_TYPE(self), base->_allocator, child_idx);
+        Py_XDECREF(name_obj);
+        if (child == NULL) {
+            Py_CLEAR(children);
+            break;
+        }
+        PyList_SET_ITEM(children, i, child);
+        name += strlen(name) + 1;
+    }
+    dir_listing_free(&listing);
+    if (children == NULL)
+        return NULL;
+
+    PyObject *iter = PyObject_GetIter(children);
+    Py_DECREF(children);
+    return iter;
+}
+
+/* ========================================================================
+ * walk()
+ *
+ * An explicit stack of open directories replaces recursion.  Each frame
+ * holds its directory handle and its (dirpath, dirnames, filenames)
+ * result; top-down walks yield a frame when it is pushed and read
+ * dirnames afterwards, so callers may prune it in place, while bottom-up
+ * walks yield a frame when it is popped.
+ * ======================================================================== */
+
+typedef struct {
+    DIR *dir;
+    Py_ssize_t node_idx;
+    PyObject *result;     /* (dirpath, dirnames, filenames) */
+    Py_ssize_t next_dir;  /* Position in dirnames of the next directory to enter */
+} WalkFrame;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *allocator;
+    PyTypeObject *path_type;
+    PyObject *on_error;   /* Called with each OSError, or NULL to ignore errors */
+    Py_ssize_t top_idx;
+    int top_down;
+    int follow_symlinks;
+    int started;
+    WalkFrame *frames;
+    Py_ssize_t depth;
+    Py_ssize_t capacity;
+} WalkIterObject;
+
+/* Report an OSError for node_idx to on_error; returns 0 to skip the directory */
+static int
+walk_error(WalkIterObject *self, Py_ssize_t node_idx, int err)
+{
+    if (self->on_error == NULL)
+        return 0;
+
+    PyObject *path = PureFastPath_from_index(self->path_type, self->allocator, node_idx);
+    if (path == NULL)
+        return -1;
+    PyObject *str = PureFastPath_str((PureFastPathObject *)path);
+    Py_DECREF(path);
+    if (str == NULL)
+        return -1;
+
+    /* OSError picks the subclass matching the errno */
+    PyObject *exc = PyObject_CallFunction(PyExc_OSError, "isO", err, strerror(err), str);
+    Py_DECREF(str);
+    if (exc == NULL)
+        return -1;
+    PyObject *result = PyObject_CallOneArg(self->on_error, exc);
+    Py_DECREF(exc);
+    if (result == NULL)
+        return -1;
+    Py_DECREF(result);
+    return 0;
+}
+
+/* Open and list a directory and push its frame; returns 1 if pushed, 0 if
+ * skipped after an error, -1 with an exception set */
+static int
+walk_push(WalkIterObject *self, Py_ssize_t node_idx, int parent_fd, const char *path)
+{
+    DirListing listing = {0};
+    int err = 0;
+    DIR *dir;
+    Py_BEGIN_ALLOW_THREADS
+    dir = fs_open_dir(parent_fd, path, self->follow_symlinks, &err);
+    if (dir != NULL) {
+        err = dir_listing_read(dir, &listing, 1, self->follow_symlinks);
+        if (err != 0) {
+            closedir(dir);
+            dir = NULL;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (dir == NULL) {
+        dir_listing_free(&listing);
+        return walk_error(self, node_idx, err) < 0 ? -1 : 0;
+    }
+
+    PyObject *dirnames = PyList_New(0);
+    PyObject *filenames = PyList_New(0);
+    const char *name = listing.names;
+    for (Py_ssize_t i = 0; dirnames != NULL && filenames != NULL && i < listing.count; i++) {
+        PyObject *name_obj;
+        if (fs_entry_child(self->allocator, node_idx, name, &name_obj) < 0 ||
+            PyList_Append(listing.is_dir[i] ? dirnames : filenames, name_obj) < 0) {
+            Py_XDECREF(name_obj);
+            Py_CLEAR(dirnames);
+            break;
+        }
+        Py_DECREF(name_obj);
+        name += strlen(name) + 1;
+    }
+    dir_listing_free(&listing);
+
+    PyObject *dirpath = NULL;
+    if (dirnames != NULL && filenames != NULL)
+        dirpath = PureFastPath_from_index(self->path_type, self->allocator, node_idx);
+    PyObject *result = dirpath ? PyTuple_Pack(3, dirpath, dirnames, filenames) : NULL;
+    Py_XDECREF(dirpath);
+    Py_XDECREF(dirnames);
+    Py_XDECREF(filenames);
+
+    if (result != NULL && self->depth >= self->capacity) {
+        Py_ssize_t capacity = self->capacity ? self->capacity * 2 : 16;
+        WalkFrame *frames = PyMem_Realloc(self->frames, capacity * sizeof(WalkFrame));
+        if (frames == NULL) {
+            PyErr_NoMemory();
+            Py_CLEAR(result);
+        } else {
+            self->frames = frames;
+            self->capacity = capacity;
+        }
+    }
+    if (result == NULL) {
+        closedir(dir);
+        return -1;
+    }
+
+    WalkFrame *frame = &self->frames[self->depth++];
+    frame->dir = dir;
+    frame->node_idx = node_idx;
+    frame->result = result;
+    frame->next_dir = 0;
+    return 1;
+}
+
+static int
+walk_push_top(WalkIterObject *self)
+{
+    PyObject *path = PureFastPath_from_index(self->path_type, self->allocator, self->top_idx);
+    if (path == NULL)
+        return -1;
+    PyObject *str;
+    PyObject *encoded = fs_encoded_path((FastPathObject *)path, &str);
+    Py_DECREF(path);
+    if (encoded == NULL)
+        return -1;
+    Py_DECREF(str);
+
+    int status = walk_push(self, self->top_idx, -1, PyBytes_AS_STRING(encoded));
+    Py_DECREF(encoded);
+    return status;
+}
+
+/* Enter the next listed directory of the top frame */
+static int
+walk_push_child(WalkIterObject *self, PyObject *name_obj)
+{
+    WalkFrame *frame = &self->frames[self->depth - 1];
+    Py_ssize_t child_idx = fs_child_index(self->allocator, frame->node_idx, name_obj);
+    if (child_idx < 0)
+        return -1;
+    PyObject *encoded = PyUnicode_EncodeFSDefault(name_obj);
+    if (encoded == NULL)
+        return -1;
+
+    int status = walk_push(self, child_idx, dirfd(frame->dir), PyBytes_AS_STRING(encoded));
+    Py_DECREF(encoded);
+    return status;
+}
+
+static PyObject *
+walk_next_unlocked(WalkIterObject *self)
+{
+    if (!self->started) {
+        self->started = 1;
+        int status = walk_push_top(self);
+        if (status < 0)
+            return NULL;
+        if (status > 0 && self->top_down) {
+            Py_INCREF(self->frames[self->depth - 1].result);
+            return self->frames[self->depth - 1].result;
+        }
+    }
+
+    while (self->depth > 0) {
+        WalkFrame *frame = &self->frames[self->depth - 1];
+        PyObject *dirnames = PyTuple_GET_ITEM(frame->result, 1);
+        if (!PyList_Check(dirnames)) {
+            PyErr_SetString(PyExc_TypeError, "walk() dirnames must stay a list");
+            return NULL;
+        }
+
+        if (frame->next_dir < PyList_GET_SIZE(dirnames)) {
+            PyObject *name_obj = PyList_GET_ITEM(dirnames, frame->next_dir++);
+            Py_INCREF(name_obj);
+            int status = PyUnicode_Check(name_obj) ? walk_push_child(self, name_obj) : 0;
+            Py_DECREF(name_obj);
+            if (status < 0)
+                return NULL;
+            if (status > 0 && self->top_down) {
+                Py_INCREF(self->frames[self->depth - 1].result);
+                return self->frames[self->depth - 1].result;
+            }
+            continue;
+        }
+
+        PyObject *result = frame->result;
+        closedir(frame->dir);
+        self->depth--;
+        if (!self->top_down)
+            return result;
+        Py_DECREF(result);
+    }
+    return NULL;
+}
+
+static PyObject *
+WalkIter_next(WalkIterObject *self)
+{
+    PyObject *result;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    result = walk_next_unlocked(self);
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+/* Close the open directories and drop the frames' results */
+static void
+walk_clear_frames(WalkIterObject *self)
+{
+    while (self->depth > 0) {
+        WalkFrame *frame = &self->frames[--self->depth];
+        closedir(frame->dir);
+        Py_DECREF(frame->result);
+    }
+}
+
+/* on_error and the listed dirnames, which callers may edit, can lead back to the iterator */
+static int
+WalkIter_traverse(WalkIterObject *self, visitproc visit, void *arg)
+{
+    Py_VISIT(self->allocator);
+    Py_VISIT(self->path_type);
+    Py_VISIT(self->on_error);
+    for (Py_ssize_t i = 0; i < self->depth; i++)
+        Py_VISIT(self->frames[i].result);
+    return 0;
+}
+
+static int
+WalkIter_clear(WalkIterObject *self)
+{
+    Py_CLEAR(self->on_error);
+    walk_clear_frames(self);
+    return 0;
+}
+
+static void
+WalkIter_dealloc(WalkIterObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    walk_clear_frames(self);
+    PyMem_Free(self->frames);
+    Py_DECREF(self->allocator);
+    Py_DECREF(self->path_type);
+    Py_XDECREF(self->on_error);
+    PyObject_GC_Del(self);
+}
+
+PyTypeObject WalkIterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.WalkIterator",
+    .tp_doc = "Iterator over (dirpath, dirnames, filenames) below a directory",
+    .tp_basicsize = sizeof(WalkIterObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = (destructor)WalkIter_dealloc,
+    .tp_traverse = (traverseproc)WalkIter_traverse,
+    .tp_clear = (inquiry)WalkIter_clear,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc)WalkIter_next,
+};
+
+PyObject *
+FastPath_walk(FastPathObject *self, PyObject *args, PyObject *kwds)
+{
+    int top_down = 1, follow_symlinks = 0;
+    PyObject *on_error = Py_None;
+    static char *kwlist[] = {"top_down", "on_error", "follow_symlinks", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOp", kwlist, &top_down, &on_error, &follow_symlinks))
+        return NULL;
+
+    WalkIterObject *iter = PyObject_GC_New(WalkIterObject, &WalkIterType);
+    if (iter == NULL)
+        return NULL;
+    iter->allocator = ((PureFastPathObject *)self)->_allocator;
+    Py_INCREF(iter->allocator);
+    iter->path_type = Py_TYPE(self);
+    Py_INCREF(iter->path_type);
+    iter->on_error = on_error == Py_None ? NULL : on_error;
+    Py_XINCREF(iter->on_error);
+    iter->top_idx = ((PureFastPathObject *)self)->_node_idx;
+    iter->top_down = top_down;
+    iter->follow_symlinks = follow_symlinks;
+    iter->started = 0;
+    iter->frames = NULL;
+    iter->depth = 0;
+    iter->capacity = 0;
+    PyObject_GC_Track(iter);
+    return (PyObject *)iter;
+}
+
+/* ========================================================================
+ * glob()
+ *
+ * The compiled pattern drives the traversal.  A literal component costs
+ * one stat() of the child path; any other component lists the directory
+ * with the GIL released and tests each entry's interned name through the
+ * pattern's per-string memo.  As in pathlib, "**" only descends into real
+ * directories, not symlinks to them, and unreadable directories are
+ * skipped silently.
+ * ======================================================================== */
+
+/* stat() a node, following symlinks; returns 0, an errno, or -1 with an exception set */
+static int
+glob_stat(PathAllocatorObject *allocator, Py_ssize_t node_idx, struct stat *st)
+{
+    PyObject *encoded = PathAllocator_get_bytes(allocator, node_idx);
+    if (encoded == NULL)
+        return -1;
+    int err = 0;
+    Py_BEGIN_ALLOW_THREADS
+    if (stat(PyBytes_AS_STRING(encoded), st) != 0)
+        err = errno;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(encoded);
+    return err;
+}
+
+/* List a directory node, classifying entries; same returns as glob_stat() */
+static int
+glob_list(PathAllocatorObject *allocator, Py_ssize_t node_idx, int follow_symlinks, DirListing *listing)
+{
+    PyObject *encoded = PathAllocator_get_bytes(allocator, node_idx);
+    if (encoded == NULL)
+        return -1;
+    int err = 0;
+    Py_BEGIN_ALLOW_THREADS
+    DIR *dir = fs_open_dir(-1, PyBytes_AS_STRING(encoded), 1, &err);
+    if (dir != NULL) {
+        err = dir_listing_read(dir, listing, 1, follow_symlinks);
+        closedir(dir);
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(encoded);
+    return err;
+}
+
+/* Expand the state (node_idx, i) against the filesystem, pushing its successors */
+static int
+glob_fs_step(GlobPatternObject *pattern, IndexBuffer *stack, GlobSeen *seen, Py_ssize_t node_idx, Py_ssize_t i)
+{
+    PathAllocatorObject *allocator = pattern->allocator;
+    GlobComponent *component = &pattern->components[i];
+    /* Only the final component may match a non-directory, unless a
+     * trailing separator asks for directories there too */
+    int want_dir = i + 1 < pattern->count || pattern->dir_only;
+
+    if (component->kind == GLOB_LITERAL) {
+        Py_ssize_t child_idx = PathAllocator_add_child(allocator, node_idx, component->text, component->length);
+        if (child_idx < 0)
+            return -1;
+        struct stat st;
+        int err = glob_stat(allocator, child_idx, &st);
+        if (err < 0)
+            return -1;
+        if (err == 0 && (!want_dir || S_ISDIR(st.st_mode)))
+            return glob_push_state(pattern, stack, seen, child_idx, i + 1);
+        return 0;
+    }
+
+    int recursive = component->kind == GLOB_RECURSIVE;
+    DirListing listing = {0};
+    int status = glob_list(allocator, node_idx, !recursive, &listing);
+    if (status > 0)
+        status = 0;
+    else if (status == 0 && recursive)
+        status = glob_push_state(pattern, stack, seen, node_idx, i + 1);
+
+    const char *name = listing.names;
+    for (Py_ssize_t k = 0; status == 0 && k < listing.count; k++, name += strlen(name) + 1) {
+        if (recursive && !listing.is_dir[k])
+            continue;
+        Py_ssize_t child_idx = fs_entry_index((PyObject *)allocator, node_idx, name, strlen(name));
+        if (child_idx < 0) {
+            status = -1;
+            break;
+        }
+        if (recursive) {
+            status = glob_push_state(pattern, stack, seen, child_idx, i);
+            continue;
+        }
+        int matched;
+        Py_BEGIN_CRITICAL_SECTION2((PyObject *)pattern, (PyObject *)allocator->tree);
+        matched = glob_component_match(pattern, component, tree_name(allocator->tree, child_idx));
+        Py_END_CRITICAL_SECTION2();
+        if (matched < 0)
+            status = -1;
+        else if (matched && (!want_dir || listing.is_dir[k]))
+            status = glob_push_state(pattern, stack, seen, child_idx, i + 1);
+    }
+    dir_listing_free(&listing);
+    return status < 0 ? -1 : 0;
+}
+
+PyObject *
+FastPath_glob(FastPathObject *self, PyObject *pattern)
+{
+    PureFastPathObject *base = (PureFastPathObject *)self;
+    if (!Py_IS_TYPE(base->_allocator, &PathAllocatorType)) {
+        PyErr_SetString(PyExc_TypeError, "glob() needs a path created with a fastpath.PathAllocator");
+        return NULL;
+    }
+    GlobPatternObject *compiled = glob_pattern_compile((PathAllocatorObject *)base->_allocator, pattern);
+    if (compiled == NULL)
+        return NULL;
+    if (glob_pattern_check(compiled) < 0 || glob_pattern_prepare(compiled) < 0) {
+        Py_DECREF(compiled);
+        return NULL;
+    }
+
+    IndexBuffer stack = {NULL, 0, 0};
+    IndexBuffer found = {NULL, 0, 0};
+    GlobSeen seen = {NULL, 0, 0};
+    int status = glob_push_state(compiled, &stack, &seen, base->_node_idx, 0);
+    while (status >= 0 && stack.count > 0) {
+        Py_ssize_t i = (Py_ssize_t)stack.items[--stack.count];
+        Py_ssize_t node_idx = (Py_ssize_t)stack.items[--stack.count];
+        if (i == compiled->count)
+            status = index_buffer_append(&found, node_idx);
+        else
+            status = glob_fs_step(compiled, &stack, &seen, node_idx, i);
+    }
+    PyMem_Free(stack.items);
+    PyMem_Free(seen.slots);
+    Py_DECREF(compiled);
+
+    PyObject *paths = status < 0 ? NULL : PyList_New(found.count);
+    for (Py_ssize_t k = 0; paths != NULL && k < found.count; k++) {
+        PyObject *path = PureFastPath_from_index(Py_TYPE(self), base->_allocator, (Py_ssize_t)found.items[k]);
+        if (path == NULL)
+            Py_CLEAR(paths);
+        else
+            PyList_SET_ITEM(paths, k, path);
+    }
+    PyMem_Free(found.items);
+    if (paths == NULL)
+        return NULL;
+
+    PyObject *iter = PyObject_GetIter(paths);
+    Py_DECREF(paths);
+    return iter;
+}
+
+PyObject *
+FastPath_rglob(FastPathObject *self, PyObject *pattern)
+{
+    PyObject *recursive = glob_recursive_pattern(((PureFastPathObject *)self)->_allocator, pattern);
+    if (recursive == NULL)
+        return NULL;
+    PyObject *result = FastPath_glob(self, recursive);
+    Py_DECREF(recursive);
+    return result;
+}
+
+/* ========================================================================
+ * Parallel scan
+ *
+ * PathAllocator.scan() reads a directory tree on worker threads that never
+ * take the GIL.  Directories waiting to be read sit on a shared stack;
+ * each worker pops one, reads it, pushes the subdirectories it found and
+ * appends every entry to a batch of its own.  Full batches are handed to
+ * the calling thread, which holds the GIL only while merging a batch into
+ * the tree.  A directory's node is created the first time anything below
+ * it is merged, from the chain of names in its task, so batches from
+ * different workers can be merged in any order.
+ *
+ * Subdirectories are opened by their full path rather than relative to an
+ * open parent, so each worker holds at most one descriptor; entries are
+ * still classified with fstatat() on that descriptor.
+ * ======================================================================== */
+
+#define SCAN_BATCH_ENTRIES 4096
+#define SCAN_WAIT_NS 50000000  /* Longest the merging thread waits for a batch between signal checks */
+
+/* Directory to read */
+typedef struct ScanTask {
+    struct ScanTask *parent;    /* NULL for the root */
+    struct ScanTask *next;      /* Next task on the pending stack */
+    struct ScanTask *all_next;  /* Every task, to free them after the scan */
+    Py_ssize_t node_idx;        /* Merging thread only; -1 until created */
+    dev_t dev;                  /* Identity of the opened directory, for loop checks */
+    ino_t ino;
+    size_t name_length;
+    char name[];
+} ScanTask;
+
+typedef struct {
+    ScanTask *dir;              /* Directory holding the entry */
+    ScanTask *subdir;           /* Task for the entry when it is a directory to read */
+    size_t name_offset;
+    size_t name_length;
+    int64_t size;               /* stat=True only */
+    int64_t mtime_ns;
+    int64_t mode;
+} ScanEntry;
+
+/* Entries gathered by one worker */
+typedef struct ScanBatch {
+    struct ScanBatch *next;
+    ScanEntry entries[SCAN_BATCH_ENTRIES];
+    Py_ssize_t count;
+    char *names;
+    size_t names_used;
+    size_t names_capacity;
+} ScanBatch;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   /* Tasks pushed, or nothing left to do */
+    pthread_cond_t merge_cond;  /* Batch queued, or a worker exited */
+    ScanTask *stack;
+    ScanTask *all_tasks;
+    Py_ssize_t pending;         /* Tasks pushed and not yet finished */
+    ScanBatch *batches;         /* Full batches waiting to be merged */
+    int workers_running;
+    int cancelled;
+    int out_of_memory;
+    int root_errno;             /* Set if the root itself could not be opened */
+    const char *root_path;
+    int follow_symlinks;
+    int want_stat;
+} Scan;
+
+static ScanTask *
+scan_task_new(ScanTask *parent, const char *name, size_t length)
+{
+    ScanTask *task = PyMem_RawMalloc(sizeof(ScanTask) + length + 1);
+    if (task == NULL)
+        return NULL;
+    task->parent = parent;
+    task->next = NULL;
+    task->all_next = NULL;
+    task->node_idx = -1;
+    task->dev = 0;
+    task->ino = 0;
+    task->name_length = length;
+    memcpy(task->name, name, length);
+    task->name[length] = '\0';
+    return task;
+}
+
+static void
+scan_batch_free(ScanBatch *batch)
+{
+    PyMem_RawFree(batch->names);
+    PyMem_RawFree(batch);
+}
+
+static int
+scan_batch_append(ScanBatch *batch, const ScanEntry *entry, const char *name)
+{
+    if (batch->names_used + entry->name_length > batch->names_capacity) {
+        size_t capacity = batch->names_capacity ? batch->names_capacity : 64 * 1024;
+        while (capacity < batch->names_used + entry->name_length)
+            capacity *= 2;
+        char *names = PyMem_RawRealloc(batch->names, capacity);
+        if (names == NULL)
+            return -1;
+        batch->names = names;
+        batch->names_capacity = capacity;
+    }
+    ScanEntry *slot = &batch->entries[batch->count++];
+    *slot = *entry;
+    slot->name_offset = batch->names_used;
+    memcpy(batch->names + batch->names_used, name, entry->name_length);
+    batch->names_used += entry->name_length;
+    return 0;
+}
+
+/* Hand a batch to the merging thread */
+static void
+scan_queue_batch(Scan *scan, ScanBatch *batch)
+{
+    pthread_mutex_lock(&scan->lock);
+    batch->next = scan->batches;
+    scan->batches = batch;
+    pthread_cond_signal(&scan->merge_cond);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+/* Wait up to SCAN_WAIT_NS for a batch or a worker exit, without the GIL; takes
+ * the queued batches and returns how many workers are still running */
+static int
+scan_wait_batches(Scan *scan, ScanBatch **batches)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += SCAN_WAIT_NS;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&scan->lock);
+    while (scan->batches == NULL && scan->workers_running > 0) {
+        if (pthread_cond_timedwait(&scan->merge_cond, &scan->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    *batches = scan->batches;
+    scan->batches = NULL;
+    int running = scan->workers_running;
+    pthread_mutex_unlock(&scan->lock);
+    return running;
+}
+
+/* Stop the workers; callers hold scan->lock */
+static void
+scan_cancel_locked(Scan *scan)
+{
+    scan->cancelled = 1;
+    pthread_cond_broadcast(&scan->work_cond);
+}
+
+/* Full path of a task's directory, in a PyMem_RawMalloc buffer */
+static char *
+scan_task_path(Scan *scan, ScanTask *task)
+{
+    size_t root_length = strlen(scan->root_path);
+    if (root_length > 0 && scan->root_path[root_length - 1] == '/')
+        root_length--;
+    size_t length = root_length;
+    for (ScanTask *t = task; t->parent != NULL; t = t->parent)
+        length += t->name_length + 1;
+
+    char *path = PyMem_RawMalloc(length + 1);
+    if (path == NULL)
+        return NULL;
+    memcpy(path, scan->root_path, root_length);
+    path[length] = '\0';
+    size_t end = length;
+    for (ScanTask *t = task; t->parent != NULL; t = t->parent) {
+        end -= t->name_length;
+        memcpy(path + end, t->name, t->name_length);
+        path[--end] = '/';
+    }
+    return path;
+}
+
+/* Open a task's directory; NULL if it cannot be read or, when following
+ * symlinks, if it is one of its own ancestors */
+static DIR *
+scan_open(Scan *scan, ScanTask *task)
+{
+    DIR *dir;
+    int err;
+    if (task->parent == NULL) {
+        dir = fs_open_dir(-1, scan->root_path, 1, &err);
+        if (dir == NULL)
+            scan->root_errno = err;
+    } else {
+        char *path = scan_task_path(scan, task);
+        if (path == NULL)
+            return NULL;
+        int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (scan->follow_symlinks ? 0 : O_NOFOLLOW);
+        int fd = open(path, flags);
+        PyMem_RawFree(path);
+        dir = fd >= 0 ? fdopendir(fd) : NULL;
+        if (fd >= 0 && dir == NULL)
+            close(fd);
+    }
+    if (dir == NULL || !scan->follow_symlinks)
+        return dir;
+
+    struct stat st;
+    if (fstat(dirfd(dir), &st) < 0) {
+        closedir(dir);
+        return NULL;
+    }
+    task->dev = st.st_dev;
+    task->ino = st.st_ino;
+    for (ScanTask *t = task->parent; t != NULL; t = t->parent) {
+        if (t->dev == st.st_dev && t->ino == st.st_ino) {
+            closedir(dir);
+            return NULL;
+        }
+    }
+    return dir;
+}
+
+/* Read one directory into *batch and push its subdirectories */
+static void
+scan_directory(Scan *scan, ScanTask *task, ScanBatch **batch)
+{
+    ScanTask *children = NULL, *last_child = NULL;
+    Py_ssize_t child_count = 0;
+    int failed = 0;
+
+    DIR *dir = scan_open(scan, task);
+    if (dir != NULL) {
+        int fd = dirfd(dir);
+        for (;;) {
+            struct dirent *dirent = readdir(dir);
+            if (dirent == NULL)
+                break;
+            const char *name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            ScanEntry entry = {task, NULL, 0, strlen(name), -1, 0, 0};
+            int is_dir = 0, need_stat = 1;
+#ifdef HAVE_DIRENT_D_TYPE
+            if (!scan->want_stat && dirent->d_type != DT_UNKNOWN &&
+                !(dirent->d_type == DT_LNK && scan->follow_symlinks)) {
+                is_dir = dirent->d_type == DT_DIR;
+                need_stat = 0;
+            }
+#endif
+            struct stat st;
+            if (need_stat && fstatat(fd, name, &st, scan->follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0) {
+                is_dir = S_ISDIR(st.st_mode);
+                entry.size = st.st_size;
+                entry.mtime_ns = (int64_t)st.st_mtime * 1000000000 + FS_NSEC(&st, st_m);
+                entry.mode = st.st_mode;
+            }
+
+            if (is_dir) {
+                entry.subdir = scan_task_new(task, name, entry.name_length);
+                if (entry.subdir == NULL) {
+                    failed = 1;
+                    break;
+                }
+                if (last_child == NULL)
+                    last_child = entry.subdir;
+                entry.subdir->all_next = children;
+                children = entry.subdir;
+                child_count++;
+            }
+
+            if (*batch == NULL) {
+                *batch = PyMem_RawCalloc(1, sizeof(ScanBatch));
+                if (*batch == NULL) {
+                    failed = 1;
+                    break;
+                }
+            }
+            if (scan_batch_append(*batch, &entry, name) < 0) {
+                failed = 1;
+                break;
+            }
+            if ((*batch)->count == SCAN_BATCH_ENTRIES) {
+                scan_queue_batch(scan, *batch);
+                *batch = NULL;
+            }
+        }
+        closedir(dir);
+    }
+
+    pthread_mutex_lock(&scan->lock);
+    if (children != NULL) {
+        /* Every new task joins all_tasks; they are also pushed unless the
+         * scan is stopping */
+        last_child->all_next = scan->all_tasks;
+        scan->all_tasks = children;
+        if (!failed && !scan->cancelled) {
+            for (ScanTask *t = children; t != last_child; t = t->all_next)
+                t->next = t->all_next;
+            last_child->next = scan->stack;
+            scan->stack = children;
+            scan->pending += child_count;
+        }
+    }
+    if (failed) {
+        scan->out_of_memory = 1;
+        scan_cancel_locked(scan);
+    }
+    if (--scan->pending == 0 || child_count > 1)
+        pthread_cond_broadcast(&scan->work_cond);
+    else if (child_count == 1)
+        pthread_cond_signal(&scan->work_cond);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+static void *
+scan_worker(void *arg)
+{
+    Scan *scan = arg;
+    ScanBatch *batch = NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&scan->lock);
+        while (scan->stack == NULL && scan->pending > 0 && !scan->cancelled)
+            pthread_cond_wait(&scan->work_cond, &scan->lock);
+        ScanTask *task = scan->cancelled ? NULL : scan->stack;
+        if (task != NULL)
+            scan->stack = task->next;
+        pthread_mutex_unlock(&scan->lock);
+        if (task == NULL)
+            break;
+        scan_directory(scan, task, &batch);
+    }
+
+    pthread_mutex_lock(&scan->lock);
+    if (batch != NULL) {
+        batch->next = scan->batches;
+        scan->batches = batch;
+    }
+    scan->workers_running--;
+    pthread_cond_signal(&scan->merge_cond);
+    pthread_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+/* Node for a task's directory, creating it and any missing ancestors */
+static Py_ssize_t
+scan_task_node(PathAllocatorObject *allocator, ScanTask *task)
+{
+    if (task->node_idx >= 0)
+        return task->node_idx;
+    Py_ssize_t parent_idx = scan_task_node(allocator, task->parent);
+    if (parent_idx < 0)
+        return -1;
+    task->node_idx = fs_entry_index((PyObject *)allocator, parent_idx, task->name, task->name_length);
+    return task->node_idx;
+}
+
+/* Merge one batch into the tree, recording metadata in columns[] when set */
+static int
+scan_merge_batch(PathAllocatorObject *allocator, ScanBatch *batch, IndexBuffer *columns)
+{
+    for (Py_ssize_t i = 0; i < batch->count; i++) {
+        ScanEntry *entry = &batch->entries[i];
+        Py_ssize_t node_idx;
+        if (entry->subdir != NULL) {
+            node_idx = scan_task_node(allocator, entry->subdir);
+        } else {
+            Py_ssize_t parent_idx = scan_task_node(allocator, entry->dir);
+            node_idx = parent_idx < 0 ? -1 :
+                fs_entry_index((PyObject *)allocator, parent_idx, batch->names + entry->name_offset,
+                               entry->name_length);
+        }
+        if (node_idx < 0)
+            return -1;
+
+        if (columns != NULL &&
+            (index_buffer_append(&columns[0], node_idx) < 0 || index_buffer_append(&columns[1], entry->size) < 0 ||
+             index_buffer_append(&columns[2], entry->mtime_ns) < 0 ||
+             index_buffer_append(&columns[3], entry->mode) < 0))
+            return -1;
+    }
+    return 0;
+}
+
+static const char *scan_column_names[] = {"node", "size", "mtime_ns", "mode"};
+
+/* {"node": ..., "size": ..., "mtime_ns": ..., "mode": ...} as array('q') columns */
+static PyObject *
+scan_columns_dict(IndexBuffer *columns)
+{
+    PyObject *dict = PyDict_New();
+    for (int i = 0; dict != NULL && i < 4; i++) {
+        PyObject *column = fastpath_index_array(columns[i].items, columns[i].count);
+        if (column == NULL || PyDict_SetItemString(dict, scan_column_names[i], column) < 0)
+            Py_CLEAR(dict);
+        Py_XDECREF(column);
+    }
+    return dict;
+}
+
+PyObject *
+PathAllocator_scan(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *root;
+    int threads = 0, follow_symlinks = 0, want_stat = 0;
+    static char *kwlist[] = {"root", "threads", "follow_symlinks", "stat", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|ipp", kwlist, PyUnicode_FSDecoder, &root, &threads,
+                                     &follow_symlinks, &want_stat))
+        return NULL;
+
+    if (threads < 0) {
+        Py_DECREF(root);
+        PyErr_SetString(PyExc_ValueError, "threads must be non-negative");
+        return NULL;
+    }
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)(cpus < 64 ? cpus : 64) : 1;
+    }
+
+    PyObject *owned;
+    Py_ssize_t root_length;
+    const char *root_data = path_argument_bytes(root, &root_length, &owned);
+    Py_ssize_t root_idx = -1;
+    if (root_data != NULL)
+        root_idx = PathAllocator_walk(self, self->tree->relative_root, root_data, root_length);
+    Py_XDECREF(owned);
+    PyObject *root_bytes = root_idx < 0 ? NULL : PyUnicode_EncodeFSDefault(root);
+    if (root_bytes == NULL) {
+        Py_DECREF(root);
+        return NULL;
+    }
+
+    Scan scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.root_path = PyBytes_AS_STRING(root_bytes);
+    scan.follow_symlinks = follow_symlinks;
+    scan.want_stat = want_stat;
+
+    ScanTask *root_task = scan_task_new(NULL, "", 0);
+    pthread_t *workers = PyMem_Malloc(threads * sizeof(pthread_t));
+    if (root_task == NULL || workers == NULL) {
+        PyMem_RawFree(root_task);
+        PyMem_Free(workers);
+        Py_DECREF(root_bytes);
+        Py_DECREF(root);
+        return PyErr_NoMemory();
+    }
+    root_task->node_idx = root_idx;
+    scan.stack = root_task;
+    scan.all_tasks = root_task;
+    scan.pending = 1;
+    pthread_mutex_init(&scan.lock, NULL);
+    pthread_cond_init(&scan.work_cond, NULL);
+    pthread_cond_init(&scan.merge_cond, NULL);
+
+    int started = 0;
+    scan.workers_running = threads;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, scan_worker, &scan) != 0)
+            break;
+    }
+    pthread_mutex_lock(&scan.lock);
+    scan.workers_running -= threads - started;
+    pthread_mutex_unlock(&scan.lock);
+
+    IndexBuffer columns[4] = {{NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0}};
+    int failed = 0;
+    if (started == 0) {
+        PyErr_SetString(PyExc_RuntimeError, "can't start scan threads");
+        failed = 1;
+    }
+
+    /* Merge batches as they arrive until every worker has exited, checking
+     * for signals at least every SCAN_WAIT_NS; after a failure keep draining
+     * and freeing batches so the workers can finish */
+    for (;;) {
+        ScanBatch *batches;
+        int running;
+        Py_BEGIN_ALLOW_THREADS
+        running = scan_wait_batches(&scan, &batches);
+        Py_END_ALLOW_THREADS
+
+        while (batches != NULL) {
+            ScanBatch *next = batches->next;
+            if (!failed && scan_merge_batch(self, batches, want_stat ? columns : NULL) < 0)
+                failed = 1;
+            scan_batch_free(batches);
+            batches = next;
+        }
+        if (!failed && PyErr_CheckSignals() < 0)
+            failed = 1;
+        if (failed) {
+            pthread_mutex_lock(&scan.lock);
+            scan_cancel_locked(&scan);
+            pthread_mutex_unlock(&scan.lock);
+        }
+        if (running == 0)
+            break;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    Py_END_ALLOW_THREADS
+
+    int out_of_memory = scan.out_of_memory;
+    int root_errno = scan.root_errno;
+    while (scan.all_tasks != NULL) {
+        ScanTask *next = scan.all_tasks->all_next;
+        PyMem_RawFree(scan.all_tasks);
+        scan.all_tasks = next;
+    }
+    pthread_cond_destroy(&scan.merge_cond);
+    pthread_cond_destroy(&scan.work_cond);
+    pthread_mutex_destroy(&scan.lock);
+    PyMem_Free(workers);
+    Py_DECREF(root_bytes);
+
+    PyObject *result = NULL;
+    if (failed) {
+        /* Exception already set */
+    } else if (root_errno != 0) {
+        errno = root_errno;
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, root);
+    } else if (out_of_memory) {
+        PyErr_NoMemory();
+    } else if (!want_stat) {
+        result = PyLong_FromSsize_t(root_idx);
+    } else {
+        PyObject *dict = scan_columns_dict(columns);
+        if (dict != NULL)
+            result = Py_BuildValue("nN", root_idx, dict);
+    }
+    Py_DECREF(root);
+    for (int i = 0; i < 4; i++)
+        PyMem_Free(columns[i].items);
+    return result;
+}
+
+#else /* MS_WINDOWS */
+
+/* Call os.<name>(str(self), *args) */
+static PyObject *
+fs_call_os(FastPathObject *self, const char *name, PyObject *kwds)
+{
+    PyObject *str = PureFastPath_str((PureFastPathObject *)self);
+    if (str == NULL)
+        return NULL;
+    PyObject *os = PyImport_ImportModule("os");
+    PyObject *func = os ? PyObject_GetAttrString(os, name) : NULL;
+    Py_XDECREF(os);
+    PyObject *args = func ? PyTuple_Pack(1, str) : NULL;
+    PyObject *result = args ? PyObject_Call(func, args, kwds) : NULL;
+    Py_XDECREF(args);
+    Py_XDECREF(func);
+    Py_DECREF(str);
+    return result;
+}
+
+static PyObject *
+fs_test_mode(FastPathObject *self, int type)
+{
+    PyObject *st = fs_call_os(self, "stat", NULL);
+    if (st == NULL) {
+        if (PyErr_ExceptionMatches(PyExc_FileNotFoundError) || PyErr_ExceptionMatches(PyExc_NotADirectoryError) ||
+            PyErr_ExceptionMatches(PyExc_ValueError)) {
+            PyErr_Clear();
+            Py_RETURN_FALSE;
+        }
+        return NULL;
+    }
+    PyObject *mode = PyObject_GetAttrString(st, "st_mode");
+    Py_DECREF(st);
+    if (mode == NULL)
+        return NULL;
+    long value = PyLong_AsLong(mode);
+    Py_DECREF(mode);
+    if (value == -1 && PyErr_Occurred())
+        return NULL;
+    return PyBool_FromLong(type == 0 || (value & 0170000) == type);
+}
+
+PyObject *
+FastPath_stat(FastPathObject *self, PyObject *args, PyObject *kwds)
+{
+    if (!PyArg_ParseTuple(args, ""))
+        return NULL;
+    return fs_call_os(self, "stat", kwds);
+}
+
+PyObject *
+FastPath_lstat(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_call_os(self, "lstat", NULL);
+}
+
+PyObject *
+FastPath_exists(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, 0);
+}
+
+PyObject *
+FastPath_is_file(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, 0100000);
+}
+
+PyObject *
+FastPath_is_dir(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return fs_test_mode(self, 0040000);
+}
+
+PyObject *
+FastPath_iterdir(FastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PureFastPathObject *base = (PureFastPathObject *)self;
+    PyObject *names = fs_call_os(self, "listdir", NULL);
+    if (names == NULL)
+        return NULL;
+
+    PyObject *children = PyList_New(PyList_GET_SIZE(names));
+    for (Py_ssize_t i = 0; children != NULL && i < PyList_GET_SIZE(names); i++) {
+        Py_ssize_t child_idx = fs_child_index(base->_allocator, base->_node_idx, PyList_GET_ITEM(names, i));
+        PyObject *child = child_idx < 0 ? NULL : PureFastPath_from_index(Py_TYPE(self), base->_allocator, child_idx);
+        if (child == NULL) {
+            Py_CLEAR(children);
+            break;
+        }
+        PyList_SET_ITEM(children, i, child);
+    }
+    Py_DECREF(names);
+    if (children == NULL)
+        return NULL;
+
+    PyObject *iter = PyObject_GetIter(children);
+    Py_DECREF(children);
+    return iter;
+}
+
+PyObject *
+FastPath_walk(FastPathObject *self, PyObject *args, PyObject *kwds)
+{
+    PyErr_SetString(PyExc_NotImplementedError, "walk() is not supported on Windows yet");
+    return NULL;
+}
+
+PyObject *
+PathAllocator_scan(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyErr_SetString(PyExc_NotImplementedError, "scan() is not supported on Windows yet");
+    return NULL;
+}
+
+PyObject *
+FastPath_glob(FastPathObject *self, PyObject *pattern)
+{
+    PyErr_SetString(PyExc_NotImplementedError, "glob() is not supported on Windows yet");
+    return NULL;
+}
+
+PyObject *
+FastPath_rglob(FastPathObject *self, PyObject *pattern)
+{
+    PyErr_SetString(PyExc_NotImplementedError, "rglob() is not supported on Windows yet");
+    return NULL;
+}
+
+#endif /* MS_WINDOWS */
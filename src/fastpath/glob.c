@@ -0,0 +1,625 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Glob patterns
+ *
+ * A pattern is compiled once per allocator into a list of components.
+ * Literal components are resolved to string IDs, so matching them against
+ * a node is an integer compare and, while globbing, a single child index
+ * probe.  Wildcard components are matched with fnmatch rules on the
+ * pooled UTF-8 bytes of a name, and the result is memoized per string ID,
+ * so each distinct name is tested at most once per component however
+ * many nodes carry it.  Globbing runs the components as an automaton over
+ * (node, component) states from the base node, so subtrees that cannot
+ * match are never visited.  compact() renumbers string IDs; patterns
+ * notice through the allocator's generation and drop what they resolved.
+ * On allocators that fold case the pattern is lowercased and every named
+ * component is matched as a wildcard, since a literal's string ID only
+ * finds one spelling of the name.
+ * ======================================================================== */
+
+/* Decode the code point at *pos and advance past it; stray bytes decode as themselves */
+static Py_UCS4
+glob_next_char(const char *text, Py_ssize_t length, Py_ssize_t *pos)
+{
+    const unsigned char *s = (const unsigned char *)text;
+    Py_ssize_t i = *pos;
+    Py_UCS4 ch = s[i];
+    int extra = ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : ch >= 0xC0 ? 1 : 0;
+    if (extra == 0 || i + extra >= length) {
+        *pos = i + 1;
+        return ch;
+    }
+    ch &= 0x3F >> extra;
+    for (int k = 1; k <= extra; k++) {
+        if ((s[i + k] & 0xC0) != 0x80) {
+            *pos = i + 1;
+            return s[i];
+        }
+        ch = (ch << 6) | (s[i + k] & 0x3F);
+    }
+    *pos = i + 1 + extra;
+    return ch;
+}
+
+/* Match ch against the set starting just after "[" at *pos and move past
+ * the closing "]"; returns -1 if the set is unterminated, in which case
+ * the "[" is an ordinary character */
+static int
+glob_match_set(const char *pat, Py_ssize_t length, Py_ssize_t *pos, Py_UCS4 ch)
+{
+    Py_ssize_t i = *pos;
+    int negate = i < length && pat[i] == '!';
+    if (negate)
+        i++;
+
+    int matched = 0;
+    /* A "]" right after the opening bracket is part of the set */
+    for (int first = 1; i < length && (first || pat[i] != ']'); first = 0) {
+        Py_UCS4 lo = glob_next_char(pat, length, &i);
+        Py_UCS4 hi = lo;
+        if (i + 1 < length && pat[i] == '-' && pat[i + 1] != ']') {
+            i++;
+            hi = glob_next_char(pat, length, &i);
+        }
+        if (lo <= ch && ch <= hi)
+            matched = 1;
+    }
+    if (i >= length)
+        return -1;
+    *pos = i + 1;
+    return matched != negate;
+}
+
+/* fnmatch of one name against one component, case-sensitive unless fold
+ * is set, in which case the pattern must already be lowercase */
+static int
+glob_fnmatch(const char *pat, Py_ssize_t pat_length, const char *name, Py_ssize_t name_length, int fold)
+{
+    Py_ssize_t p = 0, n = 0;
+    Py_ssize_t star_p = -1, star_n = 0;  /* Resume point after the last "*" */
+    while (n < name_length) {
+        int advanced = 0;
+        if (p < pat_length) {
+            if (pat[p] == '*') {
+                star_p = ++p;
+                star_n = n;
+                continue;
+            }
+            Py_ssize_t next_n = n;
+            Py_UCS4 ch = glob_next_char(name, name_length, &next_n);
+            if (fold && ch >= 'A' && ch <= 'Z')
+                ch += 'a' - 'A';
+            Py_ssize_t next_p = p + 1;
+            int result = -1;
+            if (pat[p] == '?')
+                result = 1;
+            else if (pat[p] == '[')
+                result = glob_match_set(pat, pat_length, &next_p, ch);
+            if (result < 0) {
+                next_p = p;
+                result = glob_next_char(pat, pat_length, &next_p) == ch;
+            }
+            if (result) {
+                p = next_p;
+                n = next_n;
+                advanced = 1;
+            }
+        }
+        if (!advanced) {
+            /* Let the last "*" swallow one more character and retry */
+            if (star_p < 0)
+                return 0;
+            glob_next_char(name, name_length, &star_n);
+            p = star_p;
+            n = star_n;
+        }
+    }
+    while (p < pat_length && pat[p] == '*')
+        p++;
+    return p == pat_length;
+}
+
+/* Whether "**" occurs inside a component */
+static int
+glob_has_double_star(const char *text, Py_ssize_t length)
+{
+    for (Py_ssize_t i = 0; i + 1 < length; i++) {
+        if (text[i] == '*' && text[i + 1] == '*')
+            return 1;
+    }
+    return 0;
+}
+
+static int
+glob_component_kind(const char *text, Py_ssize_t length)
+{
+    if (length == 2 && text[0] == '*' && text[1] == '*')
+        return GLOB_RECURSIVE;
+    if (length == 1 && text[0] == '*')
+        return GLOB_ANY;
+    for (Py_ssize_t i = 0; i < length; i++) {
+        if (text[i] == '*' || text[i] == '?' || text[i] == '[')
+            return GLOB_WILDCARD;
+    }
+    return GLOB_LITERAL;
+}
+
+GlobPatternObject *
+glob_pattern_compile(PathAllocatorObject *allocator, PyObject *pattern)
+{
+    if (!PyUnicode_Check(pattern)) {
+        PyErr_Format(PyExc_TypeError, "pattern must be str, not %.200s", Py_TYPE(pattern)->tp_name);
+        return NULL;
+    }
+    Py_ssize_t length;
+    const char *data = PyUnicode_AsUTF8AndSize(pattern, &length);
+    if (data == NULL)
+        return NULL;
+
+    GlobPatternObject *self = PyObject_New(GlobPatternObject, &GlobPatternType);
+    if (self == NULL)
+        return NULL;
+    Py_INCREF(allocator);
+    self->allocator = allocator;
+    Py_INCREF(pattern);
+    self->pattern = pattern;
+    self->text = PyMem_Malloc(length + 1);
+    /* At most one component per separator, plus one */
+    self->components = PyMem_Calloc(length / 2 + 1, sizeof(GlobComponent));
+    self->count = 0;
+    self->recursive_count = 0;
+    self->generation = allocator->generation;
+    if (self->text == NULL || self->components == NULL) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memcpy(self->text, data, length + 1);
+
+    const char sep = allocator->separator[0];
+    const char altsep = allocator->flavour->altsep;
+    for (Py_ssize_t i = 0; altsep != '\0' && i < length; i++) {
+        if (self->text[i] == altsep)
+            self->text[i] = sep;
+    }
+    self->fold_case = allocator->tree->fold_case;
+    for (Py_ssize_t i = 0; self->fold_case && i < length; i++) {
+        if (self->text[i] >= 'A' && self->text[i] <= 'Z')
+            self->text[i] += 'a' - 'A';
+    }
+    self->anchored = length > 0 && self->text[0] == sep;
+    self->dir_only = length > 0 && self->text[length - 1] == sep;
+    ByteScanner separators;
+    byte_scanner_init(&separators, self->text, length, sep);
+    Py_ssize_t end;
+    for (Py_ssize_t start = 0; start < length; start = end + 1) {
+        end = byte_scanner_next(&separators);
+        /* Empty and "." components name the directory itself */
+        if (end == start || (end == start + 1 && self->text[start] == '.'))
+            continue;
+
+        GlobComponent *component = &self->components[self->count++];
+        component->text = self->text + start;
+        component->length = end - start;
+        component->kind = glob_component_kind(component->text, component->length);
+        if (component->kind == GLOB_LITERAL && self->fold_case)
+            component->kind = GLOB_WILDCARD;
+        component->name_id = -1;
+        if (component->kind == GLOB_RECURSIVE)
+            self->recursive_count++;
+    }
+    return self;
+}
+
+/* Resolve literal names to string IDs, after a compaction too */
+int
+glob_pattern_prepare(GlobPatternObject *self)
+{
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    if (self->generation != self->allocator->generation) {
+        for (Py_ssize_t i = 0; i < self->count; i++) {
+            GlobComponent *component = &self->components[i];
+            component->name_id = -1;
+            if (component->memo != NULL)
+                memset(component->memo, 0, component->memo_size);
+        }
+        self->generation = self->allocator->generation;
+    }
+    for (Py_ssize_t i = 0; i < self->count; i++) {
+        GlobComponent *component = &self->components[i];
+        /* A name that is not interned yet may have been added since */
+        if (component->kind == GLOB_LITERAL && component->name_id < 0) {
+            component->name_id = StringPool_lookup_bytes(self->allocator->string_pool, component->text,
+                                                         component->length);
+            if (component->name_id < 0 && PyErr_Occurred()) {
+                status = -1;
+                break;
+            }
+        }
+    }
+    Py_END_CRITICAL_SECTION();
+    return status;
+}
+
+/* Whether the name with string ID name_id matches one component; the
+ * caller holds the pattern's and the tree's critical sections */
+int
+glob_component_match(GlobPatternObject *self, GlobComponent *component, Py_ssize_t name_id)
+{
+    switch (component->kind) {
+    case GLOB_LITERAL:
+        return name_id == component->name_id;
+    case GLOB_ANY:
+    case GLOB_RECURSIVE:
+        return 1;
+    }
+
+    if (name_id >= component->memo_size) {
+        Py_ssize_t size = component->memo_size ? component->memo_size : 256;
+        while (size <= name_id)
+            size *= 2;
+        unsigned char *memo = PyMem_Realloc(component->memo, size);
+        if (memo == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        memset(memo + component->memo_size, 0, size - component->memo_size);
+        component->memo = memo;
+        component->memo_size = size;
+    }
+    if (component->memo[name_id] == 0) {
+        StringPoolObject *pool = self->allocator->string_pool;
+        const StringEntry *entry = string_entry(pool, name_id);
+        int result = glob_fnmatch(component->text, component->length, string_entry_data(pool, entry),
+                                  (Py_ssize_t)entry->length, self->fold_case);
+        component->memo[name_id] = (unsigned char)(1 + result);
+    }
+    return component->memo[name_id] - 1;
+}
+
+/* Add key to seen; returns 1 if it was new, 0 if present, -1 on error */
+static int
+glob_seen_add(GlobSeen *seen, int64_t key)
+{
+    if ((seen->count + 1) * 2 > seen->capacity) {
+        Py_ssize_t capacity = seen->capacity ? seen->capacity * 2 : 256;
+        int64_t *slots = PyMem_Malloc(capacity * sizeof(int64_t));
+        if (slots == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (Py_ssize_t i = 0; i < capacity; i++)
+            slots[i] = -1;
+        for (Py_ssize_t i = 0; i < seen->capacity; i++) {
+            if (seen->slots[i] < 0)
+                continue;
+            size_t slot = (size_t)(((uint64_t)seen->slots[i] * 0x9E3779B97F4A7C15ULL) >> 16) & (capacity - 1);
+            while (slots[slot] >= 0)
+                slot = (slot + 1) & (capacity - 1);
+            slots[slot] = seen->slots[i];
+        }
+        PyMem_Free(seen->slots);
+        seen->slots = slots;
+        seen->capacity = capacity;
+    }
+
+    size_t mask = (size_t)seen->capacity - 1;
+    size_t slot = (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 16) & mask;
+    while (seen->slots[slot] >= 0) {
+        if (seen->slots[slot] == key)
+            return 0;
+        slot = (slot + 1) & mask;
+    }
+    seen->slots[slot] = key;
+    seen->count++;
+    return 1;
+}
+
+/* Push a (node, component) state, skipping repeats when several "**"
+ * components can reach the same state along different routes */
+int
+glob_push_state(GlobPatternObject *self, IndexBuffer *stack, GlobSeen *seen, Py_ssize_t node_idx, Py_ssize_t i)
+{
+    if (self->recursive_count > 1) {
+        int added = glob_seen_add(seen, (int64_t)node_idx * (self->count + 1) + i);
+        if (added <= 0)
+            return added;
+    }
+    if (index_buffer_append(stack, node_idx) < 0 || index_buffer_append(stack, i) < 0)
+        return -1;
+    return 0;
+}
+
+static int
+glob_tree_unlocked(GlobPatternObject *self, TreeAllocatorObject *tree, Py_ssize_t base_idx, IndexBuffer *out)
+{
+    IndexBuffer stack = {NULL, 0, 0};
+    GlobSeen seen = {NULL, 0, 0};
+    int status = glob_push_state(self, &stack, &seen, base_idx, 0);
+    while (status >= 0 && stack.count > 0) {
+        Py_ssize_t i = (Py_ssize_t)stack.items[--stack.count];
+        Py_ssize_t node_idx = (Py_ssize_t)stack.items[--stack.count];
+        if (i == self->count) {
+            status = index_buffer_append(out, node_idx);
+            continue;
+        }
+
+        GlobComponent *component = &self->components[i];
+        if (component->kind == GLOB_LITERAL) {
+            Py_ssize_t child_idx = component->name_id < 0 ? -1 : tree_lookup_child(tree, node_idx, component->name_id);
+            if (child_idx >= 0)
+                status = glob_push_state(self, &stack, &seen, child_idx, i + 1);
+            continue;
+        }
+
+        if (component->kind == GLOB_RECURSIVE)
+            status = glob_push_state(self, &stack, &seen, node_idx, i + 1);
+        for (Py_ssize_t child_idx = tree_first_child(tree, node_idx); status >= 0 && child_idx >= 0;
+             child_idx = tree_next_sibling(tree, child_idx)) {
+            if (component->kind == GLOB_RECURSIVE) {
+                status = glob_push_state(self, &stack, &seen, child_idx, i);
+                continue;
+            }
+            int matched = glob_component_match(self, component, tree_name(tree, child_idx));
+            if (matched < 0)
+                status = -1;
+            else if (matched)
+                status = glob_push_state(self, &stack, &seen, child_idx, i + 1);
+        }
+    }
+    PyMem_Free(stack.items);
+    PyMem_Free(seen.slots);
+    return status < 0 ? -1 : 0;
+}
+
+/* Check that a pattern can be used with glob(), as pathlib does */
+int
+glob_pattern_check(GlobPatternObject *self)
+{
+    if (self->anchored) {
+        PyErr_SetString(PyExc_NotImplementedError, "Non-relative patterns are unsupported");
+        return -1;
+    }
+    if (self->count == 0) {
+        PyErr_Format(PyExc_ValueError, "Unacceptable pattern: %R", self->pattern);
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < self->count; i++) {
+        const GlobComponent *component = &self->components[i];
+        if (component->kind == GLOB_WILDCARD && glob_has_double_star(component->text, component->length)) {
+            PyErr_SetString(PyExc_ValueError, "Invalid pattern: '**' can only be an entire path component");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Nodes at or below base_idx that match, as array('q') */
+PyObject *
+glob_pattern_tree(GlobPatternObject *self, Py_ssize_t base_idx)
+{
+    if (glob_pattern_check(self) < 0 || glob_pattern_prepare(self) < 0)
+        return NULL;
+
+    TreeAllocatorObject *tree = self->allocator->tree;
+    IndexBuffer out = {NULL, 0, 0};
+    int status;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self, (PyObject *)tree);
+    status = tree_valid_index(tree, base_idx) ? glob_tree_unlocked(self, tree, base_idx, &out) : -1;
+    Py_END_CRITICAL_SECTION2();
+
+    PyObject *result = status < 0 ? NULL : fastpath_index_array(out.items, out.count);
+    PyMem_Free(out.items);
+    return result;
+}
+
+/* PurePath.match(): components are compared from the right, and an
+ * anchored pattern must cover the whole path; the caller holds the locks */
+static int
+glob_match_unlocked(GlobPatternObject *self, TreeAllocatorObject *tree, Py_ssize_t node_idx)
+{
+    for (Py_ssize_t i = self->count - 1; i >= 0; i--) {
+        Py_ssize_t parent_idx = tree_parent(tree, node_idx);
+        if (parent_idx < 0)
+            return 0;
+        int matched = glob_component_match(self, &self->components[i], tree_name(tree, node_idx));
+        if (matched <= 0)
+            return matched;
+        node_idx = parent_idx;
+    }
+    return !self->anchored || node_idx == tree->absolute_root;
+}
+
+int
+glob_pattern_match(GlobPatternObject *self, Py_ssize_t node_idx)
+{
+    if (self->count == 0 && !self->anchored) {
+        PyErr_SetString(PyExc_ValueError, "empty pattern");
+        return -1;
+    }
+    if (glob_pattern_prepare(self) < 0)
+        return -1;
+
+    TreeAllocatorObject *tree = self->allocator->tree;
+    int result;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self, (PyObject *)tree);
+    result = tree_valid_index(tree, node_idx) ? glob_match_unlocked(self, tree, node_idx) : -1;
+    Py_END_CRITICAL_SECTION2();
+    return result;
+}
+
+/* The pattern rglob() uses: pattern below "**" */
+PyObject *
+glob_recursive_pattern(PyObject *allocator, PyObject *pattern)
+{
+    if (!PyUnicode_Check(pattern)) {
+        PyErr_Format(PyExc_TypeError, "pattern must be str, not %.200s", Py_TYPE(pattern)->tp_name);
+        return NULL;
+    }
+    const char *sep = Py_IS_TYPE(allocator, &PathAllocatorType) ? ((PathAllocatorObject *)allocator)->separator : "/";
+    return PyUnicode_FromFormat("**%s%U", sep, pattern);
+}
+
+/* ========================================================================
+ * GlobPattern type
+ * ======================================================================== */
+
+static void
+GlobPattern_dealloc(GlobPatternObject *self)
+{
+    if (self->components != NULL) {
+        for (Py_ssize_t i = 0; i < self->count; i++)
+            PyMem_Free(self->components[i].memo);
+        PyMem_Free(self->components);
+    }
+    PyMem_Free(self->text);
+    Py_XDECREF(self->pattern);
+    Py_XDECREF(self->allocator);
+    PyObject_Free(self);
+}
+
+static PyObject *
+GlobPattern_repr(GlobPatternObject *self)
+{
+    return PyUnicode_FromFormat("GlobPattern(%R)", self->pattern);
+}
+
+static PyObject *
+GlobPattern_glob(GlobPatternObject *self, PyObject *args)
+{
+    Py_ssize_t base_idx;
+    if (!PyArg_ParseTuple(args, "n", &base_idx))
+        return NULL;
+    return glob_pattern_tree(self, base_idx);
+}
+
+static PyObject *
+GlobPattern_match(GlobPatternObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "n", &node_idx))
+        return NULL;
+    int result = glob_pattern_match(self, node_idx);
+    if (result < 0)
+        return NULL;
+    return PyBool_FromLong(result);
+}
+
+static PyObject *
+GlobPattern_filter(GlobPatternObject *self, PyObject *nodes)
+{
+    if (self->count == 0 && !self->anchored) {
+        PyErr_SetString(PyExc_ValueError, "empty pattern");
+        return NULL;
+    }
+    IndexBuffer indices = {NULL, 0, 0};
+    if (index_buffer_collect(nodes, &indices) < 0 || glob_pattern_prepare(self) < 0) {
+        PyMem_Free(indices.items);
+        return NULL;
+    }
+
+    /* Matches are compacted to the front of indices in place */
+    TreeAllocatorObject *tree = self->allocator->tree;
+    Py_ssize_t kept = 0;
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self, (PyObject *)tree);
+    for (Py_ssize_t i = 0; i < indices.count; i++) {
+        Py_ssize_t node_idx = (Py_ssize_t)indices.items[i];
+        int matched = tree_valid_index(tree, node_idx) ? glob_match_unlocked(self, tree, node_idx) : -1;
+        if (matched < 0) {
+            status = -1;
+            break;
+        }
+        if (matched)
+            indices.items[kept++] = node_idx;
+    }
+    Py_END_CRITICAL_SECTION2();
+
+    PyObject *result = status < 0 ? NULL : fastpath_index_array(indices.items, kept);
+    PyMem_Free(indices.items);
+    return result;
+}
+
+static PyObject *
+GlobPattern_get_pattern(GlobPatternObject *self, void *closure)
+{
+    Py_INCREF(self->pattern);
+    return self->pattern;
+}
+
+static PyMethodDef GlobPattern_methods[] = {
+    {"glob", (PyCFunction)GlobPattern_glob, METH_VARARGS,
+     "Get the known nodes at or below a node that match, as an array of indices"},
+    {"match", (PyCFunction)GlobPattern_match, METH_VARARGS,
+     "Check whether a node matches, with the rules of PurePath.match"},
+    {"filter", (PyCFunction)GlobPattern_filter, METH_O,
+     "Get the nodes of a sequence or buffer of indices that match, as an array"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef GlobPattern_getset[] = {
+    {"pattern", (getter)GlobPattern_get_pattern, NULL, "Source pattern", NULL},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject GlobPatternType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.GlobPattern",
+    .tp_doc = "Glob pattern compiled against the strings of one allocator",
+    .tp_basicsize = sizeof(GlobPatternObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)GlobPattern_dealloc,
+    .tp_repr = (reprfunc)GlobPattern_repr,
+    .tp_methods = GlobPattern_methods,
+    .tp_getset = GlobPattern_getset,
+};
+
+/* ========================================================================
+ * PathAllocator glob methods
+ * ======================================================================== */
+
+PyObject *
+PathAllocator_compile_glob(PathAllocatorObject *self, PyObject *args)
+{
+    PyObject *pattern;
+    if (!PyArg_ParseTuple(args, "U", &pattern))
+        return NULL;
+    return (PyObject *)glob_pattern_compile(self, pattern);
+}
+
+PyObject *
+PathAllocator_glob(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t base_idx;
+    PyObject *pattern;
+    if (!PyArg_ParseTuple(args, "nU", &base_idx, &pattern))
+        return NULL;
+
+    GlobPatternObject *compiled = glob_pattern_compile(self, pattern);
+    if (compiled == NULL)
+        return NULL;
+    PyObject *result = glob_pattern_tree(compiled, base_idx);
+    Py_DECREF(compiled);
+    return result;
+}
+
+PyObject *
+PathAllocator_match(PathAllocatorObject *self, PyObject *args)
+{
+    Py_ssize_t node_idx;
+    PyObject *pattern;
+    if (!PyArg_ParseTuple(args, "nU", &node_idx, &pattern))
+        return NULL;
+
+    GlobPatternObject *compiled = glob_pattern_compile(self, pattern);
+    if (compiled == NULL)
+        return NULL;
+    int result = glob_pattern_match(compiled, node_idx);
+    Py_DECREF(compiled);
+    if (result < 0)
+        return NULL;
+    return PyBool_FromLong(result);
+}
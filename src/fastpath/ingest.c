@@ -0,0 +1,416 @@
+#include "fastpath.h"
+
+#ifndef MS_WINDOWS
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* ========================================================================
+ * Streaming ingest
+ *
+ * ingest() builds the paths of a delimited listing, such as the output of
+ * "git ls-files -z" or "find -print0", a block at a time, so the listing is
+ * never held whole and no str object is made per path.  Each block is split
+ * into records with the GIL released; the record cut off at its end is
+ * carried to the front of the next block.  Records are then walked into the
+ * tree where they lie, under one critical section per block.
+ *
+ * A file descriptor is read on a thread of its own, which reads and splits
+ * the next block while the caller interns the current one.  The caller
+ * waits for blocks in short slices so signal handlers still run, and when
+ * it stops early it writes to a pipe the reader polls alongside the
+ * descriptor, so a reader blocked on a quiet pipe returns to be joined.
+ * A file object is read on the caller's thread through its read() method.
+ * ======================================================================== */
+
+#define INGEST_DEFAULT_BLOCK (1 << 20)
+#define INGEST_MIN_BLOCK 4096
+#define INGEST_WAIT_NS 50000000  /* Longest the caller waits for a block between signal checks */
+
+typedef struct {
+    char *data;                /* Carried partial record, then the bytes read */
+    Py_ssize_t capacity;
+    Py_ssize_t length;         /* Bytes in use */
+    Py_ssize_t *ends;          /* Offset of the delimiter ending each complete record */
+    Py_ssize_t record_count;
+    Py_ssize_t ends_capacity;
+    Py_ssize_t tail;           /* Start of the partial record after the last delimiter */
+    int eof;                   /* Nothing follows this block, so its tail is a record too */
+    int error;                 /* errno of a failed read, or ENOMEM */
+} IngestBlock;
+
+static void
+ingest_block_free(IngestBlock *block)
+{
+    PyMem_RawFree(block->data);
+    PyMem_RawFree(block->ends);
+}
+
+/* Empty the block, keeping room for at least needed bytes; callable without the GIL */
+static int
+ingest_block_reset(IngestBlock *block, Py_ssize_t needed)
+{
+    block->length = 0;
+    block->record_count = 0;
+    block->tail = 0;
+    if (block->capacity < needed) {
+        char *data = PyMem_RawRealloc(block->data, needed);
+        if (data == NULL) {
+            block->error = ENOMEM;
+            return -1;
+        }
+        block->data = data;
+        block->capacity = needed;
+    }
+    return 0;
+}
+
+/* Record the delimiters in the bytes after the carried ones; callable without the GIL */
+static int
+ingest_block_split(IngestBlock *block, Py_ssize_t carry_length, char delimiter)
+{
+    ByteScanner delimiters;
+    byte_scanner_init(&delimiters, block->data + carry_length, block->length - carry_length, delimiter);
+    for (;;) {
+        Py_ssize_t end = byte_scanner_next(&delimiters);
+        if (end == block->length - carry_length)
+            break;
+        if (block->record_count == block->ends_capacity) {
+            Py_ssize_t capacity = block->ends_capacity ? block->ends_capacity * 2 : 1024;
+            Py_ssize_t *ends = PyMem_RawRealloc(block->ends, capacity * sizeof(Py_ssize_t));
+            if (ends == NULL) {
+                block->error = ENOMEM;
+                return -1;
+            }
+            block->ends = ends;
+            block->ends_capacity = capacity;
+        }
+        block->ends[block->record_count++] = carry_length + end;
+    }
+    block->tail = block->record_count > 0 ? block->ends[block->record_count - 1] + 1 : 0;
+    return 0;
+}
+
+static inline int
+ingest_record(PathAllocatorObject *self, const char *data, Py_ssize_t length, char delimiter, IndexBuffer *out)
+{
+    if (delimiter == '\n' && length > 0 && data[length - 1] == '\r')
+        length--;
+    /* Empty records come from a trailing or repeated delimiter */
+    if (length == 0)
+        return 0;
+    Py_ssize_t node_idx = self->flavour->walk(self, self->tree->relative_root, data, length, self->separator[0]);
+    return node_idx < 0 ? -1 : index_buffer_append(out, node_idx);
+}
+
+/* Walk every record of a split block into the tree */
+static int
+ingest_block_intern(PathAllocatorObject *self, const IngestBlock *block, char delimiter, IndexBuffer *out)
+{
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self->tree, (PyObject *)self->string_pool);
+    Py_ssize_t start = 0;
+    for (Py_ssize_t i = 0; status == 0 && i < block->record_count; i++) {
+        status = ingest_record(self, block->data + start, block->ends[i] - start, delimiter, out);
+        start = block->ends[i] + 1;
+    }
+    if (status == 0 && block->eof)
+        status = ingest_record(self, block->data + block->tail, block->length - block->tail, delimiter, out);
+    Py_END_CRITICAL_SECTION2();
+    return status;
+}
+
+/* Read blocks through file.read() on the caller's thread */
+static int
+ingest_file_object(PathAllocatorObject *self, PyObject *file, Py_ssize_t block_size, char delimiter,
+                   IndexBuffer *out)
+{
+    IngestBlock block;
+    memset(&block, 0, sizeof(block));
+    int status = 0;
+    while (status == 0 && !block.eof) {
+        /* Move the partial record to the front before the buffer can move */
+        Py_ssize_t carry_length = block.length - block.tail;
+        if (carry_length > 0)
+            memmove(block.data, block.data + block.tail, carry_length);
+        if (ingest_block_reset(&block, carry_length + block_size) < 0) {
+            PyErr_NoMemory();
+            status = -1;
+            break;
+        }
+        block.length = carry_length;
+
+        PyObject *chunk = PyObject_CallMethod(file, "read", "n", block_size);
+        if (chunk == NULL) {
+            status = -1;
+            break;
+        }
+        Py_buffer view;
+        if (PyUnicode_Check(chunk) || PyObject_GetBuffer(chunk, &view, PyBUF_SIMPLE) < 0) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "ingest() needs a file opened in binary mode");
+            Py_DECREF(chunk);
+            status = -1;
+            break;
+        }
+        if (view.len > block_size) {
+            PyErr_SetString(PyExc_ValueError, "read() returned more bytes than requested");
+            status = -1;
+        } else {
+            memcpy(block.data + block.length, view.buf, view.len);
+            block.length += view.len;
+            block.eof = view.len == 0;
+        }
+        PyBuffer_Release(&view);
+        Py_DECREF(chunk);
+        if (status < 0)
+            break;
+
+        Py_BEGIN_ALLOW_THREADS
+        status = ingest_block_split(&block, carry_length, delimiter);
+        Py_END_ALLOW_THREADS
+        if (status < 0)
+            PyErr_NoMemory();
+        else
+            status = ingest_block_intern(self, &block, delimiter, out);
+    }
+    ingest_block_free(&block);
+    return status;
+}
+
+#ifndef MS_WINDOWS
+
+/* Two blocks that the reader thread fills in turn and the caller drains */
+typedef struct {
+    IngestBlock blocks[2];
+    int full[2];               /* Block is split and waiting for the caller */
+    int cancel;                /* The caller stopped early; the reader exits */
+    int fd;
+    int wake[2];               /* Pipe written on cancel to interrupt the reader's poll() */
+    Py_ssize_t block_size;
+    char delimiter;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;       /* A block was filled or drained, or cancel was set */
+} IngestPipeline;
+
+/* Read and split one block after the carry from prev; runs without the
+ * GIL.  Returns -1 if the caller cancelled while the reader waited for data. */
+static int
+ingest_block_fill_fd(IngestBlock *block, const IngestBlock *prev, const IngestPipeline *pipeline)
+{
+    Py_ssize_t carry_length = prev != NULL ? prev->length - prev->tail : 0;
+    if (ingest_block_reset(block, carry_length + pipeline->block_size) < 0)
+        return 0;
+    if (carry_length > 0)
+        memcpy(block->data, prev->data + prev->tail, carry_length);
+    block->length = carry_length;
+
+    while (block->length < block->capacity) {
+        struct pollfd fds[2] = {{pipeline->fd, POLLIN, 0}, {pipeline->wake[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            block->error = errno;
+            return 0;
+        }
+        if (fds[1].revents != 0)
+            return -1;
+        ssize_t n = read(pipeline->fd, block->data + block->length, block->capacity - block->length);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            block->error = errno;
+            return 0;
+        }
+        if (n == 0) {
+            block->eof = 1;
+            break;
+        }
+        block->length += n;
+    }
+    ingest_block_split(block, carry_length, pipeline->delimiter);
+    return 0;
+}
+
+static void *
+ingest_reader(void *arg)
+{
+    IngestPipeline *pipeline = arg;
+    const IngestBlock *prev = NULL;
+    for (int k = 0;; k ^= 1) {
+        IngestBlock *block = &pipeline->blocks[k];
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->full[k] && !pipeline->cancel)
+            pthread_cond_wait(&pipeline->cond, &pipeline->lock);
+        int cancel = pipeline->cancel;
+        pthread_mutex_unlock(&pipeline->lock);
+        if (cancel)
+            break;
+
+        /* prev is being drained, but only its complete records are read there */
+        if (ingest_block_fill_fd(block, prev, pipeline) < 0)
+            break;
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->full[k] = 1;
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->lock);
+        if (block->eof || block->error)
+            break;
+        prev = block;
+    }
+    return NULL;
+}
+
+/* Wait up to INGEST_WAIT_NS for block k to fill, without the GIL; returns whether it did */
+static int
+ingest_wait_block(IngestPipeline *pipeline, int k)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += INGEST_WAIT_NS;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    while (!pipeline->full[k]) {
+        if (pthread_cond_timedwait(&pipeline->cond, &pipeline->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    int full = pipeline->full[k];
+    pthread_mutex_unlock(&pipeline->lock);
+    return full;
+}
+
+/* Intern a block the reader filled, raising the error it met reading it */
+static int
+ingest_block_take(PathAllocatorObject *self, IngestBlock *block, char delimiter, IndexBuffer *out)
+{
+    if (block->error == ENOMEM) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (block->error != 0) {
+        errno = block->error;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    if (ingest_block_intern(self, block, delimiter, out) < 0)
+        return -1;
+    return PyErr_CheckSignals();
+}
+
+static int
+ingest_fd(PathAllocatorObject *self, int fd, Py_ssize_t block_size, char delimiter, IndexBuffer *out)
+{
+    IngestPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.fd = fd;
+    pipeline.block_size = block_size;
+    pipeline.delimiter = delimiter;
+    if (pipe(pipeline.wake) < 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.cond, NULL);
+
+    int status = 0;
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, ingest_reader, &pipeline) != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "can't start ingest thread");
+        status = -1;
+    }
+
+    for (int k = 0; status == 0; k ^= 1) {
+        IngestBlock *block = &pipeline.blocks[k];
+        int ready = 0;
+        while (!ready && status == 0) {
+            Py_BEGIN_ALLOW_THREADS
+            ready = ingest_wait_block(&pipeline, k);
+            Py_END_ALLOW_THREADS
+            if (!ready && PyErr_CheckSignals() < 0)
+                status = -1;
+        }
+
+        if (status == 0)
+            status = ingest_block_take(self, block, delimiter, out);
+
+        int done = status < 0 || block->eof;
+        pthread_mutex_lock(&pipeline.lock);
+        if (done)
+            pipeline.cancel = 1;
+        else
+            pipeline.full[k] = 0;
+        pthread_cond_broadcast(&pipeline.cond);
+        pthread_mutex_unlock(&pipeline.lock);
+        if (done) {
+            Py_BEGIN_ALLOW_THREADS
+            /* Interrupt a reader blocked on the descriptor, then collect it */
+            while (write(pipeline.wake[1], "", 1) < 0 && errno == EINTR)
+                ;
+            pthread_join(reader, NULL);
+            Py_END_ALLOW_THREADS
+            break;
+        }
+    }
+
+    close(pipeline.wake[0]);
+    close(pipeline.wake[1]);
+    ingest_block_free(&pipeline.blocks[0]);
+    ingest_block_free(&pipeline.blocks[1]);
+    pthread_cond_destroy(&pipeline.cond);
+    pthread_mutex_destroy(&pipeline.lock);
+    return status;
+}
+
+#endif /* MS_WINDOWS */
+
+PyObject *
+PathAllocator_ingest(PathAllocatorObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *source;
+    const char *delimiter = "\0";
+    Py_ssize_t delimiter_length = 1;
+    Py_ssize_t block_size = INGEST_DEFAULT_BLOCK;
+    static char *kwlist[] = {"source", "delimiter", "block_size", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|y#n", kwlist, &source, &delimiter, &delimiter_length,
+                                     &block_size))
+        return NULL;
+    if (delimiter_length != 1) {
+        PyErr_SetString(PyExc_ValueError, "delimiter must be a single byte");
+        return NULL;
+    }
+    if (block_size < INGEST_MIN_BLOCK)
+        block_size = INGEST_MIN_BLOCK;
+
+    IndexBuffer out = {NULL, 0, 0};
+    int status;
+    if (PyLong_Check(source)) {
+        int fd = PyObject_AsFileDescriptor(source);
+        if (fd < 0)
+            return NULL;
+#ifndef MS_WINDOWS
+        status = ingest_fd(self, fd, block_size, delimiter[0], &out);
+#else
+        /* Windows has no reader thread; go through a file object on the descriptor */
+        PyObject *file = PyFile_FromFd(fd, NULL, "rb", -1, NULL, NULL, NULL, 0);
+        if (file == NULL)
+            return NULL;
+        status = ingest_file_object(self, file, block_size, delimiter[0], &out);
+        Py_DECREF(file);
+#endif
+    } else {
+        status = ingest_file_object(self, source, block_size, delimiter[0], &out);
+    }
+
+    PyObject *result = status < 0 ? NULL : fastpath_index_array(out.items, out.count);
+    PyMem_Free(out.items);
+    return result;
+}
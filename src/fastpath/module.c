@@ -1,11 +1,28 @@
 #include "fastpath.h"
 
+static PyMethodDef fastpath_methods[] = {
+    {"commonpath", (PyCFunction)fastpath_commonpath, METH_O,
+     "Return the longest common ancestor of an iterable of paths"},
+    {"block_pool_info", (PyCFunction)fastpath_block_pool_info, METH_NOARGS,
+     "Get the blocks, bytes, limit, hits and misses of the pool of freed allocator storage"},
+    {"set_block_pool_limit", (PyCFunction)fastpath_set_block_pool_limit, METH_O,
+     "Set how many bytes of freed allocator storage are kept for reuse, freeing any excess"},
+    {"_restore_allocator", (PyCFunction)fastpath_restore_allocator, METH_VARARGS,
+     "Unpickle a PathAllocator"},
+    {"_restore_path", (PyCFunction)fastpath_restore_path, METH_VARARGS,
+     "Unpickle a path"},
+    {"_restore_paths", (PyCFunction)fastpath_restore_paths, METH_VARARGS,
+     "Unpickle a PathList"},
+    {NULL}  /* Sentinel */
+};
+
 /* Module definition */
 static PyModuleDef fastpathmodule = {
     PyModuleDef_HEAD_INIT,
     .m_name = "fastpath",
     .m_doc = "Fast path implementation with shared allocator",
     .m_size = -1,
+    .m_methods = fastpath_methods,
 };
 
 PyMODINIT_FUNC
@@ -13,6 +30,8 @@ PyInit_fastpath(void)
 {
     PyObject *m;
 
+    fastpath_simd_init();
+
     /* Initialize types */
     if (PyType_Ready(&StringPoolType) < 0)
         return NULL;
@@ -29,11 +48,35 @@ PyInit_fastpath(void)
     if (PyType_Ready(&FastPathType) < 0)
         return NULL;
 
+    if (PyType_Ready(&DescendantIterType) < 0)
+        return NULL;
+
+    if (PyType_Ready(&WalkIterType) < 0)
+        return NULL;
+
+    if (PyType_Ready(&NodeColumnType) < 0)
+        return NULL;
+
+    if (PyType_Ready(&GlobPatternType) < 0)
+        return NULL;
+
+    PathListType.tp_base = &PyList_Type;
+    if (PyType_Ready(&PathListType) < 0)
+        return NULL;
+
+    if (fastpath_fs_init() < 0)
+        return NULL;
+
     /* Create module */
     m = PyModule_Create(&fastpathmodule);
     if (m == NULL)
         return NULL;
 
+#ifdef Py_GIL_DISABLED
+    /* Allocators lock their own state, so importing must not re-enable the GIL */
+    PyUnstable_Module_SetGIL(m, Py_MOD_GIL_NOT_USED);
+#endif
+
     /* Add types to module */
     Py_INCREF(&StringPoolType);
     if (PyModule_AddObject(m, "StringPool", (PyObject *)&StringPoolType) < 0) {
@@ -71,11 +114,24 @@ PyInit_fastpath(void)
         return NULL;
     }
 
+    Py_INCREF(&PathListType);
+    if (PyModule_AddObject(m, "PathList", (PyObject *)&PathListType) < 0) {
+        Py_DECREF(&PathListType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
     /* Add ROOT_PARENT constant */
     if (PyModule_AddIntConstant(m, "ROOT_PARENT", -1) < 0) {
         Py_DECREF(m);
         return NULL;
     }
 
+    /* Byte scanning kernel picked for this CPU */
+    if (PyModule_AddStringConstant(m, "_simd", fastpath_simd) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+
     return m;
 }
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Name splits
+ *
+ * Names are interned, so the suffix and stem of a name only depend on its
+ * string ID.  Both are interned in turn the first time they are asked for
+ * and remembered per ID, which makes path.suffix two array reads and
+ * grouping files by extension an integer histogram over suffix IDs.  A
+ * name without a suffix maps to the ID of the empty string and is its own
+ * stem.  The lowercase form Windows paths compare under is kept the same
+ * way, so case-insensitive equality of two names is one ID comparison.
+ * Compaction builds a fresh pool, so no split outlives its IDs.
+ * ======================================================================== */
+
+/* Split slot of string_id, allocated on first use; the caller holds the
+ * pool's critical section */
+static StringSplit *
+string_pool_split_slot(StringPoolObject *self, Py_ssize_t string_id)
+{
+    while (chunk_capacity(self->splits.count, STRING_ENTRY_CHUNK_BITS) <= string_id) {
+        int k = self->splits.count;
+        if (chunked_grow(&self->splits, STRING_ENTRY_CHUNK_BITS, sizeof(StringSplit), 0) < 0)
+            return NULL;
+        memset(self->splits.chunks[k], 0xFF, ((size_t)1 << (STRING_ENTRY_CHUNK_BITS + k)) * sizeof(StringSplit));
+    }
+    return chunked_at(&self->splits, string_id, STRING_ENTRY_CHUNK_BITS, sizeof(StringSplit));
+}
+
+/* Split of string_id, computing the parts asked for; the caller holds the
+ * pool's critical section */
+static const StringSplit *
+string_pool_split(StringPoolObject *self, Py_ssize_t string_id, int with_stem)
+{
+    StringSplit *split = string_pool_split_slot(self, string_id);
+    if (split == NULL)
+        return NULL;
+    if (split->suffix_id != STRING_ID_NONE && (!with_stem || split->stem_id != STRING_ID_NONE))
+        return split;
+
+    /* Pool storage never moves, so entry and data survive the interning */
+    const StringEntry *entry = string_entry(self, string_id);
+    const char *data = string_entry_data(self, entry);
+    Py_ssize_t dot = name_suffix_offset(data, entry->length);
+    if (split->suffix_id == STRING_ID_NONE) {
+        Py_ssize_t suffix_id = string_pool_intern(self, data + dot, entry->length - dot);
+        if (suffix_id < 0)
+            return NULL;
+        split->suffix_id = (uint32_t)suffix_id;
+    }
+    if (with_stem && split->stem_id == STRING_ID_NONE) {
+        Py_ssize_t stem_id = dot == entry->length ? string_id : string_pool_intern(self, data, dot);
+        if (stem_id < 0)
+            return NULL;
+        split->stem_id = (uint32_t)stem_id;
+    }
+    return split;
+}
+
+/* Lowercase UTF-8 form of a name as a new bytes object, as str.lower()
+ * gives it; ASCII names are folded without decoding */
+PyObject *
+name_fold(const char *data, Py_ssize_t length)
+{
+    Py_ssize_t i = 0;
+    while (i < length && (unsigned char)data[i] < 0x80)
+        i++;
+    if (i < length) {
+        PyObject *name = PyUnicode_DecodeUTF8(data, length, NULL);
+        PyObject *lower = name != NULL ? PyObject_CallMethod(name, "lower", NULL) : NULL;
+        PyObject *result = lower != NULL ? PyUnicode_AsUTF8String(lower) : NULL;
+        Py_XDECREF(name);
+        Py_XDECREF(lower);
+        return result;
+    }
+
+    PyObject *result = PyBytes_FromStringAndSize(NULL, length);
+    if (result == NULL)
+        return NULL;
+    char *dest = PyBytes_AS_STRING(result);
+    for (i = 0; i < length; i++) {
+        char c = data[i];
+        dest[i] = c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+    }
+    return result;
+}
+
+/* ID of the lowercase form of string_id; the caller holds the pool's
+ * critical section */
+Py_ssize_t
+string_pool_fold(StringPoolObject *self, Py_ssize_t string_id)
+{
+    StringSplit *split = string_pool_split_slot(self, string_id);
+    if (split == NULL)
+        return -1;
+    if (split->fold_id != STRING_ID_NONE)
+        return (Py_ssize_t)split->fold_id;
+
+    const StringEntry *entry = string_entry(self, string_id);
+    PyObject *folded = name_fold(string_entry_data(self, entry), entry->length);
+    if (folded == NULL)
+        return -1;
+    Py_ssize_t fold_id = string_pool_intern(self, PyBytes_AS_STRING(folded), PyBytes_GET_SIZE(folded));
+    Py_DECREF(folded);
+    if (fold_id < 0)
+        return -1;
+    split->fold_id = (uint32_t)fold_id;
+    return fold_id;
+}
+
+static inline int
+string_pool_check_id(StringPoolObject *self, Py_ssize_t string_id)
+{
+    if (string_id < 0 || string_id >= self->count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid string ID");
+        return -1;
+    }
+    return 0;
+}
+
+Py_ssize_t
+StringPool_suffix_id(StringPoolObject *self, Py_ssize_t string_id)
+{
+    if (string_pool_check_id(self, string_id) < 0)
+        return -1;
+
+    const StringSplit *split;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    split = string_pool_split(self, string_id, 0);
+    Py_END_CRITICAL_SECTION();
+    return split == NULL ? -1 : (Py_ssize_t)split->suffix_id;
+}
+
+Py_ssize_t
+StringPool_stem_id(StringPoolObject *self, Py_ssize_t string_id)
+{
+    if (string_pool_check_id(self, string_id) < 0)
+        return -1;
+
+    const StringSplit *split;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    split = string_pool_split(self, string_id, 1);
+    Py_END_CRITICAL_SECTION();
+    return split == NULL ? -1 : (Py_ssize_t)split->stem_id;
+}
+
+Py_ssize_t
+StringPool_fold_id(StringPoolObject *self, Py_ssize_t string_id)
+{
+    if (string_pool_check_id(self, string_id) < 0)
+        return -1;
+
+    Py_ssize_t fold_id;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    fold_id = string_pool_fold(self, string_id);
+    Py_END_CRITICAL_SECTION();
+    return fold_id;
+}
+
+PyObject *
+StringPool_suffix_id_py(StringPoolObject *self, PyObject *args)
+{
+    Py_ssize_t string_id;
+    if (!PyArg_ParseTuple(args, "n", &string_id))
+        return NULL;
+
+    Py_ssize_t suffix_id = StringPool_suffix_id(self, string_id);
+    return suffix_id < 0 ? NULL : PyLong_FromSsize_t(suffix_id);
+}
+
+PyObject *
+StringPool_stem_id_py(StringPoolObject *self, PyObject *args)
+{
+    Py_ssize_t string_id;
+    if (!PyArg_ParseTuple(args, "n", &string_id))
+        return NULL;
+
+    Py_ssize_t stem_id = StringPool_stem_id(self, string_id);
+    return stem_id < 0 ? NULL : PyLong_FromSsize_t(stem_id);
+}
+
+PyObject *
+StringPool_fold_id_py(StringPoolObject *self, PyObject *args)
+{
+    Py_ssize_t string_id;
+    if (!PyArg_ParseTuple(args, "n", &string_id))
+        return NULL;
+
+    Py_ssize_t fold_id = StringPool_fold_id(self, string_id);
+    return fold_id < 0 ? NULL : PyLong_FromSsize_t(fold_id);
+}
+
+/* ========================================================================
+ * Name-derived path operations
+ * ======================================================================== */
+
+/* Name ID of a node, -1 for roots, or -2 with an exception set */
+static inline Py_ssize_t
+path_name_id(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    if (node_idx < 0 || node_idx >= self->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -2;
+    }
+    if (tree_parent(self->tree, node_idx) < 0)
+        return -1;
+    return tree_name(self->tree, node_idx);
+}
+
+PyObject *
+PathAllocator_get_suffix(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    Py_ssize_t name_id = path_name_id(self, node_idx);
+    if (name_id == -2)
+        return NULL;
+    if (name_id == -1)
+        return PyUnicode_FromStringAndSize(NULL, 0);
+
+    Py_ssize_t suffix_id = StringPool_suffix_id(self->string_pool, name_id);
+    return suffix_id < 0 ? NULL : StringPool_get_object(self->string_pool, suffix_id);
+}
+
+PyObject *
+PathAllocator_get_stem(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    Py_ssize_t name_id = path_name_id(self, node_idx);
+    if (name_id == -2)
+        return NULL;
+    if (name_id == -1)
+        return PyUnicode_FromStringAndSize(NULL, 0);
+
+    Py_ssize_t stem_id = StringPool_stem_id(self->string_pool, name_id);
+    return stem_id < 0 ? NULL : StringPool_get_object(self->string_pool, stem_id);
+}
+
+/* Every suffix of the name, as pathlib splits them: after stripping leading
+ * dots, each dot starts one suffix, and a trailing dot means none at all */
+PyObject *
+PathAllocator_get_suffixes(PathAllocatorObject *self, Py_ssize_t node_idx)
+{
+    Py_ssize_t name_id = path_name_id(self, node_idx);
+    if (name_id == -2)
+        return NULL;
+    PyObject *result = PyList_New(0);
+    if (result == NULL || name_id == -1)
+        return result;
+
+    StringPoolObject *pool = self->string_pool;
+    IndexBuffer ids = {NULL, 0, 0};
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)pool);
+    const StringEntry *entry = string_entry(pool, name_id);
+    const char *data = string_entry_data(pool, entry);
+    Py_ssize_t length = entry->length;
+    Py_ssize_t start = 0;
+    while (start < length && data[start] == '.')
+        start++;
+    if (length > 0 && data[length - 1] != '.') {
+        const char *dot = memchr(data + start, '.', length - start);
+        while (status == 0 && dot != NULL) {
+            const char *next = memchr(dot + 1, '.', data + length - dot - 1);
+            Py_ssize_t end = next != NULL ? next - data : length;
+            Py_ssize_t suffix_id = string_pool_intern(pool, dot, data + end - dot);
+            status = suffix_id < 0 ? -1 : index_buffer_append(&ids, suffix_id);
+            dot = next;
+        }
+    }
+    Py_END_CRITICAL_SECTION();
+
+    for (Py_ssize_t i = 0; status == 0 && i < ids.count; i++) {
+        PyObject *suffix = StringPool_get_object(pool, (Py_ssize_t)ids.items[i]);
+        status = suffix == NULL ? -1 : PyList_Append(result, suffix);
+        Py_XDECREF(suffix);
+    }
+    PyMem_Free(ids.items);
+    if (status < 0)
+        Py_CLEAR(result);
+    return result;
+}
+
+/* Name and parent of a node that is about to be renamed, refusing roots */
+static Py_ssize_t
+path_renamed_parent(PathAllocatorObject *self, Py_ssize_t node_idx, Py_ssize_t *name_id)
+{
+    *name_id = path_name_id(self, node_idx);
+    if (*name_id == -2)
+        return -1;
+    if (*name_id == -1) {
+        PyObject *str = PathAllocator_get_str(self, node_idx);
+        if (str != NULL) {
+            PyErr_Format(PyExc_ValueError, "%R has an empty name", str);
+            Py_DECREF(str);
+        }
+        return -1;
+    }
+    return tree_parent(self->tree, node_idx);
+}
+
+static const char *
+path_name_bytes(PyObject *name, Py_ssize_t *length)
+{
+    if (!PyUnicode_Check(name)) {
+        PyErr_Format(PyExc_TypeError, "expected str, not %.200s", Py_TYPE(name)->tp_name);
+        return NULL;
+    }
+    return PyUnicode_AsUTF8AndSize(name, length);
+}
+
+/* Sibling of node_idx called name */
+Py_ssize_t
+PathAllocator_with_name(PathAllocatorObject *self, Py_ssize_t node_idx, PyObject *name)
+{
+    Py_ssize_t name_id;
+    Py_ssize_t parent_idx = path_renamed_parent(self, node_idx, &name_id);
+    if (parent_idx < 0)
+        return -1;
+
+    Py_ssize_t length;
+    const char *data = path_name_bytes(name, &length);
+    if (data == NULL)
+        return -1;
+    if (length == 0 || (length == 1 && data[0] == '.') || path_has_separator(self, data, length)) {
+        PyErr_Format(PyExc_ValueError, "Invalid name %R", name);
+        return -1;
+    }
+    return PathAllocator_add_child(self, parent_idx, data, length);
+}
+
+/* Sibling of node_idx with its suffix replaced, or added if it had none */
+Py_ssize_t
+PathAllocator_with_suffix(PathAllocatorObject *self, Py_ssize_t node_idx, PyObject *suffix)
+{
+    Py_ssize_t suffix_length;
+    const char *suffix_data = path_name_bytes(suffix, &suffix_length);
+    if (suffix_data == NULL)
+        return -1;
+    if (path_has_separator(self, suffix_data, suffix_length) ||
+        (suffix_length > 0 && suffix_data[0] != '.') || (suffix_length == 1 && suffix_data[0] == '.')) {
+        PyErr_Format(PyExc_ValueError, "Invalid suffix %R", suffix);
+        return -1;
+    }
+
+    Py_ssize_t name_id;
+    Py_ssize_t parent_idx = path_renamed_parent(self, node_idx, &name_id);
+    if (parent_idx < 0)
+        return -1;
+
+    /* The stem is a prefix of the name, so the new name is built in place
+     * of a stem string */
+    StringPoolObject *pool = self->string_pool;
+    const StringEntry *entry = string_entry(pool, name_id);
+    const char *name = string_entry_data(pool, entry);
+    Py_ssize_t stem_length = name_suffix_offset(name, entry->length);
+    char *buffer = PyMem_Malloc(stem_length + suffix_length + 1);
+    if (buffer == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(buffer, name, stem_length);
+    memcpy(buffer + stem_length, suffix_data, suffix_length);
+
+    Py_ssize_t result = PathAllocator_add_child(self, parent_idx, buffer, stem_length + suffix_length);
+    PyMem_Free(buffer);
+    return result;
+}
+
+/* Suffix string ID of each node, as array('q'); roots get -1 */
+PyObject *
+PathAllocator_suffix_ids(PathAllocatorObject *self, PyObject *args)
+{
+    PyObject *nodes;
+    if (!PyArg_ParseTuple(args, "O", &nodes))
+        return NULL;
+
+    IndexBuffer buf = {NULL, 0, 0};
+    if (index_buffer_collect(nodes, &buf) < 0)
+        return NULL;
+
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)tree, (PyObject *)pool);
+    for (Py_ssize_t i = 0; i < buf.count; i++) {
+        Py_ssize_t node_idx = (Py_ssize_t)buf.items[i];
+        if (!tree_valid_index(tree, node_idx)) {
+            status = -1;
+            break;
+        }
+        if (tree_parent(tree, node_idx) < 0) {
+            buf.items[i] = -1;
+            continue;
+        }
+        const StringSplit *split = string_pool_split(pool, tree_name(tree, node_idx), 0);
+        if (split == NULL) {
+            status = -1;
+            break;
+        }
+        buf.items[i] = split->suffix_id;
+    }
+    Py_END_CRITICAL_SECTION2();
+
+    PyObject *result = status < 0 ? NULL : fastpath_index_array(buf.items, buf.count);
+    PyMem_Free(buf.items);
+    return result;
+}
@@ -3,17 +3,144 @@
 /* Global default allocator */
 PyObject *default_allocator = NULL;
 
+#ifdef Py_GIL_DISABLED
+static PyMutex default_allocator_mutex;
+#endif
+
 PyObject *
 get_default_allocator(void)
 {
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&default_allocator_mutex);
+#endif
     if (default_allocator == NULL) {
         /* Create default allocator */
         default_allocator = PyObject_CallObject((PyObject *)&PathAllocatorType, NULL);
     }
     Py_XINCREF(default_allocator);
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&default_allocator_mutex);
+#endif
     return default_allocator;
 }
 
+/* ========================================================================
+ * Path object allocation
+ *
+ * Dead PureFastPath and FastPath objects are kept on small per-type
+ * freelists and reused, since .parent walks and "/" joins create many
+ * short-lived paths.  Subclasses always go through tp_alloc/tp_free.
+ * ======================================================================== */
+
+#define PATH_FREELIST_SIZE 128
+
+typedef struct {
+    PyObject *items[PATH_FREELIST_SIZE];
+    int count;
+} PathFreelist;
+
+static PathFreelist pure_path_freelist;
+static PathFreelist path_freelist;
+
+static inline int
+path_type_is_native(PyTypeObject *type)
+{
+    return type == &PureFastPathType || type == &FastPathType;
+}
+
+static inline PathFreelist *
+path_freelist_for(PyTypeObject *type)
+{
+#ifdef Py_GIL_DISABLED
+    /* The freelists are not synchronized */
+    return NULL;
+#else
+    if (type == &PureFastPathType)
+        return &pure_path_freelist;
+    if (type == &FastPathType)
+        return &path_freelist;
+    return NULL;
+#endif
+}
+
+static PureFastPathObject *
+path_alloc(PyTypeObject *type)
+{
+    PureFastPathObject *self;
+    PathFreelist *freelist = path_freelist_for(type);
+    if (freelist != NULL && freelist->count > 0) {
+        self = (PureFastPathObject *)freelist->items[--freelist->count];
+        PyObject_Init((PyObject *)self, type);
+    } else {
+        self = (PureFastPathObject *)type->tp_alloc(type, 0);
+        if (self == NULL)
+            return NULL;
+    }
+    self->_allocator = NULL;
+    self->_node_idx = -1;
+    return self;
+}
+
+/* Register a path that now has its allocator and node with an allocator
+ * that tracks live paths; on failure the caller releases the path */
+static inline int
+path_track(PureFastPathObject *self)
+{
+    PyObject *allocator = self->_allocator;
+    if (PyObject_TypeCheck(allocator, &PathAllocatorType) && ((PathAllocatorObject *)allocator)->track_paths)
+        return PathAllocator_track_path((PathAllocatorObject *)allocator, self);
+    return 0;
+}
+
+/* Drop the path's allocator, unregistering it first if it was tracked */
+static inline void
+path_release(PureFastPathObject *self)
+{
+    PyObject *allocator = self->_allocator;
+    if (allocator != NULL && self->_node_idx >= 0 && PyObject_TypeCheck(allocator, &PathAllocatorType) &&
+        ((PathAllocatorObject *)allocator)->track_paths)
+        PathAllocator_untrack_path((PathAllocatorObject *)allocator, self);
+    Py_CLEAR(self->_allocator);
+    self->_node_idx = -1;
+}
+
+/* Create a path for node_idx of allocator without argument parsing */
+PyObject *
+PureFastPath_from_index(PyTypeObject *type, PyObject *allocator, Py_ssize_t node_idx)
+{
+    if (!path_type_is_native(type)) {
+        /* Subclasses may customize construction */
+        PyObject *kwargs = Py_BuildValue("{s:O,s:n}",
+            "allocator", allocator,
+            "_node_idx", node_idx);
+        if (kwargs == NULL)
+            return NULL;
+
+        PyObject *empty = PyTuple_New(0);
+        if (empty == NULL) {
+            Py_DECREF(kwargs);
+            return NULL;
+        }
+
+        PyObject *new_path = PyObject_Call((PyObject *)type, empty, kwargs);
+        Py_DECREF(empty);
+        Py_DECREF(kwargs);
+        return new_path;
+    }
+
+    PureFastPathObject *self = path_alloc(type);
+    if (self == NULL)
+        return NULL;
+    Py_INCREF(allocator);
+    self->_allocator = allocator;
+    self->_node_idx = node_idx;
+    if (path_track(self) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
 /* ========================================================================
  * PureFastPath implementation
  * ======================================================================== */
@@ -21,20 +148,20 @@ get_default_allocator(void)
 static void
 PureFastPath_dealloc(PureFastPathObject *self)
 {
-    Py_XDECREF(self->_allocator);
+    path_release(self);
+
+    PathFreelist *freelist = path_freelist_for(Py_TYPE(self));
+    if (freelist != NULL && freelist->count < PATH_FREELIST_SIZE) {
+        freelist->items[freelist->count++] = (PyObject *)self;
+        return;
+    }
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
 static PyObject *
 PureFastPath_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    PureFastPathObject *self;
-    self = (PureFastPathObject *)type->tp_alloc(type, 0);
-    if (self != NULL) {
-        self->_allocator = NULL;
-        self->_node_idx = -1;
-    }
-    return (PyObject *)self;
+    return (PyObject *)path_alloc(type);
 }
 
 static int
@@ -44,6 +171,9 @@ PureFastPath_init(PureFastPathObject *self, PyObject *args, PyObject *kwds)
     Py_ssize_t node_idx = -1;
     static char *kwlist[] = {"allocator", "_node_idx", NULL};
 
+    /* __init__ may be called again on a live path */
+    path_release(self);
+
     /* First try to parse with keywords for internal use */
     if (PyTuple_Size(args) == 0 && kwds != NULL) {
         if (!PyArg_ParseTupleAndKeywords(args, kwds, "|On", kwlist, &allocator, &node_idx))
@@ -58,7 +188,7 @@ PureFastPath_init(PureFastPathObject *self, PyObject *args, PyObject *kwds)
             }
             self->_allocator = allocator;
             self->_node_idx = node_idx;
-            return 0;
+            return path_track(self);
         }
     }
 
@@ -70,10 +200,22 @@ PureFastPath_init(PureFastPathObject *self, PyObject *args, PyObject *kwds)
     }
     self->_allocator = allocator;
 
+    /* Native allocators are called directly */
+    if (Py_IS_TYPE(allocator, &PathAllocatorType)) {
+        PathAllocatorObject *native = (PathAllocatorObject *)allocator;
+        Py_ssize_t node_idx = PathAllocator_join_parts(native, native->tree->relative_root, args);
+        if (node_idx < 0) {
+            return -1;
+        }
+
+        self->_node_idx = node_idx;
+        return path_track(self);
+    }
+
     /* Handle single string argument - use from_string */
     if (PyTuple_Size(args) == 1) {
         PyObject *first = PyTuple_GetItem(args, 0);
-        if (PyUnicode_Check(first)) {
+        if (PyUnicode_Check(first) || PyBytes_Check(first)) {
             /* It's a path string, use from_string */
             PyObject *from_string = PyObject_GetAttrString(allocator, "from_string");
             if (from_string == NULL) {
@@ -88,7 +230,7 @@ PureFastPath_init(PureFastPathObject *self, PyObject *args, PyObject *kwds)
 
             self->_node_idx = PyLong_AsLong(result);
             Py_DECREF(result);
-            return 0;
+            return path_track(self);
         }
     }
 
@@ -107,36 +249,186 @@ PureFastPath_init(PureFastPathObject *self, PyObject *args, PyObject *kwds)
     self->_node_idx = PyLong_AsLong(result);
     Py_DECREF(result);
 
+    return path_track(self);
+}
+
+/* Construct through tp_new/tp_init, used when keywords are passed */
+static PyObject *
+path_call_generic(PyTypeObject *type, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
+{
+    Py_ssize_t nkwargs = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+    PyObject *tuple = PyTuple_New(nargs);
+    if (tuple == NULL)
+        return NULL;
+    for (Py_ssize_t i = 0; i < nargs; i++) {
+        Py_INCREF(args[i]);
+        PyTuple_SET_ITEM(tuple, i, args[i]);
+    }
+
+    PyObject *kwargs = NULL;
+    if (nkwargs > 0) {
+        kwargs = PyDict_New();
+        if (kwargs == NULL)
+            goto error;
+        for (Py_ssize_t i = 0; i < nkwargs; i++) {
+            if (PyDict_SetItem(kwargs, PyTuple_GET_ITEM(kwnames, i), args[nargs + i]) < 0)
+                goto error;
+        }
+    }
+
+    PyObject *self = type->tp_new(type, tuple, kwargs);
+    if (self != NULL && type->tp_init(self, tuple, kwargs) < 0) {
+        Py_CLEAR(self);
+    }
+    Py_DECREF(tuple);
+    Py_XDECREF(kwargs);
+    return self;
+
+error:
+    Py_DECREF(tuple);
+    Py_XDECREF(kwargs);
+    return NULL;
+}
+
+/* Vectorcall constructor: positional parts are joined onto the default
+ * allocator's relative root without building an argument tuple */
+static PyObject *
+PureFastPath_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames)
+{
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    if (kwnames != NULL && PyTuple_GET_SIZE(kwnames) > 0) {
+        return path_call_generic((PyTypeObject *)type, args, nargs, kwnames);
+    }
+
+    PyObject *allocator = get_default_allocator();
+    if (allocator == NULL)
+        return NULL;
+    if (!Py_IS_TYPE(allocator, &PathAllocatorType)) {
+        Py_DECREF(allocator);
+        return path_call_generic((PyTypeObject *)type, args, nargs, NULL);
+    }
+
+    PathAllocatorObject *native = (PathAllocatorObject *)allocator;
+    Py_ssize_t node_idx = native->tree->relative_root;
+    for (Py_ssize_t i = 0; i < nargs; i++) {
+        node_idx = PathAllocator_join_part(native, node_idx, args[i]);
+        if (node_idx < 0) {
+            Py_DECREF(allocator);
+            return NULL;
+        }
+    }
+
+    PureFastPathObject *self = path_alloc((PyTypeObject *)type);
+    if (self == NULL) {
+        Py_DECREF(allocator);
+        return NULL;
+    }
+    self->_allocator = allocator;
+    self->_node_idx = node_idx;
+    if (path_track(self) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *)self;
+}
+
+/* Return the allocator if it is a native PathAllocator, NULL for subclasses */
+static inline PathAllocatorObject *
+native_allocator(PureFastPathObject *self)
+{
+    if (Py_IS_TYPE(self->_allocator, &PathAllocatorType)) {
+        return (PathAllocatorObject *)self->_allocator;
+    }
+    return NULL;
+}
+
+/* Generic dispatch: call allocator.<name>(node_idx) */
+static PyObject *
+call_allocator_method(PureFastPathObject *self, const char *name)
+{
+    return PyObject_CallMethod(self->_allocator, name, "n", self->_node_idx);
+}
+
+/* Create a path of the same type sharing the allocator */
+static inline PyObject *
+path_from_index(PureFastPathObject *self, Py_ssize_t node_idx)
+{
+    return PureFastPath_from_index(Py_TYPE(self), self->_allocator, node_idx);
+}
+
+static PyObject *
+path_from_index_obj(PureFastPathObject *self, PyObject *idx_obj)
+{
+    Py_ssize_t node_idx = PyLong_AsSsize_t(idx_obj);
+    if (node_idx == -1 && PyErr_Occurred())
+        return NULL;
+    return path_from_index(self, node_idx);
+}
+
+/* Gather parts, absoluteness and separator through either dispatch path */
+static int
+path_components(PureFastPathObject *self, PyObject **parts, int *absolute, PyObject **separator)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        *absolute = PathAllocator_is_absolute(allocator, self->_node_idx);
+        if (*absolute < 0)
+            return -1;
+        *parts = PathAllocator_get_parts(allocator, self->_node_idx);
+        if (*parts == NULL)
+            return -1;
+        *separator = PyUnicode_FromString(allocator->separator);
+    } else {
+        PyObject *is_absolute = call_allocator_method(self, "is_absolute");
+        if (is_absolute == NULL)
+            return -1;
+        *absolute = PyObject_IsTrue(is_absolute);
+        Py_DECREF(is_absolute);
+        if (*absolute < 0)
+            return -1;
+        *parts = call_allocator_method(self, "get_parts");
+        if (*parts == NULL)
+            return -1;
+        *separator = PyObject_GetAttrString(self->_allocator, "_separator");
+        if (*separator == NULL) {
+            PyErr_Clear();
+            *separator = PyUnicode_FromString("/");
+        }
+    }
+
+    if (*separator == NULL) {
+        Py_CLEAR(*parts);
+        return -1;
+    }
     return 0;
 }
 
 PyObject *
 PureFastPath_str(PureFastPathObject *self)
 {
-    /* Get parts from allocator */
-    PyObject *get_parts = PyObject_GetAttrString(self->_allocator, "get_parts");
-    if (get_parts == NULL)
-        return NULL;
-
-    PyObject *args = Py_BuildValue("(n)", self->_node_idx);
-    PyObject *parts = PyObject_Call(get_parts, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(get_parts);
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        return PathAllocator_get_str(allocator, self->_node_idx);
+    }
 
-    if (parts == NULL)
+    PyObject *parts, *separator;
+    int absolute;
+    if (path_components(self, &parts, &absolute, &separator) < 0)
         return NULL;
 
-    /* Get separator */
-    PyObject *separator = PyObject_GetAttrString(self->_allocator, "_separator");
-    if (separator == NULL) {
-        separator = PyUnicode_FromString("/");
+    PyObject *result;
+    if (!absolute && PyTuple_GET_SIZE(parts) == 0) {
+        result = PyUnicode_FromString(".");
+    } else {
+        /* Join parts with separator */
+        result = PyUnicode_Join(separator, parts);
+        if (result != NULL && absolute) {
+            Py_SETREF(result, PyUnicode_Concat(separator, result));
+        }
     }
 
-    /* Join parts with separator */
-    PyObject *result = PyUnicode_Join(separator, parts);
     Py_DECREF(separator);
     Py_DECREF(parts);
-
     return result;
 }
 
@@ -156,151 +448,529 @@ PyObject *
 PureFastPath_truediv(PureFastPathObject *self, PyObject *other)
 {
     /* Handle path joining with / operator */
-    PyObject *join_method = PyObject_GetAttrString(self->_allocator, "join");
-    if (join_method == NULL)
-        return NULL;
-
-    PyObject *args;
-    if (PyUnicode_Check(other)) {
-        args = Py_BuildValue("(nO)", self->_node_idx, other);
-    } else {
-        Py_DECREF(join_method);
-        PyErr_SetString(PyExc_TypeError, "unsupported operand type(s) for /");
-        return NULL;
+    if (!PyObject_TypeCheck(self, &PureFastPathType) || !PyUnicode_Check(other)) {
+        Py_RETURN_NOTIMPLEMENTED;
     }
 
-    PyObject *new_idx = PyObject_Call(join_method, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(join_method);
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        Py_ssize_t new_idx = PathAllocator_join_part(allocator, self->_node_idx, other);
+        if (new_idx < 0)
+            return NULL;
+        return path_from_index(self, new_idx);
+    }
 
+    PyObject *new_idx = PyObject_CallMethod(self->_allocator, "join", "nO", self->_node_idx, other);
     if (new_idx == NULL)
         return NULL;
 
     /* Create new path object with the new index */
-    PyObject *kwargs = Py_BuildValue("{s:O,s:O}",
-        "allocator", self->_allocator,
-        "_node_idx", new_idx);
-    PyObject *new_path = PyObject_Call((PyObject *)Py_TYPE(self), PyTuple_New(0), kwargs);
-    Py_DECREF(kwargs);
+    PyObject *new_path = path_from_index_obj(self, new_idx);
     Py_DECREF(new_idx);
-
     return new_path;
 }
 
+/* The drive and root together, "" for relative paths */
+static PyObject *
+path_anchor(PureFastPathObject *self)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL)
+        return PathAllocator_get_anchor(allocator, self->_node_idx);
+
+    PyObject *parts, *separator;
+    int absolute;
+    if (path_components(self, &parts, &absolute, &separator) < 0)
+        return NULL;
+    Py_DECREF(parts);
+    if (!absolute)
+        Py_SETREF(separator, PyUnicode_FromStringAndSize(NULL, 0));
+    return separator;
+}
+
 static PyObject *
 PureFastPath_get_parts(PureFastPathObject *self, void *closure)
 {
-    PyObject *get_parts = PyObject_GetAttrString(self->_allocator, "get_parts");
-    if (get_parts == NULL)
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        /* Paths below any root other than the relative root start with their anchor, like pathlib */
+        PyObject *anchor = PathAllocator_get_anchor(allocator, self->_node_idx);
+        if (anchor == NULL)
+            return NULL;
+        if (PyUnicode_GET_LENGTH(anchor) == 0) {
+            Py_DECREF(anchor);
+            return PathAllocator_get_parts(allocator, self->_node_idx);
+        }
+        PyObject *parts = PathAllocator_get_parts(allocator, self->_node_idx);
+        PyObject *result = parts != NULL ? PyTuple_New(PyTuple_GET_SIZE(parts) + 1) : NULL;
+        if (result == NULL) {
+            Py_DECREF(anchor);
+            Py_XDECREF(parts);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(result, 0, anchor);
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(parts); i++) {
+            PyObject *item = PyTuple_GET_ITEM(parts, i);
+            Py_INCREF(item);
+            PyTuple_SET_ITEM(result, i + 1, item);
+        }
+        Py_DECREF(parts);
+        return result;
+    }
+
+    PyObject *parts, *separator;
+    int absolute;
+    if (path_components(self, &parts, &absolute, &separator) < 0)
         return NULL;
 
-    PyObject *args = Py_BuildValue("(n)", self->_node_idx);
-    PyObject *result = PyObject_Call(get_parts, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(get_parts);
+    if (!absolute) {
+        Py_DECREF(separator);
+        return parts;
+    }
 
+    /* Absolute paths start with their anchor, like pathlib */
+    Py_ssize_t count = PyTuple_GET_SIZE(parts);
+    PyObject *result = PyTuple_New(count + 1);
+    if (result == NULL) {
+        Py_DECREF(separator);
+        Py_DECREF(parts);
+        return NULL;
+    }
+    PyTuple_SET_ITEM(result, 0, separator);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *item = PyTuple_GET_ITEM(parts, i);
+        Py_INCREF(item);
+        PyTuple_SET_ITEM(result, i + 1, item);
+    }
+    Py_DECREF(parts);
     return result;
 }
 
-PyObject *
-PureFastPath_get_parent(PureFastPathObject *self, void *closure)
+static PyObject *
+PureFastPath_get_anchor(PureFastPathObject *self, void *closure)
+{
+    return path_anchor(self);
+}
+
+/* Length of the root at the end of an anchor: its trailing separator */
+static Py_ssize_t
+anchor_root_length(PyObject *anchor)
 {
-    PyObject *get_parent = PyObject_GetAttrString(self->_allocator, "get_parent");
-    if (get_parent == NULL)
+    Py_ssize_t length = PyUnicode_GET_LENGTH(anchor);
+    if (length == 0)
+        return 0;
+    Py_UCS4 last = PyUnicode_READ_CHAR(anchor, length - 1);
+    return last == '/' || last == '\\' ? 1 : 0;
+}
+
+static PyObject *
+PureFastPath_get_drive(PureFastPathObject *self, void *closure)
+{
+    PyObject *anchor = path_anchor(self);
+    if (anchor == NULL)
         return NULL;
+    PyObject *drive = PyUnicode_Substring(anchor, 0, PyUnicode_GET_LENGTH(anchor) - anchor_root_length(anchor));
+    Py_DECREF(anchor);
+    return drive;
+}
 
-    PyObject *args = Py_BuildValue("(n)", self->_node_idx);
-    PyObject *parent_idx = PyObject_Call(get_parent, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(get_parent);
+static PyObject *
+PureFastPath_get_root(PureFastPathObject *self, void *closure)
+{
+    PyObject *anchor = path_anchor(self);
+    if (anchor == NULL)
+        return NULL;
+    Py_ssize_t length = PyUnicode_GET_LENGTH(anchor);
+    PyObject *root = PyUnicode_Substring(anchor, length - anchor_root_length(anchor), length);
+    Py_DECREF(anchor);
+    return root;
+}
+
+PyObject *
+PureFastPath_get_parent(PureFastPathObject *self, void *closure)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        Py_ssize_t parent_idx = PathAllocator_get_parent(allocator, self->_node_idx);
+        if (parent_idx < 0)
+            return NULL;
+        return path_from_index(self, parent_idx);
+    }
 
+    PyObject *parent_idx = call_allocator_method(self, "get_parent");
     if (parent_idx == NULL)
         return NULL;
 
     /* Create new path with parent index */
-    PyObject *kwargs = Py_BuildValue("{s:O,s:O}",
-        "allocator", self->_allocator,
-        "_node_idx", parent_idx);
-    PyObject *new_path = PyObject_Call((PyObject *)Py_TYPE(self), PyTuple_New(0), kwargs);
-    Py_DECREF(kwargs);
+    PyObject *new_path = path_from_index_obj(self, parent_idx);
     Py_DECREF(parent_idx);
-
     return new_path;
 }
 
 PyObject *
 PureFastPath_get_name(PureFastPathObject *self, void *closure)
 {
-    PyObject *get_name = PyObject_GetAttrString(self->_allocator, "get_name");
-    if (get_name == NULL)
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        return PathAllocator_get_name(allocator, self->_node_idx);
+    }
+
+    return call_allocator_method(self, "get_name");
+}
+
+static PyObject *
+PureFastPath_get_stem(PureFastPathObject *self, void *closure)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        return PathAllocator_get_stem(allocator, self->_node_idx);
+    }
+
+    return call_allocator_method(self, "get_stem");
+}
+
+static PyObject *
+PureFastPath_get_suffix(PureFastPathObject *self, void *closure)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        return PathAllocator_get_suffix(allocator, self->_node_idx);
+    }
+
+    return call_allocator_method(self, "get_suffix");
+}
+
+static PyObject *
+PureFastPath_get_suffixes(PureFastPathObject *self, void *closure)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        return PathAllocator_get_suffixes(allocator, self->_node_idx);
+    }
+
+    return call_allocator_method(self, "get_suffixes");
+}
+
+static PyObject *
+PureFastPath_with_name(PureFastPathObject *self, PyObject *name)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        Py_ssize_t new_idx = PathAllocator_with_name(allocator, self->_node_idx, name);
+        if (new_idx < 0)
+            return NULL;
+        return path_from_index(self, new_idx);
+    }
+
+    PyObject *new_idx = PyObject_CallMethod(self->_allocator, "with_name", "nO", self->_node_idx, name);
+    if (new_idx == NULL)
         return NULL;
+    PyObject *new_path = path_from_index_obj(self, new_idx);
+    Py_DECREF(new_idx);
+    return new_path;
+}
 
-    PyObject *args = Py_BuildValue("(n)", self->_node_idx);
-    PyObject *result = PyObject_Call(get_name, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(get_name);
+static PyObject *
+PureFastPath_with_suffix(PureFastPathObject *self, PyObject *suffix)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        Py_ssize_t new_idx = PathAllocator_with_suffix(allocator, self->_node_idx, suffix);
+        if (new_idx < 0)
+            return NULL;
+        return path_from_index(self, new_idx);
+    }
 
-    return result;
+    PyObject *new_idx = PyObject_CallMethod(self->_allocator, "with_suffix", "nO", self->_node_idx, suffix);
+    if (new_idx == NULL)
+        return NULL;
+    PyObject *new_path = path_from_index_obj(self, new_idx);
+    Py_DECREF(new_idx);
+    return new_path;
 }
 
 static PyObject *
-PureFastPath_get_stem(PureFastPathObject *self, void *closure)
+PureFastPath_with_stem(PureFastPathObject *self, PyObject *stem)
 {
-    PyObject *name = PureFastPath_get_name(self, NULL);
+    if (!PyUnicode_Check(stem)) {
+        PyErr_Format(PyExc_TypeError, "expected str, not %.200s", Py_TYPE(stem)->tp_name);
+        return NULL;
+    }
+    PyObject *suffix = PureFastPath_get_suffix(self, NULL);
+    if (suffix == NULL)
+        return NULL;
+    PyObject *name = PyUnicode_Concat(stem, suffix);
+    Py_DECREF(suffix);
     if (name == NULL)
         return NULL;
+    PyObject *result = PureFastPath_with_name(self, name);
+    Py_DECREF(name);
+    return result;
+}
 
-    /* Find the last dot */
-    Py_ssize_t name_len = PyUnicode_GetLength(name);
-    const char *name_str = PyUnicode_AsUTF8(name);
+static PyObject *
+PureFastPath_is_absolute(PureFastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        int result = PathAllocator_is_absolute(allocator, self->_node_idx);
+        if (result < 0)
+            return NULL;
+        return PyBool_FromLong(result);
+    }
+
+    return call_allocator_method(self, "is_absolute");
+}
+
+/* Node index of other in self's allocator; paths living elsewhere and
+ * path-like objects are walked from their string form */
+static int
+path_other_index(PureFastPathObject *self, PyObject *other, Py_ssize_t *node_idx)
+{
+    if (PyObject_TypeCheck(other, &PureFastPathType) &&
+        ((PureFastPathObject *)other)->_allocator == self->_allocator) {
+        *node_idx = ((PureFastPathObject *)other)->_node_idx;
+        return 0;
+    }
 
-    const char *dot = strrchr(name_str, '.');
-    if (dot == NULL || dot == name_str) {
-        /* No extension or hidden file */
-        return name;
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        *node_idx = PathAllocator_join_part(allocator, allocator->tree->relative_root, other);
+        return *node_idx < 0 ? -1 : 0;
     }
 
-    Py_ssize_t stem_len = dot - name_str;
-    PyObject *stem = PyUnicode_FromStringAndSize(name_str, stem_len);
-    Py_DECREF(name);
-    return stem;
+    PyObject *str = PyOS_FSPath(other);
+    if (str == NULL)
+        return -1;
+    PyObject *idx = PyObject_CallMethod(self->_allocator, "from_string", "O", str);
+    Py_DECREF(str);
+    if (idx == NULL)
+        return -1;
+    *node_idx = PyLong_AsSsize_t(idx);
+    Py_DECREF(idx);
+    return (*node_idx == -1 && PyErr_Occurred()) ? -1 : 0;
 }
 
 static PyObject *
-PureFastPath_get_suffix(PureFastPathObject *self, void *closure)
+PureFastPath_relative_to(PureFastPathObject *self, PyObject *other)
 {
-    PyObject *name = PureFastPath_get_name(self, NULL);
-    if (name == NULL)
+    Py_ssize_t base_idx;
+    if (path_other_index(self, other, &base_idx) < 0)
         return NULL;
 
-    const char *name_str = PyUnicode_AsUTF8(name);
-    const char *dot = strrchr(name_str, '.');
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        Py_ssize_t node_idx = PathAllocator_relative_to(allocator, self->_node_idx, base_idx);
+        if (node_idx < 0)
+            return NULL;
+        return path_from_index(self, node_idx);
+    }
 
-    PyObject *result;
-    if (dot == NULL || dot == name_str) {
-        /* No extension or hidden file */
-        result = PyUnicode_FromString("");
+    PyObject *node_idx = PyObject_CallMethod(self->_allocator, "relative_to", "nn", self->_node_idx, base_idx);
+    if (node_idx == NULL)
+        return NULL;
+    PyObject *result = path_from_index_obj(self, node_idx);
+    Py_DECREF(node_idx);
+    return result;
+}
+
+static PyObject *
+PureFastPath_is_relative_to(PureFastPathObject *self, PyObject *other)
+{
+    Py_ssize_t base_idx;
+    if (path_other_index(self, other, &base_idx) < 0)
+        return NULL;
+
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL) {
+        int result = TreeAllocator_is_ancestor(allocator->tree, base_idx, self->_node_idx);
+        if (result < 0)
+            return NULL;
+        return PyBool_FromLong(result);
+    }
+
+    return PyObject_CallMethod(self->_allocator, "is_relative_to", "nn", self->_node_idx, base_idx);
+}
+
+static PyObject *
+PureFastPath_match(PureFastPathObject *self, PyObject *pattern)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator == NULL)
+        return PyObject_CallMethod(self->_allocator, "match", "nO", self->_node_idx, pattern);
+
+    GlobPatternObject *compiled = glob_pattern_compile(allocator, pattern);
+    if (compiled == NULL)
+        return NULL;
+    int result = glob_pattern_match(compiled, self->_node_idx);
+    Py_DECREF(compiled);
+    if (result < 0)
+        return NULL;
+    return PyBool_FromLong(result);
+}
+
+/* Iterator over paths of self's type for an iterable of node indices */
+static PyObject *
+path_iter_from_indices(PureFastPathObject *self, PyObject *indices)
+{
+    PyObject *paths = PyList_New(0);
+    PyObject *iter = paths == NULL ? NULL : PyObject_GetIter(indices);
+    if (iter == NULL) {
+        Py_XDECREF(paths);
+        return NULL;
+    }
+    PyObject *idx;
+    while ((idx = PyIter_Next(iter)) != NULL) {
+        PyObject *path = path_from_index_obj(self, idx);
+        Py_DECREF(idx);
+        if (path == NULL || PyList_Append(paths, path) < 0) {
+            Py_XDECREF(path);
+            break;
+        }
+        Py_DECREF(path);
+    }
+    Py_DECREF(iter);
+    if (PyErr_Occurred()) {
+        Py_DECREF(paths);
+        return NULL;
+    }
+    iter = PyObject_GetIter(paths);
+    Py_DECREF(paths);
+    return iter;
+}
+
+/* Known paths below the path that match pattern; the tree is not refreshed
+ * from the filesystem, FastPath.glob() does that */
+static PyObject *
+path_glob_known(PureFastPathObject *self, PyObject *pattern)
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    PyObject *indices;
+    if (allocator != NULL) {
+        GlobPatternObject *compiled = glob_pattern_compile(allocator, pattern);
+        if (compiled == NULL)
+            return NULL;
+        indices = glob_pattern_tree(compiled, self->_node_idx);
+        Py_DECREF(compiled);
     } else {
-        result = PyUnicode_FromString(dot);
+        indices = PyObject_CallMethod(self->_allocator, "glob", "nO", self->_node_idx, pattern);
     }
+    if (indices == NULL)
+        return NULL;
+    PyObject *result = path_iter_from_indices(self, indices);
+    Py_DECREF(indices);
+    return result;
+}
 
-    Py_DECREF(name);
+static PyObject *
+PureFastPath_glob(PureFastPathObject *self, PyObject *pattern)
+{
+    return path_glob_known(self, pattern);
+}
+
+static PyObject *
+PureFastPath_rglob(PureFastPathObject *self, PyObject *pattern)
+{
+    PyObject *recursive = glob_recursive_pattern(self->_allocator, pattern);
+    if (recursive == NULL)
+        return NULL;
+    PyObject *result = path_glob_known(self, recursive);
+    Py_DECREF(recursive);
     return result;
 }
 
 static PyObject *
-PureFastPath_is_absolute(PureFastPathObject *self, PyObject *Py_UNUSED(ignored))
+PureFastPath_get_parents(PureFastPathObject *self, void *closure)
 {
-    PyObject *is_absolute = PyObject_GetAttrString(self->_allocator, "is_absolute");
-    if (is_absolute == NULL)
+    PathAllocatorObject *allocator = native_allocator(self);
+    PyObject *indices;
+    if (allocator != NULL) {
+        indices = TreeAllocator_get_ancestors(allocator->tree, self->_node_idx);
+    } else {
+        PyObject *seq = call_allocator_method(self, "get_parents");
+        if (seq == NULL)
+            return NULL;
+        indices = PySequence_Tuple(seq);
+        Py_DECREF(seq);
+    }
+    if (indices == NULL)
         return NULL;
 
-    PyObject *args = Py_BuildValue("(n)", self->_node_idx);
-    PyObject *result = PyObject_Call(is_absolute, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(is_absolute);
+    /* Replace each index with a path in place */
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(indices); i++) {
+        PyObject *idx = PyTuple_GET_ITEM(indices, i);
+        PyObject *path = path_from_index_obj(self, idx);
+        if (path == NULL) {
+            Py_DECREF(indices);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(indices, i, path);
+        Py_DECREF(idx);
+    }
+    return indices;
+}
+
+/* fastpath.commonpath(paths): longest common ancestor, as os.path.commonpath.
+ * The result shares the first path's allocator and type. */
+PyObject *
+fastpath_commonpath(PyObject *module, PyObject *paths)
+{
+    PyObject *iter = PyObject_GetIter(paths);
+    if (iter == NULL)
+        return NULL;
 
+    PyObject *first = PyIter_Next(iter);
+    if (first == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "commonpath() arg is an empty sequence");
+        Py_DECREF(iter);
+        return NULL;
+    }
+    if (!PyObject_TypeCheck(first, &PureFastPathType)) {
+        Py_SETREF(first, PyObject_CallOneArg((PyObject *)&PureFastPathType, first));
+        if (first == NULL) {
+            Py_DECREF(iter);
+            return NULL;
+        }
+    }
+
+    PureFastPathObject *base = (PureFastPathObject *)first;
+    PathAllocatorObject *allocator = native_allocator(base);
+    Py_ssize_t common = base->_node_idx;
+    PyObject *item;
+    while ((item = PyIter_Next(iter)) != NULL) {
+        Py_ssize_t node_idx;
+        int status = path_other_index(base, item, &node_idx);
+        Py_DECREF(item);
+        if (status < 0)
+            goto error;
+
+        if (allocator != NULL) {
+            common = TreeAllocator_common_ancestor(allocator->tree, common, node_idx);
+            if (common < 0)
+                goto error;
+        } else {
+            PyObject *idx = PyObject_CallMethod(base->_allocator, "common_ancestor", "nn", common, node_idx);
+            if (idx == NULL)
+                goto error;
+            common = PyLong_AsSsize_t(idx);
+            Py_DECREF(idx);
+            if (common == -1 && PyErr_Occurred())
+                goto error;
+        }
+    }
+    if (PyErr_Occurred())
+        goto error;
+    Py_DECREF(iter);
+
+    PyObject *result = path_from_index(base, common);
+    Py_DECREF(first);
     return result;
+
+error:
+    Py_DECREF(iter);
+    Py_DECREF(first);
+    return NULL;
 }
 
 static PyObject *
@@ -330,18 +1000,45 @@ PureFastPath_joinpath(PureFastPathObject *self, PyObject *args)
 static Py_hash_t
 PureFastPath_hash(PureFastPathObject *self)
 {
-    /* Hash based on allocator and node index */
-    return PyObject_Hash(self->_allocator) ^ self->_node_idx;
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator == NULL) {
+        /* Hash based on allocator and node index */
+        return PyObject_Hash(self->_allocator) ^ self->_node_idx;
+    }
+    if (self->_node_idx < 0 || self->_node_idx >= allocator->tree->node_count) {
+        PyErr_SetString(PyExc_IndexError, "Invalid node index");
+        return -1;
+    }
+
+    /* Content hash, so equal paths from different allocators hash alike */
+    Py_hash_t hash = (Py_hash_t)tree_hash(allocator->tree, self->_node_idx);
+    return hash == -1 ? -2 : hash;
 }
 
 static PyObject *
 PureFastPath_richcompare(PureFastPathObject *self, PyObject *other, int op)
 {
-    if (!PyObject_IsInstance(other, (PyObject *)&PureFastPathType)) {
+    if (!PyObject_TypeCheck(other, &PureFastPathType)) {
         Py_RETURN_NOTIMPLEMENTED;
     }
 
     PureFastPathObject *other_path = (PureFastPathObject *)other;
+    PathAllocatorObject *allocator = native_allocator(self);
+    PathAllocatorObject *other_allocator = native_allocator(other_path);
+
+    /* Native allocators compare by walking both node chains */
+    if (allocator != NULL && other_allocator != NULL) {
+        if (op == Py_EQ || op == Py_NE) {
+            int equal = PathAllocator_equal(allocator, self->_node_idx, other_allocator, other_path->_node_idx);
+            if (equal < 0)
+                return NULL;
+            return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+        }
+        int cmp;
+        if (PathAllocator_compare(allocator, self->_node_idx, other_allocator, other_path->_node_idx, &cmp) < 0)
+            return NULL;
+        Py_RETURN_RICHCOMPARE(cmp, 0, op);
+    }
 
     /* For equality, check allocator and node index */
     if (op == Py_EQ) {
@@ -375,17 +1072,77 @@ PureFastPath_richcompare(PureFastPathObject *self, PyObject *other, int op)
     return result;
 }
 
+static PyObject *
+PureFastPath_fspath(PureFastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return PureFastPath_str(self);
+}
+
+/* os.fsencode(path), built from the pool's bytes and cached per node */
+static PyObject *
+PureFastPath_bytes(PureFastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PathAllocatorObject *allocator = native_allocator(self);
+    if (allocator != NULL)
+        return PathAllocator_get_bytes(allocator, self->_node_idx);
+
+    PyObject *str = PureFastPath_str(self);
+    if (str == NULL)
+        return NULL;
+    PyObject *encoded = PyUnicode_EncodeFSDefault(str);
+    Py_DECREF(str);
+    return encoded;
+}
+
 static PyMethodDef PureFastPath_methods[] = {
+    {"__reduce__", (PyCFunction)PureFastPath_reduce, METH_NOARGS,
+     "Pickle as the allocator plus the node index"},
+    {"__fspath__", (PyCFunction)PureFastPath_fspath, METH_NOARGS,
+     "Return the file system path representation"},
+    {"__bytes__", (PyCFunction)PureFastPath_bytes, METH_NOARGS,
+     "Return the path encoded for the file system"},
     {"is_absolute", (PyCFunction)PureFastPath_is_absolute, METH_NOARGS,
      "Return True if the path is absolute"},
+    {"relative_to", (PyCFunction)PureFastPath_relative_to, METH_O,
+     "Return the path relative to another path"},
+    {"is_relative_to", (PyCFunction)PureFastPath_is_relative_to, METH_O,
+     "Check whether the path is equal to or below another path"},
     {"joinpath", (PyCFunction)PureFastPath_joinpath, METH_VARARGS,
      "Join one or more path components"},
+    {"with_name", (PyCFunction)PureFastPath_with_name, METH_O,
+     "Return a new path with the name changed"},
+    {"with_stem", (PyCFunction)PureFastPath_with_stem, METH_O,
+     "Return a new path with the stem changed"},
+    {"with_suffix", (PyCFunction)PureFastPath_with_suffix, METH_O,
+     "Return a new path with the suffix changed, or added if there was none"},
+    {"match", (PyCFunction)PureFastPath_match, METH_O,
+     "Check whether the path matches a glob pattern, compared from the right"},
+    {"glob", (PyCFunction)PureFastPath_glob, METH_O,
+     "Iterate over the known paths below this one that match a glob pattern"},
+    {"rglob", (PyCFunction)PureFastPath_rglob, METH_O,
+     "Like glob() with the pattern prefixed by \"**/\""},
+    {NULL}  /* Sentinel */
+};
+
+static PyMemberDef PureFastPath_members[] = {
+    {"_allocator", T_OBJECT_EX, offsetof(PureFastPathObject, _allocator), READONLY,
+     "Allocator owning this path"},
+    {"_node_idx", T_PYSSIZET, offsetof(PureFastPathObject, _node_idx), READONLY,
+     "Node index in the allocator tree"},
     {NULL}  /* Sentinel */
 };
 
 static PyGetSetDef PureFastPath_getsetters[] = {
     {"parts", (getter)PureFastPath_get_parts, NULL,
      "Tuple of path components", NULL},
+    {"drive", (getter)PureFastPath_get_drive, NULL,
+     "The drive letter or UNC share, if any", NULL},
+    {"root", (getter)PureFastPath_get_root, NULL,
+     "The root separator, if any", NULL},
+    {"anchor", (getter)PureFastPath_get_anchor, NULL,
+     "The drive and root together", NULL},
+    {"parents", (getter)PureFastPath_get_parents, NULL,
+     "Ancestors of the path, nearest first", NULL},
     {"parent", (getter)PureFastPath_get_parent, NULL,
      "The parent directory", NULL},
     {"name", (getter)PureFastPath_get_name, NULL,
@@ -394,13 +1151,13 @@ static PyGetSetDef PureFastPath_getsetters[] = {
      "The final component without suffix", NULL},
     {"suffix", (getter)PureFastPath_get_suffix, NULL,
      "The file extension", NULL},
+    {"suffixes", (getter)PureFastPath_get_suffixes, NULL,
+     "All file extensions, in order", NULL},
     {NULL}  /* Sentinel */
 };
 
 static PyNumberMethods PureFastPath_as_number = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    (binaryfunc)PureFastPath_truediv,  /* nb_true_divide */
-    0, 0
+    .nb_true_divide = (binaryfunc)PureFastPath_truediv,
 };
 
 PyTypeObject PureFastPathType = {
@@ -412,12 +1169,14 @@ PyTypeObject PureFastPathType = {
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
     .tp_new = PureFastPath_new,
     .tp_init = (initproc)PureFastPath_init,
+    .tp_vectorcall = PureFastPath_vectorcall,
     .tp_dealloc = (destructor)PureFastPath_dealloc,
     .tp_repr = (reprfunc)PureFastPath_repr,
     .tp_str = (reprfunc)PureFastPath_str,
     .tp_hash = (hashfunc)PureFastPath_hash,
     .tp_richcompare = (richcmpfunc)PureFastPath_richcompare,
     .tp_methods = PureFastPath_methods,
+    .tp_members = PureFastPath_members,
     .tp_getset = PureFastPath_getsetters,
     .tp_as_number = &PureFastPath_as_number,
 };
@@ -426,40 +1185,25 @@ PyTypeObject PureFastPathType = {
  * FastPath implementation
  * ======================================================================== */
 
-static PyObject *
-FastPath_exists(FastPathObject *self, PyObject *Py_UNUSED(ignored))
-{
-    /* Get string representation of path */
-    PyObject *path_str = PureFastPath_str((PureFastPathObject *)self);
-    if (path_str == NULL)
-        return NULL;
-
-    /* Use os.path.exists */
-    PyObject *os_path = PyImport_ImportModule("os.path");
-    if (os_path == NULL) {
-        Py_DECREF(path_str);
-        return NULL;
-    }
-
-    PyObject *exists = PyObject_GetAttrString(os_path, "exists");
-    Py_DECREF(os_path);
-    if (exists == NULL) {
-        Py_DECREF(path_str);
-        return NULL;
-    }
-
-    PyObject *args = Py_BuildValue("(O)", path_str);
-    PyObject *result = PyObject_Call(exists, args, NULL);
-    Py_DECREF(args);
-    Py_DECREF(exists);
-    Py_DECREF(path_str);
-
-    return result;
-}
-
 static PyMethodDef FastPath_methods[] = {
     {"exists", (PyCFunction)FastPath_exists, METH_NOARGS,
      "Check if path exists"},
+    {"stat", (PyCFunction)FastPath_stat, METH_VARARGS | METH_KEYWORDS,
+     "Return the result of stat() on the path"},
+    {"lstat", (PyCFunction)FastPath_lstat, METH_NOARGS,
+     "Like stat(), but do not follow a final symbolic link"},
+    {"is_file", (PyCFunction)FastPath_is_file, METH_NOARGS,
+     "Check if path is a regular file"},
+    {"is_dir", (PyCFunction)FastPath_is_dir, METH_NOARGS,
+     "Check if path is a directory"},
+    {"iterdir", (PyCFunction)FastPath_iterdir, METH_NOARGS,
+     "Iterate over the entries of the directory"},
+    {"walk", (PyCFunction)FastPath_walk, METH_VARARGS | METH_KEYWORDS,
+     "Walk the directory tree, yielding (dirpath, dirnames, filenames)"},
+    {"glob", (PyCFunction)FastPath_glob, METH_O,
+     "Iterate over the existing paths below this directory that match a glob pattern"},
+    {"rglob", (PyCFunction)FastPath_rglob, METH_O,
+     "Like glob() with the pattern prefixed by \"**/\""},
     {NULL}  /* Sentinel */
 };
 
@@ -471,5 +1215,6 @@ PyTypeObject FastPathType = {
     .tp_itemsize = 0,
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
     .tp_base = &PureFastPathType,  /* Inherit from PureFastPath */
+    .tp_vectorcall = PureFastPath_vectorcall,  /* Never inherited */
     .tp_methods = FastPath_methods,
 };
\ No newline at end of file
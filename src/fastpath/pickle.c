@@ -0,0 +1,581 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Pickling
+ *
+ * A path pickles as its allocator plus its node index, so sending paths
+ * to another process costs neither string encoding nor re-interning.  The
+ * allocator pickles as a token naming it, its node count, and a source to
+ * rebuild it from: the snapshot file written by share(), which receivers
+ * map, or else the node and string arrays inlined into the pickle.  Every
+ * process keeps a weak map from tokens to the allocators it holds for
+ * them, so an allocator arriving again, or coming back to the process it
+ * started in, resolves to the existing object instead of being loaded
+ * twice.  A copy only stands in for its origin up to the nodes it was
+ * loaded with; the two grow apart after that.  Until then it pickles
+ * under the origin's token, still with a source, so a process that has
+ * never seen that token can rebuild it too.  Compaction renumbers nodes,
+ * so it retires the token.
+ * ======================================================================== */
+
+static PyObject *allocator_registry;  /* weakref.WeakValueDictionary of token -> allocator */
+
+static PyObject *
+registry_get(void)
+{
+    if (allocator_registry == NULL) {
+        PyObject *weakref = PyImport_ImportModule("weakref");
+        if (weakref == NULL)
+            return NULL;
+        PyObject *registry = PyObject_CallMethod(weakref, "WeakValueDictionary", NULL);
+        Py_DECREF(weakref);
+        if (registry == NULL)
+            return NULL;
+        /* Another thread may have won the race; keep the first */
+        if (allocator_registry == NULL)
+            allocator_registry = registry;
+        else
+            Py_DECREF(registry);
+    }
+    return allocator_registry;
+}
+
+/* Module-level reconstructor named name, looked up once; borrowed */
+static PyObject *
+restore_function(PyObject **cache, const char *name)
+{
+    if (*cache == NULL) {
+        PyObject *module = PyImport_ImportModule("fastpath");
+        if (module == NULL)
+            return NULL;
+        PyObject *function = PyObject_GetAttrString(module, name);
+        Py_DECREF(module);
+        if (function == NULL)
+            return NULL;
+        if (*cache == NULL)
+            *cache = function;
+        else
+            Py_DECREF(function);
+    }
+    return *cache;
+}
+
+static PyObject *restore_allocator_function;
+static PyObject *restore_path_function;
+static PyObject *restore_paths_function;
+
+/* The allocator's token, created and registered on first use; borrowed */
+static PyObject *
+allocator_token(PathAllocatorObject *self)
+{
+    PyObject *token;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    token = self->token;
+    Py_END_CRITICAL_SECTION();
+    if (token != NULL)
+        return token;
+
+    PyObject *registry = registry_get();
+    PyObject *os = registry ? PyImport_ImportModule("os") : NULL;
+    PyObject *random = os ? PyObject_CallMethod(os, "urandom", "i", 16) : NULL;
+    PyObject *fresh = random ? PyObject_CallMethod(random, "hex", NULL) : NULL;
+    Py_XDECREF(random);
+    Py_XDECREF(os);
+    if (fresh == NULL)
+        return NULL;
+
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    if (self->token == NULL) {
+        self->token = fresh;
+        fresh = NULL;
+    }
+    token = self->token;
+    Py_END_CRITICAL_SECTION();
+    Py_XDECREF(fresh);
+
+    if (PyObject_SetItem(registry, token, (PyObject *)self) < 0)
+        return NULL;
+    return token;
+}
+
+/* Called by compact(): old pickles must not resolve to renumbered nodes */
+void
+PathAllocator_forget_origin(PathAllocatorObject *self)
+{
+    Py_CLEAR(self->token);
+    Py_CLEAR(self->origin_token);
+    Py_CLEAR(self->origin_path);
+    self->origin_nodes = 0;
+    self->share_nodes = -1;
+}
+
+/* Inline form of an allocator: the per-node parent and name arrays plus the
+ * strings in ID order, which rebuilding replays without any parsing.  This
+ * is far smaller than a snapshot, whose sections are padded for mapping.
+ * Like snapshots, it is tied to the byte order and node index width. */
+static PyObject *
+allocator_inline_state(PathAllocatorObject *self)
+{
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    PyObject *parents = NULL, *names = NULL, *lengths = NULL, *blob = NULL, *state = NULL;
+    Py_ssize_t relative_root, absolute_root;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)tree, (PyObject *)pool);
+    relative_root = tree->relative_root;
+    absolute_root = tree->absolute_root;
+    parents = snapshot_copy_chunked(&tree->parents, tree->node_count, NODE_CHUNK_BITS, sizeof(node_index_t));
+    names = parents ? snapshot_copy_chunked(&tree->names, tree->node_count, NODE_CHUNK_BITS, sizeof(uint32_t))
+                    : NULL;
+    lengths = names ? PyBytes_FromStringAndSize(NULL, pool->count * (Py_ssize_t)sizeof(uint32_t)) : NULL;
+    if (lengths != NULL) {
+        uint32_t *length_items = (uint32_t *)PyBytes_AS_STRING(lengths);
+        Py_ssize_t total = 0;
+        for (Py_ssize_t i = 0; i < pool->count; i++) {
+            length_items[i] = string_entry(pool, i)->length;
+            total += length_items[i];
+        }
+        blob = PyBytes_FromStringAndSize(NULL, total);
+        char *dest = blob ? PyBytes_AS_STRING(blob) : NULL;
+        for (Py_ssize_t i = 0; dest != NULL && i < pool->count; i++) {
+            const StringEntry *entry = string_entry(pool, i);
+            memcpy(dest, string_entry_data(pool, entry), entry->length);
+            dest += entry->length;
+        }
+    }
+    Py_END_CRITICAL_SECTION2();
+
+    if (blob != NULL) {
+        state = Py_BuildValue("(iy#innOOOO)", (int)sizeof(node_index_t), self->separator, (Py_ssize_t)1,
+                              self->flavour->id, relative_root, absolute_root, parents, names, lengths, blob);
+    }
+    Py_XDECREF(parents);
+    Py_XDECREF(names);
+    Py_XDECREF(lengths);
+    Py_XDECREF(blob);
+    return state;
+}
+
+/* Rebuild an allocator from allocator_inline_state(), keeping every node
+ * and string ID */
+static PyObject *
+allocator_from_inline_state(PyTypeObject *type, PyObject *state)
+{
+    int index_size, flavour;
+    const char *separator;
+    Py_ssize_t separator_length, relative_root, absolute_root;
+    Py_buffer parents, names, lengths, blob;
+    if (!PyArg_ParseTuple(state, "iy#inny*y*y*y*", &index_size, &separator, &separator_length, &flavour,
+                          &relative_root, &absolute_root, &parents, &names, &lengths, &blob))
+        return NULL;
+
+    PyObject *empty = NULL;
+    PathAllocatorObject *self = NULL;
+    Py_ssize_t node_count = parents.len / (Py_ssize_t)sizeof(node_index_t);
+    Py_ssize_t string_count = lengths.len / (Py_ssize_t)sizeof(uint32_t);
+    if (index_size != (int)sizeof(node_index_t) || separator_length != 1 ||
+        (flavour != FLAVOUR_POSIX && flavour != FLAVOUR_WINDOWS) ||
+        names.len != node_count * (Py_ssize_t)sizeof(uint32_t) ||
+        relative_root < -1 || relative_root >= node_count || absolute_root < -1 || absolute_root >= node_count) {
+        PyErr_SetString(PyExc_ValueError, "corrupt pickled allocator");
+        goto error;
+    }
+
+    empty = PyTuple_New(0);
+    if (empty == NULL)
+        goto error;
+    self = (PathAllocatorObject *)type->tp_new(type, empty, NULL);
+    if (self == NULL)
+        goto error;
+    self->string_pool = (StringPoolObject *)PyObject_CallObject((PyObject *)&StringPoolType, NULL);
+    if (self->string_pool == NULL)
+        goto error;
+    self->tree = (TreeAllocatorObject *)TreeAllocatorType.tp_new(&TreeAllocatorType, empty, NULL);
+    if (self->tree == NULL || tree_setup(self->tree, (PyObject *)self->string_pool) < 0)
+        goto error;
+    /* Before any node is replayed, since the flavour decides how names hash */
+    path_allocator_set_flavour(self, flavour, separator[0]);
+
+    int status = 0;
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)self->tree, (PyObject *)self->string_pool);
+    const uint32_t *length_items = lengths.buf;
+    const char *data = blob.buf;
+    Py_ssize_t offset = 0;
+    for (Py_ssize_t i = 0; status == 0 && i < string_count; i++) {
+        if (length_items[i] > (uint64_t)(blob.len - offset) ||
+            string_pool_intern(self->string_pool, data + offset, length_items[i]) != i) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_ValueError, "corrupt pickled allocator");
+            status = -1;
+        }
+        offset += length_items[i];
+    }
+    const node_index_t *parent_items = parents.buf;
+    const uint32_t *name_items = names.buf;
+    for (Py_ssize_t i = 0; status == 0 && i < node_count; i++) {
+        Py_ssize_t parent_idx = parent_items[i] == NODE_NONE ? -1 : (Py_ssize_t)parent_items[i];
+        if (name_items[i] >= (uint64_t)string_count) {
+            PyErr_SetString(PyExc_ValueError, "corrupt pickled allocator");
+            status = -1;
+        } else if (tree_add_node(self->tree, parent_idx, name_items[i]) < 0) {
+            status = -1;
+        }
+    }
+    Py_END_CRITICAL_SECTION2();
+    if (status < 0)
+        goto error;
+    self->tree->relative_root = relative_root;
+    self->tree->absolute_root = absolute_root;
+
+    Py_DECREF(empty);
+    PyBuffer_Release(&parents);
+    PyBuffer_Release(&names);
+    PyBuffer_Release(&lengths);
+    PyBuffer_Release(&blob);
+    return (PyObject *)self;
+
+error:
+    Py_XDECREF(self);
+    Py_XDECREF(empty);
+    PyBuffer_Release(&parents);
+    PyBuffer_Release(&names);
+    PyBuffer_Release(&lengths);
+    PyBuffer_Release(&blob);
+    return NULL;
+}
+
+static PyObject *
+allocator_save_shared(PathAllocatorObject *self, PyObject *path, Py_ssize_t *node_count)
+{
+    /* The file holds at least the nodes that exist when the save starts */
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self->tree);
+    *node_count = self->tree->node_count;
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *args = PyTuple_Pack(1, path);
+    if (args == NULL)
+        return NULL;
+    PyObject *result = PathAllocator_save(self, args);
+    Py_DECREF(args);
+    return result;
+}
+
+PyObject *
+PathAllocator_share(PathAllocatorObject *self, PyObject *args)
+{
+    PyObject *path;
+    if (!PyArg_ParseTuple(args, "O", &path))
+        return NULL;
+
+    if (path == Py_None) {
+        Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+        Py_CLEAR(self->share_path);
+        self->share_nodes = -1;
+        Py_END_CRITICAL_SECTION();
+        Py_RETURN_NONE;
+    }
+
+    PyObject *fspath = PyOS_FSPath(path);
+    if (fspath == NULL)
+        return NULL;
+    Py_ssize_t node_count;
+    PyObject *result = allocator_save_shared(self, fspath, &node_count);
+    if (result == NULL) {
+        Py_DECREF(fspath);
+        return NULL;
+    }
+
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    Py_XSETREF(self->share_path, fspath);
+    self->share_nodes = node_count;
+    Py_END_CRITICAL_SECTION();
+    return result;
+}
+
+PyObject *
+PathAllocator_reduce(PathAllocatorObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (self->tree == NULL || self->string_pool == NULL) {
+        PyErr_SetString(PyExc_ValueError, "PathAllocator is not initialized");
+        return NULL;
+    }
+
+    PyObject *restore = restore_function(&restore_allocator_function, "_restore_allocator");
+    if (restore == NULL)
+        return NULL;
+
+    Py_ssize_t node_count;
+    PyObject *origin_token = NULL, *origin_path = NULL, *share_path = NULL;
+    Py_ssize_t share_nodes;
+    Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+    node_count = self->tree->node_count;
+    if (self->origin_token != NULL && node_count == self->origin_nodes) {
+        origin_token = self->origin_token;
+        Py_INCREF(origin_token);
+        origin_path = self->origin_path;
+        Py_XINCREF(origin_path);
+    }
+    share_path = self->share_path;
+    Py_XINCREF(share_path);
+    share_nodes = self->share_nodes;
+    Py_END_CRITICAL_SECTION();
+
+    PyObject *result = NULL;
+    PyObject *token = NULL;
+    PyObject *source = NULL;
+    if (origin_token != NULL) {
+        /* Still an exact copy of the allocator it came from, which the
+         * receiver is likely to hold already; the source covers receivers
+         * that do not */
+        token = origin_token;
+        origin_token = NULL;
+        if (share_path != NULL && share_nodes == node_count) {
+            source = share_path;
+            Py_INCREF(source);
+        } else if (origin_path != NULL) {
+            source = origin_path;
+            Py_INCREF(source);
+        } else {
+            source = allocator_inline_state(self);
+            if (source == NULL)
+                goto done;
+        }
+    } else {
+        token = allocator_token(self);
+        if (token == NULL)
+            goto done;
+        Py_INCREF(token);
+        if (share_path != NULL) {
+            if (share_nodes != node_count) {
+                PyObject *saved = allocator_save_shared(self, share_path, &node_count);
+                if (saved == NULL)
+                    goto done;
+                Py_DECREF(saved);
+                Py_BEGIN_CRITICAL_SECTION((PyObject *)self);
+                if (self->share_path == share_path)
+                    self->share_nodes = node_count;
+                Py_END_CRITICAL_SECTION();
+            }
+            source = share_path;
+            Py_INCREF(source);
+        } else {
+            source = allocator_inline_state(self);
+            if (source == NULL)
+                goto done;
+        }
+    }
+    result = Py_BuildValue("O(OOnO)", restore, (PyObject *)Py_TYPE(self), token, node_count, source);
+
+done:
+    Py_XDECREF(source);
+    Py_XDECREF(token);
+    Py_XDECREF(origin_path);
+    Py_XDECREF(share_path);
+    return result;
+}
+
+/* _restore_allocator(type, token, node_count, source) */
+PyObject *
+fastpath_restore_allocator(PyObject *module, PyObject *args)
+{
+    PyTypeObject *type;
+    PyObject *token, *source;
+    Py_ssize_t node_count;
+    if (!PyArg_ParseTuple(args, "O!UnO", &PyType_Type, &type, &token, &node_count, &source))
+        return NULL;
+    if (!PyType_IsSubtype(type, &PathAllocatorType)) {
+        PyErr_Format(PyExc_TypeError, "%.200s is not a PathAllocator type", type->tp_name);
+        return NULL;
+    }
+
+    PyObject *registry = registry_get();
+    if (registry == NULL)
+        return NULL;
+    PyObject *known = PyObject_CallMethod(registry, "get", "O", token);
+    if (known == NULL)
+        return NULL;
+    if (known != Py_None) {
+        PathAllocatorObject *allocator = (PathAllocatorObject *)known;
+        int usable;
+        Py_BEGIN_CRITICAL_SECTION(known);
+        if (allocator->token != NULL && PyUnicode_Compare(allocator->token, token) == 0)
+            usable = node_count <= allocator->tree->node_count;
+        else
+            usable = allocator->origin_token != NULL && node_count <= allocator->origin_nodes;
+        Py_END_CRITICAL_SECTION();
+        if (usable)
+            return known;
+    }
+    Py_DECREF(known);
+
+    PyObject *loaded;
+    if (source == Py_None) {
+        PyErr_SetString(PyExc_ValueError, "the pickled allocator is not known in this process");
+        return NULL;
+    } else if (PyTuple_Check(source)) {
+        loaded = allocator_from_inline_state(type, source);
+    } else {
+        loaded = PyObject_CallMethod((PyObject *)type, "load", "O", source);
+    }
+    if (loaded == NULL)
+        return NULL;
+
+    PathAllocatorObject *allocator = (PathAllocatorObject *)loaded;
+    if (allocator->tree->node_count < node_count) {
+        PyErr_SetString(PyExc_ValueError, "the shared allocator snapshot is older than the pickle");
+        Py_DECREF(loaded);
+        return NULL;
+    }
+    Py_INCREF(token);
+    allocator->origin_token = token;
+    allocator->origin_nodes = allocator->tree->node_count;
+    if (!PyTuple_Check(source)) {
+        Py_INCREF(source);
+        allocator->origin_path = source;
+    }
+    if (PyObject_SetItem(registry, token, loaded) < 0) {
+        Py_DECREF(loaded);
+        return NULL;
+    }
+    return loaded;
+}
+
+/* ========================================================================
+ * Paths
+ * ======================================================================== */
+
+static int
+path_check_restored(PyObject *allocator, Py_ssize_t node_idx)
+{
+    if (PyObject_TypeCheck(allocator, &PathAllocatorType) &&
+        (node_idx < 0 || node_idx >= ((PathAllocatorObject *)allocator)->tree->node_count)) {
+        PyErr_SetString(PyExc_ValueError, "pickled node index is out of range for its allocator");
+        return -1;
+    }
+    return 0;
+}
+
+PyObject *
+PureFastPath_reduce(PureFastPathObject *self, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *restore = restore_function(&restore_path_function, "_restore_path");
+    if (restore == NULL)
+        return NULL;
+    return Py_BuildValue("O(OOn)", restore, (PyObject *)Py_TYPE(self), self->_allocator, self->_node_idx);
+}
+
+/* _restore_path(type, allocator, node_idx) */
+PyObject *
+fastpath_restore_path(PyObject *module, PyObject *args)
+{
+    PyTypeObject *type;
+    PyObject *allocator;
+    Py_ssize_t node_idx;
+    if (!PyArg_ParseTuple(args, "O!On", &PyType_Type, &type, &allocator, &node_idx))
+        return NULL;
+    if (!PyType_IsSubtype(type, &PureFastPathType)) {
+        PyErr_Format(PyExc_TypeError, "%.200s is not a PureFastPath type", type->tp_name);
+        return NULL;
+    }
+    if (path_check_restored(allocator, node_idx) < 0)
+        return NULL;
+    return PureFastPath_from_index(type, allocator, node_idx);
+}
+
+/* ========================================================================
+ * PathList
+ *
+ * A list whose pickle packs paths of one allocator and type into a single
+ * index array instead of one reduce tuple per path.
+ * ======================================================================== */
+
+static PyObject *
+PathList_reduce(PyObject *self, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t count = PyList_GET_SIZE(self);
+    PyTypeObject *path_type = NULL;
+    PyObject *allocator = NULL;
+    int packable = count > 0;
+    for (Py_ssize_t i = 0; packable && i < count; i++) {
+        PyObject *item = PyList_GET_ITEM(self, i);
+        if (!PyObject_TypeCheck(item, &PureFastPathType)) {
+            packable = 0;
+        } else if (i == 0) {
+            path_type = Py_TYPE(item);
+            allocator = ((PureFastPathObject *)item)->_allocator;
+        } else {
+            packable = Py_TYPE(item) == path_type && ((PureFastPathObject *)item)->_allocator == allocator;
+        }
+    }
+
+    if (!packable) {
+        /* Mixed contents pickle item by item, like a plain list */
+        PyObject *items = PySequence_List(self);
+        if (items == NULL)
+            return NULL;
+        PyObject *result = Py_BuildValue("O(N)", (PyObject *)Py_TYPE(self), items);
+        return result;
+    }
+
+    int64_t *indices = PyMem_Malloc(count * sizeof(int64_t));
+    if (indices == NULL)
+        return PyErr_NoMemory();
+    for (Py_ssize_t i = 0; i < count; i++)
+        indices[i] = ((PureFastPathObject *)PyList_GET_ITEM(self, i))->_node_idx;
+    PyObject *array = fastpath_index_array(indices, count);
+    PyMem_Free(indices);
+    if (array == NULL)
+        return NULL;
+
+    PyObject *restore = restore_function(&restore_paths_function, "_restore_paths");
+    if (restore == NULL) {
+        Py_DECREF(array);
+        return NULL;
+    }
+    return Py_BuildValue("O(OOON)", restore, (PyObject *)Py_TYPE(self), (PyObject *)path_type, allocator, array);
+}
+
+/* _restore_paths(list_type, path_type, allocator, indices) */
+PyObject *
+fastpath_restore_paths(PyObject *module, PyObject *args)
+{
+    PyTypeObject *list_type, *path_type;
+    PyObject *allocator, *indices;
+    if (!PyArg_ParseTuple(args, "O!O!OO", &PyType_Type, &list_type, &PyType_Type, &path_type, &allocator,
+                          &indices))
+        return NULL;
+    if (!PyType_IsSubtype(list_type, &PathListType) || !PyType_IsSubtype(path_type, &PureFastPathType)) {
+        PyErr_SetString(PyExc_TypeError, "_restore_paths() needs a PathList and a PureFastPath type");
+        return NULL;
+    }
+
+    IndexBuffer buf = {NULL, 0, 0};
+    if (index_buffer_collect(indices, &buf) < 0)
+        return NULL;
+    PyObject *result = PyObject_CallNoArgs((PyObject *)list_type);
+    for (Py_ssize_t i = 0; result != NULL && i < buf.count; i++) {
+        PyObject *path = NULL;
+        if (path_check_restored(allocator, (Py_ssize_t)buf.items[i]) == 0)
+            path = PureFastPath_from_index(path_type, allocator, (Py_ssize_t)buf.items[i]);
+        if (path == NULL || PyList_Append(result, path) < 0)
+            Py_CLEAR(result);
+        Py_XDECREF(path);
+    }
+    PyMem_Free(buf.items);
+    return result;
+}
+
+static PyMethodDef PathList_methods[] = {
+    {"__reduce__", (PyCFunction)PathList_reduce, METH_NOARGS,
+     "Pickle paths of one allocator as a packed index array"},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PathListType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "fastpath.PathList",
+    .tp_doc = "List of paths that pickles as one index array when they share an allocator",
+    .tp_basicsize = sizeof(PyListObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_methods = PathList_methods,
+};
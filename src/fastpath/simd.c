@@ -0,0 +1,132 @@
+#include "fastpath.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FASTPATH_X86 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#define FASTPATH_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FASTPATH_NEON 1
+#endif
+
+/* ========================================================================
+ * Vectorized byte scanning
+ *
+ * fastpath_byte_mask turns a 64-byte block into a bitmask of the bytes
+ * equal to a given value.  The parser walks separators by taking the lowest
+ * set bit of each block's mask instead of testing byte by byte, and the
+ * dot searches behind stem and suffix take the highest.  The kernel is
+ * picked once at import: AVX2 when the CPU has it, otherwise SSE2 on x86
+ * and NEON on AArch64, both part of the baseline ISA there, with a scalar loop
+ * everywhere else.
+ * ======================================================================== */
+
+static uint64_t
+byte_mask_scalar(const char *block, char c)
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; i++)
+        mask |= (uint64_t)(block[i] == c) << i;
+    return mask;
+}
+
+#if defined(FASTPATH_X86) && (defined(__SSE2__) || defined(_M_X64))
+#define FASTPATH_SSE2 1
+static uint64_t
+byte_mask_sse2(const char *block, char c)
+{
+    __m128i needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)) << (16 * i);
+    }
+    return mask;
+}
+#endif
+
+#if defined(FASTPATH_X86) && defined(__GNUC__)
+#define FASTPATH_AVX2 1
+__attribute__((target("avx2"))) static uint64_t
+byte_mask_avx2(const char *block, char c)
+{
+    __m256i needle = _mm256_set1_epi8(c);
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+    uint32_t lo_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+    uint32_t hi_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+    return (uint64_t)lo_mask | ((uint64_t)hi_mask << 32);
+}
+#endif
+
+#ifdef FASTPATH_NEON
+static uint64_t
+byte_mask_neon(const char *block, char c)
+{
+    /* Keep one bit per byte at its lane position, then add the lanes of
+     * each half together into a 16-bit mask */
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t needle = vdupq_n_u8((uint8_t)c);
+    uint8x16_t weights = vld1q_u8(bits);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *)block + 16 * i);
+        uint8x16_t hits = vandq_u8(vceqq_u8(chunk, needle), weights);
+        uint64_t lo = vaddv_u8(vget_low_u8(hits));
+        uint64_t hi = vaddv_u8(vget_high_u8(hits));
+        mask |= (lo | (hi << 8)) << (16 * i);
+    }
+    return mask;
+}
+#endif
+
+ByteMaskFunc fastpath_byte_mask = byte_mask_scalar;
+const char *fastpath_simd = "scalar";
+
+void
+fastpath_simd_init(void)
+{
+#ifdef FASTPATH_SSE2
+    fastpath_byte_mask = byte_mask_sse2;
+    fastpath_simd = "sse2";
+#endif
+#ifdef FASTPATH_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fastpath_byte_mask = byte_mask_avx2;
+        fastpath_simd = "avx2";
+    }
+#endif
+#ifdef FASTPATH_NEON
+    fastpath_byte_mask = byte_mask_neon;
+    fastpath_simd = "neon";
+#endif
+}
+
+/* Mask of the final partial block, copied out so nothing past length is read */
+uint64_t
+byte_mask_partial(const char *data, Py_ssize_t length, char c)
+{
+    char block[64];
+    memcpy(block, data, length);
+    memset(block + length, c ^ 1, 64 - length);
+    return fastpath_byte_mask(block, c);
+}
+
+/* Offset of the last c in data[0:length], or -1 */
+Py_ssize_t
+fastpath_rfind_byte(const char *data, Py_ssize_t length, char c)
+{
+    Py_ssize_t base = length & ~(Py_ssize_t)63;
+    uint64_t mask = base < length ? byte_mask_partial(data + base, length - base, c) : 0;
+    for (;;) {
+        if (mask != 0)
+            return base + chunk_log2(mask);
+        if (base == 0)
+            return -1;
+        base -= 64;
+        mask = fastpath_byte_mask(data + base, c);
+    }
+}
@@ -0,0 +1,620 @@
+#include "fastpath.h"
+
+/* ========================================================================
+ * Allocator snapshots
+ *
+ * A snapshot is a flat binary image of a PathAllocator: a fixed header
+ * followed by page-aligned sections holding the per-node arrays, the child
+ * index, the string entries, the string bytes and the string table.
+ * Chunked arrays are written padded to their full chunk capacity, so on
+ * load the sections are used in place as the leading chunks and later
+ * growth lands in freshly allocated chunks.  Loading maps the file
+ * copy-on-write: untouched pages stay shared with every other process
+ * that maps the same snapshot.
+ *
+ * Bump SNAPSHOT_VERSION whenever the layout or a hash function changes.
+ * ======================================================================== */
+
+#define SNAPSHOT_MAGIC "FPSNAP\0\0"
+#define SNAPSHOT_VERSION 7
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGN 4096
+#define SNAPSHOT_MAX_ELEMENT_BITS 48
+
+enum {
+    SNAPSHOT_PARENTS,
+    SNAPSHOT_NAMES,
+    SNAPSHOT_ANCHORS,
+    SNAPSHOT_HASHES,
+    SNAPSHOT_FIRST_CHILDREN,
+    SNAPSHOT_NEXT_SIBLINGS,
+    SNAPSHOT_DEPTHS,
+    SNAPSHOT_CHILD_INDEX,
+    SNAPSHOT_ENTRIES,
+    SNAPSHOT_BYTES,
+    SNAPSHOT_TABLE,
+    SNAPSHOT_SECTION_COUNT
+};
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} SnapshotSection;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;       /* SNAPSHOT_BYTE_ORDER in the writer's byte order */
+    uint32_t node_index_size;  /* sizeof(node_index_t) of the writer */
+    uint32_t separator;        /* Path separator byte */
+    uint32_t flavour;          /* FLAVOUR_*, which also decides how names hash */
+    uint32_t reserved;
+    uint64_t file_size;
+    uint64_t node_count;
+    uint64_t node_chunks;
+    uint64_t relative_root;
+    uint64_t absolute_root;
+    uint64_t child_index_capacity;
+    uint64_t child_index_count;
+    uint64_t string_count;
+    uint64_t string_chunks;
+    uint64_t bytes_used;
+    uint64_t bytes_chunks;
+    uint64_t table_capacity;
+    uint64_t depth_total;      /* Sum of the depths of all nodes */
+    SnapshotSection sections[SNAPSHOT_SECTION_COUNT];
+} SnapshotHeader;
+
+static inline uint64_t
+snapshot_align(uint64_t offset)
+{
+    return (offset + SNAPSHOT_ALIGN - 1) & ~(uint64_t)(SNAPSHOT_ALIGN - 1);
+}
+
+/* Lay out the sections of a snapshot for the given allocator */
+static void
+snapshot_layout(PathAllocatorObject *self, SnapshotHeader *header)
+{
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->byte_order = SNAPSHOT_BYTE_ORDER;
+    header->node_index_size = sizeof(node_index_t);
+    header->separator = (unsigned char)self->separator[0];
+    header->flavour = (uint32_t)self->flavour->id;
+    header->node_count = tree->node_count;
+    header->node_chunks = tree->depths.count;
+    header->relative_root = tree->relative_root;
+    header->absolute_root = tree->absolute_root;
+    header->child_index_capacity = tree->child_index_capacity;
+    header->child_index_count = tree->child_index_count;
+    header->string_count = pool->count;
+    header->string_chunks = pool->objects.count;
+    header->bytes_used = pool->bytes_used;
+    header->bytes_chunks = pool->bytes.count;
+    header->table_capacity = pool->table_capacity;
+    header->depth_total = tree->depth_total;
+
+    uint64_t node_capacity = chunk_capacity(tree->depths.count, NODE_CHUNK_BITS);
+    uint64_t sizes[SNAPSHOT_SECTION_COUNT] = {
+        [SNAPSHOT_PARENTS] = node_capacity * sizeof(node_index_t),
+        [SNAPSHOT_NAMES] = node_capacity * sizeof(uint32_t),
+        [SNAPSHOT_ANCHORS] = node_capacity * sizeof(node_index_t),
+        [SNAPSHOT_HASHES] = node_capacity * sizeof(uint64_t),
+        [SNAPSHOT_FIRST_CHILDREN] = node_capacity * sizeof(node_index_t),
+        [SNAPSHOT_NEXT_SIBLINGS] = node_capacity * sizeof(node_index_t),
+        [SNAPSHOT_DEPTHS] = node_capacity * sizeof(uint32_t),
+        [SNAPSHOT_CHILD_INDEX] = (uint64_t)tree->child_index_capacity * sizeof(node_index_t),
+        [SNAPSHOT_ENTRIES] = chunk_capacity(pool->objects.count, STRING_ENTRY_CHUNK_BITS) * sizeof(StringEntry),
+        [SNAPSHOT_BYTES] = chunk_capacity(pool->bytes.count, STRING_BYTES_CHUNK_BITS),
+        [SNAPSHOT_TABLE] = (uint64_t)pool->table_capacity * sizeof(uint32_t),
+    };
+
+    uint64_t offset = snapshot_align(sizeof(SnapshotHeader));
+    for (int i = 0; i < SNAPSHOT_SECTION_COUNT; i++) {
+        header->sections[i].offset = offset;
+        header->sections[i].size = sizes[i];
+        offset = snapshot_align(offset + sizes[i]);
+    }
+    header->file_size = offset;
+}
+
+static int
+snapshot_write_at(PyObject *file, uint64_t offset, const void *data, Py_ssize_t size)
+{
+    PyObject *result = PyObject_CallMethod(file, "seek", "K", (unsigned long long)offset);
+    if (result == NULL)
+        return -1;
+    Py_DECREF(result);
+
+    PyObject *view = PyMemoryView_FromMemory((char *)data, size, PyBUF_READ);
+    if (view == NULL)
+        return -1;
+    result = PyObject_CallMethod(file, "write", "O", view);
+    Py_DECREF(view);
+    if (result == NULL)
+        return -1;
+    Py_DECREF(result);
+    return 0;
+}
+
+/* Write the used part of a chunked array; the rest of the section stays zero */
+static int
+snapshot_write_chunked(PyObject *file, const SnapshotSection *section, const ChunkedArray *array,
+                       Py_ssize_t used, int base_bits, size_t elem_size)
+{
+    for (int k = 0; k < array->count; k++) {
+        Py_ssize_t start = chunk_capacity(k, base_bits);
+        if (start >= used)
+            break;
+        if (array->chunks[k] == NULL)
+            continue;
+
+        Py_ssize_t size = (Py_ssize_t)1 << (base_bits + k);
+        if (size > used - start)
+            size = used - start;
+        if (snapshot_write_at(file, section->offset + (uint64_t)start * elem_size,
+                              array->chunks[k], size * (Py_ssize_t)elem_size) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Copy the used part of a chunked array into one flat bytes object; the
+ * section layout is the chunks back to back, so it is written as is */
+PyObject *
+snapshot_copy_chunked(const ChunkedArray *array, Py_ssize_t used, int base_bits, size_t elem_size)
+{
+    PyObject *copy = PyBytes_FromStringAndSize(NULL, used * (Py_ssize_t)elem_size);
+    if (copy == NULL)
+        return NULL;
+    for (Py_ssize_t start = 0; start < used;) {
+        Py_ssize_t offset;
+        int k = chunk_locate(start, base_bits, &offset);
+        Py_ssize_t size = ((Py_ssize_t)1 << (base_bits + k)) - offset;
+        if (size > used - start)
+            size = used - start;
+        memcpy(PyBytes_AS_STRING(copy) + start * elem_size, array->chunks[k] + offset * elem_size,
+               size * elem_size);
+        start += size;
+    }
+    return copy;
+}
+
+int
+snapshot_write(PathAllocatorObject *self, PyObject *file)
+{
+    TreeAllocatorObject *tree = self->tree;
+    StringPoolObject *pool = self->string_pool;
+    SnapshotHeader header;
+    PyObject *child_index = NULL;
+    PyObject *table = NULL;
+    PyObject *first_children = NULL;
+
+    /* The hash tables are replaced when they grow and a node's first child
+     * link changes when a child is added, while file writes may release
+     * the GIL, so copy them together with the counts they match.  Other
+     * node and string data below those counts never changes or moves. */
+    Py_BEGIN_CRITICAL_SECTION2((PyObject *)tree, (PyObject *)pool);
+    snapshot_layout(self, &header);
+    child_index = PyBytes_FromStringAndSize((const char *)tree->child_index,
+                                            header.sections[SNAPSHOT_CHILD_INDEX].size);
+    if (child_index != NULL) {
+        table = PyBytes_FromStringAndSize((const char *)pool->table, header.sections[SNAPSHOT_TABLE].size);
+    }
+    if (table != NULL) {
+        first_children = snapshot_copy_chunked(&tree->first_children, header.node_count, NODE_CHUNK_BITS,
+                                               sizeof(node_index_t));
+    }
+    Py_END_CRITICAL_SECTION2();
+
+    int status = -1;
+    if (first_children == NULL)
+        goto done;
+
+    if (snapshot_write_at(file, 0, &header, sizeof(header)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_PARENTS], &tree->parents,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(node_index_t)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_NAMES], &tree->names,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(uint32_t)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_ANCHORS], &tree->anchors,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(node_index_t)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_HASHES], &tree->hashes,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(uint64_t)) < 0 ||
+        snapshot_write_at(file, header.sections[SNAPSHOT_FIRST_CHILDREN].offset,
+                          PyBytes_AS_STRING(first_children), PyBytes_GET_SIZE(first_children)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_NEXT_SIBLINGS], &tree->next_siblings,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(node_index_t)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_DEPTHS], &tree->depths,
+                               header.node_count, NODE_CHUNK_BITS, sizeof(uint32_t)) < 0 ||
+        snapshot_write_at(file, header.sections[SNAPSHOT_CHILD_INDEX].offset,
+                          PyBytes_AS_STRING(child_index), PyBytes_GET_SIZE(child_index)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_ENTRIES], &pool->entries,
+                               header.string_count, STRING_ENTRY_CHUNK_BITS, sizeof(StringEntry)) < 0 ||
+        snapshot_write_chunked(file, &header.sections[SNAPSHOT_BYTES], &pool->bytes,
+                               header.bytes_used, STRING_BYTES_CHUNK_BITS, 1) < 0 ||
+        snapshot_write_at(file, header.sections[SNAPSHOT_TABLE].offset,
+                          PyBytes_AS_STRING(table), PyBytes_GET_SIZE(table)) < 0) {
+        goto done;
+    }
+
+    /* Extend the file over the zero padding after the last section */
+    PyObject *result = PyObject_CallMethod(file, "truncate", "K", (unsigned long long)header.file_size);
+    if (result == NULL)
+        goto done;
+    Py_DECREF(result);
+    status = 0;
+
+done:
+    Py_XDECREF(child_index);
+    Py_XDECREF(table);
+    Py_XDECREF(first_children);
+    return status;
+}
+
+/* Append a suffix to a str or bytes path */
+static PyObject *
+snapshot_temp_path(PyObject *path)
+{
+    PyObject *fspath = PyOS_FSPath(path);
+    if (fspath == NULL)
+        return NULL;
+
+    PyObject *result;
+    if (PyBytes_Check(fspath)) {
+        result = PyBytes_FromFormat("%s.tmp", PyBytes_AS_STRING(fspath));
+    } else {
+        result = PyUnicode_FromFormat("%U.tmp", fspath);
+    }
+    Py_DECREF(fspath);
+    return result;
+}
+
+PyObject *
+PathAllocator_save(PathAllocatorObject *self, PyObject *args)
+{
+    PyObject *path;
+    if (!PyArg_ParseTuple(args, "O", &path))
+        return NULL;
+
+    if (self->tree == NULL || self->string_pool == NULL) {
+        PyErr_SetString(PyExc_ValueError, "PathAllocator is not initialized");
+        return NULL;
+    }
+
+    /* Write next to the target and rename over it, so processes that have
+     * the old snapshot mapped never see a truncated file */
+    PyObject *temp_path = snapshot_temp_path(path);
+    if (temp_path == NULL)
+        return NULL;
+
+    PyObject *io = PyImport_ImportModule("io");
+    PyObject *os = PyImport_ImportModule("os");
+    PyObject *file = NULL;
+    PyObject *result = NULL;
+    if (io == NULL || os == NULL)
+        goto done;
+
+    file = PyObject_CallMethod(io, "open", "Os", temp_path, "wb");
+    if (file == NULL)
+        goto done;
+
+    int status = snapshot_write(self, file);
+    PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+    if (status < 0 || closed == NULL) {
+        Py_XDECREF(closed);
+        PyObject *exc_type, *exc_value, *exc_tb;
+        PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+        PyObject *removed = PyObject_CallMethod(os, "unlink", "O", temp_path);
+        Py_XDECREF(removed);
+        PyErr_Restore(exc_type, exc_value, exc_tb);
+        goto done;
+    }
+    Py_DECREF(closed);
+
+    PyObject *replaced = PyObject_CallMethod(os, "replace", "OO", temp_path, path);
+    if (replaced == NULL)
+        goto done;
+    Py_DECREF(replaced);
+
+    result = Py_None;
+    Py_INCREF(result);
+
+done:
+    Py_XDECREF(file);
+    Py_XDECREF(os);
+    Py_XDECREF(io);
+    Py_DECREF(temp_path);
+    return result;
+}
+
+/* Read a snapshot file into a writable buffer object */
+static PyObject *
+snapshot_open_buffer(PyObject *path, int use_mmap)
+{
+    PyObject *io = PyImport_ImportModule("io");
+    if (io == NULL)
+        return NULL;
+    PyObject *file = PyObject_CallMethod(io, "open", "Os", path, "rb");
+    Py_DECREF(io);
+    if (file == NULL)
+        return NULL;
+
+    PyObject *buffer = NULL;
+    if (use_mmap) {
+        PyObject *mmap_module = PyImport_ImportModule("mmap");
+        PyObject *fileno = mmap_module ? PyObject_CallMethod(file, "fileno", NULL) : NULL;
+        PyObject *access = fileno ? PyObject_GetAttrString(mmap_module, "ACCESS_COPY") : NULL;
+        if (access != NULL) {
+            /* Private mapping: pages are shared until written */
+            PyObject *mmap_type = PyObject_GetAttrString(mmap_module, "mmap");
+            PyObject *mmap_args = mmap_type ? Py_BuildValue("(Oi)", fileno, 0) : NULL;
+            PyObject *mmap_kwargs = mmap_args ? Py_BuildValue("{sO}", "access", access) : NULL;
+            if (mmap_kwargs != NULL)
+                buffer = PyObject_Call(mmap_type, mmap_args, mmap_kwargs);
+            Py_XDECREF(mmap_kwargs);
+            Py_XDECREF(mmap_args);
+            Py_XDECREF(mmap_type);
+        }
+        Py_XDECREF(access);
+        Py_XDECREF(fileno);
+        Py_XDECREF(mmap_module);
+    } else {
+        PyObject *data = PyObject_CallMethod(file, "read", NULL);
+        if (data != NULL) {
+            buffer = PyByteArray_FromObject(data);
+            Py_DECREF(data);
+        }
+    }
+
+    PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+    Py_DECREF(file);
+    if (closed == NULL) {
+        Py_XDECREF(buffer);
+        return NULL;
+    }
+    Py_DECREF(closed);
+    return buffer;
+}
+
+static int
+snapshot_check_section(const SnapshotHeader *header, int section, uint64_t expected_size, size_t align)
+{
+    const SnapshotSection *s = &header->sections[section];
+    if (s->size != expected_size || s->offset % align != 0 ||
+        s->offset > header->file_size || s->size > header->file_size - s->offset) {
+        PyErr_SetString(PyExc_ValueError, "corrupt snapshot: bad section layout");
+        return -1;
+    }
+    return 0;
+}
+
+static int
+snapshot_is_pow2(uint64_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+/* Chunk counts are bounded so that section sizes cannot overflow */
+static int
+snapshot_chunks_ok(uint64_t count, int base_bits)
+{
+    return count <= CHUNK_MAX && count + base_bits <= SNAPSHOT_MAX_ELEMENT_BITS;
+}
+
+/* Check the header describes a structurally valid snapshot of view_len bytes */
+static int
+snapshot_validate(const SnapshotHeader *header, Py_ssize_t view_len)
+{
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        PyErr_SetString(PyExc_ValueError, "not a fastpath snapshot");
+        return -1;
+    }
+    if (header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        PyErr_SetString(PyExc_ValueError, "snapshot was written on a machine with a different byte order");
+        return -1;
+    }
+    if (header->version != SNAPSHOT_VERSION) {
+        PyErr_Format(PyExc_ValueError, "unsupported snapshot version %u (expected %d)",
+                     header->version, SNAPSHOT_VERSION);
+        return -1;
+    }
+    if (header->flavour != FLAVOUR_POSIX && header->flavour != FLAVOUR_WINDOWS) {
+        PyErr_Format(PyExc_ValueError, "unknown snapshot path flavour %u", header->flavour);
+        return -1;
+    }
+    if (header->node_index_size != sizeof(node_index_t)) {
+        PyErr_Format(PyExc_ValueError, "snapshot uses %u-byte node indices, this build uses %d",
+                     header->node_index_size, (int)sizeof(node_index_t));
+        return -1;
+    }
+    if (header->file_size != (uint64_t)view_len) {
+        PyErr_SetString(PyExc_ValueError, "corrupt snapshot: file size mismatch");
+        return -1;
+    }
+
+    if (!snapshot_chunks_ok(header->node_chunks, NODE_CHUNK_BITS) ||
+        !snapshot_chunks_ok(header->string_chunks, STRING_ENTRY_CHUNK_BITS) ||
+        !snapshot_chunks_ok(header->bytes_chunks, STRING_BYTES_CHUNK_BITS) ||
+        header->node_count > (uint64_t)chunk_capacity((int)header->node_chunks, NODE_CHUNK_BITS) ||
+        header->node_count > (uint64_t)NODE_INDEX_MAX ||
+        header->relative_root >= header->node_count || header->absolute_root >= header->node_count ||
+        header->string_count > (uint64_t)chunk_capacity((int)header->string_chunks, STRING_ENTRY_CHUNK_BITS) ||
+        header->bytes_used > (uint64_t)chunk_capacity((int)header->bytes_chunks, STRING_BYTES_CHUNK_BITS) ||
+        !snapshot_is_pow2(header->child_index_capacity) ||
+        header->child_index_count * 2 > header->child_index_capacity ||
+        !snapshot_is_pow2(header->table_capacity) ||
+        header->string_count * 2 > header->table_capacity) {
+        PyErr_SetString(PyExc_ValueError, "corrupt snapshot: bad header");
+        return -1;
+    }
+
+    uint64_t node_capacity = chunk_capacity((int)header->node_chunks, NODE_CHUNK_BITS);
+    if (snapshot_check_section(header, SNAPSHOT_PARENTS, node_capacity * sizeof(node_index_t),
+                               sizeof(node_index_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_NAMES, node_capacity * sizeof(uint32_t),
+                               sizeof(uint32_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_ANCHORS, node_capacity * sizeof(node_index_t),
+                               sizeof(node_index_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_HASHES, node_capacity * sizeof(uint64_t),
+                               sizeof(uint64_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_FIRST_CHILDREN, node_capacity * sizeof(node_index_t),
+                               sizeof(node_index_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_NEXT_SIBLINGS, node_capacity * sizeof(node_index_t),
+                               sizeof(node_index_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_DEPTHS, node_capacity * sizeof(uint32_t),
+                               sizeof(uint32_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_CHILD_INDEX,
+                               header->child_index_capacity * sizeof(node_index_t), sizeof(node_index_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_ENTRIES,
+                               chunk_capacity((int)header->string_chunks, STRING_ENTRY_CHUNK_BITS) * sizeof(StringEntry),
+                               sizeof(uint64_t)) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_BYTES,
+                               chunk_capacity((int)header->bytes_chunks, STRING_BYTES_CHUNK_BITS), 1) < 0 ||
+        snapshot_check_section(header, SNAPSHOT_TABLE, header->table_capacity * sizeof(uint32_t),
+                               sizeof(uint32_t)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Use the snapshot sections as the leading storage of a fresh pool */
+static int
+snapshot_attach_pool(StringPoolObject *pool, PyObject *buffer, const SnapshotHeader *header)
+{
+    if (PyObject_GetBuffer(buffer, &pool->snapshot, PyBUF_WRITABLE) < 0)
+        return -1;
+    char *base = pool->snapshot.buf;
+
+    chunked_borrow(&pool->entries, base + header->sections[SNAPSHOT_ENTRIES].offset,
+                   (int)header->string_chunks, STRING_ENTRY_CHUNK_BITS, sizeof(StringEntry));
+    chunked_borrow(&pool->bytes, base + header->sections[SNAPSHOT_BYTES].offset,
+                   (int)header->bytes_chunks, STRING_BYTES_CHUNK_BITS, 1);
+    while (pool->objects.count < (int)header->string_chunks) {
+        if (chunked_grow(&pool->objects, STRING_ENTRY_CHUNK_BITS, sizeof(PyObject *), 1) < 0)
+            return -1;
+    }
+
+    block_free(pool->table, pool->table_capacity * sizeof(uint32_t));
+    pool->table = (uint32_t *)(base + header->sections[SNAPSHOT_TABLE].offset);
+    pool->table_capacity = (Py_ssize_t)header->table_capacity;
+    pool->table_borrowed = 1;
+
+    pool->count = (Py_ssize_t)header->string_count;
+    pool->capacity = chunk_capacity((int)header->string_chunks, STRING_ENTRY_CHUNK_BITS);
+    pool->bytes_used = (Py_ssize_t)header->bytes_used;
+    return 0;
+}
+
+/* Use the snapshot sections as the leading storage of a fresh tree */
+static int
+snapshot_attach_tree(TreeAllocatorObject *tree, PyObject *buffer, const SnapshotHeader *header)
+{
+    if (PyObject_GetBuffer(buffer, &tree->snapshot, PyBUF_WRITABLE) < 0)
+        return -1;
+    char *base = tree->snapshot.buf;
+    int chunks = (int)header->node_chunks;
+
+    chunked_borrow(&tree->parents, base + header->sections[SNAPSHOT_PARENTS].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(node_index_t));
+    chunked_borrow(&tree->names, base + header->sections[SNAPSHOT_NAMES].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(uint32_t));
+    chunked_borrow(&tree->anchors, base + header->sections[SNAPSHOT_ANCHORS].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(node_index_t));
+    chunked_borrow(&tree->hashes, base + header->sections[SNAPSHOT_HASHES].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(uint64_t));
+    chunked_borrow(&tree->first_children, base + header->sections[SNAPSHOT_FIRST_CHILDREN].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(node_index_t));
+    chunked_borrow(&tree->next_siblings, base + header->sections[SNAPSHOT_NEXT_SIBLINGS].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(node_index_t));
+    chunked_borrow(&tree->depths, base + header->sections[SNAPSHOT_DEPTHS].offset,
+                   chunks, NODE_CHUNK_BITS, sizeof(uint32_t));
+    tree->node_count = (Py_ssize_t)header->node_count;
+    tree->depth_total = header->depth_total;
+    tree->node_capacity = chunk_capacity(chunks, NODE_CHUNK_BITS);
+
+    tree->child_index = (node_index_t *)(base + header->sections[SNAPSHOT_CHILD_INDEX].offset);
+    tree->child_index_capacity = (Py_ssize_t)header->child_index_capacity;
+    tree->child_index_count = (Py_ssize_t)header->child_index_count;
+    tree->child_index_borrowed = 1;
+
+    tree->relative_root = (Py_ssize_t)header->relative_root;
+    tree->absolute_root = (Py_ssize_t)header->absolute_root;
+    tree->path_string_budget = PATH_CACHE_DEFAULT_BYTES;
+    return 0;
+}
+
+/* New allocator of the given type using a writable snapshot buffer in place */
+PyObject *
+snapshot_load_buffer(PyTypeObject *type, PyObject *buffer)
+{
+    PyObject *empty = NULL;
+    PathAllocatorObject *self = NULL;
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_SIMPLE) < 0)
+        goto error;
+
+    SnapshotHeader header;
+    int valid = -1;
+    if (view.len < (Py_ssize_t)sizeof(header)) {
+        PyErr_SetString(PyExc_ValueError, "not a fastpath snapshot");
+    } else {
+        memcpy(&header, view.buf, sizeof(header));
+        valid = snapshot_validate(&header, view.len);
+    }
+    PyBuffer_Release(&view);
+    if (valid < 0)
+        goto error;
+
+    empty = PyTuple_New(0);
+    if (empty == NULL)
+        goto error;
+    self = (PathAllocatorObject *)type->tp_new(type, empty, NULL);
+    if (self == NULL)
+        goto error;
+    self->string_pool = (StringPoolObject *)StringPoolType.tp_new(&StringPoolType, empty, NULL);
+    if (self->string_pool == NULL)
+        goto error;
+    self->tree = (TreeAllocatorObject *)TreeAllocatorType.tp_new(&TreeAllocatorType, empty, NULL);
+    if (self->tree == NULL)
+        goto error;
+    Py_INCREF(self->string_pool);
+    self->tree->string_pool = (PyObject *)self->string_pool;
+
+    if (snapshot_attach_pool(self->string_pool, buffer, &header) < 0 ||
+        snapshot_attach_tree(self->tree, buffer, &header) < 0) {
+        goto error;
+    }
+
+    path_allocator_set_flavour(self, (int)header.flavour, (char)header.separator);
+
+    Py_DECREF(empty);
+    return (PyObject *)self;
+
+error:
+    Py_XDECREF(self);
+    Py_XDECREF(empty);
+    return NULL;
+}
+
+PyObject *
+PathAllocator_load(PyObject *type, PyObject *args, PyObject *kwds)
+{
+    PyObject *path;
+    int use_mmap = 1;
+    static char *kwlist[] = {"path", "mmap", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", kwlist, &path, &use_mmap))
+        return NULL;
+
+    PyObject *buffer = snapshot_open_buffer(path, use_mmap);
+    if (buffer == NULL)
+        return NULL;
+    PyObject *self = snapshot_load_buffer((PyTypeObject *)type, buffer);
+    Py_DECREF(buffer);
+    return self;
+}
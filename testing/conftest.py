@@ -97,4 +97,64 @@ def capture_benchmark_results(request):
     if hasattr(benchmark, "stats"):
         if not hasattr(request.session, "_benchmark_results"):
             request.session._benchmark_results = {}
-        request.session._benchmark_results[request.node.name] = benchmark.stats
\ No newline at end of file
+        request.session._benchmark_results[request.node.name] = benchmark.stats
+
+
+# Rows recorded by test_scaling.py, printed after the run and written to
+# $FASTPATH_SCALING_REPORT as JSON when it is set
+SCALING_RESULTS: List[Dict[str, Any]] = []
+
+
+@pytest.fixture(scope="session")
+def scaling_report() -> List[Dict[str, Any]]:
+    """Collect throughput and memory rows from the scaling suite."""
+    return SCALING_RESULTS
+
+
+def pytest_terminal_summary(terminalreporter, exitstatus, config):
+    """Print the scaling curves and save them for later comparison."""
+    if not SCALING_RESULTS:
+        return
+
+    import json
+    import os
+    import platform
+
+    report_path = os.environ.get("FASTPATH_SCALING_REPORT")
+    if report_path:
+        with open(report_path, "w") as f:
+            json.dump(
+                {
+                    "python": platform.python_implementation() + " " + platform.python_version(),
+                    "machine": platform.machine(),
+                    "tier": os.environ.get("FASTPATH_SCALING", "smoke"),
+                    "results": SCALING_RESULTS,
+                },
+                f,
+                indent=2,
+            )
+
+    write = terminalreporter.write_line
+    write("")
+    write("=" * 106)
+    write("SCALING: throughput and memory per operation")
+    write("=" * 106)
+    write(
+        f"{'Corpus':<12} {'Op':<12} {'Threads':>7} {'Size':>11} {'Items':>11} "
+        f"{'Items/s':>12} {'RSS delta':>11} {'B/item':>8} {'Struct B':>9}"
+    )
+    write("-" * 106)
+    for row in SCALING_RESULTS:
+        rss = row["rss_delta"]
+        rss_str = f"{rss / (1 << 20):.1f}MB" if rss is not None else "n/a"
+        per_item = f"{row['bytes_per_item']:.1f}" if row["bytes_per_item"] is not None else "n/a"
+        structure = row.get("structure_bytes_per_item")
+        structure_str = f"{structure:.1f}" if structure is not None else ""
+        write(
+            f"{row['corpus']:<12} {row['op']:<12} {row['threads']:>7} {row['size']:>11,} "
+            f"{row['items']:>11,} {row['items_per_second']:>12,.0f} {rss_str:>11} {per_item:>8} "
+            f"{structure_str:>9}"
+        )
+    write("=" * 106)
+    if report_path:
+        write(f"Scaling report written to {report_path}")
@@ -1,8 +1,25 @@
 """Tests for the allocator module."""
 
+import array
+import gc
+import io
+import os
+import pickle
+import signal
+import subprocess
+import sys
+import threading
+import time
+from pathlib import PurePosixPath
+from pathlib import PureWindowsPath
+
 import pytest
 
+import fastpath
+from fastpath import FastPath
 from fastpath import PathAllocator
+from fastpath import PathList
+from fastpath import PureFastPath
 from fastpath import StringPool
 from fastpath import TreeAllocator
 from fastpath import ROOT_PARENT
@@ -40,6 +57,43 @@ class TestStringPool:
         assert pool.get_string(id2) == "world"
         assert pool.get_string(id3) == "test"
 
+    def test_intern_many_strings(self) -> None:
+        """Test IDs stay stable while the pool grows."""
+        pool = StringPool()
+        names = [f"file{i}.txt" for i in range(5000)]
+        ids = [pool.intern(name) for name in names]
+
+        assert ids == list(range(5000))
+        assert [pool.intern(name) for name in names] == ids
+        assert all(pool.get_string(i) == name for i, name in zip(ids, names))
+
+    def test_intern_non_ascii(self) -> None:
+        """Test interning strings with non-ASCII characters."""
+        pool = StringPool()
+        id1 = pool.intern("caf\u00e9")
+        id2 = pool.intern("\u65e5\u672c")
+        id3 = pool.intern("")
+
+        assert pool.get_string(id1) == "caf\u00e9"
+        assert pool.get_string(id2) == "\u65e5\u672c"
+        assert pool.get_string(id3) == ""
+        assert pool.intern("caf\u00e9") == id1
+
+    def test_get_string_cached(self) -> None:
+        """Test get_string returns the same object on repeated calls."""
+        pool = StringPool()
+        string_id = pool.intern("cached")
+        assert pool.get_string(string_id) is pool.get_string(string_id)
+
+    def test_get_string_invalid(self) -> None:
+        """Test get_string rejects unknown IDs."""
+        pool = StringPool()
+        pool.intern("only")
+        with pytest.raises(IndexError):
+            pool.get_string(1)
+        with pytest.raises(IndexError):
+            pool.get_string(-1)
+
     def test_len(self) -> None:
         """Test string pool length."""
         pool = StringPool()
@@ -54,6 +108,18 @@ class TestStringPool:
         pool.intern("a")  # Duplicate
         assert len(pool) == 2
 
+    def test_intern_undecodable(self) -> None:
+        """Test interning surrogate-escaped str, bytes and os.PathLike names."""
+        pool = StringPool()
+        name = os.fsdecode(b"caf\xe9")
+
+        string_id = pool.intern(name)
+        assert pool.intern(b"caf\xe9") == string_id
+        assert pool.get_string(string_id) == name
+        assert pool.intern(PurePosixPath("a")) == pool.intern("a")
+        with pytest.raises(TypeError):
+            pool.intern(1)
+
 
 class TestTreeAllocator:
     """Test the tree allocator."""
@@ -85,6 +151,55 @@ class TestTreeAllocator:
         assert tree.get_parent_idx(child_idx) == tree.relative_root
         assert tree.get_name_id(child_idx) == name_id
 
+    def test_add_node_validation(self) -> None:
+        """Test that add_node rejects unknown parents and name IDs."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        with pytest.raises(IndexError):
+            tree.add_node(1000, pool.intern("x"))
+        with pytest.raises(ValueError):
+            tree.add_node(tree.relative_root, -5)
+
+    def test_get_depth(self) -> None:
+        """Test that node depth is tracked on insertion."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        a_idx = tree.add_node(tree.absolute_root, pool.intern("a"))
+        b_idx = tree.add_node(a_idx, pool.intern("b"))
+
+        assert tree.get_depth(tree.relative_root) == 0
+        assert tree.get_depth(tree.absolute_root) == 0
+        assert tree.get_depth(a_idx) == 1
+        assert tree.get_depth(b_idx) == 2
+
+    def test_root_classification(self) -> None:
+        """Test that each node records the root it descends from."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        a_idx = tree.add_node(tree.absolute_root, pool.intern("a"))
+        b_idx = tree.add_node(a_idx, pool.intern("b"))
+        r_idx = tree.add_node(tree.relative_root, pool.intern("r"))
+        drive_idx = tree.add_node(-1, pool.intern("C:"))
+        d_idx = tree.add_node(drive_idx, pool.intern("d"))
+
+        assert tree.get_root_idx(b_idx) == tree.absolute_root
+        assert tree.get_root_idx(r_idx) == tree.relative_root
+        assert tree.get_root_idx(d_idx) == drive_idx
+        assert tree.get_root_idx(drive_idx) == drive_idx
+
+        assert tree.get_root_type(tree.relative_root) == "relative"
+        assert tree.get_root_type(tree.absolute_root) == "absolute"
+        assert tree.get_root_type(drive_idx) == "drive"
+        assert tree.get_root_type(b_idx) == "unknown"
+        assert tree.is_root(drive_idx)
+        assert not tree.is_root(b_idx)
+
+        with pytest.raises(IndexError):
+            tree.is_root(1000)
+
     def test_get_parts(self) -> None:
         """Test getting path parts."""
         pool = StringPool()
@@ -117,6 +232,149 @@ class TestTreeAllocator:
         assert tree.find_child(tree.relative_root, name_id2) == child2_idx
         assert tree.find_child(tree.relative_root, pool.intern("nonexistent")) is None
 
+        # Roots are children of ROOT_PARENT
+        assert tree.find_child(ROOT_PARENT, pool.intern("/")) == tree.absolute_root
+        assert tree.find_child(ROOT_PARENT, pool.intern("")) == tree.relative_root
+        drive_idx = tree.add_node(ROOT_PARENT, pool.intern("C:"))
+        assert tree.find_child(ROOT_PARENT, pool.intern("C:")) == drive_idx
+        assert tree.find_child(ROOT_PARENT, name_id1) is None
+
+    def test_find_child_many_nodes(self) -> None:
+        """Test child lookup stays correct as the child index grows."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        name_ids = [pool.intern(f"name{i}") for i in range(100)]
+        children = {}
+        for parent in (tree.relative_root, tree.absolute_root):
+            for name_id in name_ids:
+                children[parent, name_id] = tree.add_node(parent, name_id)
+        for (parent, name_id), child_idx in list(children.items())[:50]:
+            for name_id2 in name_ids[:10]:
+                children[child_idx, name_id2] = tree.add_node(child_idx, name_id2)
+
+        for (parent, name_id), child_idx in children.items():
+            assert tree.find_child(parent, name_id) == child_idx
+        assert tree.find_child(children[tree.relative_root, name_ids[0]], name_ids[99]) is None
+
+    def test_find_child_duplicate_keeps_first(self) -> None:
+        """Test that a duplicate add_node does not shadow the first child."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        name_id = pool.intern("child")
+        first = tree.add_node(tree.relative_root, name_id)
+        tree.add_node(tree.relative_root, name_id)
+
+        assert tree.find_child(tree.relative_root, name_id) == first
+
+
+    def test_ancestry(self) -> None:
+        """Test ancestor checks, common ancestors and re-rooting."""
+        allocator = PathAllocator()
+        tree = allocator.tree
+        base = allocator.from_string("/home/user")
+        file_idx = allocator.from_string("/home/user/docs/notes.txt")
+        other = allocator.from_string("/home/other/file")
+
+        assert tree.is_ancestor(base, file_idx)
+        assert tree.is_ancestor(file_idx, file_idx)
+        assert not tree.is_ancestor(file_idx, base)
+        assert not tree.is_ancestor(other, file_idx)
+        assert not tree.is_ancestor(tree.relative_root, file_idx)
+
+        assert tree.common_ancestor(file_idx, other) == allocator.from_string("/home")
+        assert tree.common_ancestor(file_idx, base) == base
+        with pytest.raises(ValueError):
+            tree.common_ancestor(file_idx, allocator.from_string("home"))
+
+        assert tree.relative_to(file_idx, base) == allocator.from_string("docs/notes.txt")
+        assert tree.relative_to(file_idx, file_idx) == tree.relative_root
+        with pytest.raises(ValueError):
+            tree.relative_to(base, file_idx)
+
+        assert tree.get_ancestors(file_idx)[0] == allocator.from_string("/home/user/docs")
+        assert tree.get_ancestors(file_idx)[-1] == tree.absolute_root
+        assert tree.get_ancestors(tree.absolute_root) == ()
+
+    def test_children_and_descendants(self) -> None:
+        """Test child links and preorder subtree walks."""
+        pool = StringPool()
+        tree = TreeAllocator(pool)
+
+        a = tree.add_node(tree.relative_root, pool.intern("a"))
+        b = tree.add_node(a, pool.intern("b"))
+        c = tree.add_node(a, pool.intern("c"))
+        d = tree.add_node(b, pool.intern("d"))
+
+        assert list(tree.get_children(a)) == [c, b]
+        assert list(tree.get_children(d)) == []
+        assert list(tree.iter_descendants(a)) == [c, b, d]
+        assert list(tree.iter_descendants(d)) == []
+        assert tree.count_descendants(a) == 3
+        assert tree.count_descendants(tree.relative_root) == 4
+        with pytest.raises(IndexError):
+            tree.get_children(1000)
+
+    def test_columns(self) -> None:
+        """Test per-node columns, bulk access and subtree sums."""
+        allocator = PathAllocator()
+        tree = allocator.tree
+        assert tree.column_names() == ("size", "mtime_ns", "mode")
+
+        top = allocator.from_string("/data")
+        nodes = array.array("q", [allocator.from_string(f"/data/f{i}") for i in range(100)])
+        size = tree.column("size")
+        size.set_many(nodes, array.array("q", range(100)))
+        size[top] = 1000
+        assert size[nodes[7]] == 7
+        assert size.subtree_sum(top) == 1000 + sum(range(100))
+        assert list(size.get_many(nodes[:3])) == [0, 1, 2]
+        assert tree.column("mode")[top] == 0
+
+        view = memoryview(size)
+        assert view.format == "q" and len(view) == len(size) == allocator.stats()["node_count"]
+        view[nodes[0]] = 42
+        assert size[nodes[0]] == 42
+        for i in range(10000):
+            allocator.from_string(f"/more/{i}")
+        with pytest.raises(BufferError):
+            size[len(size) - 1] = 1
+        view.release()
+        size[len(size) - 1] = 1
+
+        weight = tree.add_column("weight", "d")
+        weight[top] = 0.5
+        assert tree.column("weight").subtree_sum(top) == 0.5
+        with pytest.raises(ValueError):
+            tree.add_column("weight")
+        with pytest.raises(KeyError):
+            tree.column("missing")
+        with pytest.raises(OverflowError):
+            tree.column("mode")[top] = -1
+        with pytest.raises(IndexError):
+            size[len(size)] = 1
+
+        # Adding columns moves the column table, but not an exported format
+        view = memoryview(size)
+        for i in range(50):
+            tree.add_column(f"extra{i}", "B")
+        assert view.format == "q" and view[nodes[1]] == 1
+        view.release()
+
+    def test_find_ancestor(self) -> None:
+        """Test matching a node against many candidate roots."""
+        allocator = PathAllocator()
+        roots = {allocator.from_string(f"/src/pkg{i}") for i in range(10000)}
+        nested = allocator.from_string("/src/pkg77/sub")
+        roots.add(nested)
+
+        assert allocator.tree.find_ancestor(allocator.from_string("/src/pkg77/sub/mod.py"), roots) == nested
+        assert allocator.tree.find_ancestor(allocator.from_string("/src/pkg5/mod.py"), roots) == (
+            allocator.from_string("/src/pkg5")
+        )
+        assert allocator.tree.find_ancestor(allocator.from_string("/src/other.py"), roots) is None
+
 
 class TestPathAllocator:
     """Test the path allocator."""
@@ -162,6 +420,173 @@ class TestPathAllocator:
         assert idx3 == allocator.tree.absolute_root
         assert allocator.is_absolute(idx3) == True
 
+    def test_from_string_separators(self) -> None:
+        """Test repeated, leading and trailing separators."""
+        allocator = PathAllocator()
+
+        idx = allocator.from_string("/home/user")
+        assert allocator.from_string("//home///user/") == idx
+        assert allocator.from_string("/home/user//") == idx
+        assert allocator.from_string("home//user") != idx
+        assert allocator.get_parts(allocator.from_string("home//user")) == ("home", "user")
+
+        assert allocator.from_string("") == allocator.tree.relative_root
+        assert allocator.from_string(".") == allocator.tree.relative_root
+        assert allocator.from_string("///") == allocator.tree.absolute_root
+
+        # "." components are dropped wherever they appear, as pathlib does
+        ab = allocator.from_string("a/b")
+        assert allocator.from_string("a/./b") == ab
+        assert allocator.from_string("./a/b") == ab
+        assert allocator.from_string("a/b/.") == ab
+        assert allocator.from_string("/home/./user/.") == idx
+        assert allocator.get_parts(allocator.from_string("./.a/...")) == (".a", "...")
+
+        root = PureFastPath(allocator=allocator, _node_idx=allocator.from_string("/root/."))
+        assert root.name == "root" and root.suffix == "" and root.stem == "root"
+        assert str(root.with_suffix(".d")) == "/root.d"
+
+    def test_from_string_long(self) -> None:
+        """Test splitting paths whose separators straddle 64-byte scan blocks."""
+        allocator = PathAllocator()
+
+        for width in (1, 7, 62, 63, 64, 65, 130):
+            parts = tuple(f"{i}{'x' * width}" for i in range(6))
+            text = "/" + "//".join(parts) + "/"
+            assert allocator.get_parts(allocator.from_string(text)) == parts
+            assert allocator.from_parts("/", *parts) == allocator.from_string(text)
+            assert allocator.get_parts(allocator.from_string(text[1:])) == parts
+
+        name = "a" * 70 + ".tar." + "b" * 70
+        path = PureFastPath(allocator=allocator, _node_idx=allocator.from_string("/srv/" + name))
+        assert path.suffix == "." + "b" * 70
+        assert path.stem == "a" * 70 + ".tar"
+
+    def test_from_string_matches_from_parts(self) -> None:
+        """Test that the string parser and from_parts build the same nodes."""
+        allocator = PathAllocator()
+
+        idx = allocator.from_string("src/caf\u00e9/module.py")
+        assert allocator.from_parts("src", "caf\u00e9", "module.py") == idx
+        assert allocator.get_parts(idx) == ("src", "caf\u00e9", "module.py")
+
+    def test_from_string_type_error(self) -> None:
+        """Test that non-str input is rejected."""
+        allocator = PathAllocator()
+        with pytest.raises(TypeError):
+            allocator.from_string(42)
+        with pytest.raises(TypeError):
+            allocator.from_parts("home", 42)
+
+    def test_from_strings(self) -> None:
+        """Test batch construction from an iterable of strings."""
+        allocator = PathAllocator()
+        paths = ["/home/user/a.txt", "relative/b.txt", "/home/user/a.txt", ""]
+
+        indices = allocator.from_strings(paths)
+
+        assert indices.typecode == "q"
+        assert list(indices) == [allocator.from_string(p) for p in paths]
+        assert indices[0] == indices[2]
+        assert len(allocator.from_strings(iter([]))) == 0
+
+    def test_from_strings_buffer(self) -> None:
+        """Test batch construction from newline-separated bytes."""
+        allocator = PathAllocator()
+
+        indices = allocator.from_strings(b"/etc/hosts\nsrc/main.c\r\n/etc/hosts\n")
+
+        assert list(indices) == [
+            allocator.from_string("/etc/hosts"),
+            allocator.from_string("src/main.c"),
+            allocator.from_string("/etc/hosts"),
+        ]
+        assert list(allocator.from_strings(memoryview(b"a/b"))) == [allocator.from_string("a/b")]
+
+        # Blank lines are skipped, as ingest() skips empty records
+        listing = b"\na/b\n\r\n\n"
+        assert list(allocator.from_strings(listing)) == [allocator.from_string("a/b")]
+        assert list(allocator.ingest(io.BytesIO(listing), delimiter=b"\n")) == [allocator.from_string("a/b")]
+        with pytest.raises(TypeError):
+            allocator.from_strings("/etc/hosts")
+
+    def test_from_strings_sep(self) -> None:
+        """Test batch construction with a custom separator."""
+        allocator = PathAllocator()
+
+        indices = allocator.from_strings(["usr:lib:python"], sep=":")
+
+        assert allocator.get_parts(indices[0]) == ("usr", "lib", "python")
+        with pytest.raises(ValueError):
+            allocator.from_strings(["a"], sep="::")
+        with pytest.raises(TypeError):
+            allocator.from_strings(["a", 1])
+
+    def test_ingest(self, tmp_path) -> None:
+        """Test streaming construction from a delimited listing."""
+        paths = [f"/srv/d{i % 7}/{'x' * (i % 300)}{i}.txt" for i in range(5000)] + ["rel/a"]
+        listing = b"\0".join(p.encode() for p in paths) + b"\0"
+        expected = list(PathAllocator().from_strings(paths))
+
+        # Records straddle the 4096-byte blocks, and the final one has no delimiter
+        allocator = PathAllocator()
+        assert list(allocator.ingest(io.BytesIO(listing), block_size=4096)) == expected
+        assert list(allocator.ingest(io.BytesIO(listing[:-1]), block_size=4096)) == expected
+        lines = io.BytesIO(b"/etc/hosts\r\n\nsrc/main.c")
+        assert list(allocator.ingest(lines, delimiter=b"\n")) == [
+            allocator.from_string("/etc/hosts"),
+            allocator.from_string("src/main.c"),
+        ]
+
+        listing_file = tmp_path / "listing"
+        listing_file.write_bytes(listing)
+        with open(listing_file, "rb") as f:
+            fresh = PathAllocator()
+            assert list(fresh.ingest(f.fileno(), block_size=4096)) == expected
+
+        read_fd, write_fd = os.pipe()
+        writer = threading.Thread(target=lambda: (os.write(write_fd, listing), os.close(write_fd)))
+        writer.start()
+        try:
+            assert list(PathAllocator().ingest(read_fd)) == expected
+        finally:
+            writer.join()
+            os.close(read_fd)
+
+        assert len(allocator.ingest(io.BytesIO(b""))) == 0
+        with pytest.raises(TypeError):
+            allocator.ingest(io.StringIO("a\0b"))
+        with pytest.raises(ValueError):
+            allocator.ingest(io.BytesIO(b""), delimiter=b"")
+        directory_fd = os.open(tmp_path, os.O_RDONLY)
+        try:
+            with pytest.raises(OSError):
+                allocator.ingest(directory_fd)
+        finally:
+            os.close(directory_fd)
+
+    @pytest.mark.skipif(sys.platform == "win32", reason="needs SIGALRM")
+    def test_ingest_interrupted(self) -> None:
+        """Test that a signal handler can stop ingest() while the source is quiet."""
+        process = subprocess.Popen(["sh", "-c", "printf 'a\\0b\\0'; sleep 5"], stdout=subprocess.PIPE)
+
+        def interrupt(signum, frame):
+            raise TimeoutError
+
+        previous = signal.signal(signal.SIGALRM, interrupt)
+        start = time.monotonic()
+        signal.alarm(1)
+        try:
+            with pytest.raises(TimeoutError):
+                PathAllocator().ingest(process.stdout.fileno())
+        finally:
+            signal.alarm(0)
+            signal.signal(signal.SIGALRM, previous)
+            process.kill()
+            process.wait()
+            process.stdout.close()
+        assert time.monotonic() - start < 4
+
     def test_caching(self) -> None:
         """Test that identical paths share the same index."""
         allocator = PathAllocator()
@@ -173,6 +598,41 @@ class TestPathAllocator:
         # Verify cache is working
         assert len(allocator._cache) > 0
 
+    def test_lookup_cache(self) -> None:
+        """Test the bounded LRU cache of whole path strings."""
+        allocator = PathAllocator(lookup_cache_entries=2)
+        a = allocator.from_string("/srv/a")
+        assert allocator.from_string("/srv/a") == a
+        assert PureFastPath(allocator=allocator, _node_idx=a) == PureFastPath(
+            allocator=allocator, _node_idx=allocator.from_parts("/srv/a")
+        )
+        stats = allocator.stats()
+        assert (stats["cache_hits"], stats["cache_misses"]) == (2, 1)
+
+        # The least recently used entry goes first
+        allocator.from_string("/srv/b")
+        allocator.from_string("/srv/a")
+        allocator.from_string("/srv/c")
+        assert list(allocator._cache) == ["/srv/c", "/srv/a"]
+        assert allocator.stats()["cache_evictions"] == 1
+        assert allocator._cache["/srv/a"] == a
+
+        tiny = PathAllocator(lookup_cache_bytes=1)
+        tiny.from_string("/srv/a")
+        assert tiny.stats()["cache_entries"] == 0
+        disabled = PathAllocator(lookup_cache_entries=0)
+        assert disabled.from_string("a/b") == disabled.from_string("a/b")
+        assert disabled.stats()["cache_misses"] == 0
+
+        tracked = PathAllocator(track_paths=True)
+        tracked.from_string("/tmp/x")
+        tracked.compact()
+        assert tracked._cache == {}
+        assert tracked.get_parts(tracked.from_string("/tmp/x"))[-2:] == ("tmp", "x")
+
+        with pytest.raises(ValueError):
+            PathAllocator(lookup_cache_entries=-1)
+
     def test_get_parent(self) -> None:
         """Test getting parent index."""
         allocator = PathAllocator()
@@ -198,6 +658,34 @@ class TestPathAllocator:
         assert allocator.get_name(allocator.tree.relative_root) == ""
         assert allocator.get_name(allocator.tree.absolute_root) == ""
 
+    def test_suffix_ids(self) -> None:
+        """Test that suffixes are interned and grouped by string ID."""
+        allocator = PathAllocator()
+        pool = allocator.string_pool
+        nodes = [allocator.from_string(f"/data/f{i}.{ext}") for i, ext in enumerate(["py", "txt", "py", "c"] * 5)]
+        nodes.append(allocator.from_string("/data/README"))
+
+        ids = allocator.suffix_ids(nodes + [allocator.from_string("/")])
+        assert isinstance(ids, array.array) and ids.typecode == "q"
+        assert ids[-1] == -1
+        counts: dict = {}
+        for suffix_id in ids[:-1]:
+            counts[pool.get_string(suffix_id)] = counts.get(pool.get_string(suffix_id), 0) + 1
+        assert counts == {".py": 10, ".txt": 5, ".c": 5, "": 1}
+
+        name_id = pool.intern("x.tar.gz")
+        assert pool.get_string(pool.suffix_id(name_id)) == ".gz"
+        assert pool.get_string(pool.stem_id(name_id)) == "x.tar"
+        plain = pool.intern("plain")
+        assert pool.stem_id(plain) == plain
+
+        path = PureFastPath(allocator=allocator, _node_idx=nodes[0])
+        assert path.suffix is PureFastPath(allocator=allocator, _node_idx=nodes[2]).suffix
+        assert path.with_suffix(".txt")._node_idx == allocator.with_suffix(nodes[0], ".txt")
+        assert allocator.with_name(nodes[0], "f1.txt") == nodes[1]
+        with pytest.raises(IndexError):
+            pool.suffix_id(len(pool))
+
     def test_join(self) -> None:
         """Test joining path parts."""
         allocator = PathAllocator()
@@ -207,6 +695,366 @@ class TestPathAllocator:
 
         assert allocator.get_parts(new_idx) == ("home", "user", "documents", "file.txt")
 
+    def test_subtree_queries(self) -> None:
+        """Test listing everything below a directory."""
+        allocator = PathAllocator()
+        paths = [f"/repo/src/pkg{i % 10}/mod{i}.py" for i in range(1000)]
+        allocator.from_strings(paths + ["/repo/docs/index.md"])
+        src = allocator.from_string("/repo/src")
+
+        assert allocator.count_descendants(src) == 1010
+        assert len(allocator.children(src)) == 10
+        below = {str(p) for p in allocator.iter_descendants(src, path_type=PureFastPath)}
+        assert below >= set(paths)
+        assert "/repo/docs/index.md" not in below
+        assert all(type(p) is PureFastPath for p in allocator.children(src, path_type=PureFastPath))
+        with pytest.raises(TypeError):
+            allocator.children(src, path_type=str)
+
+    def test_get_str_cached(self) -> None:
+        """Test that path strings are materialized once per node."""
+        allocator = PathAllocator()
+        idx = allocator.from_string("/home/user/file.txt")
+        path = PureFastPath(allocator=allocator, _node_idx=idx)
+
+        first = str(path)
+        assert first == "/home/user/file.txt"
+        assert str(path) is first
+        assert str(path.parent) == "/home/user"
+        assert allocator.stats()["path_cache_bytes"] > 0
+
+    def test_get_str_budget(self) -> None:
+        """Test that a zero budget disables caching but not conversion."""
+        allocator = PathAllocator(path_cache_bytes=0)
+        idx = allocator.from_string("relative/dir/file.txt")
+        path = PureFastPath(allocator=allocator, _node_idx=idx)
+
+        assert str(path) == "relative/dir/file.txt"
+        assert str(path) == "relative/dir/file.txt"
+        assert allocator.stats()["path_cache_bytes"] == 0
+
+    @pytest.mark.parametrize("use_mmap", [True, False])
+    def test_save_load(self, tmp_path, use_mmap: bool) -> None:
+        """Test that a loaded snapshot reproduces the saved tree."""
+        allocator = PathAllocator()
+        paths = [f"/srv/build/pkg{i % 50}/src/module{i}.py" for i in range(5000)]
+        indices = allocator.from_strings(paths)
+        relative_idx = allocator.from_string("relative/dir")
+
+        snapshot = tmp_path / "allocator.snap"
+        allocator.save(snapshot)
+        loaded = PathAllocator.load(snapshot, mmap=use_mmap)
+
+        assert loaded.stats()["node_count"] == allocator.stats()["node_count"]
+        assert loaded.from_strings(paths) == indices
+        assert loaded.get_parts(indices[1234]) == allocator.get_parts(indices[1234])
+        assert loaded.is_absolute(indices[0])
+        assert not loaded.is_absolute(relative_idx)
+        assert str(PureFastPath(allocator=loaded, _node_idx=indices[42])) == paths[42]
+        src_idx = allocator.get_parent(indices[42])
+        assert list(loaded.iter_descendants(src_idx)) == list(allocator.iter_descendants(src_idx))
+
+    def test_load_grows_past_snapshot(self, tmp_path) -> None:
+        """Test that nodes added after loading do not touch the saved file."""
+        allocator = PathAllocator()
+        base_idx = allocator.from_string("/data/shared")
+        snapshot = tmp_path / "allocator.snap"
+        allocator.save(snapshot)
+        saved = snapshot.read_bytes()
+
+        loaded = PathAllocator.load(snapshot)
+        new_indices = [loaded.join(base_idx, f"file{i}.txt") for i in range(10000)]
+
+        assert loaded.get_parts(new_indices[-1]) == ("data", "shared", "file9999.txt")
+        assert loaded.join(base_idx, "file5.txt") == new_indices[5]
+        assert snapshot.read_bytes() == saved
+        assert PathAllocator.load(snapshot).stats()["node_count"] == allocator.stats()["node_count"]
+
+    def test_load_invalid(self, tmp_path) -> None:
+        """Test that files which are not valid snapshots are rejected."""
+        garbage = tmp_path / "garbage.snap"
+        garbage.write_bytes(b"x" * 8192)
+        with pytest.raises(ValueError):
+            PathAllocator.load(garbage)
+
+        allocator = PathAllocator()
+        allocator.from_string("/a/b")
+        truncated = tmp_path / "truncated.snap"
+        allocator.save(truncated)
+        truncated.write_bytes(truncated.read_bytes()[:-1])
+        with pytest.raises(ValueError):
+            PathAllocator.load(truncated)
+
+    def test_compact(self) -> None:
+        """Test that compaction drops unreferenced nodes and renumbers live paths."""
+        allocator = PathAllocator(track_paths=True)
+
+        def make_path(s: str) -> PureFastPath:
+            return PureFastPath(allocator=allocator, _node_idx=allocator.from_string(s))
+
+        kept = [make_path(f"/keep/k{i}/file.txt") for i in range(50)]
+        raw = allocator.from_string("/raw/idx")
+        allocator.tree.column("size")[kept[7]._node_idx] = 7
+        baseline = allocator.stats()["node_count"]
+
+        for round in range(3):
+            churn = [make_path(f"/churn/{round}/d{i}/f{i}.txt") for i in range(2000)]
+            del churn
+            remap = allocator.compact(keep=[raw])
+            raw = remap[raw]
+            assert allocator.stats()["node_count"] == baseline
+
+        assert [str(p) for p in kept[:2]] == ["/keep/k0/file.txt", "/keep/k1/file.txt"]
+        assert kept[7] == make_path("/keep/k7/file.txt")
+        assert hash(kept[7]) == hash(make_path("/keep/k7/file.txt"))
+        assert allocator.tree.column("size")[kept[7]._node_idx] == 7
+        assert allocator.get_parts(raw)[-2:] == ("raw", "idx")
+
+        view = memoryview(allocator.tree.column("size"))
+        with pytest.raises(BufferError):
+            allocator.compact()
+        view.release()
+        with pytest.raises(RuntimeError):
+            PathAllocator().compact()
+
+    def test_glob(self) -> None:
+        """Test compiled glob patterns over the known tree."""
+        allocator = PathAllocator()
+        names = ["src/a.py", "src/b.txt", "src/pkg/c.py", "src/pkg/sub/d.py", "docs/e.py"]
+        nodes = {name: allocator.from_string(name) for name in names}
+        src = allocator.from_string("src")
+
+        pattern = allocator.compile_glob("**/*.py")
+        assert pattern.pattern == "**/*.py"
+        expected = {nodes[n] for n in ("src/a.py", "src/pkg/c.py", "src/pkg/sub/d.py")}
+        assert set(pattern.glob(src)) == expected
+        assert set(allocator.glob(src, "*.py")) == {nodes["src/a.py"]}
+        assert set(allocator.glob(src, "pkg/*/d.py")) == {nodes["src/pkg/sub/d.py"]}
+        assert set(allocator.glob(src, "*.[!p]*")) == {nodes["src/b.txt"]}
+        assert list(allocator.glob(src, "missing/*")) == []
+
+        for name in names:
+            for pat in ("*.py", "pkg/*.py", "src/*", "*/*/*", "/src/*", "[a-c].py", "?.txt"):
+                expected_match = PurePosixPath(name).match(pat)
+                assert allocator.match(nodes[name], pat) == expected_match, (name, pat)
+        assert list(pattern.filter(list(nodes.values()))) == [nodes[n] for n in names if n.endswith(".py")]
+
+        with pytest.raises(ValueError):
+            allocator.match(src, "")
+        with pytest.raises(NotImplementedError):
+            allocator.glob(src, "/abs/*")
+        with pytest.raises(ValueError):
+            allocator.glob(src, "a/**b/c")
+
+        # Compiled patterns stay usable across a compaction
+        tracked = PathAllocator(track_paths=True)
+        keep = PureFastPath(allocator=tracked, _node_idx=tracked.from_string("x/y.py"))
+        compiled = tracked.compile_glob("x/*.py")
+        tracked.from_string("z/w.py")
+        tracked.compact()
+        assert list(compiled.glob(tracked.from_string("."))) == [keep._node_idx]
+
+    def test_pickle(self) -> None:
+        """Test that paths pickle as node indices of a shared allocator."""
+        allocator = PathAllocator()
+        path = PureFastPath(allocator=allocator, _node_idx=allocator.from_string("/srv/data/a.txt"))
+
+        restored = pickle.loads(pickle.dumps(path))
+        assert restored == path and restored._allocator is allocator
+        assert type(pickle.loads(pickle.dumps(FastPath("/tmp")))) is FastPath
+
+        batch = PathList(path.with_name(f"f{i}") for i in range(100))
+        data = pickle.dumps(batch)
+        assert len(data) < len(pickle.dumps(list(batch)))
+        restored_batch = pickle.loads(data)
+        assert type(restored_batch) is PathList and restored_batch == batch
+        assert pickle.loads(pickle.dumps(PathList([path, "x"]))) == [path, "x"]
+
+        # Once compacted, old pickles rebuild a copy instead of resolving to renumbered nodes
+        tracked = PathAllocator(track_paths=True)
+        kept = PureFastPath(allocator=tracked, _node_idx=tracked.from_string("/b/c"))
+        tracked.from_string("/a")
+        data = pickle.dumps(kept)
+        tracked.compact()
+        old = pickle.loads(data)
+        assert old == kept and old._allocator is not tracked
+        assert pickle.loads(pickle.dumps(kept))._allocator is tracked
+
+    @pytest.mark.parametrize("share", [False, True])
+    def test_pickle_across_processes(self, tmp_path, share: bool) -> None:
+        """Test that an unchanged copy pickles back to the allocator it came from."""
+        allocator = PathAllocator()
+        if share:
+            allocator.share(tmp_path / "paths.snap")
+        paths = PathList(
+            PureFastPath(allocator=allocator, _node_idx=allocator.from_string(f"/d/{i}.txt"))
+            for i in range(5)
+        )
+        code = (
+            "import pickle, sys, fastpath\n"
+            "paths = pickle.load(sys.stdin.buffer)\n"
+            "same = pickle.dumps(fastpath.PathList(p.with_suffix('.txt') for p in paths))\n"
+            "grown = [p.with_suffix('.md') for p in paths]\n"
+            "sys.stdout.buffer.write(pickle.dumps((same, grown, pickle.dumps(paths))))\n"
+        )
+        env = dict(os.environ, PYTHONPATH=os.pathsep.join(sys.path))
+        result = subprocess.run(
+            [sys.executable, "-c", code],
+            input=pickle.dumps(paths),
+            capture_output=True,
+            env=env,
+            check=True,
+        )
+        same, grown, forwarded = pickle.loads(result.stdout)
+        same = pickle.loads(same)
+        assert same == paths and same[0]._allocator is allocator
+        assert [str(p) for p in grown] == [f"/d/{i}.md" for i in range(5)]
+        assert grown[0]._allocator is not allocator
+
+        # A copy passed on unchanged still carries a source for processes
+        # that never saw the original
+        third = subprocess.run(
+            [sys.executable, "-c", "import pickle, sys; print(*pickle.load(sys.stdin.buffer))"],
+            input=forwarded,
+            capture_output=True,
+            env=env,
+            check=True,
+        )
+        assert third.stdout.split() == [f"/d/{i}.txt".encode() for i in range(5)]
+
+    def test_epochs(self) -> None:
+        """Test that nodes are stamped with the epoch they were added in."""
+        allocator = PathAllocator(track_paths=True)
+        first = allocator.from_string("/scan/a/old.txt")
+        assert allocator.epoch == 0
+
+        assert allocator.new_epoch() == 1
+        assert allocator.new_epoch() == 2
+        added = [allocator.from_string(s) for s in ("/scan/a/new.txt", "/scan/b/c.txt", "/other/x")]
+        assert allocator.from_string("/scan/a/old.txt") == first
+        assert allocator.epoch == 2
+        assert allocator.node_epoch(first) == 0 and allocator.node_epoch(added[0]) == 2
+
+        scan = allocator.from_string("/scan")
+        since = list(allocator.added_since(2))
+        assert added[0] in since and added[2] in since and first not in since
+        outside = set(allocator.get_parents(added[2])) | {added[2]}
+        assert set(allocator.added_since(1, scan)) == set(since) - outside
+        assert list(allocator.added_since(3)) == []
+        with pytest.raises(IndexError):
+            allocator.added_since(0, 10**6)
+
+        # Compaction keeps the surviving nodes in their epochs
+        kept = PureFastPath(allocator=allocator, _node_idx=added[1])
+        allocator.from_string("/scan/dropped")
+        allocator.compact(keep=[first])
+        assert allocator.epoch == 2
+        assert allocator.node_epoch(kept._node_idx) == 2
+        assert allocator.node_epoch(allocator.from_string("/scan/a/old.txt")) == 0
+
+    def test_diff(self) -> None:
+        """Test that diff() pairs the children of two subtrees by name."""
+        allocator = PathAllocator()
+        old = ["a.txt", "d/x", "d/y", "gone/deep/f"]
+        new = ["a.txt", "d/x", "d/z", "fresh/deep/f"]
+        for name in old:
+            allocator.from_string(f"/v1/{name}")
+        for name in new:
+            allocator.from_string(f"/v2/{name}")
+        v1, v2 = allocator.from_string("/v1"), allocator.from_string("/v2")
+
+        def rel(nodes, base):
+            base_path = PurePosixPath(*allocator.get_parts(base))
+            parts = (allocator.get_parts(n) for n in nodes)
+            return {str(PurePosixPath(*p).relative_to(base_path)) for p in parts}
+
+        added, removed, common = allocator.diff(v1, v2)
+        assert rel(added, v2) == {"d/z", "fresh", "fresh/deep", "fresh/deep/f"}
+        assert rel(removed, v1) == {"d/y", "gone", "gone/deep", "gone/deep/f"}
+        assert rel(common, v2) == {"a.txt", "d", "d/x"}
+
+        added, removed, common = allocator.diff(v2, v2)
+        assert list(added) == list(removed) == [] and len(common) == allocator.count_descendants(v2)
+        with pytest.raises(IndexError):
+            allocator.diff(v1, 10**6)
+
+    @pytest.mark.parametrize(
+        "text",
+        [
+            "C:\\a\\b", "C:/a/./b", "c:x", "/x", "//server/share/x",
+            "//server", "///x", "\\\\?\\C:\\x", "a//b", ".",
+        ],
+    )
+    def test_windows_flavour(self, text: str) -> None:
+        """Test that windows allocators split anchors and join like PureWindowsPath."""
+        allocator = PathAllocator(flavour="windows")
+        path = PureFastPath(allocator=allocator, _node_idx=allocator.from_string(text))
+        expected = PureWindowsPath(text)
+
+        assert str(path) == str(expected)
+        assert path.parts == expected.parts
+        assert path.drive == expected.drive
+        assert path.root == expected.root
+        assert path.anchor == expected.anchor
+        assert path.is_absolute() == expected.is_absolute()
+        for other in ("D:y", "/y", "c:y", "y"):
+            assert str(path / other) == str(expected / other)
+
+    def test_windows_comparison(self, tmp_path) -> None:
+        """Test that windows paths compare and hash case-insensitively and survive saving."""
+        allocator = PathAllocator(flavour="windows")
+
+        def path(text: str) -> PureFastPath:
+            return PureFastPath(allocator=allocator, _node_idx=allocator.from_string(text))
+
+        upper = path("C:/Users/Foo")
+        assert allocator.flavour == "windows" and allocator._separator == "\\"
+        assert upper == path("c:\\users\\FOO") and hash(upper) == hash(path("c:/users/foo"))
+        assert upper != path("C:/Users/Bar") and path("a") < path("B")
+        assert allocator.string_pool.fold_id(allocator.string_pool.intern("FOO")) == (
+            allocator.string_pool.intern("foo")
+        )
+        assert set(allocator.tree.drive_roots) == {"C:\\", "c:\\"}
+        with pytest.raises(ValueError):
+            upper.with_name("a/b")
+        with pytest.raises(TypeError):
+            upper < PureFastPath("/x")
+        with pytest.raises(ValueError):
+            PathAllocator(separator="::")
+        with pytest.raises(ValueError):
+            PathAllocator(flavour="mac")
+
+        allocator.save(tmp_path / "windows.snap")
+        loaded = PathAllocator.load(tmp_path / "windows.snap")
+        for copy in (loaded, pickle.loads(pickle.dumps(allocator))):
+            assert copy.flavour == "windows"
+            assert copy.from_string("C:/Users/Foo") == upper._node_idx
+            assert PureFastPath(allocator=copy, _node_idx=copy.from_string("c:/users/foo")) == upper
+
+    def test_windows_ancestry(self) -> None:
+        """Test that windows ancestry and glob matching ignore case, like PureWindowsPath."""
+        allocator = PathAllocator(flavour="windows")
+
+        def path(text: str) -> PureFastPath:
+            return PureFastPath(allocator=allocator, _node_idx=allocator.from_string(text))
+
+        target, base = path("C:/Users/Me/x"), path("c:/users")
+        assert target.is_relative_to(base) and allocator.is_relative_to(target._node_idx, base._node_idx)
+        assert str(target.relative_to(base)) == "Me\\x"
+        assert not target.is_relative_to(path("c:/usr")) and not target.is_relative_to(path("D:/Users"))
+        with pytest.raises(ValueError):
+            target.relative_to(path("c:/users/you"))
+
+        common = fastpath.commonpath([path("C:/Users/a"), path("c:/users/b")])
+        assert str(common) == "C:\\Users"
+        assert str(fastpath.commonpath([path("C:/Users/Me/a"), path("c:/users/ME/b")])) == "C:\\Users\\Me"
+        with pytest.raises(ValueError):
+            fastpath.commonpath([path("C:/a"), path("D:/a")])
+
+        assert path("C:/Src/Mod.PY").match("*.py") and path("C:/Src/Mod.PY").match("SRC/mod.py")
+        assert path("C:/Src/Mod.PY").match("[m]OD.*") and not path("C:/Src/Mod.PY").match("*.txt")
+        assert list(allocator.glob(path("C:/")._node_idx, "SRC/*.py")) == [path("C:/Src/Mod.PY")._node_idx]
+
     def test_stats(self) -> None:
         """Test allocator statistics."""
         allocator = PathAllocator()
@@ -224,6 +1072,74 @@ class TestPathAllocator:
         assert stats["nodes_allocated"] > 0
         assert stats["cache_entries"] > 0
 
+    def test_stats_counters(self) -> None:
+        """Test the size and hot-path figures stats() reports."""
+        allocator = PathAllocator()
+        nodes = allocator.from_strings([f"/srv/d{i % 10}/f{i}" for i in range(1000)])
+        for idx in nodes[:100]:
+            str(PureFastPath(allocator=allocator, _node_idx=idx))
+
+        stats = allocator.stats()
+        assert stats["string_count"] == stats["strings_interned"]
+        assert stats["node_bytes"] >= stats["nodes_allocated"] * 24
+        assert stats["string_bytes"] > 0 and stats["child_index_bytes"] > 0
+        assert 2 < stats["average_depth"] < 3
+        assert 0.0 <= stats["cache_hit_rate"] <= 1.0
+        if stats["counters_enabled"]:
+            assert stats["intern_misses"] == stats["strings_interned"]
+            assert stats["intern_hits"] >= 1000
+            assert stats["child_lookups"] >= 3000 and stats["average_probe_length"] >= 1
+            assert stats["node_grows"] > 0 and stats["path_strings_built"] >= 100
+        else:
+            assert "intern_hits" not in stats
+
+    def test_stats_average_depth(self, tmp_path) -> None:
+        """Test that average_depth follows the tree through every way of building one."""
+
+        def average_depth(allocator: PathAllocator) -> float:
+            count = allocator.stats()["nodes_allocated"]
+            return sum(allocator.tree.get_depth(i) for i in range(count)) / count
+
+        allocator = PathAllocator(track_paths=True)
+        nodes = allocator.from_strings([f"/srv/d{i % 10}/x/f{i}" for i in range(1000)])
+        assert allocator.stats()["average_depth"] == average_depth(allocator)
+
+        allocator.save(tmp_path / "tree.snap")
+        loaded = PathAllocator.load(tmp_path / "tree.snap")
+        loaded.from_string("/srv/new/deeper/still")
+        copy = pickle.loads(pickle.dumps(allocator))
+        for other in (loaded, copy):
+            assert other.stats()["average_depth"] == average_depth(other)
+
+        allocator.compact(keep=nodes[:10])
+        assert allocator.stats()["average_depth"] == average_depth(allocator)
+
+    def test_block_pool(self) -> None:
+        """Test that freed allocator storage is reused by the next allocator."""
+        paths = [f"/srv/d{i % 10}/f{i}" for i in range(5000)]
+        allocator = PathAllocator()
+        allocator.from_strings(paths)
+        del allocator
+        gc.collect()
+        before = fastpath.block_pool_info()
+        assert before["blocks"] > 0 and before["bytes"] <= before["limit"]
+
+        # Recycled blocks hold the previous allocator's data
+        allocator = PathAllocator()
+        nodes = allocator.from_strings(paths)
+        assert fastpath.block_pool_info()["hits"] > before["hits"]
+        assert [str(PureFastPath(allocator=allocator, _node_idx=i)) for i in nodes] == paths
+        assert len(allocator.children(allocator.from_string("/srv/d3/f3"))) == 0
+
+        try:
+            fastpath.set_block_pool_limit(0)
+            info = fastpath.block_pool_info()
+            assert info["blocks"] == 0 and info["bytes"] == 0
+            with pytest.raises(ValueError):
+                fastpath.set_block_pool_limit(-1)
+        finally:
+            fastpath.set_block_pool_limit(before["limit"])
+
 
 class TestAllocatorIntegration:
     """Integration tests for the allocator system."""
@@ -260,4 +1176,65 @@ class TestAllocatorIntegration:
         assert parent1 == parent2
 
         # All three should share home/user prefix
-        assert allocator.get_parent(parent1) == allocator.get_parent(idx3)
\ No newline at end of file
+        assert allocator.get_parent(parent1) == allocator.get_parent(idx3)
+
+    def test_cross_allocator_comparison(self) -> None:
+        """Test that equal paths in different allocators compare and hash alike."""
+        first = PathAllocator()
+        second = PathAllocator()
+        second.from_string("/unrelated/padding")
+
+        def make(allocator: PathAllocator, path: str) -> PureFastPath:
+            return PureFastPath(allocator=allocator, _node_idx=allocator.from_string(path))
+
+        assert make(first, "/home/user") == make(second, "/home/user")
+        assert hash(make(first, "/home/user")) == hash(make(second, "/home/user"))
+        assert make(first, "home/user") != make(second, "/home/user")
+        assert make(first, "/home/a") < make(second, "/home/b")
+        assert len({make(first, "x/y"), make(second, "x/y"), make(second, "x")}) == 2
+
+    def test_subclass_dispatch(self) -> None:
+        """Test that allocator subclasses see the same results as native ones."""
+
+        class CountingAllocator(PathAllocator):
+            calls = 0
+
+            def get_parts(self, node_idx: int) -> tuple[str, ...]:
+                CountingAllocator.calls += 1
+                return super().get_parts(node_idx)
+
+        for allocator in (PathAllocator(), CountingAllocator()):
+            idx = allocator.from_parts("home", "user", "notes.txt")
+            path = PureFastPath(allocator=allocator, _node_idx=idx)
+
+            assert path._allocator is allocator
+            assert path.parts == ("home", "user", "notes.txt")
+            assert str(path) == "home/user/notes.txt"
+            assert str(path.parent) == "home/user"
+            assert path.name == "notes.txt"
+            assert str(path / "more") == "home/user/notes.txt/more"
+            assert not path.is_absolute()
+
+        # The subclass override is honoured by the generic dispatch path
+        assert CountingAllocator.calls > 0
+
+    def test_concurrent_construction(self) -> None:
+        """Test that threads sharing an allocator agree on node indices."""
+        allocator = PathAllocator()
+        paths = [f"/crawl/dir{i % 16}/sub{i % 7}/file{i}.dat" for i in range(2000)]
+        results: list[list[int]] = [[] for _ in range(4)]
+
+        def worker(slot: int) -> None:
+            for path in paths:
+                idx = allocator.from_string(path)
+                str(PureFastPath(allocator=allocator, _node_idx=idx).parent)
+                results[slot].append(idx)
+
+        threads = [threading.Thread(target=worker, args=(slot,)) for slot in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        assert all(result == results[0] for result in results)
+        assert list(allocator.from_strings(paths)) == results[0]
@@ -1,7 +1,9 @@
 """Compatibility tests comparing FastPath with pathlib.Path."""
 
+import gc
 import os
 import tempfile
+import weakref
 from pathlib import Path as StdPath
 from pathlib import PurePath as StdPurePath
 from typing import Any
@@ -11,6 +13,7 @@ from typing import Tuple
 
 import pytest
 
+import fastpath
 from fastpath import FastPath
 from fastpath import PureFastPath
 
@@ -96,6 +99,15 @@ class TestPurePathCompatibility:
             fast_path = PureFastPath(path_str)
             assert fast_path.stem == std_path.stem == expected_stem
 
+    def test_suffixes(self) -> None:
+        """Test suffix, stem and suffixes on unusual names."""
+        for name in ("archive.tar.gz", "file.", "a..b", "..", ".a.b", "x", "caf\u00e9.t\u00e9", "/"):
+            std_path = StdPurePath("/dir") / name
+            fast_path = PureFastPath("/dir") / name
+            assert fast_path.suffixes == std_path.suffixes, name
+            assert fast_path.suffix == std_path.suffix, name
+            assert fast_path.stem == std_path.stem, name
+
     def test_joinpath(self) -> None:
         """Test that joinpath works the same way."""
         test_cases = [
@@ -126,6 +138,20 @@ class TestPurePathCompatibility:
         for std_path, fast_path in pure_path_pairs:
             assert str(fast_path) == str(std_path)
 
+    def test_fspath(self, pure_path_pairs: list[Tuple[StdPurePath, PureFastPath]]) -> None:
+        """Test os.fspath matches pathlib."""
+        for std_path, fast_path in pure_path_pairs:
+            assert os.fspath(fast_path) == os.fspath(std_path)
+
+    def test_bytes(self, pure_path_pairs: list[Tuple[StdPurePath, PureFastPath]]) -> None:
+        """Test bytes() and construction from bytes and path-like objects match pathlib."""
+        for std_path, fast_path in pure_path_pairs:
+            assert bytes(fast_path) == bytes(std_path)
+            assert PureFastPath(bytes(std_path)) == fast_path
+            assert PureFastPath(std_path) == fast_path
+            assert PureFastPath(fast_path)._node_idx == fast_path._node_idx
+        assert PureFastPath("/a\udcff") == PureFastPath(b"/a\xff")
+
     def test_equality(self) -> None:
         """Test equality comparisons."""
         fast1 = PureFastPath("/home/user")
@@ -139,6 +165,17 @@ class TestPurePathCompatibility:
         std_path = StdPurePath("/home/user")
         assert fast1 == str(std_path)
 
+    def test_ordering(self) -> None:
+        """Test that sorting matches pathlib's component-wise order."""
+        strings = ["a/b", "a-b", "a", "/a", "/", "b", "a/b/c", "ab", "/a/b", "A", "\u00e9", "z"]
+        fast_sorted = sorted(PureFastPath(s) for s in strings)
+        std_sorted = sorted(StdPurePath(s) for s in strings)
+
+        assert [str(p) for p in fast_sorted] == [str(p) for p in std_sorted]
+        assert PureFastPath("a") < PureFastPath("a/b")
+        assert PureFastPath("a/b") <= PureFastPath("a/b")
+        assert PureFastPath("b") > PureFastPath("a/z")
+
     def test_is_absolute(self) -> None:
         """Test absolute path detection."""
         test_cases = [
@@ -187,6 +224,43 @@ class TestPurePathCompatibility:
             fast_path = PureFastPath(path_str)
             assert fast_path.is_relative_to(base_str) == expected
 
+    def test_parents(self, pure_path_pairs: list[Tuple[StdPurePath, PureFastPath]]) -> None:
+        """Test parents matches pathlib."""
+        for std_path, fast_path in pure_path_pairs:
+            assert [str(p) for p in fast_path.parents] == [str(p) for p in std_path.parents]
+
+    def test_commonpath(self) -> None:
+        """Test commonpath matches os.path.commonpath."""
+        cases = [
+            ["/home/user/a.txt", "/home/user/docs/b.txt", "/home/other"],
+            ["/home/user", "/home/user"],
+            ["src/pkg/mod.py", "src/pkg/sub/mod.py"],
+            ["/a", "/b"],
+        ]
+        for paths in cases:
+            fast_paths = [PureFastPath(p) for p in paths]
+            assert str(fastpath.commonpath(fast_paths)) == os.path.commonpath(paths)
+
+        assert str(fastpath.commonpath([PureFastPath("/x/y"), "/x/z"])) == "/x"
+        with pytest.raises(ValueError):
+            fastpath.commonpath([])
+        with pytest.raises(ValueError):
+            fastpath.commonpath([PureFastPath("/a"), PureFastPath("a")])
+
+    def test_match(self) -> None:
+        """Test match against pathlib."""
+        cases = [
+            ("/home/user/a.py", ["*.py", "user/*.py", "/home/*/*.py", "/user/*.py", "*.txt", "**/a.py"]),
+            ("src/pkg/mod.py", ["src/*/*.py", "pkg/[lm]od.py", "*/*", "?????/*.py", "src/**/mod.py"]),
+            ("caf\u00e9/\u00e9t\u00e9.txt", ["*/?t?.txt", "caf?/*", "[\u00e9]*.txt"]),
+        ]
+        for path_str, patterns in cases:
+            for pattern in patterns:
+                assert PureFastPath(path_str).match(pattern) == StdPurePath(path_str).match(pattern), pattern
+
+        with pytest.raises(ValueError):
+            PureFastPath("a").match("")
+
     def test_with_name(self) -> None:
         """Test with_name method."""
         test_cases = [
@@ -224,6 +298,27 @@ class TestPurePathCompatibility:
             fast_path = PureFastPath(original).with_stem(new_stem)
             assert str(fast_path) == str(std_path) == expected
 
+    @pytest.mark.parametrize(
+        "method, argument",
+        [
+            ("with_name", ""),
+            ("with_name", "."),
+            ("with_name", "a/b"),
+            ("with_suffix", "txt"),
+            ("with_suffix", "."),
+            ("with_suffix", "./x"),
+            ("with_stem", "a/b"),
+        ],
+    )
+    def test_with_invalid(self, method: str, argument: str) -> None:
+        """Test that invalid names and suffixes raise like pathlib."""
+        with pytest.raises(ValueError):
+            getattr(StdPurePath("/a/b.txt"), method)(argument)
+        with pytest.raises(ValueError):
+            getattr(PureFastPath("/a/b.txt"), method)(argument)
+        with pytest.raises(ValueError):
+            getattr(PureFastPath("/"), method)("x.txt" if method != "with_suffix" else ".txt")
+
 
 class TestFastPathCompatibility:
     """Test FastPath I/O operations."""
@@ -342,6 +437,157 @@ class TestFastPathCompatibility:
         assert fast_contents == std_contents
         assert len(fast_contents) == len(files) + len(dirs)
 
+    def test_stat(self, temp_dir: str) -> None:
+        """Test stat and lstat match os."""
+        test_file = os.path.join(temp_dir, "test.txt")
+        with open(test_file, "w") as f:
+            f.write("test")
+        link = os.path.join(temp_dir, "link")
+        os.symlink(test_file, link)
+
+        assert FastPath(test_file).stat() == os.stat(test_file)
+        assert FastPath(test_file).stat().st_mtime_ns == os.stat(test_file).st_mtime_ns
+        assert FastPath(link).lstat() == os.lstat(link)
+        assert FastPath(link).stat(follow_symlinks=False) == os.lstat(link)
+        with pytest.raises(FileNotFoundError):
+            FastPath(os.path.join(temp_dir, "missing")).stat()
+        assert not FastPath(os.path.join(temp_dir, "test.txt", "below")).exists()
+
+    def test_iterdir_shares_tree(self, temp_dir: str) -> None:
+        """Test that listed entries are children of the directory's node."""
+        for name in ("a.txt", "b.txt", "caf\u00e9"):
+            open(os.path.join(temp_dir, name), "w").close()
+
+        directory = FastPath(temp_dir)
+        entries = sorted(directory.iterdir(), key=str)
+
+        assert [p.name for p in entries] == ["a.txt", "b.txt", "caf\u00e9"]
+        assert all(p.parent == directory for p in entries)
+        assert entries[0] == FastPath(os.path.join(temp_dir, "a.txt"))
+
+    def test_undecodable_names(self, temp_dir: str) -> None:
+        """Test that names that are not valid UTF-8 keep their bytes."""
+        raw = os.path.join(os.fsencode(temp_dir), b"caf\xe9.txt")
+        try:
+            open(raw, "wb").close()
+        except OSError:
+            pytest.skip("filesystem rejects names that are not UTF-8")
+
+        (entry,) = FastPath(temp_dir).iterdir()
+        assert bytes(entry) == raw
+        assert entry == FastPath(raw) == FastPath(os.fsdecode(raw))
+        assert entry.exists()
+
+    def test_walk(self, temp_dir: str) -> None:
+        """Test walk against os.walk, pruning and bottom-up order."""
+        os.makedirs(os.path.join(temp_dir, "a", "b"))
+        os.mkdir(os.path.join(temp_dir, "skip"))
+        for name in ("top.txt", "a/mid.txt", "a/b/leaf.txt", "skip/hidden.txt"):
+            open(os.path.join(temp_dir, name), "w").close()
+
+        def normalize(results: Any) -> list:
+            return sorted((str(d), sorted(ds), sorted(fs)) for d, ds, fs in results)
+
+        assert normalize(FastPath(temp_dir).walk()) == normalize(os.walk(temp_dir))
+
+        visited = []
+        for dirpath, dirnames, _ in FastPath(temp_dir).walk():
+            visited.append(dirpath)
+            dirnames[:] = [d for d in dirnames if d != "skip"]
+        assert FastPath(temp_dir, "skip") not in visited
+        assert FastPath(temp_dir, "a", "b") in visited
+
+        bottom_up = [dirpath for dirpath, _, _ in FastPath(temp_dir).walk(top_down=False)]
+        assert bottom_up.index(FastPath(temp_dir, "a", "b")) < bottom_up.index(FastPath(temp_dir, "a"))
+        assert bottom_up[-1] == FastPath(temp_dir)
+
+        errors: list = []
+        assert list(FastPath(temp_dir, "missing").walk(on_error=errors.append)) == []
+        assert len(errors) == 1 and isinstance(errors[0], FileNotFoundError)
+
+    def test_walk_collects_cycles(self, temp_dir: str) -> None:
+        """Test that a walker kept alive only by its own on_error handler is collected."""
+        os.mkdir(os.path.join(temp_dir, "a"))
+
+        class Handler:
+            walker: Any = None
+
+            def __call__(self, error: OSError) -> None:
+                pass
+
+        handler = Handler()
+        handler.walker = FastPath(temp_dir).walk(on_error=handler)
+        next(handler.walker)
+        ref = weakref.ref(handler)
+        del handler
+        gc.collect()
+        assert ref() is None
+
+    def test_walk_symlinks(self, temp_dir: str) -> None:
+        """Test that symlinked directories are only entered when following links."""
+        os.makedirs(os.path.join(temp_dir, "real"))
+        open(os.path.join(temp_dir, "real", "file.txt"), "w").close()
+        os.symlink(os.path.join(temp_dir, "real"), os.path.join(temp_dir, "link"))
+
+        top = next(iter(FastPath(temp_dir).walk()))
+        assert top[1] == ["real"] and top[2] == ["link"]
+        followed = [str(d) for d, _, _ in FastPath(temp_dir).walk(follow_symlinks=True)]
+        assert os.path.join(temp_dir, "link") in followed
+
+    def test_scan(self, temp_dir: str) -> None:
+        """Test PathAllocator.scan against os.walk."""
+        for i in range(20):
+            os.makedirs(os.path.join(temp_dir, f"d{i}", "sub"))
+            with open(os.path.join(temp_dir, f"d{i}", "sub", "f.txt"), "w") as f:
+                f.write("x" * i)
+        os.symlink(temp_dir, os.path.join(temp_dir, "d0", "loop"))
+
+        expected = set()
+        for dirpath, dirnames, filenames in os.walk(temp_dir):
+            expected.update(os.path.join(dirpath, name) for name in dirnames + filenames)
+
+        allocator = fastpath.PathAllocator()
+        root = allocator.scan(temp_dir, threads=4)
+        found = {str(p) for p in allocator.iter_descendants(root, path_type=FastPath)}
+        assert found == expected
+        assert root == allocator.from_string(temp_dir)
+
+        # d0/loop points back at the root, so it is listed but not entered
+        allocator = fastpath.PathAllocator()
+        root = allocator.scan(temp_dir, follow_symlinks=True)
+        assert allocator.count_descendants(root) == len(expected)
+
+        root, columns = allocator.scan(temp_dir, stat=True)
+        assert len(columns["node"]) == len(expected)
+        leaf = allocator.from_string(os.path.join(temp_dir, "d7", "sub", "f.txt"))
+        i = list(columns["node"]).index(leaf)
+        assert columns["size"][i] == 7
+        assert columns["mode"][i] == os.lstat(os.path.join(temp_dir, "d7", "sub", "f.txt")).st_mode
+
+        with pytest.raises(FileNotFoundError):
+            allocator.scan(os.path.join(temp_dir, "missing"))
+
+    def test_glob(self, temp_dir: str) -> None:
+        """Test glob and rglob against pathlib."""
+        os.makedirs(os.path.join(temp_dir, "a", "b"))
+        os.makedirs(os.path.join(temp_dir, "c"))
+        for name in ("x.py", "a/y.py", "a/b/z.py", "a/b/notes.txt", "c/w.txt"):
+            open(os.path.join(temp_dir, name), "w").close()
+        os.symlink(os.path.join(temp_dir, "a"), os.path.join(temp_dir, "c", "link"))
+
+        def found(paths: Any) -> list:
+            return sorted(str(p) for p in paths)
+
+        for pattern in ("*.py", "*/*.py", "**/*.py", "**", "a/**", "*/", "c/*/*.py", "[ax]*", "**/b/*", "missing/*"):
+            assert found(FastPath(temp_dir).glob(pattern)) == found(StdPath(temp_dir).glob(pattern)), pattern
+        for pattern in ("*.py", "*.txt", "b"):
+            assert found(FastPath(temp_dir).rglob(pattern)) == found(StdPath(temp_dir).rglob(pattern)), pattern
+
+        # Matches are added to the directory's tree
+        matches = list(FastPath(temp_dir).glob("a/*.py"))
+        assert matches == [FastPath(temp_dir, "a", "y.py")]
+        assert matches[0].parent.parent == FastPath(temp_dir)
+
     def test_unlink(self, temp_dir: str) -> None:
         """Test unlink method."""
         test_file = os.path.join(temp_dir, "to_delete.txt")
@@ -423,10 +669,10 @@ class TestEdgeCases:
 
     def test_path_with_dots(self) -> None:
         """Test paths with . and .. components."""
-        # Note: Our implementation doesn't normalize these automatically
-        # This matches pathlib.PurePath behavior
+        # "." is dropped but ".." is kept, matching pathlib.PurePath behavior
         fast_path = PureFastPath("/home/./user/../documents")
-        assert "." in fast_path.parts
+        assert fast_path.parts == StdPurePath("/home/./user/../documents").parts
+        assert "." not in fast_path.parts
         assert ".." in fast_path.parts
 
     def test_path_from_path(self) -> None:
@@ -442,4 +688,40 @@ class TestEdgeCases:
         std_path = StdPath("/home/user")
         fast_path = FastPath(std_path)
 
-        assert str(fast_path) == str(std_path)
\ No newline at end of file
+        assert str(fast_path) == str(std_path)
+
+    def test_derived_paths_keep_type(self) -> None:
+        """Test that parent and join results keep the path type."""
+        fast_path = FastPath("/home/user/file.txt")
+        pure_path = PureFastPath("/home/user/file.txt")
+
+        assert type(fast_path.parent) is FastPath
+        assert type(fast_path / "x") is FastPath
+        assert type(pure_path.parent) is PureFastPath
+        assert type(pure_path / "x") is PureFastPath
+        assert fast_path.parent._allocator is fast_path._allocator
+
+    def test_subclass_construction(self) -> None:
+        """Test that subclasses keep their own construction path."""
+
+        class MyPath(PureFastPath):
+            created = 0
+
+            def __init__(self, *args, **kwargs) -> None:
+                MyPath.created += 1
+                super().__init__(*args, **kwargs)
+
+        path = MyPath("/home/user")
+        parent = path.parent
+
+        assert type(parent) is MyPath
+        assert str(parent) == "/home"
+        assert MyPath.created == 2
+
+    def test_many_short_lived_paths(self) -> None:
+        """Test that recycled path objects are fully reinitialized."""
+        base = PureFastPath("/data")
+        for i in range(1000):
+            child = base / f"item{i}"
+            assert str(child) == f"/data/item{i}"
+            assert child.parent == base
@@ -166,6 +166,28 @@ class TestAllocatorBenchmarks:
 
         benchmark(construct_paths)
 
+    @pytest.mark.parametrize("tree_size", [1_000, 100_000])
+    def test_path_construction_large_tree(self, benchmark: Any, tree_size: int) -> None:
+        """Benchmark path construction against an already populated tree."""
+        allocator = PathAllocator()
+        for i in range(tree_size // 4):
+            allocator.from_parts("data", f"shard{i % 100}", f"entry{i}")
+
+        def construct_paths() -> list[int]:
+            return [
+                allocator.from_parts("data", f"shard{i % 100}", f"entry{i}")
+                for i in range(1000)
+            ]
+
+        benchmark(construct_paths)
+
+    def test_batch_construction(self, benchmark: Any) -> None:
+        """Benchmark batch construction from a file listing."""
+        allocator = PathAllocator()
+        listing = [f"/repo/src/pkg{i % 50}/module{i % 500}/file{i}.py" for i in range(10000)]
+
+        benchmark(allocator.from_strings, listing)
+
     def test_tree_traversal(self, benchmark: Any) -> None:
         """Benchmark tree traversal operations."""
         allocator = PathAllocator()
@@ -0,0 +1,254 @@
+"""Scaling curves for the allocator on large synthetic and replayed trees.
+
+test_performance.py times small workloads against pathlib. This suite
+measures how every operation behaves as trees grow, on corpora shaped to
+stress one part of the design each:
+
+- balanced: a few levels of moderately wide directories
+- deep: paths more than 60 levels deep below a shared spine
+- wide: every path a sibling in one directory
+- unique: every component a distinct string
+
+FASTPATH_SCALING picks the sizes: "smoke" (the default, fast enough for
+every test run), "full" (1M to 10M paths) or "huge" (up to 50M paths). Set
+FASTPATH_SCALING_REPLAY to a directory, or to a file listing one path per
+line, to replay a real tree through the same operations.
+FASTPATH_SCALING_REPORT names a JSON file to write the curves to.
+"""
+
+import os
+import tempfile
+import threading
+import time
+from typing import Any
+from typing import Callable
+from typing import Dict
+from typing import List
+from typing import Optional
+
+import pytest
+
+from fastpath import PathAllocator
+from fastpath import PureFastPath
+
+
+TIERS = {
+    "smoke": (10_000, 100_000),
+    "full": (1_000_000, 5_000_000, 10_000_000),
+    "huge": (1_000_000, 10_000_000, 50_000_000),
+}
+TIER = os.environ.get("FASTPATH_SCALING", "smoke")
+SIZES = TIERS[TIER]
+REPLAY = os.environ.get("FASTPATH_SCALING_REPLAY")
+
+# Per-path operations are timed on an evenly spaced sample of this size
+SAMPLE = 100_000
+
+EXTENSIONS = ("py", "txt", "json", "c", "md")
+DEEP_SPINE = "/".join(f"level{k}" for k in range(56))
+
+
+def balanced_path(i: int) -> str:
+    return f"/balanced/d{i % 31}/d{i // 31 % 37}/d{i // 1147 % 41}/f{i}.{EXTENSIONS[i % 5]}"
+
+
+def deep_path(i: int) -> str:
+    branch = "/".join(f"n{(i >> (2 * k)) & 3}" for k in range(10))
+    return f"/deep/{DEEP_SPINE}/{branch}/f{i}.{EXTENSIONS[i % 5]}"
+
+
+def wide_path(i: int) -> str:
+    return f"/wide/entry{i}.{EXTENSIONS[i % 5]}"
+
+
+def unique_path(i: int) -> str:
+    x = (i * 0x9E3779B97F4A7C15) & 0xFFFFFFFFFFFFFFFF
+    return f"/unique/{x:016x}/{x >> 23:x}/n{i}.{EXTENSIONS[i % 5]}"
+
+
+CORPORA: Dict[str, Callable[[int], str]] = {
+    "balanced": balanced_path,
+    "deep": deep_path,
+    "wide": wide_path,
+    "unique": unique_path,
+}
+
+
+def corpus_listing(corpus: str, size: int) -> bytes:
+    """The corpus as a newline-separated buffer, the cheapest input to from_strings()."""
+    make = CORPORA[corpus]
+    return "\n".join(make(i) for i in range(size)).encode()
+
+
+def rss_bytes() -> Optional[int]:
+    """Current resident set size, or None where it cannot be read."""
+    try:
+        with open("/proc/self/statm") as f:
+            return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+    except (OSError, ValueError, AttributeError):
+        return None
+
+
+def record(
+    report: List[Dict[str, Any]],
+    corpus: str,
+    size: int,
+    op: str,
+    items: int,
+    seconds: float,
+    rss_delta: Optional[int] = None,
+    threads: int = 1,
+) -> Dict[str, Any]:
+    row = {
+        "corpus": corpus,
+        "size": size,
+        "op": op,
+        "threads": threads,
+        "items": items,
+        "seconds": seconds,
+        "items_per_second": items / seconds if seconds > 0 else float("inf"),
+        "rss_delta": rss_delta,
+        "bytes_per_item": rss_delta / items if rss_delta is not None and items else None,
+    }
+    report.append(row)
+    return row
+
+
+def timed(fn: Callable[[], Any]) -> "tuple[Any, float, Optional[int]]":
+    """Run fn once, returning its result, the elapsed time and the RSS it added."""
+    before = rss_bytes()
+    start = time.perf_counter()
+    result = fn()
+    elapsed = time.perf_counter() - start
+    after = rss_bytes()
+    rss_delta = after - before if before is not None and after is not None else None
+    return result, elapsed, rss_delta
+
+
+def sample(nodes: Any) -> List[int]:
+    step = max(1, len(nodes) // SAMPLE)
+    return list(nodes[::step])
+
+
+def measure_tree(report: List[Dict[str, Any]], corpus: str, listing: bytes, root: str) -> None:
+    """Time every operation against one listing, from construction to teardown."""
+    allocator = PathAllocator(track_paths=True)
+    nodes, seconds, rss_delta = timed(lambda: allocator.from_strings(listing))
+    size = len(nodes)
+    stats = allocator.stats()
+    row = record(report, corpus, size, "build", size, seconds, rss_delta)
+    row["nodes"] = stats["nodes_allocated"]
+    row["strings"] = stats["strings_interned"]
+    # RSS misses memory that earlier tests freed and this build reused, so
+    # also report what the allocator's own arrays hold
+    structure_bytes = stats["node_bytes"] + stats["string_bytes"] + stats["child_index_bytes"]
+    row["structure_bytes_per_item"] = structure_bytes / size
+
+    _, seconds, _ = timed(lambda: allocator.from_strings(listing))
+    record(report, corpus, size, "lookup", size, seconds)
+
+    picked = sample(nodes)
+    strings, seconds, _ = timed(
+        lambda: [str(PureFastPath(allocator=allocator, _node_idx=i)) for i in picked]
+    )
+    record(report, corpus, size, "str", len(picked), seconds)
+
+    _, seconds, _ = timed(lambda: [allocator.get_parents(i) for i in picked])
+    record(report, corpus, size, "parents", len(picked), seconds)
+
+    root_idx = allocator.from_string(root)
+    count, seconds, _ = timed(lambda: sum(1 for _ in allocator.iter_descendants(root_idx)))
+    record(report, corpus, size, "descendants", count, seconds)
+
+    _, seconds, _ = timed(lambda: allocator.glob(root_idx, "**/*.py"))
+    record(report, corpus, size, "glob", count, seconds)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        snapshot = os.path.join(tmp, "tree.snap")
+        _, seconds, _ = timed(lambda: allocator.save(snapshot))
+        record(report, corpus, size, "save", stats["nodes_allocated"], seconds)
+        loaded, seconds, _ = timed(lambda: PathAllocator.load(snapshot))
+        record(report, corpus, size, "load", stats["nodes_allocated"], seconds)
+        del loaded
+
+    # Keep one path in ten, as a long-running process would after churn
+    keep = nodes[::10]
+    _, seconds, _ = timed(lambda: allocator.compact(keep=keep))
+    record(report, corpus, size, "compact", stats["nodes_allocated"], seconds)
+
+    assert strings[0].encode() == listing[: listing.find(b"\n")]
+
+
+@pytest.mark.parametrize("size", SIZES)
+@pytest.mark.parametrize("corpus", sorted(CORPORA))
+def test_scaling_curve(scaling_report: List[Dict[str, Any]], corpus: str, size: int) -> None:
+    """Record throughput and memory for every operation on one corpus size."""
+    measure_tree(scaling_report, corpus, corpus_listing(corpus, size), f"/{corpus}")
+
+
+@pytest.mark.parametrize("corpus", sorted(CORPORA))
+def test_build_is_linear(scaling_report: List[Dict[str, Any]], corpus: str) -> None:
+    """Construction cost per path must not grow with the tree."""
+    small, large = SIZES[0], SIZES[-1]
+    per_path = {}
+    for size in (small, large):
+        listing = corpus_listing(corpus, size)
+        best = float("inf")
+        for _ in range(3):
+            allocator = PathAllocator()
+            _, seconds, _ = timed(lambda: allocator.from_strings(listing))
+            best = min(best, seconds)
+            del allocator
+        per_path[size] = best / size
+
+    # Cache misses grow with the tree, but a quadratic step would make the
+    # large tree at least 10x slower per path
+    ratio = per_path[large] / per_path[small]
+    row = record(scaling_report, corpus, large, "build_ratio", large, best)
+    row["ratio"] = ratio
+    assert ratio < 5, f"{corpus}: {ratio:.1f}x the per-path cost at {large} paths"
+
+
+@pytest.mark.parametrize("threads", [1, 2, 4, 8])
+def test_threaded_construction(scaling_report: List[Dict[str, Any]], threads: int) -> None:
+    """Build one shared tree from several threads, each inserting its own slice."""
+    size = SIZES[-1]
+    lines = corpus_listing("balanced", size).split(b"\n")
+    chunks = [b"\n".join(lines[t::threads]) for t in range(threads)]
+    allocator = PathAllocator()
+    results: List[Any] = [None] * threads
+
+    def work(t: int) -> None:
+        results[t] = allocator.from_strings(chunks[t])
+
+    workers = [threading.Thread(target=work, args=(t,)) for t in range(threads)]
+
+    def run() -> None:
+        for worker in workers:
+            worker.start()
+        for worker in workers:
+            worker.join()
+
+    _, seconds, rss_delta = timed(run)
+    record(scaling_report, "balanced", size, "build", size, seconds, rss_delta, threads=threads)
+
+    assert sum(len(r) for r in results) == size
+    assert len(set().union(*results)) == size
+
+
+@pytest.mark.skipif(REPLAY is None, reason="set FASTPATH_SCALING_REPLAY to replay a real tree")
+def test_replay(scaling_report: List[Dict[str, Any]]) -> None:
+    """Replay a real directory tree or path listing through every operation."""
+    assert REPLAY is not None
+    if os.path.isdir(REPLAY):
+        allocator = PathAllocator()
+        root_idx, seconds, rss_delta = timed(lambda: allocator.scan(REPLAY, threads=os.cpu_count()))
+        found = allocator.count_descendants(root_idx)
+        record(scaling_report, "replay", found, "scan", found, seconds, rss_delta)
+        listing = b"\n".join(allocator.get_bytes(i) for i in allocator.iter_descendants(root_idx))
+        root = REPLAY
+    else:
+        with open(REPLAY, "rb") as f:
+            listing = f.read().rstrip(b"\n")
+        root = "/" if listing.startswith(b"/") else "."
+    measure_tree(scaling_report, "replay", listing, root)